@@ -92,6 +92,7 @@ Alignment::Alignment()
 
 Alignment::~Alignment()
 {
+  if (m_file.IsOpen()) return; // arrays point into the mapped file
   if (m_array != NULL) {
     free(m_array);
   }
@@ -190,16 +191,30 @@ void Alignment::Save(const string& fileName ) const
     exit(1);
   }
 
-  fwrite( &m_size, sizeof(INDEX), 1, pFile );
-  fwrite( m_array, sizeof(int), m_size*2, pFile ); // corpus
+  MappedFile::WriteMagic( pFile );
+  MappedFile::WriteSection( pFile, &m_size, sizeof(INDEX) );
+  MappedFile::WriteSection( pFile, m_array, sizeof(int) * m_size*2 ); // corpus
 
-  fwrite( &m_sentenceCount, sizeof(INDEX), 1, pFile );
-  fwrite( m_sentenceEnd, sizeof(INDEX), m_sentenceCount, pFile); // sentence index
+  MappedFile::WriteSection( pFile, &m_sentenceCount, sizeof(INDEX) );
+  MappedFile::WriteSection( pFile, m_sentenceEnd, sizeof(INDEX) * m_sentenceCount ); // sentence index
   fclose( pFile );
 }
 
 void Alignment::Load(const string& fileName )
 {
+  if (m_file.Open( fileName + ".align" )) {
+    cerr << "mapping " << fileName << ".align" << endl;
+    m_size = m_file.NextValue<INDEX>();
+    cerr << "alignment points in corpus: " << m_size << endl;
+    m_array = m_file.Next<int>( m_size*2 );
+    m_sentenceCount = m_file.NextValue<INDEX>();
+    cerr << "sentences in corpus: " << m_sentenceCount << endl;
+    m_sentenceEnd = m_file.Next<INDEX>( m_sentenceCount );
+    cerr << "done loading\n";
+    return;
+  }
+
+  // saved before the arrays were aligned for mapping
   FILE *pFile = fopen ( (fileName + ".align").c_str() , "r" );
   if (pFile == NULL) {
     cerr << "no such file or directory: " << fileName << ".align" << endl;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Vocabulary.h"
+#include "MappedFile.h"
 
 class Alignment
 {
@@ -13,6 +14,7 @@ private:
   INDEX m_size;
   INDEX m_sentenceCount;
   char m_unaligned[ 256 ]; // here for speed (local to PhraseAlignment)
+  MappedFile m_file;
 
   // No copying allowed.
   Alignment(const Alignment&);
@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+const char MAGIC[8] = { 'b', 'i', 'c', 'o', 'n', 'c', 'o', '1' };
+const size_t ALIGNMENT = 8;
+
+size_t Padded( size_t size )
+{
+  return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+} // namespace
+
+using namespace std;
+
+MappedFile::MappedFile()
+  : m_data(NULL),
+    m_size(0),
+    m_offset(0) {}
+
+MappedFile::~MappedFile()
+{
+  if (m_data != NULL) {
+    munmap( m_data, m_size );
+  }
+}
+
+bool MappedFile::Open( const string& fileName )
+{
+  int fd = open( fileName.c_str(), O_RDONLY );
+  if (fd == -1) {
+    cerr << "Error: no such file or directory " << fileName << endl;
+    exit(1);
+  }
+  struct stat info;
+  if (fstat( fd, &info ) == -1) {
+    cerr << "Error: cannot stat " << fileName << endl;
+    exit(1);
+  }
+
+  // older layout: leave it to fread()
+  char magic[ sizeof(MAGIC) ];
+  if ((size_t) info.st_size < sizeof(MAGIC) ||
+      pread( fd, magic, sizeof(MAGIC), 0 ) != (ssize_t) sizeof(MAGIC) ||
+      memcmp( magic, MAGIC, sizeof(MAGIC) ) != 0) {
+    close( fd );
+    return false;
+  }
+
+  void *data = mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if (data == MAP_FAILED) {
+    cerr << "Error: cannot memory map " << fileName << endl;
+    exit(1);
+  }
+  m_data = (char*) data;
+  m_size = info.st_size;
+  m_offset = Padded( sizeof(MAGIC) );
+  m_fileName = fileName;
+  return true;
+}
+
+const char *MappedFile::NextSection( size_t size )
+{
+  if (m_offset + size > m_size) {
+    cerr << "Error: " << m_fileName << " is truncated" << endl;
+    exit(1);
+  }
+  const char *section = m_data + m_offset;
+  m_offset += Padded( size );
+  return section;
+}
+
+void MappedFile::WriteMagic( FILE *pFile )
+{
+  WriteSection( pFile, MAGIC, sizeof(MAGIC) );
+}
+
+void MappedFile::WriteSection( FILE *pFile, const void *data, size_t size )
+{
+  static const char padding[ ALIGNMENT ] = { 0 };
+  if (fwrite( data, 1, size, pFile ) != size ||
+      fwrite( padding, 1, Padded( size ) - size, pFile ) != Padded( size ) - size) {
+    cerr << "Error: could not write saved model" << endl;
+    exit(1);
+  }
+}
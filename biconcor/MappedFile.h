@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+/** Saved model files that are memory mapped instead of read into the heap.
+ *  The file starts with a magic string, followed by sections that are each
+ *  padded to 8 bytes, so that every array can be used in place.  Files
+ *  without the magic string are in the older fread() layout. */
+class MappedFile
+{
+private:
+  char *m_data;
+  size_t m_size;
+  size_t m_offset;
+  std::string m_fileName;
+
+  // No copying allowed.
+  MappedFile(const MappedFile&);
+  void operator=(const MappedFile&);
+
+  const char *NextSection( size_t size );
+
+public:
+  MappedFile();
+  ~MappedFile();
+
+  // returns false if the file is in the older layout, and then does not map it
+  bool Open( const std::string& fileName );
+  bool IsOpen() const {
+    return m_data != NULL;
+  }
+
+  // next section, holding count elements of type T
+  template<class T> T *Next( size_t count ) {
+    return (T*) NextSection( sizeof(T) * count );
+  }
+  template<class T> T NextValue() {
+    return *Next<T>( 1 );
+  }
+
+  static void WriteMagic( FILE *pFile );
+  static void WriteSection( FILE *pFile, const void *data, size_t size );
+};
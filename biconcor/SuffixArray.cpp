@@ -4,12 +4,73 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <cmath>
+
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
 
 namespace
 {
 
 const int LINE_MAX_LENGTH = 10000;
 
+typedef SuffixArray::INDEX INDEX;
+
+// the order of CompareIndex(), but on word ranks instead of word strings
+class SuffixOrderer
+{
+public:
+  SuffixOrderer( const WORD_ID *array, INDEX size, const std::vector< INDEX > &rank )
+    : m_array(array), m_size(size), m_rank(rank) {}
+
+  // suffixes in the same bucket start with the same word
+  bool operator()( INDEX a, INDEX b ) const {
+    INDEX offset = 1;
+    while( a+offset < m_size &&
+           b+offset < m_size &&
+           m_array[ a+offset ] == m_array[ b+offset ] ) {
+      offset++;
+    }
+    if( a+offset == m_size ) return true;
+    if( b+offset == m_size ) return false;
+    return m_rank[ m_array[ a+offset ] ] < m_rank[ m_array[ b+offset ] ];
+  }
+
+private:
+  const WORD_ID *m_array;
+  INDEX m_size;
+  const std::vector< INDEX > &m_rank;
+};
+
+// orders word ids by their strings
+class WordOrderer
+{
+public:
+  WordOrderer( const Vocabulary &vcb ) : m_vcb(vcb) {}
+  bool operator()( WORD_ID a, WORD_ID b ) const {
+    return m_vcb.GetWord(a) < m_vcb.GetWord(b);
+  }
+private:
+  const Vocabulary &m_vcb;
+};
+
+typedef std::pair< INDEX, INDEX > Bucket;
+
+bool LargerBucket( const Bucket &a, const Bucket &b )
+{
+  return a.second - a.first > b.second - b.first;
+}
+
+void SortBuckets( INDEX *index, const std::vector< Bucket > *buckets, const SuffixOrderer *orderer )
+{
+  for(size_t i=0; i<buckets->size(); i++) {
+    std::sort( index + (*buckets)[i].first, index + (*buckets)[i].second, *orderer );
+  }
+}
+
 } // namespace
 
 using namespace std;
@@ -17,21 +78,23 @@ using namespace std;
 SuffixArray::SuffixArray()
   : m_array(NULL),
     m_index(NULL),
-    m_buffer(NULL),
     m_wordInSentence(NULL),
     m_sentence(NULL),
     m_sentenceLength(NULL),
     m_document(NULL),
     m_documentName(NULL),
+    m_documentNameBuffer(NULL),
     m_documentNameLength(0),
     m_documentCount(0),
     m_useDocument(false),
     m_vcb(),
     m_size(0),
-    m_sentenceCount(0) { }
+    m_sentenceCount(0),
+    m_threads(1) { }
 
 SuffixArray::~SuffixArray()
 {
+  if (m_file.IsOpen()) return; // arrays point into the mapped file
   free(m_array);
   free(m_index);
   free(m_wordInSentence);
@@ -39,6 +102,7 @@ SuffixArray::~SuffixArray()
   free(m_sentenceLength);
   free(m_document);
   free(m_documentName);
+  free(m_documentNameBuffer);
 }
 
 void SuffixArray::Create(const string& fileName )
@@ -128,16 +192,7 @@ void SuffixArray::Create(const string& fileName )
   cerr << "done reading " << wordIndex << " words, " << sentenceId << " sentences." << endl;
   // List(0,9);
 
-  // sort
-  m_buffer = (INDEX*) calloc( sizeof( INDEX ), m_size );
-
-  if (m_buffer == NULL) {
-    cerr << "Error: cannot allocate memory to m_buffer" << endl;
-    exit(1);
-  }
-
-  Sort( 0, m_size-1 );
-  free( m_buffer );
+  Sort();
   cerr << "done sorting" << endl;
 }
 
@@ -180,35 +235,64 @@ bool SuffixArray::ProcessDocumentLine( const char *line, const size_t sentenceId
   return true;
 }
 
-// good ol' quick sort
-void SuffixArray::Sort(INDEX start, INDEX end)
+// bucket the suffixes by their first word, in the order of the word
+// strings, then sort the buckets on m_threads threads
+void SuffixArray::Sort()
 {
-  if (start == end) return;
-  INDEX mid = (start+end+1)/2;
-  Sort( start, mid-1 );
-  Sort( mid, end );
-
-  // merge
-  INDEX i = start;
-  INDEX j = mid;
-  INDEX k = 0;
-  INDEX length = end-start+1;
-  while( k<length ) {
-    if (i == mid ) {
-      m_buffer[ k++ ] = m_index[ j++ ];
-    } else if (j > end ) {
-      m_buffer[ k++ ] = m_index[ i++ ];
-    } else {
-      if (CompareIndex( m_index[i], m_index[j] ) < 0) {
-        m_buffer[ k++ ] = m_index[ i++ ];
-      } else {
-        m_buffer[ k++ ] = m_index[ j++ ];
-      }
+  // rank of each word id, so that suffixes are compared on integers
+  vector< WORD_ID > byString( m_vcb.vocab.size() );
+  for(WORD_ID id=0; id<byString.size(); id++) {
+    byString[ id ] = id;
+  }
+  std::sort( byString.begin(), byString.end(), WordOrderer( m_vcb ) );
+  vector< INDEX > rank( byString.size() );
+  for(INDEX r=0; r<byString.size(); r++) {
+    rank[ byString[ r ] ] = r;
+  }
+
+  // counting sort by rank of the first word
+  vector< INDEX > bucketStart( rank.size()+1, 0 );
+  for(INDEX i=0; i<m_size; i++) {
+    bucketStart[ rank[ m_array[i] ]+1 ]++;
+  }
+  for(size_t r=1; r<bucketStart.size(); r++) {
+    bucketStart[r] += bucketStart[r-1];
+  }
+  vector< INDEX > next( bucketStart.begin(), bucketStart.end()-1 );
+  for(INDEX i=0; i<m_size; i++) {
+    m_index[ next[ rank[ m_array[i] ] ]++ ] = i;
+  }
+
+  // hand out the buckets largest first to the least loaded thread
+  vector< Bucket > buckets;
+  for(size_t r=0; r+1<bucketStart.size(); r++) {
+    if (bucketStart[r+1] - bucketStart[r] > 1) {
+      buckets.push_back( Bucket( bucketStart[r], bucketStart[r+1] ) );
     }
   }
+  std::stable_sort( buckets.begin(), buckets.end(), LargerBucket );
+  vector< vector< Bucket > > assigned( m_threads );
+  vector< double > load( m_threads, 0 );
+  for(size_t i=0; i<buckets.size(); i++) {
+    size_t thread = min_element( load.begin(), load.end() ) - load.begin();
+    assigned[ thread ].push_back( buckets[i] );
+    INDEX size = buckets[i].second - buckets[i].first;
+    load[ thread ] += size * log( (double) size );
+  }
 
-  memcpy( ((char*)m_index) + sizeof( INDEX ) * start,
-          ((char*)m_buffer), sizeof( INDEX ) * (end-start+1) );
+  SuffixOrderer orderer( m_array, m_size, rank );
+#ifdef WITH_THREADS
+  boost::thread_group threads;
+  for(size_t t=1; t<m_threads; t++) {
+    threads.create_thread( boost::bind( &SortBuckets, m_index, &assigned[t], &orderer ) );
+  }
+  SortBuckets( m_index, &assigned[0], &orderer );
+  threads.join_all();
+#else
+  for(size_t t=0; t<m_threads; t++) {
+    SortBuckets( m_index, &assigned[t], &orderer );
+  }
+#endif
 }
 
 int SuffixArray::CompareIndex( INDEX a, INDEX b ) const
@@ -405,23 +489,27 @@ void SuffixArray::Save(const string& fileName ) const
   FILE *pFile = fopen ( fileName.c_str() , "w" );
   if (pFile == NULL) Error("cannot open",fileName);
 
-  fwrite( &m_size, sizeof(INDEX), 1, pFile );
-  fwrite( m_array, sizeof(WORD_ID), m_size, pFile ); // corpus
-  fwrite( m_index, sizeof(INDEX), m_size, pFile );   // suffix array
-  fwrite( m_wordInSentence, sizeof(char), m_size, pFile); // word index
-  fwrite( m_sentence, sizeof(INDEX), m_size, pFile); // sentence index
+  // every array in its own aligned section, so that Load() can map them
+  MappedFile::WriteMagic( pFile );
+  MappedFile::WriteSection( pFile, &m_size, sizeof(INDEX) );
+  MappedFile::WriteSection( pFile, m_array, sizeof(WORD_ID) * m_size ); // corpus
+  MappedFile::WriteSection( pFile, m_index, sizeof(INDEX) * m_size );   // suffix array
+  MappedFile::WriteSection( pFile, m_wordInSentence, sizeof(char) * m_size ); // word index
+  MappedFile::WriteSection( pFile, m_sentence, sizeof(INDEX) * m_size ); // sentence index
 
-  fwrite( &m_sentenceCount, sizeof(INDEX), 1, pFile );
-  fwrite( m_sentenceLength, sizeof(char), m_sentenceCount, pFile); // sentence length
+  MappedFile::WriteSection( pFile, &m_sentenceCount, sizeof(INDEX) );
+  MappedFile::WriteSection( pFile, m_sentenceLength, sizeof(char) * m_sentenceCount ); // sentence length
 
-  char useDocument = m_useDocument; // not sure if that is needed
-  fwrite( &useDocument, sizeof(char), 1, pFile );
+  char useDocument = m_useDocument;
+  MappedFile::WriteSection( pFile, &useDocument, sizeof(char) );
   if (m_useDocument) {
-    fwrite( &m_documentCount, sizeof(INDEX), 1, pFile );
-    fwrite( m_document, sizeof(INDEX), m_documentCount, pFile );
-    fwrite( m_documentName, sizeof(INDEX), m_documentCount, pFile );
-    fwrite( &m_documentNameLength, sizeof(INDEX), 1, pFile );
-    fwrite( m_documentNameBuffer, sizeof(char), m_documentNameLength, pFile );
+    INDEX documentCount = m_documentCount;
+    INDEX documentNameLength = m_documentNameLength;
+    MappedFile::WriteSection( pFile, &documentCount, sizeof(INDEX) );
+    MappedFile::WriteSection( pFile, m_document, sizeof(INDEX) * m_documentCount );
+    MappedFile::WriteSection( pFile, m_documentName, sizeof(INDEX) * m_documentCount );
+    MappedFile::WriteSection( pFile, &documentNameLength, sizeof(INDEX) );
+    MappedFile::WriteSection( pFile, m_documentNameBuffer, sizeof(char) * m_documentNameLength );
   }
   fclose( pFile );
 
@@ -430,11 +518,45 @@ void SuffixArray::Save(const string& fileName ) const
 
 void SuffixArray::Load(const string& fileName )
 {
-  FILE *pFile = fopen ( fileName.c_str() , "r" );
-  if (pFile == NULL) Error("no such file or directory", fileName);
-
   cerr << "loading from " << fileName << endl;
+  if (!m_file.Open( fileName )) {
+    FILE *pFile = fopen ( fileName.c_str() , "r" );
+    if (pFile == NULL) Error("no such file or directory", fileName);
+    LoadLegacy( pFile, fileName );
+    fclose( pFile );
+    m_vcb.Load( fileName + ".src-vcb" );
+    return;
+  }
+
+  m_size = m_file.NextValue<INDEX>();
+  cerr << "words in corpus: " << m_size << endl;
+  m_array = m_file.Next<WORD_ID>( m_size );
+  m_index = m_file.Next<INDEX>( m_size );
+  m_wordInSentence = m_file.Next<char>( m_size );
+  m_sentence = m_file.Next<INDEX>( m_size );
 
+  m_sentenceCount = m_file.NextValue<INDEX>();
+  cerr << "sentences in corpus: " << m_sentenceCount << endl;
+  m_sentenceLength = m_file.Next<char>( m_sentenceCount );
+
+  if (m_useDocument) {
+    if (!m_file.NextValue<char>()) {
+      cerr << "Error: stored suffix array does not have a document index\n";
+      exit(1);
+    }
+    m_documentCount = m_file.NextValue<INDEX>();
+    m_document = m_file.Next<INDEX>( m_documentCount );
+    m_documentName = m_file.Next<INDEX>( m_documentCount );
+    m_documentNameLength = m_file.NextValue<INDEX>();
+    m_documentNameBuffer = m_file.Next<char>( m_documentNameLength );
+  }
+
+  m_vcb.Load( fileName + ".src-vcb" );
+}
+
+// saved before the arrays were aligned for mapping
+void SuffixArray::LoadLegacy( FILE *pFile, const string& fileName )
+{
   fread( &m_size, sizeof(INDEX), 1, pFile )
   || Error("could not read m_size from", fileName);
   cerr << "words in corpus: " << m_size << endl;
@@ -490,10 +612,6 @@ void SuffixArray::Load(const string& fileName )
     fread( m_documentNameBuffer, sizeof(char), m_documentNameLength, pFile )
     || Error("could not read m_document from", fileName);
   }
-
-  fclose( pFile );
-
-  m_vcb.Load( fileName + ".src-vcb" );
 }
 
 void SuffixArray::CheckAllocation( bool check, const char *dataStructure ) const
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Vocabulary.h"
+#include "MappedFile.h"
 
 class SuffixArray
 {
@@ -10,7 +11,6 @@ public:
 private:
   WORD_ID *m_array;
   INDEX *m_index;
-  INDEX *m_buffer;
   char *m_wordInSentence;
   INDEX *m_sentence;
   char *m_sentenceLength;
@@ -24,6 +24,10 @@ private:
   Vocabulary m_vcb;
   INDEX m_size;
   INDEX m_sentenceCount;
+  size_t m_threads;
+  MappedFile m_file;
+
+  void LoadLegacy( FILE *pFile, const std::string& fileName );
 
   // No copying allowed.
   SuffixArray(const SuffixArray&);
@@ -35,7 +39,7 @@ public:
 
   void Create(const std::string& fileName );
   bool ProcessDocumentLine( const char* const, const size_t );
-  void Sort(INDEX start, INDEX end);
+  void Sort();
   int CompareIndex( INDEX a, INDEX b ) const;
   inline int CompareWord( WORD_ID a, WORD_ID b ) const;
   int Count( const std::vector< WORD > &phrase );
@@ -69,6 +73,9 @@ public:
   void UseDocument() {
     m_useDocument = true;
   }
+  void SetThreads( size_t threads ) {
+    m_threads = threads > 0 ? threads : 1;
+  }
   INDEX GetDocument( INDEX sentence ) const;
   void PrintDocumentName( INDEX document ) {
     for(INDEX i=m_documentName[ document ]; m_documentNameBuffer[i] != 0; i++) {
@@ -23,6 +23,7 @@ TargetCorpus::TargetCorpus()
 
 TargetCorpus::~TargetCorpus()
 {
+  if (m_file.IsOpen()) return; // arrays point into the mapped file
   free(m_array);
   free(m_sentenceEnd);
 }
@@ -127,11 +128,12 @@ void TargetCorpus::Save(const string& fileName ) const
     exit(1);
   }
 
-  fwrite( &m_size, sizeof(INDEX), 1, pFile );
-  fwrite( m_array, sizeof(WORD_ID), m_size, pFile ); // corpus
+  MappedFile::WriteMagic( pFile );
+  MappedFile::WriteSection( pFile, &m_size, sizeof(INDEX) );
+  MappedFile::WriteSection( pFile, m_array, sizeof(WORD_ID) * m_size ); // corpus
 
-  fwrite( &m_sentenceCount, sizeof(INDEX), 1, pFile );
-  fwrite( m_sentenceEnd, sizeof(INDEX), m_sentenceCount, pFile); // sentence index
+  MappedFile::WriteSection( pFile, &m_sentenceCount, sizeof(INDEX) );
+  MappedFile::WriteSection( pFile, m_sentenceEnd, sizeof(INDEX) * m_sentenceCount ); // sentence index
   fclose( pFile );
 
   m_vcb.Save( fileName + ".tgt-vcb" );
@@ -139,6 +141,19 @@ void TargetCorpus::Save(const string& fileName ) const
 
 void TargetCorpus::Load(const string& fileName )
 {
+  if (m_file.Open( fileName + ".tgt" )) {
+    cerr << "mapping " << fileName << ".tgt" << endl;
+    m_size = m_file.NextValue<INDEX>();
+    cerr << "words in corpus: " << m_size << endl;
+    m_array = m_file.Next<WORD_ID>( m_size );
+    m_sentenceCount = m_file.NextValue<INDEX>();
+    cerr << "sentences in corpus: " << m_sentenceCount << endl;
+    m_sentenceEnd = m_file.Next<INDEX>( m_sentenceCount );
+    m_vcb.Load( fileName + ".tgt-vcb" );
+    return;
+  }
+
+  // saved before the arrays were aligned for mapping
   FILE *pFile = fopen ( (fileName + ".tgt").c_str() , "r" );
   if (pFile == NULL) {
     cerr << "Cannot open " << fileName << endl;
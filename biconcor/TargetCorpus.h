@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Vocabulary.h"
+#include "MappedFile.h"
 
 class TargetCorpus
 {
@@ -13,6 +14,7 @@ private:
   Vocabulary m_vcb;
   INDEX m_size;
   INDEX m_sentenceCount;
+  MappedFile m_file;
 
   // No copying allowed.
   TargetCorpus(const TargetCorpus&);
@@ -24,7 +24,8 @@ int main(int argc, char* argv[])
   int stdioFlag = false;  // receive requests from STDIN, respond to STDOUT
   int max_translation = 20;
   int max_example = 50;
-  string info = "usage: biconcor\n\t[--load model-file]\n\t[--save model-file]\n\t[--create source-corpus]\n\t[--query string]\n\t[--target target-corpus]\n\t[--alignment file]\n\t[--translations count]\n\t[--examples count]\n\t[--html]\n\t[--stdio]\n";
+  int threads = 1;
+  string info = "usage: biconcor\n\t[--load model-file]\n\t[--save model-file]\n\t[--create source-corpus]\n\t[--query string]\n\t[--target target-corpus]\n\t[--alignment file]\n\t[--translations count]\n\t[--examples count]\n\t[--html]\n\t[--stdio]\n\t[--threads count]\n";
   while(1) {
     static struct option long_options[] = {
       {"load", required_argument, 0, 'l'},
@@ -38,10 +39,11 @@ int main(int argc, char* argv[])
       {"stdio", no_argument, 0, 'i'},
       {"translations", required_argument, 0, 'o'},
       {"examples", required_argument, 0, 'e'},
+      {"threads", required_argument, 0, 'T'},
       {0, 0, 0, 0}
     };
     int option_index = 0;
-    int c = getopt_long (argc, argv, "l:s:c:q:Q:t:a:hpio:e:", long_options, &option_index);
+    int c = getopt_long (argc, argv, "l:s:c:q:Q:t:a:hpio:e:T:", long_options, &option_index);
     if (c == -1) break;
     switch (c) {
     case 'l':
@@ -76,6 +78,9 @@ int main(int argc, char* argv[])
     case 'e':
       max_example = atoi(optarg);
       break;
+    case 'T':
+      threads = atoi(optarg);
+      break;
     case 'p':
       prettyFlag = true;
       break;
@@ -116,6 +121,7 @@ int main(int argc, char* argv[])
   SuffixArray suffixArray;
   TargetCorpus targetCorpus;
   Alignment alignment;
+  suffixArray.SetThreads( threads );
   if (createFlag) {
     cerr << "will create\n";
     cerr << "source corpus is in " << fileNameSource << endl;
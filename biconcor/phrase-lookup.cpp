@@ -2,12 +2,21 @@
 #include "../util/tokenize.hh"
 #include <getopt.h>
 
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
 using namespace std;
 
 size_t lookup( string );
+void lookupBatch( const vector< string > &queries, int threads );
 vector<string> tokenize( const char input[] );
 SuffixArray suffixArray;
 
+// queries answered at a time in batch mode
+const size_t BATCH_SIZE = 100000;
+
 int main(int argc, char* argv[])
 {
   // handle parameters
@@ -21,7 +30,9 @@ int main(int argc, char* argv[])
   bool querySentenceFlag = false;
 
   int stdioFlag = false;  // receive requests from STDIN, respond to STDOUT
-  string info = "usage: biconcor\n\t[--load model-file]\n\t[--save model-file]\n\t[--create corpus]\n\t[--query string]\n\t[--stdio]\n";
+  bool batchFlag = false; // all of STDIN at once, answered on several threads
+  int threads = 1;
+  string info = "usage: biconcor\n\t[--load model-file]\n\t[--save model-file]\n\t[--create corpus]\n\t[--query string]\n\t[--stdio]\n\t[--batch]\n\t[--threads count]\n";
   while(1) {
     static struct option long_options[] = {
       {"load", required_argument, 0, 'l'},
@@ -32,10 +43,12 @@ int main(int argc, char* argv[])
       {"document", required_argument, 0, 'd'},
       {"stdio", no_argument, 0, 'i'},
       {"stdio-sentence", no_argument, 0, 'I'},
+      {"batch", no_argument, 0, 'b'},
+      {"threads", required_argument, 0, 'T'},
       {0, 0, 0, 0}
     };
     int option_index = 0;
-    int c = getopt_long (argc, argv, "l:s:c:q:Q:iId", long_options, &option_index);
+    int c = getopt_long (argc, argv, "l:s:c:q:Q:iIdbT:", long_options, &option_index);
     if (c == -1) break;
     switch (c) {
     case 'l':
@@ -68,6 +81,12 @@ int main(int argc, char* argv[])
     case 'd':
       suffixArray.UseDocument();
       break;
+    case 'b':
+      batchFlag = true;
+      break;
+    case 'T':
+      threads = atoi(optarg);
+      break;
     default:
       cerr << info;
       exit(1);
@@ -88,7 +107,13 @@ int main(int argc, char* argv[])
     exit(1);
   }
 
+  if (batchFlag && querySentenceFlag) {
+    cerr << "error: batch mode only counts matches\n" << info;
+    exit(1);
+  }
+
   // get suffix array
+  suffixArray.SetThreads( threads );
   if (createFlag) {
     cerr << "will create\n";
     cerr << "corpus is in " << fileNameSource << endl;
@@ -104,7 +129,18 @@ int main(int argc, char* argv[])
   }
 
   // do something with it
-  if (stdioFlag) {
+  if (batchFlag) {
+    vector< string > queries;
+    string query;
+    while(getline(cin, query, '\n')) {
+      queries.push_back( query );
+      if (queries.size() == BATCH_SIZE) {
+        lookupBatch( queries, threads );
+        queries.clear();
+      }
+    }
+    lookupBatch( queries, threads );
+  } else if (stdioFlag) {
     while(true) {
       string query;
       if (getline(cin, query, '\n').eof()) {
@@ -132,3 +168,31 @@ size_t lookup( string query )
   vector< string > queryString = util::tokenize( query.c_str() );
   return suffixArray.Count( queryString );
 }
+
+void countQueries( const vector< string > *queries, vector< size_t > *counts, size_t start, size_t stride )
+{
+  for(size_t i=start; i<queries->size(); i+=stride) {
+    vector< string > queryString = util::tokenize( (*queries)[i].c_str() );
+    (*counts)[i] = queryString.empty() ? 0 : suffixArray.Count( queryString );
+  }
+}
+
+// counts are printed in the order of the queries
+void lookupBatch( const vector< string > &queries, int threads )
+{
+  vector< size_t > counts( queries.size() );
+#ifdef WITH_THREADS
+  boost::thread_group workers;
+  for(int t=1; t<threads; t++) {
+    workers.create_thread( boost::bind( &countQueries, &queries, &counts, t, threads ) );
+  }
+  countQueries( &queries, &counts, 0, threads > 1 ? threads : 1 );
+  workers.join_all();
+#else
+  countQueries( &queries, &counts, 0, 1 );
+#endif
+  for(size_t i=0; i<counts.size(); i++) {
+    cout << counts[i] << '\n';
+  }
+  cout << flush;
+}
@@ -1,6 +1,7 @@
 #include "lm/filter/arpa_io.hh"
 #include "lm/filter/format.hh"
 #include "lm/filter/phrase.hh"
+#include "lm/filter/trie_filter.hh"
 #ifndef NTHREAD
 #include "lm/filter/thread.hh"
 #endif
@@ -21,7 +22,7 @@ namespace {
 
 void DisplayHelp(const char *name) {
   std::cerr
-    << "Usage: " << name << " mode [context] [phrase] [raw|arpa] [threads:m] [batch_size:m] (vocab|model):input_file output_file\n\n"
+    << "Usage: " << name << " mode [context] [phrase] [raw|arpa|binary] [threads:m] [batch_size:m] (vocab|model):input_file output_file\n\n"
     "copy mode just copies, but makes the format nicer for e.g. irstlm's broken\n"
     "    parser.\n"
     "single mode treats the entire input as a single sentence.\n"
@@ -38,7 +39,10 @@ void DisplayHelp(const char *name) {
     "The file format is set by [raw|arpa] with default arpa:\n"
     "raw means space-separated tokens, optionally followed by a tab and arbitrary\n"
     "    text.  This is useful for ngram count files.\n"
-    "arpa means the ARPA file format for n-gram language models.\n\n"
+    "arpa means the ARPA file format for n-gram language models.\n"
+    "binary means a KenLM trie binary, which is filtered to a binary of the same\n"
+    "    type without parsing text.  Only single mode is supported and the model\n"
+    "    must be given as a file.  Orders are filtered in parallel.\n\n"
 #ifndef NTHREAD
     "threads:m sets m threads (default: conccurrency detected by boost)\n"
     "batch_size:m sets the batch size for threading.  Expect memory usage from this\n"
@@ -55,7 +59,7 @@ void DisplayHelp(const char *name) {
 }
 
 typedef enum {MODE_COPY, MODE_SINGLE, MODE_MULTIPLE, MODE_UNION, MODE_UNSET} FilterMode;
-typedef enum {FORMAT_ARPA, FORMAT_COUNT} Format;
+typedef enum {FORMAT_ARPA, FORMAT_COUNT, FORMAT_BINARY} Format;
 
 struct Config {
   Config() :
@@ -185,6 +189,8 @@ int main(int argc, char *argv[]) {
         config.format = lm::FORMAT_ARPA;
       } else if (!std::strcmp(str, "raw")) {
         config.format = lm::FORMAT_COUNT;
+      } else if (!std::strcmp(str, "binary")) {
+        config.format = lm::FORMAT_BINARY;
 #ifndef NTHREAD
       } else if (!std::strncmp(str, "threads:", 8)) {
         config.threads = boost::lexical_cast<size_t>(str + 8);
@@ -238,6 +244,21 @@ int main(int argc, char *argv[]) {
       vocab = &cmd_file;
     }
 
+    if (config.format == lm::FORMAT_BINARY) {
+      if (config.mode != lm::MODE_SINGLE || config.phrase || !cmd_is_model) {
+        std::cerr << "Binary filtering supports only single mode, with the model given as a file and the vocabulary on stdin." << std::endl;
+        return 1;
+      }
+      boost::unordered_set<std::string> words;
+      lm::vocab::ReadSingle(*vocab, words);
+#ifndef NTHREAD
+      lm::ngram::trie::FilterTrie(cmd_input, words, config.context, config.threads, argv[argc - 1]);
+#else
+      lm::ngram::trie::FilterTrie(cmd_input, words, config.context, 1, argv[argc - 1]);
+#endif
+      return 0;
+    }
+
     util::FilePiece model(cmd_is_model ? util::OpenReadOrThrow(cmd_input) : 0, cmd_is_model ? cmd_input : NULL, &std::cerr);
 
     if (config.format == lm::FORMAT_ARPA) {
@@ -0,0 +1,374 @@
+#include "lm/filter/trie_filter.hh"
+
+#include "lm/bhiksha.hh"
+#include "lm/binary_format.hh"
+#include "lm/config.hh"
+#include "lm/enumerate_vocab.hh"
+#include "lm/filter/vocab.hh"
+#include "lm/lm_exception.hh"
+#include "lm/max_order.hh"
+#include "lm/quantize.hh"
+#include "lm/search_trie.hh"
+#include "lm/vocab.hh"
+#include "util/bit_packing.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/string_piece_hash.hh"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#ifndef NTHREAD
+#include <boost/thread/thread.hpp>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+namespace lm {
+namespace ngram {
+namespace trie {
+
+namespace {
+
+inline unsigned int PopCount(uint64_t value) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(value);
+#else
+  unsigned int ret = 0;
+  for (; value; value &= value - 1) ++ret;
+  return ret;
+#endif
+}
+
+// The entries of one order that survive, with ranks to renumber pointers.
+class KeepSet {
+  public:
+    KeepSet() : count_(0) {}
+
+    void Resize(uint64_t entries) {
+      // One more word so that Rank(entries) can be asked.
+      bits_.assign(entries / 64 + 1, 0);
+    }
+
+    // Threads may set entries concurrently if they write different 64-entry blocks.
+    void Set(uint64_t index) {
+      bits_[index >> 6] |= 1ULL << (index & 63);
+    }
+
+    bool Test(uint64_t index) const {
+      return (bits_[index >> 6] >> (index & 63)) & 1;
+    }
+
+    void FinishedSetting() {
+      cumulative_.resize(bits_.size());
+      count_ = 0;
+      for (std::size_t i = 0; i < bits_.size(); ++i) {
+        cumulative_[i] = count_;
+        count_ += PopCount(bits_[i]);
+      }
+    }
+
+    // Number of entries before index that survive.
+    uint64_t Rank(uint64_t index) const {
+      return cumulative_[index >> 6] + PopCount(bits_[index >> 6] & ((1ULL << (index & 63)) - 1));
+    }
+
+    uint64_t Count() const { return count_; }
+
+  private:
+    std::vector<uint64_t> bits_;
+    std::vector<uint64_t> cumulative_;
+    uint64_t count_;
+};
+
+// Decides which words pass while the vocabulary strings are read.
+class PassWords : public EnumerateVocab {
+  public:
+    // keep_all keeps every word as a unigram, whether it passes or not.
+    PassWords(const boost::unordered_set<std::string> &vocab, WordIndex bound, bool keep_all)
+      : vocab_(vocab), passes_(bound, false), keep_all_(keep_all) {}
+
+    void Add(WordIndex index, const StringPiece &str) {
+      UTIL_THROW_IF(index >= passes_.size(), FormatLoadException, "The binary file has more vocabulary words than unigrams.");
+      passes_[index] = vocab::IsTag(str) || FindStringPiece(vocab_, str) != vocab_.end();
+      if (index && (keep_all_ || passes_[index])) kept_.push_back(std::string(str.data(), str.size()));
+    }
+
+    const std::vector<bool> &Passes() const { return passes_; }
+
+    // Words that remain unigrams in id order, except <unk>.
+    const std::vector<std::string> &Kept() const { return kept_; }
+
+  private:
+    const boost::unordered_set<std::string> &vocab_;
+    std::vector<bool> passes_;
+    const bool keep_all_;
+    std::vector<std::string> kept_;
+};
+
+void CopyBits(util::BitAddress from, util::BitAddress to, uint8_t bits) {
+  while (bits) {
+    uint8_t length = std::min<uint8_t>(bits, 57);
+    util::WriteInt57(to.base, to.offset, length, util::ReadInt57(from.base, from.offset, length, (1ULL << length) - 1));
+    from.offset += length;
+    to.offset += length;
+    bits -= length;
+  }
+}
+
+// Calls function(i) for i in [0, tasks) on up to threads threads.
+void RunTasks(std::size_t tasks, std::size_t threads, const boost::function<void (std::size_t)> &function);
+
+#ifndef NTHREAD
+void RunStrided(const boost::function<void (std::size_t)> &function, std::size_t first, std::size_t step, std::size_t tasks) {
+  for (std::size_t i = first; i < tasks; i += step) function(i);
+}
+#endif
+
+void RunTasks(std::size_t tasks, std::size_t threads, const boost::function<void (std::size_t)> &function) {
+  threads = std::min(threads, tasks);
+#ifndef NTHREAD
+  if (threads > 1) {
+    boost::thread_group group;
+    for (std::size_t t = 0; t < threads; ++t) {
+      group.create_thread(boost::bind(&RunStrided, boost::cref(function), t, threads, tasks));
+    }
+    group.join_all();
+    return;
+  }
+#endif
+  for (std::size_t i = 0; i < tasks; ++i) function(i);
+}
+
+} // namespace
+
+/* Walks the trie one order at a time.  An entry survives if its parent does
+ * and its word passes, so dropping a word drops everything below it.
+ * Surviving entries are then copied with their word ids and pointers
+ * renumbered and their weights copied bit for bit, which also preserves
+ * quantization.
+ */
+template <class Quant, class Bhiksha> class TrieFilter {
+  public:
+    typedef TrieSearch<Quant, Bhiksha> Search;
+
+    TrieFilter(Search &in, const std::vector<uint64_t> &counts)
+      : in_(in), counts_(counts), keep_(counts.size()) {}
+
+    // Order 0 is unigrams.
+    void Keep(const std::vector<bool> &passes, bool context, std::size_t threads) {
+      passes_ = &passes;
+      keep_[0].Resize(counts_[0]);
+      for (uint64_t i = 0; i < counts_[0]; ++i) {
+        // With context, the trie is keyed by the last word so unigrams always survive.
+        if (context || passes[i]) keep_[0].Set(i);
+      }
+      keep_[0].FinishedSetting();
+      for (unsigned char level = 1; level < counts_.size(); ++level) {
+        keep_[level].Resize(counts_[level]);
+        // Chunks are multiples of 64 entries so threads set different words.
+        uint64_t chunk = std::max<uint64_t>(1 << 16, ((counts_[level] / threads) + 63) & ~static_cast<uint64_t>(63));
+        std::size_t chunks = (counts_[level] + chunk - 1) / chunk;
+        RunTasks(chunks, threads, boost::bind(&TrieFilter::KeepChunk, this, level, chunk, _1));
+        keep_[level].FinishedSetting();
+      }
+      renumber_.resize(counts_[0]);
+      for (uint64_t i = 0; i < counts_[0]; ++i) {
+        renumber_[i] = keep_[0].Rank(i);
+      }
+    }
+
+    std::vector<uint64_t> Counts() const {
+      std::vector<uint64_t> ret;
+      for (unsigned char level = 0; level < counts_.size(); ++level) {
+        ret.push_back(keep_[level].Count());
+      }
+      return ret;
+    }
+
+    // Each order is written by its own task.
+    void Write(Search &out, const Config &config, std::size_t threads) {
+      RunTasks(counts_.size(), threads, boost::bind(&TrieFilter::WriteOrder, this, boost::ref(out), boost::cref(config), _1));
+    }
+
+  private:
+    NodeRange Children(unsigned char level, uint64_t parent) const {
+      NodeRange ret;
+      if (level == 0) {
+        const UnigramValue *value = in_.unigram_.Raw() + parent;
+        ret.begin = value[0].next;
+        ret.end = value[1].next;
+      } else {
+        in_.middle_begin_[level - 1].ReadEntry(parent, ret);
+      }
+      return ret;
+    }
+
+    WordIndex Word(unsigned char level, uint64_t index) const {
+      if (level == counts_.size() - 1) return in_.longest_.ReadWord(index);
+      return in_.middle_begin_[level - 1].ReadWord(index);
+    }
+
+    void KeepChunk(unsigned char level, uint64_t chunk, std::size_t number) {
+      const uint64_t begin = number * chunk;
+      const uint64_t end = std::min(begin + chunk, counts_[level]);
+      // Binary search for the parent of begin.
+      uint64_t parent = 0, high = counts_[level - 1];
+      while (parent < high) {
+        uint64_t mid = parent + (high - parent) / 2;
+        if (Children(level - 1, mid).end <= begin) {
+          parent = mid + 1;
+        } else {
+          high = mid;
+        }
+      }
+      const KeepSet &parents = keep_[level - 1];
+      KeepSet &keep = keep_[level];
+      NodeRange range = Children(level - 1, parent);
+      for (uint64_t i = begin; i < end; ++i) {
+        while (range.end <= i) range = Children(level - 1, ++parent);
+        if (parents.Test(parent) && (*passes_)[Word(level, i)]) keep.Set(i);
+      }
+    }
+
+    void WriteOrder(Search &out, const Config &config, std::size_t level) {
+      if (level == 0) {
+        WriteUnigrams(out);
+      } else if (level == counts_.size() - 1) {
+        WriteLongest(out, config);
+      } else {
+        WriteMiddle(out, config, level);
+      }
+    }
+
+    void WriteUnigrams(Search &out) {
+      const UnigramValue *from = in_.unigram_.Raw();
+      UnigramValue *to = out.unigram_.Raw();
+      const KeepSet &next = keep_[1];
+      for (uint64_t i = 0; i < counts_[0]; ++i) {
+        if (!keep_[0].Test(i)) continue;
+        to->weights = from[i].weights;
+        to->next = next.Rank(from[i].next);
+        ++to;
+      }
+      // The end pointer for the last unigram.
+      to->next = next.Count();
+    }
+
+    void WriteMiddle(Search &out, const Config &config, unsigned char level) {
+      typename Search::Middle &from = in_.middle_begin_[level - 1];
+      typename Search::Middle &to = out.middle_begin_[level - 1];
+      const KeepSet &keep = keep_[level], &next = keep_[level + 1];
+      const uint8_t bits = Quant::MiddleBits(config);
+      NodeRange range;
+      for (uint64_t i = 0; i < counts_[level]; ++i) {
+        if (!keep.Test(i)) continue;
+        util::BitAddress weights(from.ReadEntry(i, range));
+        CopyBits(weights, to.Insert(renumber_[from.ReadWord(i)], next.Rank(range.begin)), bits);
+      }
+      to.FinishedLoading(next.Count(), config);
+    }
+
+    void WriteLongest(Search &out, const Config &config) {
+      const KeepSet &keep = keep_.back();
+      const uint8_t bits = Quant::LongestBits(config);
+      for (uint64_t i = 0; i < counts_.back(); ++i) {
+        if (!keep.Test(i)) continue;
+        CopyBits(in_.longest_.ReadEntry(i), out.longest_.Insert(renumber_[in_.longest_.ReadWord(i)]), bits);
+      }
+    }
+
+    Search &in_;
+    const std::vector<uint64_t> &counts_;
+    std::vector<KeepSet> keep_;
+    const std::vector<bool> *passes_;
+    std::vector<WordIndex> renumber_;
+};
+
+namespace {
+
+template <class Quant, class Bhiksha> void Filter(const char *in_file, const boost::unordered_set<std::string> &vocab, bool context, std::size_t threads, const char *out_file) {
+  typedef TrieSearch<Quant, Bhiksha> Search;
+  // Load the input much like GenericModel does, keeping hold of the pieces.
+  Config config;
+  BinaryFormat in_backing(config);
+  Parameters params;
+  util::scoped_fd fd(util::OpenReadOrThrow(in_file));
+  int fd_shallow = fd.release();
+  in_backing.InitializeBinary(fd_shallow, Search::kModelType, Search::kVersion, params);
+  const std::vector<uint64_t> &counts = params.counts;
+  UTIL_THROW_IF(counts.size() > KENLM_MAX_ORDER, FormatLoadException, "This model has order " << counts.size() << " but KenLM was compiled to support up to " << KENLM_MAX_ORDER << ".  " << KENLM_ORDER_MESSAGE);
+  UTIL_THROW_IF(!params.fixed.has_vocabulary, FormatLoadException, in_file << " does not contain its vocabulary strings, so it cannot be filtered.  Rebuild it with an updated build_binary.");
+  const std::size_t in_vocab_size = SortedVocabulary::Size(counts[0], config);
+  Search::UpdateConfigFromBinary(in_backing, counts, in_vocab_size, config);
+  uint8_t *in_base = static_cast<uint8_t*>(in_backing.LoadBinary(in_vocab_size + Search::Size(counts, config)));
+  SortedVocabulary in_vocab;
+  in_vocab.SetupMemory(in_base, in_vocab_size, counts[0], config);
+  Search in_search;
+  in_search.SetupMemory(in_base + in_vocab_size, counts, config);
+  PassWords passes(vocab, counts[0], context);
+  in_vocab.LoadedBinary(true, fd_shallow, &passes, in_backing.VocabStringReadingOffset());
+
+  TrieFilter<Quant, Bhiksha> filter(in_search, counts);
+  filter.Keep(passes.Passes(), context, threads);
+  const std::vector<uint64_t> out_counts(filter.Counts());
+
+  config.write_mmap = out_file;
+  config.write_method = Config::WRITE_AFTER;
+  config.include_vocab = true;
+  BinaryFormat out_backing(config);
+  const std::size_t out_vocab_size = SortedVocabulary::Size(out_counts[0], config);
+  SortedVocabulary out_vocab;
+  out_vocab.SetupMemory(out_backing.SetupJustVocab(out_vocab_size, out_counts.size()), out_vocab_size, out_counts[0], config);
+  WriteWordsWrapper words(NULL);
+  out_vocab.ConfigureEnumerate(&words, out_counts[0]);
+  // Ids were assigned in hash order, so the survivors are already sorted and
+  // keep the ids the filter renumbered them to.
+  for (std::vector<std::string>::const_iterator i = passes.Kept().begin(); i != passes.Kept().end(); ++i) {
+    out_vocab.Insert(*i);
+  }
+  std::vector<ProbBackoff> unused(out_counts[0]);
+  out_vocab.FinishedLoading(&unused[0]);
+
+  void *vocab_base;
+  uint8_t *out_base = static_cast<uint8_t*>(out_backing.GrowForSearch(Search::Size(out_counts, config), 0, vocab_base));
+  out_vocab.Relocate(vocab_base);
+  Search out_search;
+  out_search.SetupMemory(out_base, out_counts, config);
+  // Quantization tables are unchanged.
+  std::copy(in_base + in_vocab_size, in_base + in_vocab_size + Quant::Size(counts.size(), config), out_base);
+  filter.Write(out_search, config, threads);
+
+  void *vocab_rebase, *search_rebase;
+  out_backing.WriteVocabWords(words.Buffer(), vocab_rebase, search_rebase);
+  out_backing.FinishFile(config, Search::kModelType, Search::kVersion, out_counts);
+}
+
+} // namespace
+
+void FilterTrie(const char *in_file, const boost::unordered_set<std::string> &vocab, bool context, std::size_t threads, const char *out_file) {
+  // Keep zero from reaching the chunk size computation.
+  threads = std::max<std::size_t>(threads, 1);
+  ModelType type;
+  UTIL_THROW_IF(!RecognizeBinary(in_file, type), FormatLoadException, in_file << " is not a KenLM binary file.  Filter it as arpa instead.");
+  switch (type) {
+    case TRIE:
+      Filter<DontQuantize, DontBhiksha>(in_file, vocab, context, threads, out_file);
+      break;
+    case QUANT_TRIE:
+      Filter<SeparatelyQuantize, DontBhiksha>(in_file, vocab, context, threads, out_file);
+      break;
+    case ARRAY_TRIE:
+      Filter<DontQuantize, ArrayBhiksha>(in_file, vocab, context, threads, out_file);
+      break;
+    case QUANT_ARRAY_TRIE:
+      Filter<SeparatelyQuantize, ArrayBhiksha>(in_file, vocab, context, threads, out_file);
+      break;
+    default:
+      UTIL_THROW(FormatLoadException, in_file << " is a " << kModelNames[type] << " model, which stores hashes of n-grams instead of their words.  Only trie models can be filtered in binary form.");
+  }
+}
+
+} // namespace trie
+} // namespace ngram
+} // namespace lm
@@ -0,0 +1,32 @@
+#ifndef LM_FILTER_TRIE_FILTER_H
+#define LM_FILTER_TRIE_FILTER_H
+
+// Vocabulary filtering of trie binary models without going through ARPA.
+
+#include <boost/unordered/unordered_set.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace lm {
+namespace ngram {
+namespace trie {
+
+/* Write to out_file the n-grams of the trie binary in_file whose words all
+ * appear in vocab (or, with context, all but the last word).  Tags like <s>
+ * always pass.  The result is a binary of the same type and quantization
+ * with a vocabulary renumbered to the words that survive.
+ *
+ * Only trie models can be filtered: probing models store hashes, not the
+ * words of their n-grams.
+ *
+ * Orders are filtered by separate threads, up to threads at a time.  A threads
+ * of 0 is taken as 1.
+ */
+void FilterTrie(const char *in_file, const boost::unordered_set<std::string> &vocab, bool context, std::size_t threads, const char *out_file);
+
+} // namespace trie
+} // namespace ngram
+} // namespace lm
+
+#endif // LM_FILTER_TRIE_FILTER_H
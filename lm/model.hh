@@ -75,6 +75,19 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
      */
     void GetState(const WordIndex *context_rbegin, const WordIndex *context_rend, State &out_state) const;
 
+    /* Hint that new_word will soon be scored after the context
+     * [context_rbegin, context_rend), in the same reverse order as
+     * FullScoreForgotState.  With probing hash tables this starts loading the
+     * buckets the lookup will probe, so that several queries can wait on
+     * memory at the same time.  It does not change any results.
+     */
+    void Prefetch(const WordIndex *context_rbegin, const WordIndex *context_rend, const WordIndex new_word) const {
+      search_.Prefetch(context_rbegin, std::min(context_rend, context_rbegin + P::Order() - 1), new_word);
+    }
+    void Prefetch(const State &in_state, const WordIndex new_word) const {
+      search_.Prefetch(in_state.words, in_state.words + in_state.length, new_word);
+    }
+
     /* More efficient version of FullScore where a partial n-gram has already
      * been scored.
      * NOTE: THE RETURNED .rest AND .prob ARE RELATIVE TO THE .rest RETURNED BEFORE.
@@ -8,16 +8,35 @@
 #include "util/usage.hh"
 
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <cmath>
 
+#include <stdint.h>
+
+#ifdef WITH_THREADS
+#include "util/pcqueue.hh"
+
+#include <boost/thread/thread.hpp>
+
+#include <vector>
+#endif
+
 namespace lm {
 namespace ngram {
 
+// Per-sentence record of the optional binary output, in native byte order.
+struct SentenceScore {
+  float total; // log10 probability, </s> included
+  uint32_t oov;
+  uint32_t tokens; // </s> included
+};
+
 class QueryPrinter {
   public:
-    QueryPrinter(int fd, bool print_word, bool print_line, bool print_summary, bool flush)
-      : out_(fd), print_word_(print_word), print_line_(print_line), print_summary_(print_summary), flush_(flush) {}
+    // binary_fd, if not -1, receives a SentenceScore for each sentence.
+    QueryPrinter(int fd, bool print_word, bool print_line, bool print_summary, bool flush, int binary_fd = -1)
+      : out_(fd), binary_(binary_fd), print_word_(print_word), print_line_(print_line), print_summary_(print_summary), flush_(flush), print_binary_(binary_fd != -1) {}
 
     void Word(StringPiece surface, WordIndex vocab, const FullScoreReturn &ret) {
       if (!print_word_) return;
@@ -25,7 +44,15 @@ class QueryPrinter {
       if (flush_) out_.flush();
     }
 
-    void Line(uint64_t oov, float total) {
+    void Line(uint64_t oov, float total, uint64_t tokens) {
+      if (print_binary_) {
+        SentenceScore score;
+        score.total = total;
+        score.oov = static_cast<uint32_t>(oov);
+        score.tokens = static_cast<uint32_t>(tokens);
+        binary_.write(&score, sizeof(SentenceScore));
+        if (flush_) binary_.flush();
+      }
       if (!print_line_) return;
       out_ << "Total: " << total << " OOV: " << oov << '\n';
       if (flush_) out_.flush();
@@ -39,14 +66,17 @@ class QueryPrinter {
         "OOVs:\t" << corpus_oov << "\n"
         "Tokens:\t" << corpus_tokens << '\n';
       out_.flush();
+      if (print_binary_) binary_.flush();
     }
 
   private:
     util::FileStream out_;
+    util::FileStream binary_;
     bool print_word_;
     bool print_line_;
     bool print_summary_;
     bool flush_;
+    bool print_binary_;
 };
 
 template <class Model, class Printer> void Query(const Model &model, bool sentence_context, Printer &printer) {
@@ -65,6 +95,7 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
     state = sentence_context ? model.BeginSentenceState() : model.NullContextState();
     float total = 0.0;
     uint64_t oov = 0;
+    uint64_t tokens = 0;
 
     while (in.ReadWordSameLine(word)) {
       lm::WordIndex vocab = model.GetVocabulary().Index(word);
@@ -75,23 +106,27 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
       }
       total += ret.prob;
       printer.Word(word, vocab, ret);
-      ++corpus_tokens;
+      ++tokens;
       state = out;
     }
     // If people don't have a newline after their last query, this won't add a </s>.
     // Sue me.
     try {
       UTIL_THROW_IF('\n' != in.get(), util::Exception, "FilePiece is confused.");
-    } catch (const util::EndOfFileException &e) { break; }
+    } catch (const util::EndOfFileException &e) {
+      corpus_tokens += tokens;
+      break;
+    }
     if (sentence_context) {
       ret = model.FullScore(state, model.GetVocabulary().EndSentence(), out);
       total += ret.prob;
-      ++corpus_tokens;
+      ++tokens;
       printer.Word("</s>", model.GetVocabulary().EndSentence(), ret);
     }
-    printer.Line(oov, total);
+    printer.Line(oov, total, tokens);
     corpus_total += total;
     corpus_oov += oov;
+    corpus_tokens += tokens;
   }
   printer.Summary(
       pow(10.0, -(corpus_total / static_cast<double>(corpus_tokens))), // PPL including OOVs
@@ -100,8 +135,241 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
       corpus_tokens);
 }
 
-template <class Model> void Query(const char *file, const Config &config, bool sentence_context, QueryPrinter &printer) {
+#ifdef WITH_THREADS
+namespace detail {
+
+struct QueryWord {
+  StringPiece surface;
+  WordIndex vocab;
+  FullScoreReturn ret;
+};
+
+struct QueryLine {
+  // One past the line's last entry in QueryBlock::words.
+  std::size_t words_end;
+  uint64_t oov;
+  float total;
+  // False for a last line without newline: it is scored but not reported.
+  bool complete;
+};
+
+// A run of input lines, scored by one worker.
+struct QueryBlock {
+  QueryBlock() : done(0) {}
+
+  std::string text;
+  bool terminated;
+  std::vector<QueryWord> words;
+  std::vector<QueryLine> lines;
+  // Posted by the worker once words and lines are filled in.
+  util::Semaphore done;
+};
+
+// How many words ahead of scoring to prefetch.
+const std::size_t kQueryPrefetch = 4;
+
+template <class Model> class QueryWorker {
+  public:
+    QueryWorker(const Model &model, bool sentence_context, util::PCQueue<QueryBlock*> &in)
+      : model_(model), sentence_context_(sentence_context), in_(in) {}
+
+    void operator()() {
+      QueryBlock *block;
+      for (in_.Consume(block); block; in_.Consume(block)) {
+        Score(*block);
+        block->done.post();
+      }
+    }
+
+  private:
+    void Score(QueryBlock &block) {
+      const typename Model::Vocabulary &vocab = model_.GetVocabulary();
+      const char *i = block.text.data();
+      const char *const end = i + block.text.size();
+      while (i != end) {
+        const char *line_end = static_cast<const char*>(memchr(i, '\n', end - i));
+        if (!line_end) line_end = end;
+        std::size_t begin = block.words.size();
+        // Same whitespace as FilePiece::ReadWordSameLine.
+        for (const char *word = i; ; ) {
+          for (; word != line_end && util::kSpaces[static_cast<unsigned char>(*word)]; ++word) {}
+          if (word == line_end) break;
+          const char *word_end = word;
+          for (; word_end != line_end && !util::kSpaces[static_cast<unsigned char>(*word_end)]; ++word_end) {}
+          QueryWord add;
+          add.surface = StringPiece(word, word_end - word);
+          add.vocab = vocab.Index(add.surface);
+          block.words.push_back(add);
+          word = word_end;
+        }
+        ScoreLine(block, begin, line_end != end || block.terminated);
+        i = (line_end == end) ? end : line_end + 1;
+      }
+    }
+
+    void ScoreLine(QueryBlock &block, std::size_t begin, bool complete) {
+      const WordIndex end_sentence = model_.GetVocabulary().EndSentence();
+      const std::size_t length = block.words.size() - begin;
+      const bool add_end = complete && sentence_context_;
+      // The words in reverse, then <s>, so that every word's context is a
+      // suffix that can be handed to Prefetch before the word is scored.
+      reversed_.resize(length + 1);
+      for (std::size_t j = 0; j < length; ++j) {
+        reversed_[length - 1 - j] = block.words[begin + j].vocab;
+      }
+      reversed_[length] = model_.GetVocabulary().BeginSentence();
+      const WordIndex *const context_end = &reversed_[length] + (sentence_context_ ? 1 : 0);
+      const std::size_t scored = length + (add_end ? 1 : 0);
+      for (std::size_t j = 0; j < std::min(kQueryPrefetch, scored); ++j) {
+        model_.Prefetch(&reversed_[length - j], context_end, j < length ? reversed_[length - 1 - j] : end_sentence);
+      }
+
+      typename Model::State state(sentence_context_ ? model_.BeginSentenceState() : model_.NullContextState()), out;
+      QueryLine line;
+      line.oov = 0;
+      line.total = 0.0;
+      line.complete = complete;
+      for (std::size_t j = 0; j < length; ++j) {
+        std::size_t ahead = j + kQueryPrefetch;
+        if (ahead < scored) {
+          model_.Prefetch(&reversed_[length - ahead], context_end, ahead < length ? reversed_[length - 1 - ahead] : end_sentence);
+        }
+        QueryWord &word = block.words[begin + j];
+        word.ret = model_.FullScore(state, word.vocab, out);
+        if (word.vocab == model_.GetVocabulary().NotFound()) ++line.oov;
+        line.total += word.ret.prob;
+        state = out;
+      }
+      if (add_end) {
+        QueryWord word;
+        word.surface = StringPiece("</s>");
+        word.vocab = end_sentence;
+        word.ret = model_.FullScore(state, end_sentence, out);
+        line.total += word.ret.prob;
+        block.words.push_back(word);
+      }
+      line.words_end = block.words.size();
+      block.lines.push_back(line);
+    }
+
+    const Model &model_;
+    const bool sentence_context_;
+    util::PCQueue<QueryBlock*> &in_;
+    std::vector<WordIndex> reversed_;
+};
+
+struct QueryTotals {
+  QueryTotals() : total(0.0), total_oov_only(0.0), oov(0), tokens(0) {}
+  double total;
+  double total_oov_only;
+  uint64_t oov;
+  uint64_t tokens;
+};
+
+// Prints blocks in input order as they are finished.
+template <class Printer> class QueryWriter {
+  public:
+    QueryWriter(Printer &printer, util::PCQueue<QueryBlock*> &in, WordIndex not_found, QueryTotals &totals)
+      : printer_(printer), in_(in), not_found_(not_found), totals_(totals) {}
+
+    void operator()() {
+      QueryBlock *block;
+      for (in_.Consume(block); block; in_.Consume(block)) {
+        util::WaitSemaphore(block->done);
+        std::vector<QueryWord>::const_iterator word = block->words.begin();
+        for (std::vector<QueryLine>::const_iterator line = block->lines.begin(); line != block->lines.end(); ++line) {
+          for (; word != block->words.begin() + line->words_end; ++word) {
+            if (word->vocab == not_found_) totals_.total_oov_only += word->ret.prob;
+            printer_.Word(word->surface, word->vocab, word->ret);
+          }
+          uint64_t tokens = line->words_end - (line == block->lines.begin() ? 0 : (line - 1)->words_end);
+          totals_.tokens += tokens;
+          if (!line->complete) continue;
+          printer_.Line(line->oov, line->total, tokens);
+          totals_.total += line->total;
+          totals_.oov += line->oov;
+        }
+        delete block;
+      }
+    }
+
+  private:
+    Printer &printer_;
+    util::PCQueue<QueryBlock*> &in_;
+    const WordIndex not_found_;
+    QueryTotals &totals_;
+};
+
+} // namespace detail
+
+/* Like Query, but lines are scored by several threads sharing the model.
+ * The main thread cuts stdin into blocks of lines, a pool of workers scores
+ * them and the printer sees them in input order, so the output is the same
+ * as Query's.
+ */
+template <class Model, class Printer> void ParallelQuery(const Model &model, bool sentence_context, Printer &printer, std::size_t threads) {
+  const std::size_t kBlockBytes = 1 << 18;
+  util::PCQueue<detail::QueryBlock*> work(threads * 2), order(threads * 4);
+  boost::thread_group workers;
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers.create_thread(detail::QueryWorker<Model>(model, sentence_context, work));
+  }
+  detail::QueryTotals totals;
+  boost::thread writer(detail::QueryWriter<Printer>(printer, order, model.GetVocabulary().NotFound(), totals));
+
+  std::string carry;
+  bool eof = false;
+  while (!eof) {
+    detail::QueryBlock *block = new detail::QueryBlock();
+    block->text.swap(carry);
+    while (true) {
+      std::size_t old = block->text.size();
+      block->text.resize(old + kBlockBytes);
+      std::size_t got = util::ReadOrEOF(0, &block->text[old], kBlockBytes);
+      block->text.resize(old + got);
+      if (!got) {
+        eof = true;
+        break;
+      }
+      // Cut after the last newline; a line longer than a block makes it grow.
+      std::size_t last = block->text.rfind('\n');
+      if (last != std::string::npos) {
+        carry.assign(block->text, last + 1, std::string::npos);
+        block->text.resize(last + 1);
+        break;
+      }
+    }
+    if (block->text.empty()) {
+      delete block;
+      break;
+    }
+    block->terminated = (block->text[block->text.size() - 1] == '\n');
+    work.Produce(block);
+    order.Produce(block);
+  }
+  for (std::size_t i = 0; i < threads; ++i) {
+    work.Produce(NULL);
+  }
+  order.Produce(NULL);
+  workers.join_all();
+  writer.join();
+
+  printer.Summary(
+      pow(10.0, -(totals.total / static_cast<double>(totals.tokens))), // PPL including OOVs
+      pow(10.0, -((totals.total - totals.total_oov_only) / static_cast<double>(totals.tokens - totals.oov))), // PPL excluding OOVs
+      totals.oov,
+      totals.tokens);
+}
+#endif // WITH_THREADS
+
+template <class Model> void Query(const char *file, const Config &config, bool sentence_context, QueryPrinter &printer, std::size_t threads = 1) {
   Model model(file, config);
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    ParallelQuery<Model, QueryPrinter>(model, sentence_context, printer, threads);
+    return;
+  }
+#endif
   Query<Model, QueryPrinter>(model, sentence_context, printer);
 }
 
@@ -10,12 +10,17 @@
 void Usage(const char *name) {
   std::cerr <<
     "KenLM was compiled with maximum order " << KENLM_MAX_ORDER << ".\n"
-    "Usage: " << name << " [-b] [-n] [-w] [-s] lm_file\n"
+    "Usage: " << name << " [-b] [-n] [-w] [-s] [-t threads] [-B file] lm_file\n"
     "-b: Do not buffer output.\n"
     "-n: Do not wrap the input in <s> and </s>.\n"
     "-v summary|sentence|word: Level of verbosity\n"
     "-l lazy|populate|read|parallel: Load lazily, with populate, or malloc+read\n"
-    "The default loading method is populate on Linux and read on others.\n";
+    "The default loading method is populate on Linux and read on others.\n"
+#ifdef WITH_THREADS
+    "-t: Number of threads scoring sentences.  Output is in input order.\n"
+#endif
+    "-B: Also write per-sentence scores to file as binary records of\n"
+    "    float log10 probability, uint32 OOVs and uint32 tokens (</s> included).\n";
   exit(1);
 }
 
@@ -27,9 +32,11 @@ int main(int argc, char *argv[]) {
   bool sentence_context = true;
   unsigned int verbosity = 2;
   bool flush = false;
+  std::size_t threads = 1;
+  const char *binary_file = NULL;
 
   int opt;
-  while ((opt = getopt(argc, argv, "bnv:l:")) != -1) {
+  while ((opt = getopt(argc, argv, "bnv:l:t:B:")) != -1) {
     switch (opt) {
       case 'b':
         flush = true;
@@ -61,6 +68,15 @@ int main(int argc, char *argv[]) {
           Usage(argv[0]);
         }
         break;
+#ifdef WITH_THREADS
+      case 't':
+        threads = strtoul(optarg, NULL, 10);
+        if (!threads) Usage(argv[0]);
+        break;
+#endif
+      case 'B':
+        binary_file = optarg;
+        break;
       case 'h':
       default:
         Usage(argv[0]);
@@ -68,30 +84,31 @@ int main(int argc, char *argv[]) {
   }
   if (optind + 1 != argc)
     Usage(argv[0]);
-  lm::ngram::QueryPrinter printer(1, verbosity >= 2, verbosity >= 1, true, flush);
   const char *file = argv[optind];
   try {
+    util::scoped_fd binary(binary_file ? util::CreateOrThrow(binary_file) : -1);
+    lm::ngram::QueryPrinter printer(1, verbosity >= 2, verbosity >= 1, true, flush, binary.get());
     using namespace lm::ngram;
     ModelType model_type;
     if (RecognizeBinary(file, model_type)) {
       switch(model_type) {
         case PROBING:
-          Query<lm::ngram::ProbingModel>(file, config, sentence_context, printer);
+          Query<lm::ngram::ProbingModel>(file, config, sentence_context, printer, threads);
           break;
         case REST_PROBING:
-          Query<lm::ngram::RestProbingModel>(file, config, sentence_context, printer);
+          Query<lm::ngram::RestProbingModel>(file, config, sentence_context, printer, threads);
           break;
         case TRIE:
-          Query<TrieModel>(file, config, sentence_context, printer);
+          Query<TrieModel>(file, config, sentence_context, printer, threads);
           break;
         case QUANT_TRIE:
-          Query<QuantTrieModel>(file, config, sentence_context, printer);
+          Query<QuantTrieModel>(file, config, sentence_context, printer, threads);
           break;
         case ARRAY_TRIE:
-          Query<ArrayTrieModel>(file, config, sentence_context, printer);
+          Query<ArrayTrieModel>(file, config, sentence_context, printer, threads);
           break;
         case QUANT_ARRAY_TRIE:
-          Query<QuantArrayTrieModel>(file, config, sentence_context, printer);
+          Query<QuantArrayTrieModel>(file, config, sentence_context, printer, threads);
           break;
         default:
           std::cerr << "Unrecognized kenlm model type " << model_type << std::endl;
@@ -104,7 +121,7 @@ int main(int argc, char *argv[]) {
       Query<lm::np::Model, lm::ngram::QueryPrinter>(model, sentence_context, printer);
 #endif
     } else {
-      Query<ProbingModel>(file, config, sentence_context, printer);
+      Query<ProbingModel>(file, config, sentence_context, printer, threads);
     }
     util::PrintUsage(std::cerr);
   } catch (const std::exception &e) {
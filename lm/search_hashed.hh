@@ -125,6 +125,22 @@ template <class Value> class HashedSearch {
       return LongestPointer(found->value.prob);
     }
 
+    // Start loading the entries that scoring word after the context
+    // [context_rbegin, context_rend) will probe.
+    void Prefetch(const WordIndex *context_rbegin, const WordIndex *context_rend, WordIndex word) const {
+      Node node = static_cast<Node>(word);
+      unsigned char order_minus_2 = 0;
+      for (const WordIndex *i = context_rbegin; i < context_rend; ++i, ++order_minus_2) {
+        node = CombineWordHash(node, *i);
+        if (order_minus_2 < middle_.size()) {
+          middle_[order_minus_2].Prefetch(node);
+        } else {
+          longest_.Prefetch(node);
+          return;
+        }
+      }
+    }
+
     // Generate a node without necessarily checking that it actually exists.
     // Optionally return false if it's know to not exist.
     bool FastMakeNode(const WordIndex *begin, const WordIndex *end, Node &node) const {
@@ -21,6 +21,7 @@ class SortedVocabulary;
 namespace trie {
 
 template <class Quant, class Bhiksha> class TrieSearch;
+template <class Quant, class Bhiksha> class TrieFilter;
 class SortedFiles;
 template <class Quant, class Bhiksha> void BuildTrie(SortedFiles &files, std::vector<uint64_t> &counts, const Config &config, TrieSearch<Quant, Bhiksha> &out, Quant &quant, SortedVocabulary &vocab, BinaryFormat &backing);
 
@@ -88,6 +89,9 @@ template <class Quant, class Bhiksha> class TrieSearch {
       return LongestPointer(quant_, longest_.Find(word, node));
     }
 
+    // Lookups walk the trie, so there is nothing to load in advance.
+    void Prefetch(const WordIndex *, const WordIndex *, WordIndex) const {}
+
     bool FastMakeNode(const WordIndex *begin, const WordIndex *end, Node &node) const {
       assert(begin != end);
       bool independent_left;
@@ -100,6 +104,7 @@ template <class Quant, class Bhiksha> class TrieSearch {
     }
 
   private:
+    friend class TrieFilter<Quant, Bhiksha>;
     friend void BuildTrie<Quant, Bhiksha>(SortedFiles &files, std::vector<uint64_t> &counts, const Config &config, TrieSearch<Quant, Bhiksha> &out, Quant &quant, SortedVocabulary &vocab, BinaryFormat &backing);
 
     // Middles are managed manually so we can delay construction and they don't have to be copyable.
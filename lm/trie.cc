@@ -72,6 +72,10 @@ template <class Bhiksha> BitPackedMiddle<Bhiksha>::BitPackedMiddle(void *base, u
 }
 
 template <class Bhiksha> util::BitAddress BitPackedMiddle<Bhiksha>::Insert(WordIndex word) {
+  return Insert(word, next_source_->InsertIndex());
+}
+
+template <class Bhiksha> util::BitAddress BitPackedMiddle<Bhiksha>::Insert(WordIndex word, uint64_t next) {
   assert(word <= word_mask_);
   uint64_t at_pointer = insert_index_ * total_bits_;
 
@@ -79,7 +83,6 @@ template <class Bhiksha> util::BitAddress BitPackedMiddle<Bhiksha>::Insert(WordI
   at_pointer += word_bits_;
   util::BitAddress ret(base_, at_pointer);
   at_pointer += quant_bits_;
-  uint64_t next = next_source_->InsertIndex();
   bhiksha_.WriteNext(base_, at_pointer, insert_index_, next);
   ++insert_index_;
   return ret;
@@ -81,6 +81,10 @@ class BitPacked {
       return insert_index_;
     }
 
+    WordIndex ReadWord(uint64_t pointer) const {
+      return util::ReadInt57(base_, pointer * total_bits_, word_bits_, word_mask_);
+    }
+
   protected:
     static uint64_t BaseSize(uint64_t entries, uint64_t max_vocab, uint8_t remaining_bits);
 
@@ -104,6 +108,9 @@ template <class Bhiksha> class BitPackedMiddle : public BitPacked {
 
     util::BitAddress Insert(WordIndex word);
 
+    // Insert with an explicit pointer to the next order instead of where it is inserting.
+    util::BitAddress Insert(WordIndex word, uint64_t next);
+
     void FinishedLoading(uint64_t next_end, const Config &config);
 
     util::BitAddress Find(WordIndex word, NodeRange &range, uint64_t &pointer) const;
@@ -137,6 +144,10 @@ class BitPackedLongest : public BitPacked {
     util::BitAddress Insert(WordIndex word);
 
     util::BitAddress Find(WordIndex word, const NodeRange &node) const;
+
+    util::BitAddress ReadEntry(uint64_t pointer) const {
+      return util::BitAddress(base_, pointer * total_bits_ + word_bits_);
+    }
 };
 
 } // namespace trie
@@ -0,0 +1,415 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2011- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "util/exception.hh"
+#include "util/file.hh"
+
+#include "ColumnStore.h"
+#include "FeatureStats.h"
+#include "ScoreStats.h"
+
+using namespace std;
+
+namespace MosesTuning
+{
+
+namespace
+{
+
+const char kMagic[8] = "MERTCOL";
+const uint32_t kVersion = 1;
+const uint32_t kIntegerColumns = 1;
+
+uint64_t Align8(uint64_t offset)
+{
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+template <class T>
+void Put(vector<char>& buffer, uint64_t offset, const T* data, size_t n)
+{
+  if (n) memcpy(&buffer[offset], data, n * sizeof(T));
+}
+
+template <class T>
+const T* At(const char* base, uint64_t offset)
+{
+  return reinterpret_cast<const T*>(base + offset);
+}
+
+bool IsIntegral(float value)
+{
+  // INT32_MAX converts to 2^31 as a float, which does not fit.
+  const float limit = 2147483648.0f;
+  return value >= -limit && value < limit
+         && static_cast<float>(static_cast<int32_t>(value)) == value;
+}
+
+// True if count items of width bytes starting at offset lie within size
+// bytes, without overflowing.
+bool Fits(uint64_t offset, uint64_t count, uint64_t width, uint64_t size)
+{
+  return offset <= size && count <= (size - offset) / width;
+}
+
+// True if the count + 1 offsets in begin do not decrease and end at most at
+// limit.
+bool Ascending(const uint64_t* begin, uint64_t count, uint64_t limit)
+{
+  for (uint64_t i = 0; i < count; ++i)
+    if (begin[i] > begin[i + 1]) return false;
+  return begin[count] <= limit;
+}
+
+} // namespace
+
+ColumnStoreWriter::ColumnStoreWriter(ColumnStoreKind kind, const string& label,
+                                     size_t numColumns)
+  : m_kind(kind), m_label(label), m_num_columns(numColumns),
+    m_sentence_begin(1, 0), m_sparse_row(1, 0) {}
+
+void ColumnStoreWriter::StartEntry(int sentence, size_t numColumns)
+{
+  UTIL_THROW_IF(numColumns != m_num_columns, util::Exception,
+                "Expected " << m_num_columns << " values per entry, got "
+                << numColumns << " for sentence " << sentence);
+  if (m_sentence_ids.empty() || m_sentence_ids.back() != sentence) {
+    m_sentence_ids.push_back(sentence);
+    m_sentence_begin.push_back(m_sentence_begin.back());
+  }
+  ++m_sentence_begin.back();
+}
+
+void ColumnStoreWriter::Add(int sentence, const FeatureStats& stats)
+{
+  UTIL_THROW_IF(m_kind != COLUMN_FEATURES, util::Exception,
+                "Adding features to a score store");
+  StartEntry(sentence, stats.size());
+  for (size_t i = 0; i < stats.size(); ++i)
+    m_rows.push_back(stats.get(i));
+
+  const SparseVector& sparse = stats.getSparse();
+  const vector<size_t> ids = sparse.feats();
+  for (size_t k = 0; k < ids.size(); ++k) {
+    const string name = SparseVector::decode(ids[k]);
+    map<string, uint32_t>::const_iterator it = m_name_ids.find(name);
+    if (it == m_name_ids.end()) {
+      it = m_name_ids.insert(make_pair(name, static_cast<uint32_t>(m_names.size()))).first;
+      m_names.push_back(name);
+    }
+    m_sparse_name.push_back(it->second);
+    m_sparse_value.push_back(sparse.get(ids[k]));
+  }
+  m_sparse_row.push_back(m_sparse_name.size());
+}
+
+void ColumnStoreWriter::Add(int sentence, const ScoreStats& stats)
+{
+  UTIL_THROW_IF(m_kind != COLUMN_SCORES, util::Exception,
+                "Adding scores to a feature store");
+  StartEntry(sentence, stats.size());
+  for (size_t i = 0; i < stats.size(); ++i)
+    m_rows.push_back(stats.get(i));
+  m_sparse_row.push_back(m_sparse_name.size());
+}
+
+void ColumnStoreWriter::Append(const string& file) const
+{
+  const uint64_t numEntries = size();
+  const uint64_t numSentences = m_sentence_ids.size();
+  const uint64_t numSparse = m_sparse_name.size();
+
+  bool integral = (m_kind == COLUMN_SCORES);
+  for (size_t i = 0; integral && i < m_rows.size(); ++i)
+    integral = IsIntegral(m_rows[i]);
+
+  vector<uint64_t> nameBegin(1, 0);
+  for (size_t n = 0; n < m_names.size(); ++n)
+    nameBegin.push_back(nameBegin.back() + m_names[n].size());
+
+  ColumnSegmentHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(header.magic));
+  header.version = kVersion;
+  header.kind = m_kind;
+  header.numSentences = numSentences;
+  header.numEntries = numEntries;
+  header.numColumns = m_num_columns;
+  header.flags = integral ? kIntegerColumns : 0;
+  header.numSparse = numSparse;
+  header.numNames = m_names.size();
+
+  uint64_t offset = sizeof(header);
+  header.labelOffset = offset;
+  header.labelSize = m_label.size();
+  offset = Align8(offset + m_label.size());
+  header.sentenceOffset = offset;
+  offset = Align8(offset + sizeof(uint64_t) * (numSentences + 1)
+                  + sizeof(int32_t) * numSentences);
+  header.columnOffset = offset;
+  offset = Align8(offset + sizeof(float) * m_num_columns * numEntries);
+  header.sparseOffset = offset;
+  offset = Align8(offset + sizeof(uint64_t) * (numEntries + 1)
+                  + (sizeof(uint32_t) + sizeof(float)) * numSparse);
+  header.nameOffset = offset;
+  offset = Align8(offset + sizeof(uint64_t) * nameBegin.size() + nameBegin.back());
+  header.size = offset;
+
+  vector<char> buffer(header.size, 0);
+  Put(buffer, 0, &header, 1);
+  Put(buffer, header.labelOffset, m_label.data(), m_label.size());
+
+  uint64_t at = header.sentenceOffset;
+  Put(buffer, at, &m_sentence_begin[0], m_sentence_begin.size());
+  at += sizeof(uint64_t) * m_sentence_begin.size();
+  if (numSentences)
+    Put(buffer, at, &m_sentence_ids[0], numSentences);
+
+  // Transpose the rows into columns.
+  for (size_t c = 0; c < m_num_columns; ++c) {
+    at = header.columnOffset + sizeof(float) * c * numEntries;
+    for (uint64_t e = 0; e < numEntries; ++e, at += sizeof(float)) {
+      const float value = m_rows[e * m_num_columns + c];
+      if (integral) {
+        const int32_t i = static_cast<int32_t>(value);
+        Put(buffer, at, &i, 1);
+      } else {
+        Put(buffer, at, &value, 1);
+      }
+    }
+  }
+
+  at = header.sparseOffset;
+  Put(buffer, at, &m_sparse_row[0], m_sparse_row.size());
+  at += sizeof(uint64_t) * m_sparse_row.size();
+  if (numSparse) {
+    Put(buffer, at, &m_sparse_name[0], numSparse);
+    at += sizeof(uint32_t) * numSparse;
+    Put(buffer, at, &m_sparse_value[0], numSparse);
+  }
+
+  at = header.nameOffset;
+  Put(buffer, at, &nameBegin[0], nameBegin.size());
+  at += sizeof(uint64_t) * nameBegin.size();
+  for (size_t n = 0; n < m_names.size(); ++n) {
+    Put(buffer, at, m_names[n].data(), m_names[n].size());
+    at += m_names[n].size();
+  }
+
+  ofstream out(file.c_str(), ios::out | ios::binary | ios::app);
+  UTIL_THROW_IF(!out, util::Exception, "Unable to open " << file << " for appending");
+  out.write(&buffer[0], buffer.size());
+  out.close();
+  UTIL_THROW_IF(!out, util::Exception, "Failed to append a segment to " << file);
+}
+
+struct ColumnStore::Segment {
+  const ColumnSegmentHeader* header;
+  const uint64_t* sentenceBegin;
+  const int32_t* sentenceIds;
+  const char* columns;
+  bool integral;
+  const uint64_t* sparseRow;
+  const uint32_t* sparseName;
+  const float* sparseValue;
+  vector<size_t> sparseIds;  // names encoded by SparseVector
+};
+
+float ColumnStore::Entry::Value(size_t column) const
+{
+  const uint64_t i = column * m_segment->header->numEntries + m_row;
+  if (m_segment->integral)
+    return reinterpret_cast<const int32_t*>(m_segment->columns)[i];
+  return reinterpret_cast<const float*>(m_segment->columns)[i];
+}
+
+size_t ColumnStore::Entry::NumSparse() const
+{
+  return m_segment->sparseRow[m_row + 1] - m_segment->sparseRow[m_row];
+}
+
+size_t ColumnStore::Entry::SparseId(size_t k) const
+{
+  return m_segment->sparseIds[m_segment->sparseName[m_segment->sparseRow[m_row] + k]];
+}
+
+float ColumnStore::Entry::SparseValue(size_t k) const
+{
+  return m_segment->sparseValue[m_segment->sparseRow[m_row] + k];
+}
+
+ColumnStore::ColumnStore(const string& file)
+  : m_file(file), m_kind(COLUMN_FEATURES), m_num_columns(0)
+{
+  util::scoped_fd fd(util::OpenReadOrThrow(file.c_str()));
+  const uint64_t size = util::SizeOrThrow(fd.get());
+  UTIL_THROW_IF(size == 0, util::Exception, "Empty column store " << file);
+  util::MapRead(util::LAZY, fd.get(), 0, size, m_mem);
+  const char* data = static_cast<const char*>(m_mem.get());
+
+  map<int, vector<Range> > sentences;
+  for (uint64_t pos = 0; pos < size;) {
+    UTIL_THROW_IF(size - pos < sizeof(ColumnSegmentHeader), util::Exception,
+                  "Truncated segment at byte " << pos << " of " << file);
+    const char* base = data + pos;
+    const ColumnSegmentHeader* header = At<ColumnSegmentHeader>(base, 0);
+    UTIL_THROW_IF(memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+                  || header->version != kVersion, util::Exception,
+                  "No column store segment at byte " << pos << " of " << file);
+    UTIL_THROW_IF(header->size > size - pos, util::Exception,
+                  "Truncated segment at byte " << pos << " of " << file);
+    // Every section must lie within the segment, and its offsets within
+    // the section they index, so that a damaged store is never read out
+    // of bounds.
+    const uint64_t segmentSize = header->size;
+    const uint64_t sentenceBeginBytes = sizeof(uint64_t) * (header->numSentences + 1);
+    const uint64_t sparseRowBytes = sizeof(uint64_t) * (header->numEntries + 1);
+    const uint64_t nameBeginBytes = sizeof(uint64_t) * (header->numNames + 1);
+    UTIL_THROW_IF(segmentSize < sizeof(ColumnSegmentHeader)
+                  // counts that no section could hold, so that the sizes
+                  // below do not overflow
+                  || header->numSentences >= segmentSize
+                  || header->numEntries >= segmentSize
+                  || header->numNames >= segmentSize
+                  || !Fits(header->labelOffset, header->labelSize, 1, segmentSize)
+                  || !Fits(header->sentenceOffset, header->numSentences + 1, sizeof(uint64_t), segmentSize)
+                  || !Fits(header->sentenceOffset + sentenceBeginBytes, header->numSentences,
+                           sizeof(int32_t), segmentSize)
+                  || (header->numColumns
+                      && !Fits(header->columnOffset, header->numEntries,
+                               sizeof(float) * static_cast<uint64_t>(header->numColumns), segmentSize))
+                  || !Fits(header->sparseOffset, header->numEntries + 1, sizeof(uint64_t), segmentSize)
+                  || !Fits(header->sparseOffset + sparseRowBytes, header->numSparse,
+                           sizeof(uint32_t) + sizeof(float), segmentSize)
+                  || !Fits(header->nameOffset, header->numNames + 1, sizeof(uint64_t), segmentSize),
+                  util::Exception, "Corrupt segment at byte " << pos << " of " << file);
+    if (m_segments.empty()) {
+      m_kind = static_cast<ColumnStoreKind>(header->kind);
+      m_label.assign(base + header->labelOffset, header->labelSize);
+      m_num_columns = header->numColumns;
+    }
+    UTIL_THROW_IF(header->kind != m_kind || header->numColumns != m_num_columns,
+                  util::Exception, "Segment at byte " << pos << " of " << file
+                  << " does not match the first segment");
+
+    Segment* segment = new Segment;
+    m_segments.push_back(segment);
+    segment->header = header;
+    segment->sentenceBegin = At<uint64_t>(base, header->sentenceOffset);
+    segment->sentenceIds = At<int32_t>(base, header->sentenceOffset + sentenceBeginBytes);
+    segment->columns = base + header->columnOffset;
+    segment->integral = header->flags & kIntegerColumns;
+    segment->sparseRow = At<uint64_t>(base, header->sparseOffset);
+    segment->sparseName = At<uint32_t>(base, header->sparseOffset + sparseRowBytes);
+    segment->sparseValue = At<float>(base, header->sparseOffset + sparseRowBytes
+                                     + sizeof(uint32_t) * header->numSparse);
+
+    const uint64_t* nameBegin = At<uint64_t>(base, header->nameOffset);
+    const char* chars = base + header->nameOffset + nameBeginBytes;
+    bool valid = Ascending(segment->sentenceBegin, header->numSentences, header->numEntries)
+                 && Ascending(segment->sparseRow, header->numEntries, header->numSparse)
+                 && Ascending(nameBegin, header->numNames,
+                              segmentSize - header->nameOffset - nameBeginBytes);
+    for (uint64_t k = 0; valid && k < header->numSparse; ++k)
+      valid = segment->sparseName[k] < header->numNames;
+    UTIL_THROW_IF(!valid, util::Exception,
+                  "Corrupt segment at byte " << pos << " of " << file);
+    for (uint64_t n = 0; n < header->numNames; ++n) {
+      segment->sparseIds.push_back(SparseVector::encode(
+                                     string(chars + nameBegin[n], nameBegin[n + 1] - nameBegin[n])));
+    }
+
+    for (uint64_t s = 0; s < header->numSentences; ++s) {
+      Range range;
+      range.segment = m_segments.size() - 1;
+      range.begin = segment->sentenceBegin[s];
+      range.end = segment->sentenceBegin[s + 1];
+      sentences[segment->sentenceIds[s]].push_back(range);
+    }
+    pos += header->size;
+  }
+
+  for (map<int, vector<Range> >::const_iterator it = sentences.begin();
+       it != sentences.end(); ++it) {
+    Sentence sentence;
+    sentence.id = it->first;
+    sentence.firstRange = m_ranges.size();
+    sentence.numRanges = it->second.size();
+    sentence.numEntries = 0;
+    for (size_t r = 0; r < it->second.size(); ++r) {
+      m_ranges.push_back(it->second[r]);
+      sentence.numEntries += it->second[r].end - it->second[r].begin;
+    }
+    m_sentences.push_back(sentence);
+  }
+}
+
+ColumnStore::~ColumnStore()
+{
+  for (size_t i = 0; i < m_segments.size(); ++i)
+    delete m_segments[i];
+}
+
+bool ColumnStore::IsColumnStore(const string& file)
+{
+  ifstream in(file.c_str(), ios::in | ios::binary);
+  char magic[sizeof(kMagic)];
+  return in.read(magic, sizeof(magic)) && memcmp(magic, kMagic, sizeof(magic)) == 0;
+}
+
+void ColumnStore::Entries(size_t s, vector<Entry>& out) const
+{
+  out.clear();
+  const Sentence& sentence = m_sentences[s];
+  out.reserve(sentence.numEntries);
+  for (size_t r = sentence.firstRange; r < sentence.firstRange + sentence.numRanges; ++r) {
+    const Range& range = m_ranges[r];
+    for (uint64_t row = range.begin; row < range.end; ++row)
+      out.push_back(Entry(m_segments[range.segment], row));
+  }
+}
+
+void ColumnStore::Get(const Entry& entry, FeatureStats& out,
+                      const SparseVector& sparseWeights) const
+{
+  out.reset();
+  for (size_t c = 0; c < m_num_columns; ++c)
+    out.add(entry.Value(c));
+  if (sparseWeights.size()) {
+    SparseVector sparse;
+    for (size_t k = 0; k < entry.NumSparse(); ++k)
+      sparse.set(entry.SparseId(k), entry.SparseValue(k));
+    out.add(inner_product(sparseWeights, sparse));
+  } else {
+    for (size_t k = 0; k < entry.NumSparse(); ++k)
+      out.addSparse(entry.SparseId(k), entry.SparseValue(k));
+  }
+}
+
+void ColumnStore::Get(const Entry& entry, ScoreStats& out) const
+{
+  out.reset();
+  for (size_t c = 0; c < m_num_columns; ++c)
+    out.add(entry.Value(c));
+}
+
+}
@@ -0,0 +1,209 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2011- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef MERT_COLUMN_STORE_H_
+#define MERT_COLUMN_STORE_H_
+
+/**
+ * Append-only, memory-mapped store for feature and score data.
+ *
+ * A store is a sequence of self-describing segments, typically one per
+ * tuning iteration, so adding an iteration never rewrites the earlier ones.
+ * Inside a segment the entries of a sentence are contiguous, dense values
+ * are laid out column by column, sparse features are kept in CSR form and
+ * score statistics are stored as integer columns when they are all
+ * integral. Readers map the file and use it in place; nothing is parsed.
+ */
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "util/mmap.hh"
+#include "util/string_piece.hh"
+
+namespace MosesTuning
+{
+
+class FeatureStats;
+class ScoreStats;
+class SparseVector;
+
+enum ColumnStoreKind {
+  COLUMN_FEATURES = 1,
+  COLUMN_SCORES = 2
+};
+
+struct ColumnSegmentHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint64_t size;            // bytes in the segment, header included
+  uint64_t numSentences;
+  uint64_t numEntries;
+  uint32_t numColumns;      // dense features or score statistics
+  uint32_t flags;
+  uint64_t numSparse;       // sparse values over all entries
+  uint64_t numNames;        // distinct sparse feature names
+  // All offsets are relative to the start of the segment.
+  uint64_t labelOffset;     // feature names or score type
+  uint64_t labelSize;
+  uint64_t sentenceOffset;  // uint64 begin[numSentences + 1], int32 id[numSentences]
+  uint64_t columnOffset;    // numColumns columns of numEntries values each
+  uint64_t sparseOffset;    // uint64 row[numEntries + 1], uint32 name[], float value[]
+  uint64_t nameOffset;      // uint64 begin[numNames + 1], then the characters
+};
+
+/**
+ * Collects entries in memory and appends them to a store as one segment.
+ */
+class ColumnStoreWriter
+{
+public:
+  ColumnStoreWriter(ColumnStoreKind kind, const std::string& label,
+                    std::size_t numColumns);
+
+  void Add(int sentence, const FeatureStats& stats);
+  void Add(int sentence, const ScoreStats& stats);
+
+  std::size_t size() const {
+    return m_sparse_row.size() - 1;
+  }
+
+  /**
+   * Append the collected entries to file, creating it if necessary.
+   */
+  void Append(const std::string& file) const;
+
+private:
+  void StartEntry(int sentence, std::size_t numColumns);
+
+  ColumnStoreKind m_kind;
+  std::string m_label;
+  std::size_t m_num_columns;
+
+  std::vector<uint64_t> m_sentence_begin;
+  std::vector<int32_t> m_sentence_ids;
+  std::vector<float> m_rows;  // row major, transposed by Append()
+  std::vector<uint64_t> m_sparse_row;
+  std::vector<uint32_t> m_sparse_name;
+  std::vector<float> m_sparse_value;
+  std::map<std::string, uint32_t> m_name_ids;
+  std::vector<std::string> m_names;
+};
+
+/**
+ * Read-only view of a store. The entries of a sentence from all segments
+ * are presented together, in the order they were appended; sentences are
+ * ordered by id.
+ */
+class ColumnStore
+{
+  struct Segment;
+
+public:
+  class Entry
+  {
+  public:
+    float Value(std::size_t column) const;
+
+    std::size_t NumSparse() const;
+    //! Sparse feature id, as used by SparseVector.
+    std::size_t SparseId(std::size_t k) const;
+    float SparseValue(std::size_t k) const;
+
+  private:
+    friend class ColumnStore;
+    Entry(const Segment* segment, uint64_t row)
+      : m_segment(segment), m_row(row) {}
+
+    const Segment* m_segment;
+    uint64_t m_row;
+  };
+
+  explicit ColumnStore(const std::string& file);
+  ~ColumnStore();
+
+  //! True if file starts with a store segment.
+  static bool IsColumnStore(const std::string& file);
+
+  ColumnStoreKind Kind() const {
+    return m_kind;
+  }
+  const std::string& Label() const {
+    return m_label;
+  }
+  std::size_t NumColumns() const {
+    return m_num_columns;
+  }
+  std::size_t NumSegments() const {
+    return m_segments.size();
+  }
+
+  std::size_t NumSentences() const {
+    return m_sentences.size();
+  }
+  int SentenceId(std::size_t s) const {
+    return m_sentences[s].id;
+  }
+  std::size_t NumEntries(std::size_t s) const {
+    return m_sentences[s].numEntries;
+  }
+
+  //! The entries of the s-th sentence.
+  void Entries(std::size_t s, std::vector<Entry>& out) const;
+
+  /**
+   * Helpers to build the in-memory representation of an entry. As when
+   * loading text, non-empty sparseWeights fold the sparse features into
+   * one extra dense feature.
+   */
+  void Get(const Entry& entry, FeatureStats& out,
+           const SparseVector& sparseWeights) const;
+  void Get(const Entry& entry, ScoreStats& out) const;
+
+private:
+  ColumnStore(const ColumnStore&);
+  ColumnStore& operator=(const ColumnStore&);
+
+  struct Range {
+    uint32_t segment;
+    uint64_t begin, end;
+  };
+  struct Sentence {
+    int id;
+    std::size_t firstRange, numRanges, numEntries;
+  };
+
+  std::string m_file;
+  util::scoped_memory m_mem;
+  ColumnStoreKind m_kind;
+  std::string m_label;
+  std::size_t m_num_columns;
+  std::vector<Segment*> m_segments;
+  std::vector<Range> m_ranges;
+  std::vector<Sentence> m_sentences;
+};
+
+}
+
+#endif  // MERT_COLUMN_STORE_H_
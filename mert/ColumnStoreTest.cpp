@@ -0,0 +1,212 @@
+#include "ColumnStore.h"
+#include "FeatureDataIterator.h"
+#include "FeatureStats.h"
+#include "ScoreDataIterator.h"
+#include "ScoreStats.h"
+
+#define BOOST_TEST_MODULE MertColumnStore
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "util/exception.hh"
+
+using namespace MosesTuning;
+
+namespace
+{
+
+class TempFile
+{
+public:
+  TempFile()
+    : m_path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("mert-columns-%%%%-%%%%")) {}
+  ~TempFile() {
+    boost::filesystem::remove(m_path);
+  }
+  std::string str() const {
+    return m_path.string();
+  }
+
+private:
+  boost::filesystem::path m_path;
+};
+
+FeatureStats MakeFeatures(float a, float b, const char* sparse, float value)
+{
+  FeatureStats stats;
+  stats.add(a);
+  stats.add(b);
+  if (sparse) stats.addSparse(sparse, value);
+  return stats;
+}
+
+ScoreStats MakeScores(float a, float b, float c)
+{
+  ScoreStats stats;
+  stats.add(a);
+  stats.add(b);
+  stats.add(c);
+  return stats;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(column_store_segments)
+{
+  TempFile file;
+  {
+    ColumnStoreWriter writer(COLUMN_FEATURES, "lm_0 w_0 ", 2);
+    writer.Add(0, MakeFeatures(-1.5, 3, "pp_a", 1));
+    writer.Add(0, MakeFeatures(-2.5, 4, NULL, 0));
+    writer.Add(1, MakeFeatures(-3.5, 5, "pp_b", 2));
+    BOOST_CHECK_EQUAL(writer.size(), (std::size_t)3);
+    writer.Append(file.str());
+  }
+  {
+    // next iteration: new candidates for sentence 1, and sentence 2
+    ColumnStoreWriter writer(COLUMN_FEATURES, "lm_0 w_0 ", 2);
+    writer.Add(2, MakeFeatures(-4.5, 6, NULL, 0));
+    writer.Add(1, MakeFeatures(-5.5, 7, "pp_a", 3));
+    writer.Append(file.str());
+  }
+
+  BOOST_REQUIRE(ColumnStore::IsColumnStore(file.str()));
+  ColumnStore store(file.str());
+  BOOST_CHECK_EQUAL(store.Kind(), COLUMN_FEATURES);
+  BOOST_CHECK_EQUAL(store.Label(), "lm_0 w_0 ");
+  BOOST_CHECK_EQUAL(store.NumColumns(), (std::size_t)2);
+  BOOST_CHECK_EQUAL(store.NumSegments(), (std::size_t)2);
+  BOOST_REQUIRE_EQUAL(store.NumSentences(), (std::size_t)3);
+
+  std::vector<ColumnStore::Entry> entries;
+  store.Entries(1, entries);
+  BOOST_CHECK_EQUAL(store.SentenceId(1), 1);
+  BOOST_REQUIRE_EQUAL(entries.size(), (std::size_t)2);
+  BOOST_CHECK_EQUAL(entries[0].Value(0), -3.5);
+  BOOST_CHECK_EQUAL(entries[0].Value(1), 5);
+  BOOST_CHECK_EQUAL(entries[1].Value(0), -5.5);
+  BOOST_REQUIRE_EQUAL(entries[1].NumSparse(), (std::size_t)1);
+  BOOST_CHECK_EQUAL(SparseVector::decode(entries[1].SparseId(0)), "pp_a");
+  BOOST_CHECK_EQUAL(entries[1].SparseValue(0), 3);
+
+  FeatureStats stats;
+  SparseVector weights;
+  store.Get(entries[0], stats, weights);
+  BOOST_CHECK_EQUAL(stats.size(), (std::size_t)2);
+  BOOST_CHECK_EQUAL(stats.getSparse().get("pp_b"), 2);
+
+  weights.set("pp_b", 0.5);
+  store.Get(entries[0], stats, weights);
+  BOOST_CHECK_EQUAL(stats.size(), (std::size_t)3);
+  BOOST_CHECK_EQUAL(stats.get(2), 1);
+  BOOST_CHECK_EQUAL(stats.getSparse().size(), (std::size_t)0);
+}
+
+BOOST_AUTO_TEST_CASE(column_store_iterators)
+{
+  TempFile features, scores;
+  ColumnStoreWriter fwriter(COLUMN_FEATURES, "lm_0 w_0 ", 2);
+  ColumnStoreWriter swriter(COLUMN_SCORES, "BLEU", 3);
+  fwriter.Add(0, MakeFeatures(-1, 2, "pp_a", 1));
+  swriter.Add(0, MakeScores(3, 4, 5));
+  fwriter.Add(1, MakeFeatures(-3, 4, NULL, 0));
+  swriter.Add(1, MakeScores(6, 7, 8));
+  fwriter.Append(features.str());
+  swriter.Append(scores.str());
+
+  // non-integral statistics are kept as floats
+  ColumnStoreWriter fractional(COLUMN_SCORES, "BLEU", 3);
+  fractional.Add(1, MakeScores(0.25, 1, 2));
+  fractional.Append(scores.str());
+
+  FeatureDataIterator fit(features.str());
+  BOOST_REQUIRE(fit != FeatureDataIterator::end());
+  BOOST_REQUIRE_EQUAL(fit->size(), (std::size_t)1);
+  BOOST_CHECK_EQUAL((*fit)[0].dense[0], -1);
+  BOOST_CHECK_EQUAL((*fit)[0].sparse.get("pp_a"), 1);
+  ++fit;
+  BOOST_REQUIRE(fit != FeatureDataIterator::end());
+  BOOST_CHECK_EQUAL((*fit)[0].dense[1], 4);
+  ++fit;
+  BOOST_CHECK(fit == FeatureDataIterator::end());
+
+  ScoreDataIterator sit(scores.str());
+  BOOST_REQUIRE(sit != ScoreDataIterator::end());
+  BOOST_CHECK_EQUAL((*sit)[0][2], 5);
+  ++sit;
+  BOOST_REQUIRE(sit != ScoreDataIterator::end());
+  BOOST_REQUIRE_EQUAL(sit->size(), (std::size_t)2);
+  BOOST_CHECK_EQUAL((*sit)[0][0], 6);
+  BOOST_CHECK_EQUAL((*sit)[1][0], 0.25);
+  ++sit;
+  BOOST_CHECK(sit == ScoreDataIterator::end());
+}
+
+BOOST_AUTO_TEST_CASE(column_store_large_statistics)
+{
+  // 2^31 is integral but does not fit an int32 column
+  TempFile file;
+  ColumnStoreWriter writer(COLUMN_SCORES, "BLEU", 3);
+  writer.Add(0, MakeScores(2147483648.0f, -2147483648.0f, 1));
+  writer.Append(file.str());
+
+  ColumnStore store(file.str());
+  std::vector<ColumnStore::Entry> entries;
+  store.Entries(0, entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), (std::size_t)1);
+  BOOST_CHECK_EQUAL(entries[0].Value(0), 2147483648.0f);
+  BOOST_CHECK_EQUAL(entries[0].Value(1), -2147483648.0f);
+}
+
+BOOST_AUTO_TEST_CASE(column_store_damaged)
+{
+  TempFile file;
+  ColumnStoreWriter writer(COLUMN_FEATURES, "lm_0 w_0 ", 2);
+  writer.Add(0, MakeFeatures(-1.5, 3, "pp_a", 1));
+  writer.Add(1, MakeFeatures(-3.5, 5, "pp_b", 2));
+  writer.Append(file.str());
+
+  std::string bytes;
+  {
+    std::ifstream in(file.str().c_str(), std::ios::in | std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  BOOST_REQUIRE(bytes.size() > sizeof(ColumnSegmentHeader));
+
+  // a segment cut short
+  {
+    std::ofstream out(file.str().c_str(), std::ios::out | std::ios::binary);
+    out.write(bytes.data(), bytes.size() - 8);
+  }
+  BOOST_CHECK_THROW(ColumnStore store(file.str()), util::Exception);
+
+  // a section beyond the end of its segment
+  {
+    std::string damaged(bytes);
+    ColumnSegmentHeader header;
+    memcpy(&header, damaged.data(), sizeof(header));
+    header.nameOffset = header.size;
+    memcpy(&damaged[0], &header, sizeof(header));
+    std::ofstream out(file.str().c_str(), std::ios::out | std::ios::binary);
+    out.write(damaged.data(), damaged.size());
+  }
+  BOOST_CHECK_THROW(ColumnStore store(file.str()), util::Exception);
+
+  // more entries than the segment has room for
+  {
+    std::string damaged(bytes);
+    ColumnSegmentHeader header;
+    memcpy(&header, damaged.data(), sizeof(header));
+    header.numEntries = 1000;
+    memcpy(&damaged[0], &header, sizeof(header));
+    std::ofstream out(file.str().c_str(), std::ios::out | std::ios::binary);
+    out.write(damaged.data(), damaged.size());
+  }
+  BOOST_CHECK_THROW(ColumnStore store(file.str()), util::Exception);
+}
@@ -128,6 +128,56 @@ void Data::removeDuplicates()
     }
   }
 }
+
+void Data::removeDuplicates(const Data& seen)
+{
+  for (size_t s = 0; s < m_feature_data->size(); s++) {
+    FeatureArray& feat_array = m_feature_data->get(s);
+    ScoreArray& score_array = m_score_data->get(s);
+    int seen_feat_pos = seen.m_feature_data->getIndex(feat_array.getIndex());
+    int seen_score_pos = seen.m_score_data->getIndex(score_array.getIndex());
+    if (seen_feat_pos < 0 || seen_score_pos < 0) continue;
+    const FeatureArray& seen_feats = seen.m_feature_data->get(seen_feat_pos);
+    const ScoreArray& seen_scores = seen.m_score_data->get(seen_score_pos);
+
+    // seen entries by the sum of their dense features, as above
+    map<double, vector<size_t> > lookup;
+    for (size_t j = 0; j < seen_feats.size(); j++) {
+      const FeatureStats& feats = seen_feats.get(j);
+      double sum = 0.0;
+      for (size_t l = 0; l < feats.size(); l++)
+        sum += feats.get(l);
+      lookup[sum].push_back(j);
+    }
+
+    size_t nKept = 0;
+    for (size_t k = 0; k < feat_array.size(); k++) {
+      const FeatureStats& cur_feats = feat_array.get(k);
+      double sum = 0.0;
+      for (size_t l = 0; l < cur_feats.size(); l++)
+        sum += cur_feats.get(l);
+
+      bool duplicate = false;
+      map<double, vector<size_t> >::const_iterator it = lookup.find(sum);
+      if (it != lookup.end()) {
+        for (size_t l = 0; l < it->second.size() && !duplicate; l++) {
+          size_t j = it->second[l];
+          duplicate = cur_feats == seen_feats.get(j)
+                      && score_array.get(k) == seen_scores.get(j);
+        }
+      }
+      if (!duplicate) {
+        if (nKept != k) {
+          feat_array.swap(nKept, k);
+          score_array.swap(nKept, k);
+        }
+        nKept++;
+      }
+    }
+    feat_array.resize(nKept);
+    score_array.resize(nKept);
+  }
+}
 //END_ADDED
 
 void Data::load(const std::string &featfile, const std::string &scorefile)
@@ -206,6 +256,12 @@ void Data::save(const std::string &featfile, const std::string &scorefile, bool
   m_score_data->save(scorefile, bin);
 }
 
+void Data::append(const std::string &featfile, const std::string &scorefile) const
+{
+  m_feature_data->append(featfile);
+  m_score_data->append(scorefile);
+}
+
 void Data::InitFeatureMap(const string& str)
 {
   string buf = str;
@@ -73,10 +73,21 @@ public:
 
   void save(const std::string &featfile, const std::string &scorefile, bool bin=false);
 
+  /**
+   * Append the data to a pair of column stores as new segments.
+   */
+  void append(const std::string &featfile, const std::string &scorefile) const;
+
   //ADDED BY TS
   void removeDuplicates();
   //END_ADDED
 
+  /**
+   * Remove the entries that seen already has for the same sentence, e.g.
+   * those of earlier iterations when only the new ones are appended.
+   */
+  void removeDuplicates(const Data& seen);
+
   inline bool existsFeatureNames() const {
     return m_feature_data->existsFeatureNames();
   }
@@ -75,3 +75,46 @@ BOOST_AUTO_TEST_CASE(add_features_test)
   BOOST_CHECK(IsAlmostEqual(-14.7486f, stats.get(7)));
   BOOST_CHECK(IsAlmostEqual(7.99917f,  stats.get(8)));
 }
+
+namespace
+{
+// adds an entry with one feature and one score statistic for sentence
+void AddEntry(Data& data, int sentence, float feature, int score)
+{
+  FeatureStats feats;
+  feats.add(feature);
+  ScoreStats scores;
+  scores.add(score);
+  data.getFeatureData()->add(feats, sentence);
+  data.getScoreData()->add(scores, sentence);
+}
+}
+
+BOOST_AUTO_TEST_CASE(remove_seen_duplicates_test)
+{
+  boost::scoped_ptr<Scorer> scorer(ScorerFactory::getScorer("BLEU", ""));
+  Data seen(scorer.get());
+  AddEntry(seen, 0, 1.0f, 1);
+  AddEntry(seen, 0, 2.0f, 2);
+  AddEntry(seen, 1, 3.0f, 3);
+
+  Data data(scorer.get());
+  AddEntry(data, 0, 2.0f, 2);  // seen
+  AddEntry(data, 0, 2.0f, 5);  // same features, other score
+  AddEntry(data, 0, 4.0f, 4);
+  AddEntry(data, 1, 3.0f, 3);  // seen
+  AddEntry(data, 2, 1.0f, 1);  // seen, but for another sentence
+  data.removeDuplicates(seen);
+
+  FeatureDataHandle feats = data.getFeatureData();
+  ScoreDataHandle scores = data.getScoreData();
+  BOOST_REQUIRE_EQUAL(feats->size(), (std::size_t)3);
+  BOOST_REQUIRE_EQUAL(feats->get(0).size(), (std::size_t)2);
+  BOOST_CHECK(IsAlmostEqual(2.0f, feats->get(0, 0).get(0)));
+  BOOST_CHECK_EQUAL(scores->get(0, 0).get(0), 5);
+  BOOST_CHECK(IsAlmostEqual(4.0f, feats->get(0, 1).get(0)));
+  BOOST_CHECK_EQUAL(scores->get(0, 1).get(0), 4);
+  BOOST_CHECK_EQUAL(feats->get(1).size(), (std::size_t)0);
+  BOOST_CHECK_EQUAL(scores->get(1).size(), (std::size_t)0);
+  BOOST_CHECK_EQUAL(feats->get(2).size(), (std::size_t)1);
+}
@@ -9,8 +9,10 @@
 #include "FeatureData.h"
 
 #include <limits>
+#include "ColumnStore.h"
 #include "FileStream.h"
 #include "Util.h"
+#include "util/exception.hh"
 
 using namespace std;
 
@@ -70,6 +72,10 @@ void FeatureData::load(istream* is, const SparseVector& sparseWeights)
 void FeatureData::load(const string &file, const SparseVector& sparseWeights)
 {
   TRACE_ERR("loading feature data from " << file << endl);
+  if (ColumnStore::IsColumnStore(file)) {
+    loadColumns(file, sparseWeights);
+    return;
+  }
   inputfilestream input_stream(file); // matches a stream with a file. Opens the file
   if (!input_stream) {
     throw runtime_error("Unable to open feature file: " + file);
@@ -79,6 +85,42 @@ void FeatureData::load(const string &file, const SparseVector& sparseWeights)
   input_stream.close();
 }
 
+void FeatureData::loadColumns(const string &file, const SparseVector& sparseWeights)
+{
+  ColumnStore store(file);
+  UTIL_THROW_IF(store.Kind() != COLUMN_FEATURES, util::Exception,
+                file << " does not hold feature data");
+  if (size() == 0)
+    setFeatureMap(store.Label());
+
+  vector<ColumnStore::Entry> entries;
+  FeatureStats stats(store.NumColumns());
+  for (size_t s = 0; s < store.NumSentences(); ++s) {
+    FeatureArray entry;
+    entry.setIndex(store.SentenceId(s));
+    entry.NumberOfFeatures(store.NumColumns());
+    entry.Features(store.Label());
+    store.Entries(s, entries);
+    for (size_t j = 0; j < entries.size(); ++j) {
+      store.Get(entries[j], stats, sparseWeights);
+      entry.add(stats);
+    }
+    add(entry);
+  }
+}
+
+void FeatureData::append(const string &file) const
+{
+  if (file.empty()) return;
+  TRACE_ERR("appending the array to " << file << endl);
+  ColumnStoreWriter writer(COLUMN_FEATURES, m_features, m_num_features);
+  for (featdata_t::const_iterator i = m_array.begin(); i != m_array.end(); ++i) {
+    for (size_t j = 0; j < i->size(); ++j)
+      writer.Add(i->getIndex(), i->get(j));
+  }
+  writer.Append(file);
+}
+
 void FeatureData::add(FeatureArray& e)
 {
   if (exists(e.getIndex())) { // array at position e.getIndex() already exists
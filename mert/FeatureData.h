@@ -89,6 +89,13 @@ public:
   void load(std::istream* is, const SparseVector& sparseWeights);
   void load(const std::string &file, const SparseVector& sparseWeights);
 
+  /**
+   * Append all entries to a column store as one segment. load() reads
+   * column stores as well as text and binary files.
+   */
+  void append(const std::string &file) const;
+  void loadColumns(const std::string &file, const SparseVector& sparseWeights);
+
   bool check_consistency() const;
 
   void setIndex();
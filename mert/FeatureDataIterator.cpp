@@ -25,6 +25,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "FeatureArray.h"
 #include "FeatureDataIterator.h"
+#include "ColumnStore.h"
 
 
 using namespace std;
@@ -69,10 +70,17 @@ size_t hash_value(FeatureDataItem const& item)
 }
 
 
-FeatureDataIterator::FeatureDataIterator() {}
+FeatureDataIterator::FeatureDataIterator() : m_sentence(0) {}
 
-FeatureDataIterator::FeatureDataIterator(const string& filename)
+FeatureDataIterator::FeatureDataIterator(const string& filename) : m_sentence(0)
 {
+  if (ColumnStore::IsColumnStore(filename)) {
+    m_store.reset(new ColumnStore(filename));
+    UTIL_THROW_IF(m_store->Kind() != COLUMN_FEATURES, util::Exception,
+                  filename << " does not hold feature data");
+    readNextColumns();
+    return;
+  }
   m_in.reset(new FilePiece(filename.c_str()));
   readNext();
 }
@@ -124,13 +132,41 @@ void FeatureDataIterator::readNext()
   }
 }
 
+void FeatureDataIterator::readNextColumns()
+{
+  m_next.clear();
+  if (m_sentence == m_store->NumSentences()) {
+    m_store.reset();
+    return;
+  }
+  vector<ColumnStore::Entry> entries;
+  m_store->Entries(m_sentence, entries);
+  m_next.resize(entries.size());
+  for (size_t j = 0; j < entries.size(); ++j) {
+    FeatureDataItem& item = m_next[j];
+    item.dense.resize(m_store->NumColumns());
+    for (size_t c = 0; c < item.dense.size(); ++c)
+      item.dense[c] = entries[j].Value(c);
+    for (size_t k = 0; k < entries[j].NumSparse(); ++k)
+      item.sparse.set(entries[j].SparseId(k), entries[j].SparseValue(k));
+  }
+}
+
 void FeatureDataIterator::increment()
 {
-  readNext();
+  if (m_store) {
+    ++m_sentence;
+    readNextColumns();
+  } else {
+    readNext();
+  }
 }
 
 bool FeatureDataIterator::equal(const FeatureDataIterator& rhs) const
 {
+  if (m_store || rhs.m_store) {
+    return m_store == rhs.m_store && m_sentence == rhs.m_sentence;
+  }
   if (!m_in && !rhs.m_in) {
     return true;
   } else if (!m_in) {
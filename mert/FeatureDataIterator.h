@@ -45,6 +45,8 @@ class FilePiece;
 namespace MosesTuning
 {
 
+class ColumnStore;
+
 
 class FileFormatException : public util::Exception
 {
@@ -95,8 +97,12 @@ private:
   const std::vector<FeatureDataItem>& dereference() const;
 
   void readNext();
+  void readNextColumns();
 
   boost::shared_ptr<util::FilePiece> m_in;
+  // Column stores are read in place, one sentence at a time.
+  boost::shared_ptr<ColumnStore> m_store;
+  std::size_t m_sentence;
   std::vector<FeatureDataItem> m_next;
 };
 
@@ -249,6 +249,11 @@ void FeatureStats::addSparse(const string& name, FeatureStatsType v)
   m_map.set(name,v);
 }
 
+void FeatureStats::addSparse(size_t id, FeatureStatsType v)
+{
+  m_map.set(id,v);
+}
+
 void FeatureStats::set(string &theString, const SparseVector& sparseWeights )
 {
   string substring, stringBuf;
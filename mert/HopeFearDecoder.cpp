@@ -24,6 +24,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #define BOOST_FILESYSTEM_VERSION 3
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
 
 #include "util/exception.hh"
 #include "util/file_piece.hh"
@@ -39,6 +42,186 @@ namespace MosesTuning
 
 static const ValType BLEU_RATIO = 5;
 
+namespace
+{
+
+/** Runs task(i) for i in [begin,end), catching what it throws */
+template <class Task>
+struct TaskBlock {
+  const Task* task;
+  size_t begin, end;
+  string error;
+
+  void operator()() {
+    try {
+      for (size_t i = begin; i < end; ++i) (*task)(i);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+  }
+};
+
+/** Runs task(i) for i in [0,count), split in contiguous blocks over threads */
+template <class Task>
+void RunTask(const Task& task, size_t count, size_t numThreads)
+{
+  size_t numBlocks = 1;
+#ifdef WITH_THREADS
+  numBlocks = max<size_t>(1, min(numThreads, count));
+#endif
+  vector<TaskBlock<Task> > blocks(numBlocks);
+  for (size_t i = 0; i < numBlocks; ++i) {
+    blocks[i].task = &task;
+    blocks[i].begin = count * i / numBlocks;
+    blocks[i].end = count * (i + 1) / numBlocks;
+  }
+#ifdef WITH_THREADS
+  if (numBlocks > 1) {
+    boost::thread_group workers;
+    for (size_t i = 1; i < numBlocks; ++i)
+      workers.create_thread(boost::ref(blocks[i]));
+    blocks[0]();
+    workers.join_all();
+  } else
+#endif
+    blocks[0]();
+  for (size_t i = 0; i < numBlocks; ++i) {
+    UTIL_THROW_IF(!blocks[i].error.empty(), util::Exception, blocks[i].error);
+  }
+}
+
+struct HopeFearTask {
+  const HopeFearDecoder* decoder;
+  size_t first;
+  const vector<ValType>* backgroundBleu;
+  const MiraWeightVector* wv;
+  vector<HopeFearData>* hopeFear;
+
+  void operator()(size_t i) const {
+    decoder->HopeFearAt(first + i, *backgroundBleu, *wv, &(*hopeFear)[i]);
+  }
+};
+
+struct MaxModelTask {
+  const HopeFearDecoder* decoder;
+  const AvgWeightVector* wv;
+  vector<vector<ValType> >* stats;
+
+  void operator()(size_t i) const {
+    decoder->MaxModelAt(i, *wv, &(*stats)[i]);
+  }
+};
+
+/** The n-best list being decoded: the iterator's current one */
+class CurrentPack
+{
+public:
+  explicit CurrentPack(HypPackEnumerator& train) : train_(train) {}
+  size_t size() const {
+    return train_.cur_size();
+  }
+  const MiraFeatureVector& featuresAt(size_t i) const {
+    return train_.featuresAt(i);
+  }
+  const ScoreDataItem& scoresAt(size_t i) const {
+    return train_.scoresAt(i);
+  }
+private:
+  HypPackEnumerator& train_;
+};
+
+/** The n-best list being decoded: the one at a given position */
+class PackAt
+{
+public:
+  PackAt(const RandomAccessHypPackEnumerator& train, size_t pos)
+    : train_(train), pos_(pos) {}
+  size_t size() const {
+    return train_.sizeAt(pos_);
+  }
+  const MiraFeatureVector& featuresAt(size_t i) const {
+    return train_.featuresAt(pos_, i);
+  }
+  const ScoreDataItem& scoresAt(size_t i) const {
+    return train_.scoresAt(pos_, i);
+  }
+private:
+  const RandomAccessHypPackEnumerator& train_;
+  size_t pos_;
+};
+
+template <class Pack>
+void NbestHopeFear(const Pack& pack, Scorer* scorer, bool safe_hope,
+                   const vector<ValType>& backgroundBleu,
+                   const MiraWeightVector& wv, HopeFearData* hopeFear)
+{
+  // Hope / fear decode
+  ValType hope_scale = 1.0;
+  size_t hope_index=0, fear_index=0, model_index=0;
+  ValType hope_score=0, fear_score=0, model_score=0;
+  for(size_t safe_loop=0; safe_loop<2; safe_loop++) {
+    ValType hope_bleu=0, hope_model=0;
+    for(size_t i=0; i< pack.size(); i++) {
+      const MiraFeatureVector& vec=pack.featuresAt(i);
+      ValType score = wv.score(vec);
+      ValType bleu = scorer->calculateSentenceLevelBackgroundScore(pack.scoresAt(i),backgroundBleu);
+      // Hope
+      if(i==0 || (hope_scale*score + bleu) > hope_score) {
+        hope_score = hope_scale*score + bleu;
+        hope_index = i;
+        hope_bleu = bleu;
+        hope_model = score;
+      }
+      // Fear
+      if(i==0 || (score - bleu) > fear_score) {
+        fear_score = score - bleu;
+        fear_index = i;
+      }
+      // Model
+      if(i==0 || score > model_score) {
+        model_score = score;
+        model_index = i;
+      }
+    }
+    // Outer loop rescales the contribution of model score to 'hope' in antagonistic cases
+    // where model score is having far more influence than BLEU
+    hope_bleu *= BLEU_RATIO; // We only care about cases where model has MUCH more influence than BLEU
+    if(safe_hope && safe_loop==0 && abs(hope_model)>1e-8 && abs(hope_bleu)/abs(hope_model)<hope_scale)
+      hope_scale = abs(hope_bleu) / abs(hope_model);
+    else break;
+  }
+  hopeFear->modelFeatures = pack.featuresAt(model_index);
+  hopeFear->hopeFeatures = pack.featuresAt(hope_index);
+  hopeFear->fearFeatures = pack.featuresAt(fear_index);
+
+  hopeFear->hopeStats = pack.scoresAt(hope_index);
+  hopeFear->hopeBleu = scorer->calculateSentenceLevelBackgroundScore(hopeFear->hopeStats, backgroundBleu);
+  const vector<float>& fear_stats = pack.scoresAt(fear_index);
+  hopeFear->fearBleu = scorer->calculateSentenceLevelBackgroundScore(fear_stats, backgroundBleu);
+
+  hopeFear->modelStats = pack.scoresAt(model_index);
+  hopeFear->hopeFearEqual = (hope_index == fear_index);
+}
+
+template <class Pack>
+void NbestMaxModel(const Pack& pack, const AvgWeightVector& wv, vector<ValType>* stats)
+{
+  // Find max model
+  size_t max_index=0;
+  ValType max_score=0;
+  for(size_t i=0; i<pack.size(); i++) {
+    MiraFeatureVector vec(pack.featuresAt(i));
+    ValType score = wv.score(vec);
+    if(i==0 || score > max_score) {
+      max_index = i;
+      max_score = score;
+    }
+  }
+  *stats = pack.scoresAt(max_index);
+}
+
+} // namespace
+
 std::pair<MiraWeightVector*,size_t>
 InitialiseWeights(const string& denseInitFile, const string& sparseInitFile,
                   const string& type, bool verbose)
@@ -132,9 +315,22 @@ InitialiseWeights(const string& denseInitFile, const string& sparseInitFile,
   return pair<MiraWeightVector*,size_t>(new MiraWeightVector(initParams), initDenseSize);
 }
 
-ValType HopeFearDecoder::Evaluate(const AvgWeightVector& wv)
+ValType HopeFearDecoder::Evaluate(const AvgWeightVector& wv, size_t numThreads)
 {
   vector<ValType> stats(scorer_->NumberOfScores(),0);
+  if (numThreads > 1 && RandomAccess()) {
+    // Decode in parallel, then sum in epoch order as below
+    reset();
+    vector<vector<ValType> > sents(NumExamples());
+    MaxModelTask task = { this, &wv, &sents };
+    RunTask(task, sents.size(), numThreads);
+    for (size_t j = 0; j < sents.size(); ++j) {
+      for(size_t i=0; i<sents[j].size(); i++) {
+        stats[i]+=sents[j][i];
+      }
+    }
+    return scorer_->calculateScore(stats);
+  }
   for(reset(); !finished(); next()) {
     vector<ValType> sent;
     MaxModel(wv,&sent);
@@ -145,6 +341,25 @@ ValType HopeFearDecoder::Evaluate(const AvgWeightVector& wv)
   return scorer_->calculateScore(stats);
 }
 
+void HopeFearDecoder::HopeFearBatch(
+  size_t batchSize,
+  size_t numThreads,
+  const vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  vector<HopeFearData>* hopeFear
+)
+{
+  UTIL_THROW_IF(!RandomAccess(), util::Exception,
+                "Batched hope/fear decoding needs the training data in memory");
+  size_t first = Position();
+  size_t count = min(batchSize, NumExamples() - first);
+  hopeFear->clear();
+  hopeFear->resize(count);
+  HopeFearTask task = { this, first, &backgroundBleu, &wv, hopeFear };
+  RunTask(task, count, numThreads);
+  for (size_t i = 0; i < count; ++i) next();
+}
+
 NbestHopeFearDecoder::NbestHopeFearDecoder(
   const vector<string>& featureFiles,
   const vector<string>&  scoreFiles,
@@ -157,8 +372,10 @@ NbestHopeFearDecoder::NbestHopeFearDecoder(
   scorer_ = scorer;
   if (streaming) {
     train_.reset(new StreamingHypPackEnumerator(featureFiles, scoreFiles));
+    random_ = NULL;
   } else {
-    train_.reset(new RandomAccessHypPackEnumerator(featureFiles, scoreFiles, no_shuffle));
+    random_ = new RandomAccessHypPackEnumerator(featureFiles, scoreFiles, no_shuffle);
+    train_.reset(random_);
   }
 }
 
@@ -184,72 +401,48 @@ void NbestHopeFearDecoder::HopeFear(
   HopeFearData* hopeFear
 )
 {
+  NbestHopeFear(CurrentPack(*train_), scorer_, safe_hope_, backgroundBleu, wv, hopeFear);
+}
 
+void NbestHopeFearDecoder::MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats)
+{
+  NbestMaxModel(CurrentPack(*train_), wv, stats);
+}
 
-  // Hope / fear decode
-  ValType hope_scale = 1.0;
-  size_t hope_index=0, fear_index=0, model_index=0;
-  ValType hope_score=0, fear_score=0, model_score=0;
-  for(size_t safe_loop=0; safe_loop<2; safe_loop++) {
-    ValType hope_bleu=0, hope_model=0;
-    for(size_t i=0; i< train_->cur_size(); i++) {
-      const MiraFeatureVector& vec=train_->featuresAt(i);
-      ValType score = wv.score(vec);
-      ValType bleu = scorer_->calculateSentenceLevelBackgroundScore(train_->scoresAt(i),backgroundBleu);
-      // Hope
-      if(i==0 || (hope_scale*score + bleu) > hope_score) {
-        hope_score = hope_scale*score + bleu;
-        hope_index = i;
-        hope_bleu = bleu;
-        hope_model = score;
-      }
-      // Fear
-      if(i==0 || (score - bleu) > fear_score) {
-        fear_score = score - bleu;
-        fear_index = i;
-      }
-      // Model
-      if(i==0 || score > model_score) {
-        model_score = score;
-        model_index = i;
-      }
-    }
-    // Outer loop rescales the contribution of model score to 'hope' in antagonistic cases
-    // where model score is having far more influence than BLEU
-    hope_bleu *= BLEU_RATIO; // We only care about cases where model has MUCH more influence than BLEU
-    if(safe_hope_ && safe_loop==0 && abs(hope_model)>1e-8 && abs(hope_bleu)/abs(hope_model)<hope_scale)
-      hope_scale = abs(hope_bleu) / abs(hope_model);
-    else break;
-  }
-  hopeFear->modelFeatures = train_->featuresAt(model_index);
-  hopeFear->hopeFeatures = train_->featuresAt(hope_index);
-  hopeFear->fearFeatures = train_->featuresAt(fear_index);
+bool NbestHopeFearDecoder::RandomAccess() const
+{
+  return random_ != NULL;
+}
 
-  hopeFear->hopeStats = train_->scoresAt(hope_index);
-  hopeFear->hopeBleu = scorer_->calculateSentenceLevelBackgroundScore(hopeFear->hopeStats, backgroundBleu);
-  const vector<float>& fear_stats = train_->scoresAt(fear_index);
-  hopeFear->fearBleu = scorer_->calculateSentenceLevelBackgroundScore(fear_stats, backgroundBleu);
+size_t NbestHopeFearDecoder::Position() const
+{
+  assert(random_);
+  return random_->cur_position();
+}
 
-  hopeFear->modelStats = train_->scoresAt(model_index);
-  hopeFear->hopeFearEqual = (hope_index == fear_index);
+size_t NbestHopeFearDecoder::NumExamples() const
+{
+  assert(random_);
+  return random_->num_packs();
 }
 
-void NbestHopeFearDecoder::MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats)
+void NbestHopeFearDecoder::HopeFearAt(
+  size_t index,
+  const std::vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  HopeFearData* hopeFear
+) const
 {
-  // Find max model
-  size_t max_index=0;
-  ValType max_score=0;
-  for(size_t i=0; i<train_->cur_size(); i++) {
-    MiraFeatureVector vec(train_->featuresAt(i));
-    ValType score = wv.score(vec);
-    if(i==0 || score > max_score) {
-      max_index = i;
-      max_score = score;
-    }
-  }
-  *stats = train_->scoresAt(max_index);
+  assert(random_);
+  NbestHopeFear(PackAt(*random_, index), scorer_, safe_hope_, backgroundBleu, wv, hopeFear);
 }
 
+void NbestHopeFearDecoder::MaxModelAt(size_t index, const AvgWeightVector& wv,
+                                      std::vector<ValType>* stats) const
+{
+  assert(random_);
+  NbestMaxModel(PackAt(*random_, index), wv, stats);
+}
 
 
 HypergraphHopeFearDecoder::HypergraphHopeFearDecoder
@@ -328,16 +521,48 @@ bool HypergraphHopeFearDecoder::finished()
   return sentenceIdIter_ == sentenceIds_.end();
 }
 
+bool HypergraphHopeFearDecoder::RandomAccess() const
+{
+  return true;
+}
+
+size_t HypergraphHopeFearDecoder::Position() const
+{
+  return sentenceIdIter_ - sentenceIds_.begin();
+}
+
+size_t HypergraphHopeFearDecoder::NumExamples() const
+{
+  return sentenceIds_.size();
+}
+
+const Graph& HypergraphHopeFearDecoder::GetGraph(size_t sentenceId) const
+{
+  GraphColl::const_iterator i = graphs_.find(sentenceId);
+  UTIL_THROW_IF(i == graphs_.end(), HypergraphException, "No hypergraph for sentence " << sentenceId);
+  return *(i->second);
+}
+
 void HypergraphHopeFearDecoder::HopeFear(
   const vector<ValType>& backgroundBleu,
   const MiraWeightVector& wv,
   HopeFearData* hopeFear
 )
 {
-  size_t sentenceId = *sentenceIdIter_;
+  HopeFearAt(Position(), backgroundBleu, wv, hopeFear);
+}
+
+void HypergraphHopeFearDecoder::HopeFearAt(
+  size_t index,
+  const vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  HopeFearData* hopeFear
+) const
+{
+  size_t sentenceId = sentenceIds_[index];
   SparseVector weights;
   wv.ToSparse(&weights, num_dense_);
-  const Graph& graph = *(graphs_[sentenceId]);
+  const Graph& graph = GetGraph(sentenceId);
 
   // ValType hope_scale = 1.0;
   HgHypothesis hopeHypo, fearHypo, modelHypo;
@@ -428,13 +653,19 @@ void HypergraphHopeFearDecoder::HopeFear(
 void HypergraphHopeFearDecoder::MaxModel(const AvgWeightVector& wv, vector<ValType>* stats)
 {
   assert(!finished());
+  MaxModelAt(Position(), wv, stats);
+}
+
+void HypergraphHopeFearDecoder::MaxModelAt(size_t index, const AvgWeightVector& wv,
+    vector<ValType>* stats) const
+{
   HgHypothesis bestHypo;
-  size_t sentenceId = *sentenceIdIter_;
+  size_t sentenceId = sentenceIds_[index];
   SparseVector weights;
   wv.ToSparse(&weights, num_dense_);
   vector<ValType> bg(scorer_->NumberOfScores());
   //cerr << "Calculating bleu on " << sentenceId << endl;
-  Viterbi(*(graphs_[sentenceId]), weights, 0, references_, sentenceId, bg, &bestHypo);
+  Viterbi(GetGraph(sentenceId), weights, 0, references_, sentenceId, bg, &bestHypo);
   stats->resize(bestHypo.bleuStats.size());
   /*
   for (size_t i = 0; i < bestHypo.text.size(); ++i) {
@@ -84,8 +84,47 @@ public:
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats)
   = 0;
 
+  /**
+    * True if the examples of an epoch can be decoded out of order, which
+    * HopeFearBatch and multi-threaded evaluation need.
+    **/
+  virtual bool RandomAccess() const = 0;
+
+  /** Position of the iterator in the current epoch, and the epoch's size */
+  virtual size_t Position() const = 0;
+  virtual size_t NumExamples() const = 0;
+
+  /**
+    * As HopeFear and MaxModel, for the example at the given position of the
+    * current epoch. These do not move the iterator and may be called from
+    * several threads at once.
+    **/
+  virtual void HopeFearAt(
+    size_t index,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    HopeFearData* hopeFear
+  ) const = 0;
+  virtual void MaxModelAt(size_t index, const AvgWeightVector& wv,
+                          std::vector<ValType>* stats) const = 0;
+
+  /**
+    * Calculate hope, fear and model hypotheses for the next batchSize
+    * examples (fewer at the end of the epoch) using up to numThreads
+    * threads, and move the iterator past them. All of them are decoded with
+    * the same weights, and the results are in epoch order whatever the
+    * number of threads.
+    **/
+  void HopeFearBatch(
+    size_t batchSize,
+    size_t numThreads,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    std::vector<HopeFearData>* hopeFear
+  );
+
   /** Calculate bleu on training set */
-  ValType Evaluate(const AvgWeightVector& wv);
+  ValType Evaluate(const AvgWeightVector& wv, size_t numThreads = 1);
 
 protected:
   Scorer* scorer_;
@@ -116,8 +155,24 @@ public:
 
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats);
 
+  virtual bool RandomAccess() const;
+  virtual size_t Position() const;
+  virtual size_t NumExamples() const;
+
+  virtual void HopeFearAt(
+    size_t index,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    HopeFearData* hopeFear
+  ) const;
+
+  virtual void MaxModelAt(size_t index, const AvgWeightVector& wv,
+                          std::vector<ValType>* stats) const;
+
 private:
   boost::scoped_ptr<HypPackEnumerator> train_;
+  // Same object as train_ when reading into memory, NULL when streaming
+  RandomAccessHypPackEnumerator* random_;
   bool safe_hope_;
 
 };
@@ -152,7 +207,23 @@ public:
 
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats);
 
+  virtual bool RandomAccess() const;
+  virtual size_t Position() const;
+  virtual size_t NumExamples() const;
+
+  virtual void HopeFearAt(
+    size_t index,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    HopeFearData* hopeFear
+  ) const;
+
+  virtual void MaxModelAt(size_t index, const AvgWeightVector& wv,
+                          std::vector<ValType>* stats) const;
+
 private:
+  const Graph& GetGraph(size_t sentenceId) const;
+
   size_t num_dense_;
   //maps sentence Id to graph ptr
   typedef std::map<size_t, boost::shared_ptr<Graph> > GraphColl;
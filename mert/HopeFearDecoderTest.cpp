@@ -0,0 +1,167 @@
+#include "HopeFearDecoder.h"
+
+#define BOOST_TEST_MODULE MertHopeFearDecoder
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "BleuScorer.h"
+#include "MiraWeightVector.h"
+
+using namespace std;
+using namespace MosesTuning;
+
+namespace
+{
+
+const size_t kSentences = 60;
+const size_t kDense = 3;
+
+// An n-best list of random features and consistent BLEU statistics for each
+// sentence, some with a sparse feature.
+class NbestFiles
+{
+public:
+  NbestFiles()
+    : m_dir(boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("hope-fear-%%%%-%%%%")) {
+    boost::filesystem::create_directories(m_dir);
+    ofstream features(Features().c_str()), scores(Scores().c_str());
+    unsigned r = 12345;
+    for (size_t s = 0; s < kSentences; ++s) {
+      const size_t n = 5 + s % 20;
+      features << "FEATURES_TXT_BEGIN_0 " << s << " " << n << " " << kDense << " d_0 d_1 d_2\n";
+      scores << "SCORES_TXT_BEGIN_0 " << s << " " << n << " 9 BLEU\n";
+      for (size_t j = 0; j < n; ++j) {
+        for (size_t k = 0; k < kDense; ++k)
+          features << (k ? " " : "") << Next(r) % 200 / 10.0 - 10.0;
+        if (j % 3 == 0) features << " sparse" << j % 2 << "=" << Next(r) % 5;
+        features << "\n";
+        const unsigned length = 5 + Next(r) % 20;
+        for (unsigned order = 0; order < 4; ++order) {
+          const unsigned total = length > order ? length - order : 0;
+          scores << (total ? Next(r) % (total + 1) : 0) << " " << total << " ";
+        }
+        scores << length + Next(r) % 5 - 2 << "\n";
+      }
+      features << "FEATURES_TXT_END_0\n";
+      scores << "SCORES_TXT_END_0\n";
+    }
+  }
+
+  ~NbestFiles() {
+    boost::filesystem::remove_all(m_dir);
+  }
+
+  string Features() const {
+    return (m_dir / "features.dat").string();
+  }
+
+  string Scores() const {
+    return (m_dir / "scores.dat").string();
+  }
+
+private:
+  static unsigned Next(unsigned& r) {
+    r = r * 1103515245 + 12345;
+    return r >> 16;
+  }
+
+  boost::filesystem::path m_dir;
+};
+
+// The decoder kbmira uses for n-best lists read into memory, shuffling the
+// examples of each epoch.
+HopeFearDecoder* MakeDecoder(const NbestFiles& files, Scorer* scorer)
+{
+  return new NbestHopeFearDecoder(vector<string>(1, files.Features()),
+                                  vector<string>(1, files.Scores()),
+                                  false, false, true, scorer);
+}
+
+void CheckEqual(const MiraFeatureVector& a, const MiraFeatureVector& b)
+{
+  BOOST_REQUIRE_EQUAL(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    BOOST_CHECK_EQUAL(a.feat(i), b.feat(i));
+    BOOST_CHECK_EQUAL(a.val(i), b.val(i));
+  }
+}
+
+void CheckEqual(const HopeFearData& a, const HopeFearData& b)
+{
+  CheckEqual(a.modelFeatures, b.modelFeatures);
+  CheckEqual(a.hopeFeatures, b.hopeFeatures);
+  CheckEqual(a.fearFeatures, b.fearFeatures);
+  BOOST_CHECK(a.modelStats == b.modelStats);
+  BOOST_CHECK(a.hopeStats == b.hopeStats);
+  BOOST_CHECK_EQUAL(a.hopeBleu, b.hopeBleu);
+  BOOST_CHECK_EQUAL(a.fearBleu, b.fearBleu);
+  BOOST_CHECK_EQUAL(a.hopeFearEqual, b.hopeFearEqual);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(threaded_hope_fear_equals_serial)
+{
+  NbestFiles files;
+  BleuScorer scorer;
+  boost::scoped_ptr<HopeFearDecoder> serial(MakeDecoder(files, &scorer));
+  boost::scoped_ptr<HopeFearDecoder> threaded(MakeDecoder(files, &scorer));
+  BOOST_REQUIRE(threaded->RandomAccess());
+
+  vector<ValType> init(kDense);
+  init[0] = 0.5;
+  init[1] = -0.2;
+  init[2] = 0.1;
+  MiraWeightVector wv(init);
+  const vector<ValType> bg(scorer.NumberOfScores(), 1);
+
+  // Both see the epoch in the same shuffled order. Batches of 7 leave a
+  // shorter one at the end.
+  srand(7);
+  serial->reset();
+  srand(7);
+  threaded->reset();
+  vector<HopeFearData> batch;
+  size_t examples = 0;
+  while (!threaded->finished()) {
+    BOOST_REQUIRE_EQUAL(threaded->Position(), examples);
+    threaded->HopeFearBatch(7, 4, bg, wv, &batch);
+    BOOST_REQUIRE(!batch.empty());
+    for (size_t i = 0; i < batch.size(); ++i, ++examples) {
+      BOOST_REQUIRE(!serial->finished());
+      HopeFearData expected;
+      serial->HopeFear(bg, wv, &expected);
+      serial->next();
+      CheckEqual(expected, batch[i]);
+    }
+  }
+  BOOST_CHECK(serial->finished());
+  BOOST_CHECK_EQUAL(examples, kSentences);
+}
+
+BOOST_AUTO_TEST_CASE(threaded_evaluation_equals_serial)
+{
+  NbestFiles files;
+  BleuScorer scorer;
+  boost::scoped_ptr<HopeFearDecoder> decoder(MakeDecoder(files, &scorer));
+
+  vector<ValType> init(kDense);
+  init[0] = -0.3;
+  init[1] = 0.4;
+  init[2] = 0.2;
+  MiraWeightVector wv(init);
+  // one update, so that the average differs from the weights
+  MiraFeatureVector step(vector<ValType>(kDense, 1.0), vector<size_t>(), vector<ValType>());
+  wv.update(step, 0.1);
+  const AvgWeightVector avg = wv.avg();
+
+  const ValType expected = decoder->Evaluate(avg, 1);
+  BOOST_CHECK_EQUAL(decoder->Evaluate(avg, 4), expected);
+  BOOST_CHECK_EQUAL(decoder->Evaluate(avg, 1000), expected);
+}
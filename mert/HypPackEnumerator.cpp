@@ -211,6 +211,27 @@ size_t RandomAccessHypPackEnumerator::cur_id()
 {
   return m_indexes[m_cur_index];
 }
+
+size_t RandomAccessHypPackEnumerator::cur_position() const
+{
+  return m_cur_index;
+}
+size_t RandomAccessHypPackEnumerator::num_packs() const
+{
+  return m_indexes.size();
+}
+size_t RandomAccessHypPackEnumerator::sizeAt(size_t pos) const
+{
+  return m_features[m_indexes[pos]].size();
+}
+const MiraFeatureVector& RandomAccessHypPackEnumerator::featuresAt(size_t pos, size_t i) const
+{
+  return m_features[m_indexes[pos]][i];
+}
+const ScoreDataItem& RandomAccessHypPackEnumerator::scoresAt(size_t pos, size_t i) const
+{
+  return m_scores[m_indexes[pos]][i];
+}
 // --Emacs trickery--
 // Local Variables:
 // mode:c++
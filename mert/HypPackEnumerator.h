@@ -95,6 +95,14 @@ public:
   virtual const MiraFeatureVector& featuresAt(std::size_t i);
   virtual const ScoreDataItem& scoresAt(std::size_t i);
 
+  // Random access to the pack at a position of the current order; these
+  // leave the iterator alone and are safe to call from several threads
+  std::size_t cur_position() const;
+  std::size_t num_packs() const;
+  std::size_t sizeAt(std::size_t pos) const;
+  const MiraFeatureVector& featuresAt(std::size_t pos, std::size_t i) const;
+  const ScoreDataItem& scoresAt(std::size_t pos, std::size_t i) const;
+
 private:
   bool m_no_shuffle;
   std::size_t m_cur_index;
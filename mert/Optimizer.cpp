@@ -5,10 +5,17 @@
 #include <vector>
 #include <limits>
 #include <map>
+#include <queue>
+#include <algorithm>
+#include <functional>
 #include <cfloat>
 #include <iostream>
 #include <stdint.h>
 
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
+
 #include "Point.h"
 #include "Util.h"
 
@@ -39,7 +46,7 @@ namespace MosesTuning
 
 
 Optimizer::Optimizer(unsigned Pd, const vector<unsigned>& i2O, const vector<bool>& pos, const vector<parameter_t>& start, unsigned int nrandom)
-  : m_scorer(NULL), m_feature_data(), m_num_random_directions(nrandom), m_positive(pos)
+  : m_scorer(NULL), m_feature_data(), m_num_random_directions(nrandom), m_num_threads(1), m_positive(pos)
 {
   // Warning: the init vector is a full set of parameters, of dimension m_pdim!
   Point::m_pdim = Pd;
@@ -71,196 +78,328 @@ statscore_t Optimizer::GetStatScore(const Point& param) const
   return score;
 }
 
-map<float,diff_t >::iterator AddThreshold(map<float,diff_t >& thresholdmap, float newt, const pair<unsigned,unsigned>& newdiff)
-{
-  map<float,diff_t>::iterator it = thresholdmap.find(newt);
-  if (it != thresholdmap.end()) {
-    // the threshold already exists!! this is very unlikely
-    if (it->second.back().first == newdiff.first)
-      // there was already a diff for this sentence, we change the 1 best;
-      it->second.back().second = newdiff.second;
-    else
-      it->second.push_back(newdiff);
-  } else {
-    // normal case
-    pair<map<float,diff_t>::iterator, bool> ins = thresholdmap.insert(threshold(newt, diff_t(1, newdiff)));
-    UTIL_THROW_IF(!ins.second, util::Exception, "Error");                // we really inserted something
-    it = ins.first;
-  }
-  return it;
-}
-
-statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction, Point& bestpoint) const
+namespace
 {
-  // We are looking for the best Point on the line y=Origin+x*direction
-  float min_int = 0.0001;
-  //typedef pair<unsigned,unsigned> diff;//first the sentence that changes, second is the new 1best for this sentence
-  //list<threshold> thresholdlist;
 
-  map<float,diff_t> thresholdmap;
-  thresholdmap[MIN_FLOAT] = diff_t();
-  vector<unsigned> first1best;       // the vector of nbests for x=-inf
-  for (unsigned int S = 0; S < size(); S++) {
-    map<float,diff_t >::iterator previnserted = thresholdmap.begin();
-    // First, we determine the translation with the best feature score
-    // for each sentence and each value of x.
-    //cerr << "Sentence " << S << endl;
-    multimap<float, unsigned> gradient;
-    vector<float> f0;
-    f0.resize(m_feature_data->get(S).size());
-    for (unsigned j = 0; j < m_feature_data->get(S).size(); j++) {
-      // gradient of the feature function for this particular target sentence
-      gradient.insert(pair<float, unsigned>(direction * (m_feature_data->get(S,j)), j));
-      // compute the feature function at the origin point
-      f0[j] = origin * m_feature_data->get(S, j);
+/**
+ * The weights of origin and direction, gathered in the order in which
+ * Point::operator* visits the feature columns. Slope and intercept of a
+ * candidate then come out exactly as before, but in a single pass over its
+ * contiguous FeatureStats array.
+ */
+struct LineProjection {
+  vector<unsigned> columns;
+  vector<parameter_t> origin;
+  vector<parameter_t> direction;
+
+  LineProjection(const Point& o, const Point& d) {
+    const vector<unsigned>& opt = Point::get_optindices();
+    const bool all = Point::OptimizeAll();
+    for (unsigned i = 0; i < o.size(); i++) {
+      columns.push_back(all ? i : opt[i]);
+      origin.push_back(o[i]);
+      direction.push_back(d[i]);
+    }
+    // Point::operator* adds the fixed weights to every product,
+    // including the one with the direction.
+    const map<unsigned,parameter_t>& fixed = Point::get_fixed_weights();
+    for (map<unsigned,parameter_t>::const_iterator it = fixed.begin();
+         it != fixed.end(); ++it) {
+      columns.push_back(it->first);
+      origin.push_back(it->second);
+      direction.push_back(it->second);
     }
-    // Now let's compute the 1best for each value of x.
+  }
+};
 
-    //    vector<pair<float,unsigned> > onebest;
+/**
+ * Candidate j of a sentence as a line f0[j] + x * slope.
+ */
+struct CandidateLine {
+  float slope;
+  unsigned index;
 
+  bool operator<(const CandidateLine& other) const {
+    return slope < other.slope;
+  }
+};
 
-    multimap<float,unsigned>::iterator gradientit = gradient.begin();
-    multimap<float,unsigned>::iterator highest_f0 = gradient.begin();
+/**
+ * The 1-best of a sentence changes to best at position x.
+ */
+struct Crossing {
+  float x;
+  unsigned sentence;
+  unsigned best;
 
-    float smallest = gradientit->first;//smallest gradient
-    // Several candidates can have the lowest slope (e.g., for word penalty where the gradient is an integer).
+  bool operator<(const Crossing& other) const {
+    return x < other.x || (x == other.x && sentence < other.sentence);
+  }
+};
 
-    gradientit++;
-    while (gradientit != gradient.end() && gradientit->first == smallest) {
-      //   cerr<<"ni"<<gradientit->second<<endl;;
-      //cerr<<"fos"<<f0[gradientit->second]<<" "<<f0[index]<<" "<<index<<endl;
-      if (f0[gradientit->second] > f0[highest_f0->second])
-        highest_f0 = gradientit;//the highest line is the one with he highest f0
-      gradientit++;
+/**
+ * Merge the sorted runs items[bounds[r], bounds[r+1]) into out, ordered by
+ * (x, sentence).
+ */
+void MergeRuns(const vector<Crossing>& items, const vector<size_t>& bounds,
+               vector<Crossing>& out)
+{
+  struct Head {
+    Crossing c;
+    size_t pos, end;
+    bool operator>(const Head& other) const {
+      return other.c < c;
+    }
+  };
+  priority_queue<Head, vector<Head>, greater<Head> > heap;
+  for (size_t r = 0; r + 1 < bounds.size(); r++) {
+    if (bounds[r] < bounds[r + 1]) {
+      Head h = { items[bounds[r]], bounds[r], bounds[r + 1] };
+      heap.push(h);
+    }
+  }
+  out.reserve(out.size() + items.size());
+  while (!heap.empty()) {
+    Head h = heap.top();
+    heap.pop();
+    out.push_back(h.c);
+    if (++h.pos < h.end) {
+      h.c = items[h.pos];
+      heap.push(h);
     }
+  }
+}
 
-    gradientit = highest_f0;
-    first1best.push_back(highest_f0->second);
-
-    // Now we look for the intersections points indicating a change of 1 best.
-    // We use the fact that the function is convex, which means that the gradient can only go up.
-    while (gradientit != gradient.end()) {
-      map<float,unsigned>::iterator leftmost = gradientit;
-      float m = gradientit->first;
-      float b = f0[gradientit->second];
-      multimap<float,unsigned>::iterator gradientit2 = gradientit;
-      gradientit2++;
-      float leftmostx = MAX_FLOAT;
-      for (; gradientit2 != gradient.end(); gradientit2++) {
-        //cerr<<"--"<<d++<<' '<<gradientit2->first<<' '<<gradientit2->second<<endl;
-        // Look for all candidate with a gradient bigger than the current one, and
-        // find the one with the leftmost intersection.
-        float curintersect;
-        if (m != gradientit2->first) {
-          curintersect = intersect(m, b, gradientit2->first, f0[gradientit2->second]);
-          //cerr << "curintersect: " << curintersect << " leftmostx: " << leftmostx << endl;
-          if (curintersect<=leftmostx) {
-            // We have found an intersection to the left of the leftmost we had so far.
-            // We might have curintersect==leftmostx for example is 2 candidates are the same
-            // in that case its better its better to update leftmost to gradientit2 to avoid some recomputing later.
-            leftmostx = curintersect;
-            leftmost = gradientit2; // this is the new reference
-          }
+/**
+ * Compute the upper envelope of the candidates of sentence S along the line.
+ * Returns the 1-best for x=-inf and appends the points where the 1-best
+ * changes to out, in increasing order of x.
+ */
+unsigned SentenceEnvelope(const FeatureArray& candidates, unsigned S,
+                          const LineProjection& proj, float min_int,
+                          vector<CandidateLine>& lines, vector<float>& f0,
+                          vector<Crossing>& out)
+{
+  const size_t n = candidates.size();
+  const size_t ncols = proj.columns.size();
+  const unsigned* columns = &proj.columns[0];
+  const parameter_t* dir = &proj.direction[0];
+  const parameter_t* org = &proj.origin[0];
+  lines.resize(n);
+  f0.resize(n);
+  for (size_t j = 0; j < n; j++) {
+    // gradient of the feature function for this candidate, and its
+    // value at the origin point
+    const featstats_t feats = candidates.get(j).getArray();
+    double m = 0.0, b = 0.0;
+    for (size_t k = 0; k < ncols; k++) {
+      const FeatureStatsType f = feats[columns[k]];
+      m += dir[k] * f;
+      b += org[k] * f;
+    }
+    lines[j].slope = m;
+    lines[j].index = j;
+    f0[j] = b;
+  }
+  // Stable, so that candidates with equal slopes keep their order.
+  stable_sort(lines.begin(), lines.end());
+
+  // Several candidates can have the lowest slope (e.g., for word penalty
+  // where the gradient is an integer); the highest line is the one with the
+  // highest f0.
+  size_t cur = 0;
+  for (size_t i = 1; i < n && lines[i].slope == lines[0].slope; i++) {
+    if (f0[lines[i].index] > f0[lines[cur].index])
+      cur = i;
+  }
+  const unsigned first1best = lines[cur].index;
+
+  // Now we look for the intersections points indicating a change of 1 best.
+  // We use the fact that the function is convex, which means that the
+  // gradient can only go up.
+  const size_t begin = out.size();
+  for (;;) {
+    size_t leftmost = cur;
+    const float m = lines[cur].slope;
+    const float b = f0[lines[cur].index];
+    float leftmostx = MAX_FLOAT;
+    for (size_t k = cur + 1; k < n; k++) {
+      // Look for all candidate with a gradient bigger than the current one,
+      // and find the one with the leftmost intersection. On a tie we move
+      // to the later candidate, which avoids some recomputing later.
+      if (m != lines[k].slope) {
+        const float curintersect = intersect(m, b, lines[k].slope, f0[lines[k].index]);
+        if (curintersect <= leftmostx) {
+          leftmostx = curintersect;
+          leftmost = k;
         }
       }
-      if (leftmost == gradientit) {
-        // We didn't find any more intersections.
-        // The rightmost bestindex is the one with the highest slope.
-
-        // They should be equal but there might be.
-        UTIL_THROW_IF(abs(leftmost->first-gradient.rbegin()->first) >= 0.0001,
-                      util::Exception, "Error");
-        // A small difference due to rounding error
-        break;
-      }
-      // We have found the next intersection!
-
-      pair<unsigned,unsigned> newd(S, leftmost->second);//new onebest for Sentence S is leftmost->second
-
-      if (leftmostx-previnserted->first < min_int) {
-        // Require that the intersection Point be at least min_int to the right of the previous
-        // one (for this sentence). If not, we replace the previous intersection Point with
-        // this one.
-        // Yes, it can even happen that the new intersection Point is slightly to the left of
-        // the old one, because of numerical imprecision. We do not check that we are to the
-        // right of the penultimate point also. It this happen the 1best the interval will
-        // be wrong we are going to replace previnsert by the new one because we do not want to keep
-        // 2 very close threshold: if the minima is there it could be an artifact.
-
-        map<float,diff_t>::iterator tit = thresholdmap.find(leftmostx);
-        if (tit == previnserted) {
-          // The threshold is the same as before can happen if 2 candidates are the same for example.
-          UTIL_THROW_IF(previnserted->second.back().first != newd.first,
-                        util::Exception,
-                        "Error");
-          previnserted->second.back()=newd; // just replace the 1 best for sentence S
-          // previnsert doesn't change
-        } else {
-
-          if (tit == thresholdmap.end()) {
-            thresholdmap[leftmostx]=previnserted->second; // We keep the diffs at previnsert
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = thresholdmap.find(leftmostx); // point previnsert to the new threshold
-            previnserted->second.back()=newd; // We update the diff for sentence S
-            // Threshold already exists but is not the previous one.
-          } else {
-            // We append the diffs in previnsert to tit before destroying previnsert.
-            tit->second.insert(tit->second.end(),previnserted->second.begin(),previnserted->second.end());
-            UTIL_THROW_IF(tit->second.back().first != newd.first,
-                          util::Exception,
-                          "Error");
-            tit->second.back()=newd;    // change diff for sentence S
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = tit;  // point previnsert to the new threshold
-          }
-        }
+    }
+    if (leftmost == cur) {
+      // We didn't find any more intersections. The rightmost bestindex is
+      // the one with the highest slope, up to a small rounding error.
+      UTIL_THROW_IF(abs(m - lines[n - 1].slope) >= 0.0001,
+                    util::Exception, "Error");
+      break;
+    }
 
-        UTIL_THROW_IF(previnserted == thresholdmap.end(),
-                      util::Exception,
-                      "Error");
-      } else { //normal insertion process
-        previnserted = AddThreshold(thresholdmap, leftmostx, newd);
+    const Crossing c = { leftmostx, S, lines[leftmost].index };
+    if (out.size() > begin && leftmostx - out.back().x < min_int) {
+      // Require that the intersection Point be at least min_int to the
+      // right of the previous one for this sentence. If not, it replaces
+      // the previous one: we do not want to keep 2 very close thresholds,
+      // if the minimum is there it could be an artifact. Because of
+      // numerical imprecision the new point can even be slightly to the
+      // left of the old one.
+      out.back() = c;
+    } else {
+      out.push_back(c);
+    }
+    cur = leftmost;
+  }
+  return first1best;
+}
+
+/**
+ * Envelopes of the sentences [begin, end), merged into a single run.
+ */
+struct EnvelopeBlock {
+  const FeatureData* data;
+  const LineProjection* proj;
+  float min_int;
+  unsigned begin, end;
+  unsigned* first1best;  // indexed by sentence
+  vector<Crossing> run;
+  string error;
+
+  void operator()() {
+    try {
+      vector<CandidateLine> lines;
+      vector<float> f0;
+      vector<Crossing> crossings;
+      vector<size_t> bounds(1, 0);
+      for (unsigned S = begin; S < end; S++) {
+        first1best[S] = SentenceEnvelope(data->get(S), S, *proj, min_int,
+                                         lines, f0, crossings);
+        bounds.push_back(crossings.size());
       }
-      gradientit = leftmost;
-    } // while (gradientit!=gradient.end()){
-  }   // loop on S
+      MergeRuns(crossings, bounds, run);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+  }
+};
 
-  // Now the thresholdlist is up to date: it contains a list of all the parameter_ts where
-  // the function changed its value, along with the nbest list for the interval after each threshold.
+} // namespace
 
-  map<float,diff_t >::iterator thrit;
+void Optimizer::LineEnvelope(const Point& origin, const Point& direction,
+                             vector<unsigned>& first1best,
+                             vector<float>& thresholds, diffs_t& diffs) const
+{
+  float min_int = 0.0001;
+  const LineProjection proj(origin, direction);
+
+  // First, we determine the translation with the best feature score for each
+  // sentence and each value of x. Sentences are independent: they are split
+  // into contiguous blocks, one per thread, and each block yields its
+  // threshold changes sorted by (x, sentence).
+  first1best.assign(size(), 0);
+  unsigned num_blocks = 1;
+#ifdef WITH_THREADS
+  num_blocks = max(1u, min(m_num_threads, size()));
+#endif
+  vector<EnvelopeBlock> blocks(num_blocks);
+  for (unsigned i = 0; i < num_blocks; i++) {
+    EnvelopeBlock& block = blocks[i];
+    block.data = m_feature_data.get();
+    block.proj = &proj;
+    block.min_int = min_int;
+    block.begin = static_cast<size_t>(size()) * i / num_blocks;
+    block.end = static_cast<size_t>(size()) * (i + 1) / num_blocks;
+    block.first1best = first1best.empty() ? NULL : &first1best[0];
+  }
+#ifdef WITH_THREADS
+  if (num_blocks > 1) {
+    boost::thread_group workers;
+    for (unsigned i = 1; i < num_blocks; i++)
+      workers.create_thread(boost::ref(blocks[i]));
+    blocks[0]();
+    workers.join_all();
+  } else
+#endif
+    blocks[0]();
+  for (unsigned i = 0; i < num_blocks; i++) {
+    UTIL_THROW_IF(!blocks[i].error.empty(), util::Exception, blocks[i].error);
+  }
+
+  // Merge the blocks. Changes at the same x are applied together.
+  vector<Crossing> merged;
+  if (num_blocks == 1) {
+    merged.swap(blocks[0].run);
+  } else {
+    vector<Crossing> runs;
+    vector<size_t> bounds(1, 0);
+    for (unsigned i = 0; i < num_blocks; i++) {
+      runs.insert(runs.end(), blocks[i].run.begin(), blocks[i].run.end());
+      vector<Crossing>().swap(blocks[i].run);
+      bounds.push_back(runs.size());
+    }
+    MergeRuns(runs, bounds, merged);
+  }
+
+  // thresholds[0] is x=-inf, the interval of first1best; diffs[i] holds the
+  // new 1-bests from thresholds[i+1] on.
+  thresholds.assign(1, MIN_FLOAT);
+  diffs.clear();
+  for (size_t i = 0; i < merged.size(); i++) {
+    const Crossing& c = merged[i];
+    if (thresholds.size() == 1 || c.x != thresholds.back()) {
+      thresholds.push_back(c.x);
+      diffs.push_back(diff_t());
+    }
+    diffs.back().push_back(make_pair(c.sentence, c.best));
+  }
+}
+
+statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction, Point& bestpoint) const
+{
+  // We are looking for the best Point on the line y=Origin+x*direction
+  vector<unsigned> first1best;       // the vector of nbests for x=-inf
+  vector<float> thresholds;
+  diffs_t diffs;
+  LineEnvelope(origin, direction, first1best, thresholds, diffs);
+
+  // Now the thresholds are up to date: they contain all the parameter_ts
+  // where the function changed its value, along with the nbest list for the
+  // interval after each threshold.
   if (verboselevel() > 6) {
-    cerr << "Thresholds:(" << thresholdmap.size() << ")" << endl;
-    for (thrit = thresholdmap.begin(); thrit != thresholdmap.end(); thrit++) {
-      cerr << "x: " << thrit->first << " diffs";
-      for (size_t j = 0; j < thrit->second.size(); ++j) {
-        cerr << " " <<thrit->second[j].first << "," << thrit->second[j].second;
+    cerr << "Thresholds:(" << thresholds.size() << ")" << endl;
+    for (size_t i = 0; i < thresholds.size(); i++) {
+      cerr << "x: " << thresholds[i] << " diffs";
+      if (i > 0) {
+        for (size_t j = 0; j < diffs[i - 1].size(); ++j) {
+          cerr << " " << diffs[i - 1][j].first << "," << diffs[i - 1][j].second;
+        }
       }
       cerr << endl;
     }
   }
 
   // Last thing to do is compute the Stat score (i.e., BLEU) and find the minimum.
-  thrit = thresholdmap.begin();
-  ++thrit;       // first diff corrrespond to MIN_FLOAT and first1best
-  diffs_t diffs;
-  for (; thrit != thresholdmap.end(); thrit++)
-    diffs.push_back(thrit->second);
   vector<statscore_t> scores = GetIncStatScore(first1best, diffs);
 
-  thrit = thresholdmap.begin();
   statscore_t bestscore = MIN_FLOAT;
   float bestx = MIN_FLOAT;
 
-  // We skipped the first el of thresholdlist but GetIncStatScore return 1 more for first1best.
-  UTIL_THROW_IF(scores.size() != thresholdmap.size(),
+  // GetIncStatScore returns 1 more score than diffs, for first1best.
+  UTIL_THROW_IF(scores.size() != thresholds.size(),
                 util::Exception,
                 "Error");
   for (unsigned int sc = 0; sc != scores.size(); sc++) {
-    //cerr << "x=" << thrit->first << " => " << scores[sc] << endl;
+    //cerr << "x=" << thresholds[sc] << " => " << scores[sc] << endl;
 
     //enforce positivity
-    Point respoint = origin + direction * thrit->first;
+    Point respoint = origin + direction * thresholds[sc];
     bool is_valid = true;
     for (unsigned int k=0; k < respoint.getdim(); k++) {
       if (m_positive[k] && respoint[k] <= 0.0)
@@ -268,9 +407,9 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
     }
 
     if (is_valid && scores[sc] > bestscore) {
-      // This is the score for the interval [lit2->first, (lit2+1)->first]
+      // This is the score for the interval [thresholds[sc], thresholds[sc+1]]
       // unless we're at the last score, when it's the score
-      // for the interval [lit2->first,+inf].
+      // for the interval [thresholds[sc],+inf].
       bestscore = scores[sc];
 
       // If we're not in [-inf,x1] or [xn,+inf], then just take the value
@@ -278,16 +417,8 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       // take x to be the last interval boundary + 0.1, and for the leftmost
       // interval, take x to be the first interval boundary - 1000.
       // These values are taken from cmert.
-      float leftx = thrit->first;
-      if (thrit == thresholdmap.begin()) {
-        leftx = MIN_FLOAT;
-      }
-      ++thrit;
-      float rightx = MAX_FLOAT;
-      if (thrit != thresholdmap.end()) {
-        rightx = thrit->first;
-      }
-      --thrit;
+      const float leftx = sc == 0 ? MIN_FLOAT : thresholds[sc];
+      const float rightx = sc + 1 < thresholds.size() ? thresholds[sc + 1] : MAX_FLOAT;
       //cerr << "leftx: " << leftx << " rightx: " << rightx << endl;
       if (leftx == MIN_FLOAT) {
         bestx = rightx-1000;
@@ -298,7 +429,6 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       }
       //cerr << "x = " << "set new bestx to: " << bestx << endl;
     }
-    ++thrit;
   }
 
   if (abs(bestx) < 0.00015) {
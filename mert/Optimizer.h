@@ -25,6 +25,7 @@ protected:
   Scorer *m_scorer;      // no accessor for them only child can use them
   FeatureDataHandle m_feature_data;  // no accessor for them only child can use them
   unsigned int m_num_random_directions;
+  unsigned int m_num_threads;
 
   const std::vector<bool>& m_positive;
 
@@ -37,6 +38,12 @@ public:
   void SetFeatureData(FeatureDataHandle feature_data) {
     m_feature_data = feature_data;
   }
+  /**
+   * Number of threads LineOptimize may use to build the sentence envelopes.
+   */
+  void SetNumThreads(unsigned int num_threads) {
+    m_num_threads = num_threads > 0 ? num_threads : 1;
+  }
   virtual ~Optimizer();
 
   unsigned size() const {
@@ -69,6 +76,15 @@ public:
 
   std::vector<statscore_t> GetIncStatScore(const std::vector<unsigned>& ref, const std::vector<std::vector<std::pair<unsigned,unsigned> > >& diffs) const;
 
+  /**
+   * The upper envelope of all sentences along the line origin + x * direction:
+   * the nbests for x=-inf, then each x where the nbest of some sentences
+   * changes (after thresholds[0] = -inf), with those changes in diffs.
+   */
+  void LineEnvelope(const Point& origin, const Point& direction,
+                    std::vector<unsigned>& first1best,
+                    std::vector<float>& thresholds, diffs_t& diffs) const;
+
   /**
    * Get the optimal Lambda and the best score in a particular direction from a given Point.
    */
@@ -0,0 +1,112 @@
+#include "Optimizer.h"
+
+#define BOOST_TEST_MODULE MertOptimizer
+#include <boost/test/unit_test.hpp>
+
+#include "FeatureData.h"
+#include "FeatureStats.h"
+#include "Point.h"
+
+using namespace std;
+using namespace MosesTuning;
+
+namespace
+{
+
+const unsigned kDim = 5;
+
+// Random n-best lists of varying length. The last feature counts words, so
+// that several candidates of a sentence have the same slope along it.
+FeatureDataHandle RandomFeatureData(unsigned sentences)
+{
+  FeatureDataHandle data(new FeatureData);
+  unsigned r = 12345;
+  for (unsigned S = 0; S < sentences; S++) {
+    for (unsigned j = 0; j < 1 + S % 30; j++) {
+      FeatureStats stats;
+      for (unsigned k = 0; k < kDim; k++) {
+        r = r * 1103515245 + 12345;
+        const unsigned x = r >> 16;
+        stats.add(k + 1 < kDim ? (x % 2000) / 100.0 - 10.0 : -float(x % 8));
+      }
+      data->add(stats, S);
+    }
+  }
+  return data;
+}
+
+struct Envelope {
+  vector<unsigned> first1best;
+  vector<float> thresholds;
+  diffs_t diffs;
+};
+
+Envelope BuildEnvelope(Optimizer& optimizer, unsigned threads,
+                       const Point& origin, const Point& direction)
+{
+  Envelope envelope;
+  optimizer.SetNumThreads(threads);
+  optimizer.LineEnvelope(origin, direction, envelope.first1best,
+                         envelope.thresholds, envelope.diffs);
+  return envelope;
+}
+
+// Compares the envelopes built on several threads with the one built on a
+// single thread, along one line per optimized feature. If check_bests, the
+// single-threaded one must also give the 1-bests between its thresholds.
+void CheckEnvelopes(const vector<unsigned>& to_optimize, bool check_bests)
+{
+  const vector<bool> positive(kDim, false);
+  vector<parameter_t> start(kDim);
+  for (unsigned k = 0; k < kDim; k++)
+    start[k] = 0.1 * (k + 1);
+  SimpleOptimizer optimizer(kDim, to_optimize, positive, start, 0);
+  optimizer.SetFeatureData(RandomFeatureData(200));
+
+  const vector<parameter_t> limits(kDim, 0.0);
+  const Point origin(start, limits, limits);
+  for (unsigned d = 0; d < Point::getdim(); d++) {
+    Point direction;
+    for (unsigned k = 0; k < Point::getdim(); k++)
+      direction[k] = k == d ? 1.0 : 0.1 * k;
+
+    const Envelope serial = BuildEnvelope(optimizer, 1, origin, direction);
+    BOOST_REQUIRE_GT(serial.thresholds.size(), 10);
+    BOOST_REQUIRE_EQUAL(serial.thresholds.size(), serial.diffs.size() + 1);
+
+    vector<unsigned> nbests = serial.first1best, bests;
+    for (size_t i = 0; check_bests && i + 2 < serial.thresholds.size(); i++) {
+      for (size_t c = 0; c < serial.diffs[i].size(); c++)
+        nbests[serial.diffs[i][c].first] = serial.diffs[i][c].second;
+      const float left = serial.thresholds[i + 1], right = serial.thresholds[i + 2];
+      if (right - left < 0.01)
+        continue;
+      optimizer.Get1bests(origin + direction * (0.5 * (left + right)), bests);
+      BOOST_CHECK(bests == nbests);
+    }
+
+    // More threads, and more than there are sentences.
+    const unsigned threads[] = { 2, 3, 8, 500 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+      const Envelope parallel = BuildEnvelope(optimizer, threads[t], origin, direction);
+      BOOST_CHECK(parallel.first1best == serial.first1best);
+      BOOST_CHECK(parallel.thresholds == serial.thresholds);
+      BOOST_CHECK(parallel.diffs == serial.diffs);
+    }
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(parallel_envelope_equals_serial_envelope)
+{
+  vector<unsigned> to_optimize;
+  for (unsigned k = 0; k < kDim; k++)
+    to_optimize.push_back(k);
+  CheckEnvelopes(to_optimize, true);
+
+  // Point::operator* adds a fixed weight to the slope as well, so with one
+  // the envelope is no longer that of the 1-bests along the line.
+  to_optimize.erase(to_optimize.begin());
+  CheckEnvelopes(to_optimize, false);
+}
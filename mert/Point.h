@@ -75,6 +75,10 @@ public:
     return m_opt_indices;
   }
 
+  static const std::map<unsigned int,parameter_t>& get_fixed_weights() {
+    return m_fixed_weights;
+  }
+
   static bool OptimizeAll() {
     return m_fixed_weights.empty();
   }
@@ -13,6 +13,8 @@
 #include "Scorer.h"
 #include "Util.h"
 #include "FileStream.h"
+#include "ColumnStore.h"
+#include "util/exception.hh"
 
 using namespace std;
 
@@ -75,6 +77,10 @@ void ScoreData::load(istream* is)
 void ScoreData::load(const string &file)
 {
   TRACE_ERR("loading score data from " << file << endl);
+  if (ColumnStore::IsColumnStore(file)) {
+    loadColumns(file);
+    return;
+  }
   inputfilestream input_stream(file); // matches a stream with a file. Opens the file
   if (!input_stream) {
     throw runtime_error("Unable to open score file: " + file);
@@ -84,6 +90,41 @@ void ScoreData::load(const string &file)
   input_stream.close();
 }
 
+void ScoreData::loadColumns(const string &file)
+{
+  ColumnStore store(file);
+  UTIL_THROW_IF(store.Kind() != COLUMN_SCORES, util::Exception,
+                file << " does not hold score statistics");
+
+  string score_type = store.Label();
+  vector<ColumnStore::Entry> entries;
+  ScoreStats stats(store.NumColumns());
+  for (size_t s = 0; s < store.NumSentences(); ++s) {
+    ScoreArray entry;
+    entry.setIndex(store.SentenceId(s));
+    entry.NumberOfScores(store.NumColumns());
+    entry.name(score_type);
+    store.Entries(s, entries);
+    for (size_t j = 0; j < entries.size(); ++j) {
+      store.Get(entries[j], stats);
+      entry.add(stats);
+    }
+    add(entry);
+  }
+}
+
+void ScoreData::append(const string &file) const
+{
+  if (file.empty()) return;
+  TRACE_ERR("appending the array to " << file << endl);
+  ColumnStoreWriter writer(COLUMN_SCORES, m_score_type, m_num_scores);
+  for (scoredata_t::const_iterator i = m_array.begin(); i != m_array.end(); ++i) {
+    for (size_t j = 0; j < i->size(); ++j)
+      writer.Add(i->getIndex(), i->get(j));
+  }
+  writer.Append(file);
+}
+
 void ScoreData::add(ScoreArray& e)
 {
   if (exists(e.getIndex())) { // array at position e.getIndex() already exists
@@ -94,6 +94,13 @@ public:
   void load(std::istream* is);
   void load(const std::string &file);
 
+  /**
+   * Append all entries to a column store as one segment. load() reads
+   * column stores as well as text and binary files.
+   */
+  void append(const std::string &file) const;
+  void loadColumns(const std::string &file);
+
   bool check_consistency() const;
 
   void setIndex();
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "ScoreArray.h"
 #include "ScoreDataIterator.h"
+#include "ColumnStore.h"
 
 using namespace std;
 using namespace util;
@@ -31,10 +32,17 @@ namespace MosesTuning
 {
 
 
-ScoreDataIterator::ScoreDataIterator() {}
+ScoreDataIterator::ScoreDataIterator() : m_sentence(0) {}
 
-ScoreDataIterator::ScoreDataIterator(const string& filename)
+ScoreDataIterator::ScoreDataIterator(const string& filename) : m_sentence(0)
 {
+  if (ColumnStore::IsColumnStore(filename)) {
+    m_store.reset(new ColumnStore(filename));
+    UTIL_THROW_IF(m_store->Kind() != COLUMN_SCORES, util::Exception,
+                  filename << " does not hold score statistics");
+    readNextColumns();
+    return;
+  }
   m_in.reset(new FilePiece(filename.c_str()));
   readNext();
 }
@@ -74,14 +82,40 @@ void ScoreDataIterator::readNext()
   }
 }
 
+void ScoreDataIterator::readNextColumns()
+{
+  m_next.clear();
+  if (m_sentence == m_store->NumSentences()) {
+    m_store.reset();
+    return;
+  }
+  vector<ColumnStore::Entry> entries;
+  m_store->Entries(m_sentence, entries);
+  m_next.resize(entries.size());
+  for (size_t j = 0; j < entries.size(); ++j) {
+    ScoreDataItem& item = m_next[j];
+    item.resize(m_store->NumColumns());
+    for (size_t c = 0; c < item.size(); ++c)
+      item[c] = entries[j].Value(c);
+  }
+}
+
 void ScoreDataIterator::increment()
 {
-  readNext();
+  if (m_store) {
+    ++m_sentence;
+    readNextColumns();
+  } else {
+    readNext();
+  }
 }
 
 
 bool ScoreDataIterator::equal(const ScoreDataIterator& rhs) const
 {
+  if (m_store || rhs.m_store) {
+    return m_store == rhs.m_store && m_sentence == rhs.m_sentence;
+  }
   if (!m_in && !rhs.m_in) {
     return true;
   } else if (!m_in) {
@@ -41,6 +41,8 @@ class FilePiece;
 namespace MosesTuning
 {
 
+class ColumnStore;
+
 
 typedef std::vector<float> ScoreDataItem;
 
@@ -67,8 +69,12 @@ private:
   const std::vector<ScoreDataItem>& dereference() const;
 
   void readNext();
+  void readNextColumns();
 
   boost::shared_ptr<util::FilePiece> m_in;
+  // Column stores are read in place, one sentence at a time.
+  boost::shared_ptr<ColumnStore> m_store;
+  std::size_t m_sentence;
   std::vector<ScoreDataItem> m_next;
 };
 
@@ -69,7 +69,7 @@ void  StatisticsBasedScorer::score(const candidates_t& candidates, const diffs_t
   int numCounts = m_score_data->get(0,candidates[0]).size();
   vector<ScoreStatsType> totals(numCounts);
   for (size_t i = 0; i < candidates.size(); ++i) {
-    ScoreStats stats = m_score_data->get(i,candidates[i]);
+    const ScoreStats& stats = m_score_data->get(i,candidates[i]);
     if (stats.size() != totals.size()) {
       stringstream msg;
       msg << "Statistics for (" << "," << candidates[i] << ") have incorrect "
@@ -90,9 +90,10 @@ void  StatisticsBasedScorer::score(const candidates_t& candidates, const diffs_t
       size_t sid = diffs[i][j].first;
       size_t nid = diffs[i][j].second;
       size_t last_nid = last_candidates[sid];
+      const ScoreStats& next = m_score_data->get(sid,nid);
+      const ScoreStats& last = m_score_data->get(sid,last_nid);
       for (size_t k  = 0; k < totals.size(); ++k) {
-        int diff = m_score_data->get(sid,nid).get(k)
-                   - m_score_data->get(sid,last_nid).get(k);
+        int diff = next.get(k) - last.get(k);
         totals[k] += diff;
       }
       last_candidates[sid] = nid;
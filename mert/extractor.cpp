@@ -31,6 +31,7 @@ void usage()
   cerr << "\tThis is of the form NAME1:VAL1,NAME2:VAL2 etc " << endl;
   cerr << "[--reference|-r] comma separated list of reference files" << endl;
   cerr << "[--binary|-b] use binary output format (default to text )" << endl;
+  cerr << "[--columnar|-C] append the new entries to column stores (mert, pro and kbmira read them in place)" << endl;
   cerr << "[--nbest|-n] the nbest file" << endl;
   cerr << "[--scfile|-S] the scorer data output file" << endl;
   cerr << "[--ffile|-F] the feature data output file" << endl;
@@ -51,6 +52,7 @@ static struct option long_options[] = {
   {"filter", required_argument,0, 'l'},
   {"reference", required_argument, 0, 'r'},
   {"binary", no_argument, 0, 'b'},
+  {"columnar", no_argument, 0, 'C'},
   {"nbest", required_argument, 0, 'n'},
   {"scfile", required_argument, 0, 'S'},
   {"ffile", required_argument, 0, 'F'},
@@ -75,6 +77,7 @@ struct ProgramOption {
   string prevScoreDataFile;
   string prevFeatureDataFile;
   bool binmode;
+  bool columnar;
   bool allowDuplicates;
   int verbosity;
 
@@ -90,6 +93,7 @@ struct ProgramOption {
       prevScoreDataFile(""),
       prevFeatureDataFile(""),
       binmode(false),
+      columnar(false),
       allowDuplicates(false),
       verbosity(0) { }
 };
@@ -99,7 +103,7 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
   int c;
   int option_index;
 
-  while ((c = getopt_long(argc, argv, "s:r:f:l:n:S:F:R:E:v:hbd", long_options, &option_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "s:r:f:l:n:S:F:R:E:v:hbCd", long_options, &option_index)) != -1) {
     switch (c) {
     case 's':
       opt->scorerType = string(optarg);
@@ -119,6 +123,9 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
     case 'b':
       opt->binmode = true;
       break;
+    case 'C':
+      opt->columnar = true;
+      break;
     case 'n':
       opt->nbestFile = string(optarg);
       break;
@@ -218,9 +225,12 @@ int main(int argc, char** argv)
 
     Data data(scorer.get());
 
-    // load old data
+    // load old data; column stores already hold it, so then it is kept
+    // apart and only used to leave out duplicates of earlier entries
+    Data prevData(scorer.get());
+    Data& prev = option.columnar ? prevData : data;
     for (size_t i = 0; i < prevScoreDataFiles.size(); i++) {
-      data.load(prevFeatureDataFiles.at(i), prevScoreDataFiles.at(i));
+      prev.load(prevFeatureDataFiles.at(i), prevScoreDataFiles.at(i));
     }
 
 //    PrintUserTime("Previous data loaded");
@@ -237,8 +247,15 @@ int main(int argc, char** argv)
       data.removeDuplicates();
     }
     //END_ADDED
+    if (option.columnar && !option.allowDuplicates) {
+      data.removeDuplicates(prevData);
+    }
 
-    data.save(option.featureDataFile, option.scoreDataFile, option.binmode);
+    if (option.columnar) {
+      data.append(option.featureDataFile, option.scoreDataFile);
+    } else {
+      data.save(option.featureDataFile, option.scoreDataFile, option.binmode);
+    }
     PrintUserTime("Stopping...");
 
     return EXIT_SUCCESS;
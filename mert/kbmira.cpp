@@ -80,6 +80,8 @@ int main(int argc, char** argv)
   bool verbose = false; // Verbose updates
   bool safe_hope = false; // Model score cannot have more than BLEU_RATIO times more influence than BLEU
   size_t hgPruning = 50; //prune hypergraphs to have this many edges per reference word
+  size_t threads = 1;   // Threads for hope/fear decoding and evaluation
+  size_t batchSize = 1; // Examples decoded against the same weights
 
   // Command-line processing follows pro.cpp
   po::options_description desc("Allowed options");
@@ -106,6 +108,8 @@ int main(int argc, char** argv)
   ("verbose", po::value(&verbose)->zero_tokens()->default_value(false), "Verbose updates")
   ("safe-hope", po::value(&safe_hope)->zero_tokens()->default_value(false), "Mode score's influence on hope decoding is limited")
   ("hg-prune", po::value<size_t>(&hgPruning), "Prune hypergraphs to have this many edges per reference word")
+  ("threads", po::value<size_t>(&threads), "Number of threads for hope/fear decoding and evaluation (default 1)")
+  ("batch-size", po::value<size_t>(&batchSize), "Decode this many examples in parallel with the same weights, then apply their updates in order (default 1)")
   ;
 
   po::options_description cmdline_options;
@@ -122,6 +126,10 @@ int main(int argc, char** argv)
 
   cerr << "kbmira with c=" << c << " decay=" << decay << " no_shuffle=" << no_shuffle << endl;
 
+  UTIL_THROW_IF(threads == 0 || batchSize == 0, util::Exception, "--threads and --batch-size must be positive");
+  const bool batched = (threads > 1 || batchSize > 1);
+  UTIL_THROW_IF(batched && streaming, util::Exception, "--threads and --batch-size cannot be used with --streaming");
+
   if (vm.count("random-seed")) {
     cerr << "Initialising random seed to " << seed << endl;
     util::rand_init(seed);
@@ -155,7 +163,7 @@ int main(int argc, char** argv)
 
   // Training loop
   if (!streaming_out)
-    cerr << "Initial BLEU = " << decoder->Evaluate(wv->avg()) << endl;
+    cerr << "Initial BLEU = " << decoder->Evaluate(wv->avg(), threads) << endl;
   ValType bestBleu = 0;
   for(int j=0; j<n_iters; j++) {
     // MIRA train for one epoch
@@ -163,48 +171,60 @@ int main(int argc, char** argv)
     int iNumUpdates = 0;
     ValType totalLoss = 0.0;
     size_t sentenceIndex = 0;
-    for(decoder->reset(); !decoder->finished(); decoder->next()) {
-      HopeFearData hfd;
-      decoder->HopeFear(bg,*wv,&hfd);
+    vector<HopeFearData> batch;
+    for(decoder->reset(); !decoder->finished(); ) {
+      // Hope/fear decode the next examples against the current weights. In
+      // batched mode their updates are applied afterwards, one by one in
+      // epoch order, so the result does not depend on the number of threads.
+      if (batched) {
+        decoder->HopeFearBatch(batchSize, threads, bg, *wv, &batch);
+      } else {
+        batch.assign(1, HopeFearData());
+        decoder->HopeFear(bg,*wv,&batch[0]);
+        decoder->next();
+      }
+      for (size_t b = 0; b < batch.size(); ++b) {
+        const HopeFearData& hfd = batch[b];
 
-      // Update weights
-      if (!hfd.hopeFearEqual && hfd.hopeBleu  > hfd.fearBleu) {
-        // Vector difference
-        MiraFeatureVector diff = hfd.hopeFeatures - hfd.fearFeatures;
-        // Bleu difference
-        //assert(hfd.hopeBleu + 1e-8 >= hfd.fearBleu);
-        ValType delta = hfd.hopeBleu - hfd.fearBleu;
-        // Loss and update
-        ValType diff_score = wv->score(diff);
-        ValType loss = delta - diff_score;
-        if(verbose) {
-          cerr << "Updating sent " << sentenceIndex << endl;
-          cerr << "Wght: " << *wv << endl;
-          cerr << "Hope: " << hfd.hopeFeatures << " BLEU:" << hfd.hopeBleu << " Score:" << wv->score(hfd.hopeFeatures) << endl;
-          cerr << "Fear: " << hfd.fearFeatures << " BLEU:" << hfd.fearBleu << " Score:" << wv->score(hfd.fearFeatures) << endl;
-          cerr << "Diff: " << diff << " BLEU:" << delta << " Score:" << diff_score << endl;
-          cerr << "Loss: " << loss <<  " Scale: " << 1 << endl;
-          cerr << endl;
-        }
-        if(loss > 0) {
-          ValType eta = min(c, loss / diff.sqrNorm());
-          wv->update(diff,eta);
-          totalLoss+=loss;
-          iNumUpdates++;
-        }
-        // Update BLEU statistics
-        for(size_t k=0; k<bg.size(); k++) {
-          bg[k]*=decay;
-          if(model_bg)
-            bg[k]+=hfd.modelStats[k];
-          else
-            bg[k]+=hfd.hopeStats[k];
+        // Update weights
+        if (!hfd.hopeFearEqual && hfd.hopeBleu  > hfd.fearBleu) {
+          // Vector difference
+          MiraFeatureVector diff = hfd.hopeFeatures - hfd.fearFeatures;
+          // Bleu difference
+          //assert(hfd.hopeBleu + 1e-8 >= hfd.fearBleu);
+          ValType delta = hfd.hopeBleu - hfd.fearBleu;
+          // Loss and update
+          ValType diff_score = wv->score(diff);
+          ValType loss = delta - diff_score;
+          if(verbose) {
+            cerr << "Updating sent " << sentenceIndex << endl;
+            cerr << "Wght: " << *wv << endl;
+            cerr << "Hope: " << hfd.hopeFeatures << " BLEU:" << hfd.hopeBleu << " Score:" << wv->score(hfd.hopeFeatures) << endl;
+            cerr << "Fear: " << hfd.fearFeatures << " BLEU:" << hfd.fearBleu << " Score:" << wv->score(hfd.fearFeatures) << endl;
+            cerr << "Diff: " << diff << " BLEU:" << delta << " Score:" << diff_score << endl;
+            cerr << "Loss: " << loss <<  " Scale: " << 1 << endl;
+            cerr << endl;
+          }
+          if(loss > 0) {
+            ValType eta = min(c, loss / diff.sqrNorm());
+            wv->update(diff,eta);
+            totalLoss+=loss;
+            iNumUpdates++;
+          }
+          // Update BLEU statistics
+          for(size_t k=0; k<bg.size(); k++) {
+            bg[k]*=decay;
+            if(model_bg)
+              bg[k]+=hfd.modelStats[k];
+            else
+              bg[k]+=hfd.hopeStats[k];
+          }
         }
+        iNumExamples++;
+        ++sentenceIndex;
+        if (streaming_out)
+          cout << *wv << endl;
       }
-      iNumExamples++;
-      ++sentenceIndex;
-      if (streaming_out)
-        cout << *wv << endl;
     }
     // Training Epoch summary
     cerr << iNumUpdates << "/" << iNumExamples << " updates"
@@ -213,7 +233,7 @@ int main(int argc, char** argv)
 
     // Evaluate current average weights
     AvgWeightVector avg = wv->avg();
-    ValType bleu = decoder->Evaluate(avg);
+    ValType bleu = decoder->Evaluate(avg, threads);
     cerr << ", BLEU = " << bleu << endl;
     if(bleu > bestBleu) {
       /*
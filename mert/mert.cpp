@@ -461,6 +461,12 @@ int main(int argc, char **argv)
     allTasks.resize(option.shard_count);
   }
 
+  // With fewer tasks than threads, let each line search use the rest.
+  unsigned int line_threads = 1;
+#ifdef WITH_THREADS
+  line_threads = std::max<size_t>(1, option.num_threads / (allTasks.size() * startingPoints.size()));
+#endif
+
   // launch tasks
   for (size_t i = 0; i < allTasks.size(); ++i) {
     Data& data_ref = data;
@@ -471,6 +477,7 @@ int main(int argc, char **argv)
     Optimizer *optimizer = OptimizerFactory::BuildOptimizer(option.pdim, to_optimize, positive, start_list[0], option.optimize_type, option.nrandom);
     optimizer->SetScorer(data_ref.getScorer());
     optimizer->SetFeatureData(data_ref.getFeatureData());
+    optimizer->SetNumThreads(line_threads);
     // A task for each start point
     for (size_t j = 0; j < startingPoints.size(); ++j) {
       boost::shared_ptr<OptimizationTask>
@@ -1,9 +1,11 @@
 #include <iostream>
 #include <string>
+#include <cstdlib>
 
 #include "moses/Timer.h"
 #include "moses/InputFileStream.h"
 #include "moses/FF/LexicalReordering/LexicalReorderingTable.h"
+#include "moses/FF/LexicalReordering/LexicalReorderingTableHashed.h"
 
 using namespace Moses;
 
@@ -15,7 +17,9 @@ void printHelp()
             "options: \n"
             "\t-in  string -- input table file name\n"
             "\t-out string -- prefix of binary table files\n"
-            "If -in is not specified reads from stdin\n"
+            "\t-hashed     -- write a quantized hash table (<out>.hlexr)\n"
+            "\t-bits int   -- bits per score for -hashed, 8 or 16 (default 16)\n"
+            "If -in is not specified reads from stdin (not with -hashed)\n"
             "\n";
 }
 
@@ -24,6 +28,8 @@ int main(int argc, char** argv)
   std::cerr << "processLexicalTable v0.1 by Konrad Rawlik\n";
   std::string inFilePath;
   std::string outFilePath("out");
+  bool hashed = false;
+  size_t bits = 16;
   if(1 >= argc) {
     printHelp();
     return 1;
@@ -36,6 +42,11 @@ int main(int argc, char** argv)
     } else if("-out" == arg && i+1 < argc) {
       ++i;
       outFilePath = argv[i];
+    } else if("-hashed" == arg) {
+      hashed = true;
+    } else if("-bits" == arg && i+1 < argc) {
+      ++i;
+      bits = atoi(argv[i]);
     } else {
       //somethings wrong... print help
       printHelp();
@@ -45,7 +56,16 @@ int main(int argc, char** argv)
 
   bool success = false;
 
-  if(inFilePath.empty()) {
+  if(hashed) {
+    if(inFilePath.empty()) {
+      std::cerr << "-hashed needs an input file, the table is read twice\n";
+      return 1;
+    }
+    std::cerr << "processing " << inFilePath << " to " << outFilePath
+              << LexicalReorderingTableHashed::Extension << "\n";
+    success = LexicalReorderingTableHashed::Create(inFilePath, outFilePath
+              + LexicalReorderingTableHashed::Extension, bits);
+  } else if(inFilePath.empty()) {
     std::cerr << "processing stdin to " << outFilePath << ".*\n";
     success = LexicalReorderingTableTree::Create(std::cin, outFilePath);
   } else {
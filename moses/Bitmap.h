@@ -31,6 +31,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <cstdlib>
 #include "TypeDef.h"
 #include "Range.h"
+#include "DecodeArena.h"
 
 namespace Moses
 {
@@ -106,6 +107,14 @@ public:
 
   explicit Bitmap(const Bitmap &copy, const Range &range);
 
+  //! allocated from the worker's DecodeArena
+  static void *operator new(size_t size) {
+    return DecodeArena::Allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    DecodeArena::Free(p, size);
+  }
+
   //! Count of words translated.
   size_t GetNumWordsCovered() const {
     return m_numWordsCovered;
@@ -218,9 +218,8 @@ BackwardsEdge::Initialize()
   m_initialized = true;
 }
 
-Hypothesis *BackwardsEdge::CreateHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt)
+Hypothesis *BackwardsEdge::NewHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt)
 {
-  // create hypothesis and calculate all its scores
   IFVERBOSE(2) {
     hypothesis.GetManager().GetSentenceStats().StartTimeBuildHyp();
   }
@@ -229,6 +228,13 @@ Hypothesis *BackwardsEdge::CreateHypothesis(const Hypothesis &hypothesis, const
   IFVERBOSE(2) {
     hypothesis.GetManager().GetSentenceStats().StopTimeBuildHyp();
   }
+  return newHypo;
+}
+
+Hypothesis *BackwardsEdge::CreateHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt)
+{
+  // create hypothesis and calculate all its scores
+  Hypothesis *newHypo = NewHypothesis(hypothesis, transOpt);
   newHypo->EvaluateWhenApplied(m_estimatedScore);
 
   return newHypo;
@@ -264,27 +270,34 @@ BackwardsEdge::GetBitmapContainer() const
 }
 
 void
-BackwardsEdge::PushSuccessors(const size_t x, const size_t y)
+BackwardsEdge::CreateSuccessors(const size_t x, const size_t y, std::vector<CubeSuccessor> &successors)
 {
-  Hypothesis *newHypo;
+  CubeSuccessor successor;
+  successor.edge = this;
 
   if(y + 1 < m_translations.size() && !SeenPosition(x, y + 1)) {
     SetSeenPosition(x, y + 1);
-    newHypo = CreateHypothesis(*m_hypotheses[x], *m_translations.Get(y + 1));
-    if(newHypo != NULL) {
-      m_parent.Enqueue(x, y + 1, newHypo, (BackwardsEdge*)this);
-    }
+    successor.hypothesis_pos = x;
+    successor.translation_pos = y + 1;
+    successor.hypothesis = NewHypothesis(*m_hypotheses[x], *m_translations.Get(y + 1));
+    successors.push_back(successor);
   }
 
   if(x + 1 < m_hypotheses.size() && !SeenPosition(x + 1, y)) {
     SetSeenPosition(x + 1, y);
-    newHypo = CreateHypothesis(*m_hypotheses[x + 1], *m_translations.Get(y));
-    if(newHypo != NULL) {
-      m_parent.Enqueue(x + 1, y, newHypo, (BackwardsEdge*)this);
-    }
+    successor.hypothesis_pos = x + 1;
+    successor.translation_pos = y;
+    successor.hypothesis = NewHypothesis(*m_hypotheses[x + 1], *m_translations.Get(y));
+    successors.push_back(successor);
   }
 }
 
+void
+BackwardsEdge::EvaluateSuccessor(Hypothesis *hypothesis)
+{
+  hypothesis->EvaluateWhenApplied(m_estimatedScore);
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // BitmapContainer Code
@@ -448,44 +461,70 @@ BitmapContainer::EnsureMinStackHyps(const size_t minNumHyps)
 void
 BitmapContainer::ProcessBestHypothesis()
 {
-  if (m_queue.empty()) {
-    return;
-  }
+  ProcessBestHypotheses(1);
+}
 
-  // Get the currently best hypothesis from the queue.
-  HypothesisQueueItem *item = Dequeue();
+/** Pop up to maxPops of the best hypotheses and add them to the stack, then
+ * create the successors of all of them and score those together, so that
+ * the feature functions can prefetch what they look up for the whole group.
+ * With maxPops == 1 this is ordinary cube pruning. Returns the number of
+ * hypotheses popped.
+ */
+size_t
+BitmapContainer::ProcessBestHypotheses(size_t maxPops)
+{
+  m_successors.clear();
+  size_t numPops = 0;
+  for (; numPops < maxPops && !m_queue.empty(); ++numPops) {
+    // Get the currently best hypothesis from the queue.
+    HypothesisQueueItem *item = Dequeue();
+
+    // If the priority queue is exhausted, we are done and should have exited
+    UTIL_THROW_IF2(item == NULL, "Null object");
+
+    // check we are pulling things off of priority queue in right order
+    if (!Empty()) {
+      HypothesisQueueItem *check = Dequeue(true);
+      UTIL_THROW_IF2(item->GetHypothesis()->GetFutureScore() < check->GetHypothesis()->GetFutureScore(),
+                     "Non-monotonic total score: "
+                     << item->GetHypothesis()->GetFutureScore() << " vs. "
+                     << check->GetHypothesis()->GetFutureScore());
+    }
 
-  // If the priority queue is exhausted, we are done and should have exited
-  UTIL_THROW_IF2(item == NULL, "Null object");
+    // Logging for the criminally insane
+    IFVERBOSE(3) {
+      item->GetHypothesis()->PrintHypothesis();
+    }
 
-  // check we are pulling things off of priority queue in right order
-  if (!Empty()) {
-    HypothesisQueueItem *check = Dequeue(true);
-    UTIL_THROW_IF2(item->GetHypothesis()->GetFutureScore() < check->GetHypothesis()->GetFutureScore(),
-                   "Non-monotonic total score: "
-                   << item->GetHypothesis()->GetFutureScore() << " vs. "
-                   << check->GetHypothesis()->GetFutureScore());
-  }
+    // Add best hypothesis to hypothesis stack.
+    const bool newstackentry = m_stack.AddPrune(item->GetHypothesis());
+    if (newstackentry)
+      m_numStackInsertions++;
 
-  // Logging for the criminally insane
-  IFVERBOSE(3) {
-    item->GetHypothesis()->PrintHypothesis();
-  }
+    IFVERBOSE(3) {
+      TRACE_ERR("new stack entry flag is " << newstackentry << std::endl);
+    }
 
-  // Add best hypothesis to hypothesis stack.
-  const bool newstackentry = m_stack.AddPrune(item->GetHypothesis());
-  if (newstackentry)
-    m_numStackInsertions++;
+    // Create new hypotheses for the two successors of the hypothesis just added.
+    item->GetBackwardsEdge()->CreateSuccessors(item->GetHypothesisPos(), item->GetTranslationPos(), m_successors);
 
-  IFVERBOSE(3) {
-    TRACE_ERR("new stack entry flag is " << newstackentry << std::endl);
+    // We are done with the queue item, we delete it.
+    delete item;
   }
 
-  // Create new hypotheses for the two successors of the hypothesis just added.
-  item->GetBackwardsEdge()->PushSuccessors(item->GetHypothesisPos(), item->GetTranslationPos());
+  // Score the successors and put them in the queue, in the order they were
+  // created.
+  for (size_t i = 0; i < m_successors.size(); ++i) {
+    m_successors[i].hypothesis->PrefetchWhenApplied();
+  }
+  for (size_t i = 0; i < m_successors.size(); ++i) {
+    CubeSuccessor &successor = m_successors[i];
+    successor.edge->EvaluateSuccessor(successor.hypothesis);
+    Enqueue(successor.hypothesis_pos, successor.translation_pos, successor.hypothesis, successor.edge);
+  }
+  m_successors.clear();
 
-  // We are done with the queue item, we delete it.
-  delete item;
+  return numPops;
 }
 
 void
@@ -50,6 +50,13 @@ typedef std::vector< Hypothesis* > HypothesisSet;
 typedef std::set< BackwardsEdge* > BackwardsEdgeSet;
 typedef std::priority_queue< HypothesisQueueItem*, std::vector< HypothesisQueueItem* >, QueueItemOrderer> HypothesisQueue;
 
+//! A successor created by a BackwardsEdge that still has to be scored and enqueued
+struct CubeSuccessor {
+  size_t hypothesis_pos, translation_pos;
+  Hypothesis *hypothesis;
+  BackwardsEdge *edge;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Hypothesis Priority Queue Code
 ////////////////////////////////////////////////////////////////////////////////
@@ -195,6 +202,7 @@ private:
   // We don't want to instantiate "empty" objects.
   BackwardsEdge();
 
+  Hypothesis *NewHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt);
   Hypothesis *CreateHypothesis(const Hypothesis &hypothesis, const TranslationOption &transOpt);
   bool SeenPosition(const size_t x, const size_t y);
   void SetSeenPosition(const size_t x, const size_t y);
@@ -214,7 +222,10 @@ public:
   bool GetInitialized();
   const BitmapContainer &GetBitmapContainer() const;
   int GetDistortionPenalty();
-  void PushSuccessors(const size_t x, const size_t y);
+  //! Create the unscored successors of position (x, y) in the cube
+  void CreateSuccessors(const size_t x, const size_t y, std::vector<CubeSuccessor> &successors);
+  //! Score a hypothesis made by CreateSuccessors()
+  void EvaluateSuccessor(Hypothesis *hypothesis);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -235,6 +246,7 @@ private:
   HypothesisQueue m_queue;
   size_t m_numStackInsertions;
   bool m_deterministic;
+  std::vector<CubeSuccessor> m_successors;
 
   // We always require a corresponding bitmap to be supplied.
   BitmapContainer();
@@ -264,6 +276,7 @@ public:
 
   void InitializeEdges();
   void ProcessBestHypothesis();
+  size_t ProcessBestHypotheses(size_t maxPops);
   void EnsureMinStackHyps(const size_t minNumHyps);
   void AddHypothesis(Hypothesis *hypothesis);
   void AddBackwardsEdge(BackwardsEdge *edge);
@@ -4,6 +4,10 @@
 // shared pointers to task-specific objects such as caches and priors.
 // Since these objects are referenced via shared pointers, sopes can
 // share information.
+// A scope can also be chained onto a parent scope (e.g. a document onto
+// the global scope). It keeps caches and biases of its own, so that they
+// only serve the sentences of the scope, but uses its parent's context
+// weights unless it is given its own.
 #pragma once
 
 #ifdef WITH_THREADS
@@ -35,6 +39,8 @@ protected:
   mutable boost::shared_mutex m_lock;
 #endif
   SPTR<std::map<std::string,float> const> m_context_weights;
+  boost::shared_ptr<ContextScope> m_parent;
+
 public:
   typedef boost::shared_ptr<ContextScope> ptr;
   template<typename T>
@@ -78,16 +84,21 @@ public:
 
   ContextScope() { }
 
+  explicit ContextScope(ptr const& parent) : m_parent(parent) { }
+
   ContextScope(ContextScope const& other) {
 #ifdef WITH_THREADS
     boost::unique_lock<boost::shared_mutex> lock1(this->m_lock);
     boost::unique_lock<boost::shared_mutex> lock2(other.m_lock);
 #endif
     m_scratchpad = other.m_scratchpad;
+    m_parent = other.m_parent;
   }
 
+  // own context weights, or else the parent's
   SPTR<std::map<std::string,float> const>
   GetContextWeights() {
+    if (!m_context_weights && m_parent) return m_parent->GetContextWeights();
     return m_context_weights;
   }
 
@@ -0,0 +1,101 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include "ContextScope.h"
+
+using namespace Moses;
+
+BOOST_AUTO_TEST_SUITE(context_scope)
+
+namespace
+{
+// stands in for a feature function's cache key
+const int cache_key = 0;
+
+// stands in for its cache: counts the sentences that used it
+struct Cache {
+  int n;
+  Cache() : n(0) {}
+};
+
+// what the sentences of one document do with a scope
+boost::shared_ptr<Cache> DecodeDocument(ContextScope::ptr const& dscope, size_t sentences)
+{
+  boost::shared_ptr<Cache> first = dscope->get<Cache>(&cache_key, true);
+  for (size_t i = 1; i < sentences; ++i) {
+    boost::shared_ptr<Cache> cache = dscope->get<Cache>(&cache_key, true);
+    BOOST_CHECK_EQUAL(cache, first);
+    ++cache->n;
+  }
+  return first;
+}
+}
+
+BOOST_AUTO_TEST_CASE(documents_keep_their_caches)
+{
+  ContextScope::ptr gscope(new ContextScope);
+  gscope->SetContextWeights("in,0.8:out,0.2");
+  boost::shared_ptr<Cache> global = gscope->get<Cache>(&cache_key, true);
+
+  // the global context weights, but a cache of the document's own
+  ContextScope::ptr doc1(new ContextScope(gscope));
+  boost::shared_ptr<Cache> cache1 = DecodeDocument(doc1, 3);
+  BOOST_CHECK(cache1 != global);
+  BOOST_CHECK_EQUAL(cache1->n, 2);
+  BOOST_CHECK_EQUAL(doc1->GetContextWeights(), gscope->GetContextWeights());
+
+  // the next document does not see the entries of the first
+  ContextScope::ptr doc2(new ContextScope(gscope));
+  boost::shared_ptr<Cache> cache2 = DecodeDocument(doc2, 2);
+  BOOST_CHECK(cache2 != cache1);
+  BOOST_CHECK_EQUAL(cache2->n, 1);
+  BOOST_CHECK_EQUAL(cache1->n, 2);
+  BOOST_CHECK_EQUAL(gscope->get<Cache>(&cache_key), global);
+  BOOST_CHECK_EQUAL(global->n, 0);
+}
+
+BOOST_AUTO_TEST_CASE(documents_with_own_context)
+{
+  ContextScope::ptr gscope(new ContextScope);
+  boost::shared_ptr<Cache> global = gscope->get<Cache>(&cache_key, true);
+
+  // state is carried across the sentences of a document ...
+  ContextScope::ptr doc1(new ContextScope(gscope));
+  BOOST_CHECK(doc1->SetContextWeights("in,1"));
+  boost::shared_ptr<Cache> cache1 = DecodeDocument(doc1, 4);
+  BOOST_CHECK(cache1 != global);
+  BOOST_CHECK_EQUAL(cache1->n, 3);
+  BOOST_CHECK_EQUAL(doc1->GetContextWeights()->find("in")->second, 1);
+
+  // ... and starts afresh with the next document
+  ContextScope::ptr doc2(new ContextScope(gscope));
+  BOOST_CHECK(doc2->SetContextWeights("out,1"));
+  boost::shared_ptr<Cache> cache2 = DecodeDocument(doc2, 1);
+  BOOST_CHECK(cache2 != cache1);
+  BOOST_CHECK_EQUAL(cache2->n, 0);
+
+  // the global scope is left alone
+  BOOST_CHECK_EQUAL(gscope->get<Cache>(&cache_key), global);
+  BOOST_CHECK_EQUAL(global->n, 0);
+  BOOST_CHECK(!gscope->GetContextWeights());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
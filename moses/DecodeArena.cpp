@@ -0,0 +1,142 @@
+// -*- c++ -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <new>
+#include <vector>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#endif
+
+#include "DecodeArena.h"
+
+namespace Moses
+{
+
+namespace
+{
+const std::size_t kGranularity = 16;
+const std::size_t kNumClasses = DecodeArena::kMaxRecycled / kGranularity;
+const std::size_t kChunkSize = 64 * 1024;
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+}
+
+struct DecodeArena::Local {
+  FreeBlock *free[kNumClasses];
+  char *cur, *end;
+
+  Local() : cur(NULL), end(NULL) {
+    for (std::size_t i = 0; i < kNumClasses; ++i) free[i] = NULL;
+  }
+};
+
+#ifdef WITH_THREADS
+namespace
+{
+// Arenas of threads that have exited, waiting for a new thread to adopt
+// them. Blocks from them may still be in use, so they are never freed. The
+// bookkeeping is not destroyed at exit either: objects may be freed by
+// static destructors that run after it.
+boost::mutex &SpareMutex()
+{
+  static boost::mutex *mutex = new boost::mutex;
+  return *mutex;
+}
+
+std::vector<DecodeArena::Local*> &Spares()
+{
+  static std::vector<DecodeArena::Local*> *spares
+    = new std::vector<DecodeArena::Local*>;
+  return *spares;
+}
+
+void Retire(DecodeArena::Local *local)
+{
+  boost::mutex::scoped_lock lock(SpareMutex());
+  Spares().push_back(local);
+}
+}
+
+DecodeArena::Local &DecodeArena::GetLocal()
+{
+  static boost::thread_specific_ptr<Local> &locals
+    = *new boost::thread_specific_ptr<Local>(&Retire);
+  Local *local = locals.get();
+  if (local == NULL) {
+    {
+      boost::mutex::scoped_lock lock(SpareMutex());
+      if (!Spares().empty()) {
+        local = Spares().back();
+        Spares().pop_back();
+      }
+    }
+    if (local == NULL) local = new Local;
+    locals.reset(local);
+  }
+  return *local;
+}
+#else
+DecodeArena::Local &DecodeArena::GetLocal()
+{
+  static Local *local = new Local;
+  return *local;
+}
+#endif
+
+void *DecodeArena::Allocate(std::size_t size)
+{
+  if (size > kMaxRecycled) return ::operator new(size);
+  std::size_t cls = size ? (size - 1) / kGranularity : 0;
+  Local &local = GetLocal();
+  FreeBlock *block = local.free[cls];
+  if (block) {
+    local.free[cls] = block->next;
+    return block;
+  }
+  std::size_t bytes = (cls + 1) * kGranularity;
+  if (static_cast<std::size_t>(local.end - local.cur) < bytes) {
+    // The tail of the previous chunk is left unused.
+    local.cur = static_cast<char*>(::operator new(kChunkSize));
+    local.end = local.cur + kChunkSize;
+  }
+  void *ret = local.cur;
+  local.cur += bytes;
+  return ret;
+}
+
+void DecodeArena::Free(void *p, std::size_t size)
+{
+  if (p == NULL) return;
+  if (size > kMaxRecycled) {
+    ::operator delete(p);
+    return;
+  }
+  std::size_t cls = size ? (size - 1) / kGranularity : 0;
+  Local &local = GetLocal();
+  FreeBlock *block = static_cast<FreeBlock*>(p);
+  block->next = local.free[cls];
+  local.free[cls] = block;
+}
+
+}
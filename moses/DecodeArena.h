@@ -0,0 +1,60 @@
+// -*- c++ -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_DecodeArena_h
+#define moses_DecodeArena_h
+
+#include <cstddef>
+
+namespace Moses
+{
+
+/** Per-thread recycling allocator for the small objects that phrase-based
+ * decoding creates and throws away for every sentence: hypotheses,
+ * translation options, coverage bitmaps and future score matrices.
+ *
+ * Blocks are carved out of large chunks and, when freed, kept on free lists
+ * by size instead of being handed back to malloc, so the next sentence
+ * decoded by the same worker thread reuses them. Memory is never returned to
+ * the system; when a thread exits its chunks and free lists are passed on to
+ * the next thread that starts decoding. A block may be freed by a different
+ * thread than the one that allocated it.
+ *
+ * Classes opt in with class-specific operator new and delete, see
+ * Hypothesis.
+ */
+class DecodeArena
+{
+public:
+  static void *Allocate(std::size_t size);
+  static void Free(void *p, std::size_t size);
+
+  //! Largest block size that is recycled; larger ones go to operator new.
+  static const std::size_t kMaxRecycled = 1024;
+
+  struct Local;
+
+private:
+  static Local &GetLocal();
+};
+
+}
+
+#endif
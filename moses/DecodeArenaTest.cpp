@@ -0,0 +1,67 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+
+#include "Bitmap.h"
+#include "DecodeArena.h"
+
+using namespace Moses;
+
+BOOST_AUTO_TEST_SUITE(decode_arena)
+
+BOOST_AUTO_TEST_CASE(recycle)
+{
+  void *a = DecodeArena::Allocate(40);
+  void *b = DecodeArena::Allocate(40);
+  BOOST_CHECK(a != b);
+  std::memset(a, 1, 40);
+  std::memset(b, 2, 40);
+  DecodeArena::Free(a, 40);
+  // same size class: the freed block comes back
+  BOOST_CHECK_EQUAL(DecodeArena::Allocate(33), a);
+  DecodeArena::Free(a, 33);
+  DecodeArena::Free(b, 40);
+}
+
+BOOST_AUTO_TEST_CASE(large)
+{
+  std::size_t size = DecodeArena::kMaxRecycled + 1;
+  char *p = static_cast<char*>(DecodeArena::Allocate(size));
+  std::memset(p, 3, size);
+  DecodeArena::Free(p, size);
+  DecodeArena::Free(NULL, 8);
+}
+
+BOOST_AUTO_TEST_CASE(bitmap)
+{
+  Bitmap *first = new Bitmap(5);
+  Bitmap *next = new Bitmap(*first, Range(1, 3));
+  BOOST_CHECK_EQUAL(next->GetNumWordsCovered(), 3);
+  delete first;
+  Bitmap *reused = new Bitmap(7);
+  BOOST_CHECK_EQUAL(static_cast<void*>(reused), static_cast<void*>(first));
+  BOOST_CHECK_EQUAL(reused->GetNumWordsCovered(), 0);
+  delete reused;
+  delete next;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
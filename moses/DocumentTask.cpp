@@ -0,0 +1,22 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "DocumentTask.h"
+#include "TranslationTask.h"
+#include "TranslationModel/PhraseDictionary.h"
+
+namespace Moses
+{
+
+void
+DocumentTask::
+Run()
+{
+  // the lookups cached for the previous document must not serve this one
+  PhraseDictionary::InitializeForDocument();
+  for (size_t i = 0; i < m_tasks.size(); ++i) {
+    m_tasks[i]->Run();
+    // release the sentence's input and manager before decoding the next one
+    m_tasks[i].reset();
+  }
+}
+
+}
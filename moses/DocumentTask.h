@@ -0,0 +1,38 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "moses/ThreadPool.h"
+
+namespace Moses
+{
+class TranslationTask;
+
+/** Translates the sentences of one input document, in order, on a single
+ *  worker thread. Consecutive sentences of a document share most of their
+ *  vocabulary, so the phrase-table lookups they cache (cache-size, and the
+ *  caches in the document's ContextScope) serve the repeats. The caches
+ *  start empty for every document. Output ordering is unaffected: each
+ *  sentence still writes to the output collectors under its own
+ *  translation id.
+ */
+class DocumentTask : public Task
+{
+public:
+  typedef std::vector<boost::shared_ptr<TranslationTask> > TaskList;
+
+  explicit DocumentTask(TaskList const& tasks) : m_tasks(tasks) { }
+
+  virtual void Run();
+
+  size_t GetSize() const {
+    return m_tasks.size();
+  }
+
+private:
+  TaskList m_tasks;
+};
+
+}
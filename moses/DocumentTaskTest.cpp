@@ -0,0 +1,93 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "DocumentTask.h"
+#include "Phrase.h"
+#include "TargetPhraseCollection.h"
+#include "TranslationModel/PhraseDictionary.h"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(document_task)
+
+namespace
+{
+// a phrase table that counts the lookups that miss its cache
+class CountingTable : public PhraseDictionary
+{
+public:
+  CountingTable()
+    : PhraseDictionary("CountingTable num-features=0", false), lookups(0) { }
+
+  ChartRuleLookupManager *CreateRuleLookupManager(
+    const ChartParser &, const ChartCellCollectionBase &, std::size_t) {
+    return NULL;
+  }
+
+  mutable size_t lookups;
+
+protected:
+  TargetPhraseCollection::shared_ptr
+  GetTargetPhraseCollectionNonCacheLEGACY(const Phrase &src) const {
+    ++lookups;
+    return TargetPhraseCollection::shared_ptr(new TargetPhraseCollection);
+  }
+};
+
+Phrase MakePhrase(const string &words)
+{
+  Phrase phrase;
+  phrase.CreateFromString(Input, vector<FactorType>(1, 0), words, NULL);
+  return phrase;
+}
+
+// what the sentences of a document do with the table
+void DecodeDocument(const CountingTable &table, const vector<string> &sentences)
+{
+  DocumentTask(DocumentTask::TaskList()).Run();
+  for (size_t i = 0; i < sentences.size(); ++i) {
+    table.GetTargetPhraseCollectionLEGACY(MakePhrase(sentences[i]));
+  }
+}
+}
+
+BOOST_AUTO_TEST_CASE(lookup_cache_is_per_document)
+{
+  // phrase tables stay in PhraseDictionary::GetColl() for good, so this one
+  // is never deleted
+  const CountingTable &table = *new CountingTable;
+  vector<string> doc(3, "das haus");
+  doc.push_back("klein");
+
+  // repeats are served from the cache ...
+  DecodeDocument(table, doc);
+  BOOST_CHECK_EQUAL(table.lookups, 2);
+
+  // ... but only within the document
+  DecodeDocument(table, vector<string>(1, "das haus"));
+  BOOST_CHECK_EQUAL(table.lookups, 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <sstream>
 #include <vector>
 
+#include <boost/foreach.hpp>
+
 #include "util/random.hh"
 #include "util/usage.hh"
 
@@ -47,6 +49,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "FF/StatefulFeatureFunction.h"
 #include "FF/StatelessFeatureFunction.h"
 #include "TranslationTask.h"
+#include "DocumentTask.h"
 #include "ExportInterface.h"
 
 #ifdef HAVE_PROTOBUF
@@ -227,9 +230,45 @@ batch_run()
   if (!use_sliding_context_window)
     gscope.reset(new ContextScope);
 
+  // document-input: each document is decoded by a single worker, in a
+  // scope of its own that is chained onto the global one. Its caches and
+  // biases (e.g. of mmsapt) live as long as the document; it uses the
+  // global context weights unless it brings its own
+  // (<doc context-weights="...">).
+  if (staticData.options()->input.document_input) {
+    UTIL_THROW_IF2(use_context_window, "[" << HERE << "] "
+                   << "document-input cannot be combined with a context window");
+    if (context_weights != "")
+      gscope->SetContextWeights(context_weights);
+    std::vector<boost::shared_ptr<InputType> > doc;
+    std::string doc_weights;
+    while (ioWrapper->ReadDocument(doc, doc_weights)) {
+      IFVERBOSE(1) ResetUserTime();
+      boost::shared_ptr<ContextScope> dscope(new ContextScope(gscope));
+      if (doc_weights != "")
+        dscope->SetContextWeights(doc_weights);
+      DocumentTask::TaskList tasks;
+      BOOST_FOREACH(boost::shared_ptr<InputType> const& source, doc) {
+        boost::shared_ptr<TranslationTask> task;
+        task = TranslationTask::create(source, ioWrapper, dscope);
+        if (context_window)
+          task->SetContextWindow(context_window);
+        FeatureFunction::SetupAll(*task);
+        tasks.push_back(task);
+      }
+      boost::shared_ptr<DocumentTask> dtask(new DocumentTask(tasks));
+#ifdef WITH_THREADS
+      pool.Submit(dtask);
+#else
+      dtask->Run();
+#endif
+    }
+  }
+
   // main loop over set of input sentences
   boost::shared_ptr<InputType> source;
-  while ((source = ioWrapper->ReadInput(cw)) != NULL) {
+  while (!staticData.options()->input.document_input
+         && (source = ioWrapper->ReadInput(cw)) != NULL) {
     IFVERBOSE(1) ResetUserTime();
 
     // set up task of translating one sentence
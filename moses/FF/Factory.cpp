@@ -76,6 +76,9 @@
 #include "moses/Syntax/RuleTableFF.h"
 
 #include "moses/LM/InMemoryPerSentenceOnDemandLM.h"
+#include "moses/LM/NeuralLMWrapper.h"
+#include "moses/LM/RDLM.h"
+#include "moses/LM/bilingual-lm/BiLM_NPLM.h"
 #include "moses/FF/EditOps.h"
 #include "moses/FF/CorrectionPattern.h"
 
@@ -126,12 +129,6 @@
 #include "moses/SyntacticLanguageModel.h"
 #endif
 
-#ifdef LM_NEURAL
-#include "moses/LM/NeuralLMWrapper.h"
-#include "moses/LM/RDLM.h"
-#include "moses/LM/bilingual-lm/BiLM_NPLM.h"
-#endif
-
 #ifdef LM_DALM
 #include "moses/LM/DALMWrapper.h"
 #endif
@@ -306,6 +303,9 @@ FeatureRegistry::FeatureRegistry()
   MOSES_FNAME(ExamplePT);
 
   MOSES_FNAME(InMemoryPerSentenceOnDemandLM);
+  MOSES_FNAME2("NeuralLM", NeuralLMWrapper);
+  MOSES_FNAME(RDLM);
+  MOSES_FNAME2("BilingualNPLM", BilingualLM_NPLM);
   MOSES_FNAME(EditOps);
   MOSES_FNAME(CorrectionPattern);
 
@@ -350,11 +350,6 @@ FeatureRegistry::FeatureRegistry()
 #ifdef LM_RAND
   MOSES_FNAME2("RANDLM", LanguageModelRandLM);
 #endif
-#ifdef LM_NEURAL
-  MOSES_FNAME2("NeuralLM", NeuralLMWrapper);
-  MOSES_FNAME(RDLM);
-  MOSES_FNAME2("BilingualNPLM", BilingualLM_NPLM);
-#endif
 #ifdef LM_DALM
   MOSES_FNAME2("DALM", LanguageModelDALM);
 #endif
@@ -99,6 +99,12 @@ public:
     return FName(GetScoreProducerDescription(), name);
   }
 
+  //! intern a known set of sparse feature names at once, typically in Load()
+  void GetFeatureNames(const std::vector<std::string>& names,
+                       std::vector<FName>& out) const {
+    FName::Register(GetScoreProducerDescription(), names, out);
+  }
+
 
   //! if false, then this feature is not displayed in the n-best list.
   // use with care
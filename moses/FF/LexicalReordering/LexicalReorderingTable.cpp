@@ -8,6 +8,7 @@
 #include "moses/TargetPhrase.h"
 #include "moses/TargetPhraseCollection.h"
 #include "moses/TranslationTask.h"
+#include "LexicalReorderingTableHashed.h"
 
 #if !defined WIN32 || defined __MINGW32__ || defined HAVE_CMPH
 #include "moses/TranslationModel/CompactPT/LexicalReorderingTableCompact.h"
@@ -52,13 +53,18 @@ LoadAvailable(const std::string& filePath,
               const FactorList& e_factors,
               const FactorList& c_factors)
 {
-  //decide use Compact or Tree or Memory table
+  //decide use Compact, Hashed, Tree or Memory table
 #ifdef HAVE_CMPH
   LexicalReorderingTable *compactLexr = NULL;
   compactLexr = LexicalReorderingTableCompact::CheckAndLoad(filePath + ".minlexr", f_factors, e_factors, c_factors);
   if(compactLexr)
     return compactLexr;
 #endif
+  LexicalReorderingTable *hashedLexr
+  = LexicalReorderingTableHashed::CheckAndLoad(filePath, f_factors,
+      e_factors, c_factors);
+  if(hashedLexr)
+    return hashedLexr;
   LexicalReorderingTable* ret;
   if (FileExists(filePath+".binlexr.idx") )
     ret = new LexicalReorderingTableTree(filePath, f_factors,
@@ -0,0 +1,367 @@
+// -*- c++ -*-
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "LexicalReorderingTableHashed.h"
+#include "moses/InputFileStream.h"
+#include "moses/StaticData.h"
+#include "moses/Util.h"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/murmur_hash.hh"
+#include "util/tokenize_piece.hh"
+
+namespace Moses
+{
+
+namespace
+{
+const char kMagic[8] = { 'm', 'o', 's', 'h', 'l', 'x', 'r', '\0' };
+const uint32_t kVersion = 1;
+const uint64_t kWordSeed = 0x9e3779b97f4a7c15ULL;
+const uint64_t kPartSeed = 0xc2b2ae3d27d4eb4fULL;
+const size_t kCacheLine = 64;
+
+inline size_t AlignUp(size_t n, size_t to)
+{
+  return (n + to - 1) / to * to;
+}
+
+inline uint64_t NextPowerOfTwo(uint64_t n)
+{
+  uint64_t ret = 1;
+  while (ret < n) ret <<= 1;
+  return ret;
+}
+}
+
+const std::string LexicalReorderingTableHashed::Extension = ".hlexr";
+
+LexicalReorderingTableHashed::
+LexicalReorderingTableHashed(const std::string& filePath,
+                             const std::vector<FactorType>& f_factors,
+                             const std::vector<FactorType>& e_factors,
+                             const std::vector<FactorType>& c_factors)
+  : LexicalReorderingTable(f_factors, e_factors, c_factors)
+  , m_header(NULL)
+  , m_offsets(NULL)
+  , m_steps(NULL)
+  , m_slots(NULL)
+  , m_mask(0)
+{
+  Load(filePath);
+}
+
+LexicalReorderingTableHashed::
+~LexicalReorderingTableHashed() { }
+
+LexicalReorderingTable*
+LexicalReorderingTableHashed::
+CheckAndLoad(const std::string& filePath,
+             const std::vector<FactorType>& f_factors,
+             const std::vector<FactorType>& e_factors,
+             const std::vector<FactorType>& c_factors)
+{
+  // file name is specified without suffix
+  if(FileExists(filePath + Extension)) {
+    VERBOSE(2,"Using hashed lexical reordering table" << std::endl);
+    return new LexicalReorderingTableHashed(filePath + Extension,
+                                            f_factors, e_factors, c_factors);
+  }
+  // file name is specified with suffix
+  if(filePath.size() > Extension.size()
+      && filePath.compare(filePath.size() - Extension.size(),
+                          Extension.size(), Extension) == 0
+      && FileExists(filePath)) {
+    VERBOSE(2,"Using hashed lexical reordering table" << std::endl);
+    return new LexicalReorderingTableHashed(filePath, f_factors,
+                                            e_factors, c_factors);
+  }
+  return 0;
+}
+
+void
+LexicalReorderingTableHashed::
+Load(const std::string& filePath)
+{
+  util::scoped_fd fd(util::OpenReadOrThrow(filePath.c_str()));
+  uint64_t size = util::SizeOrThrow(fd.get());
+  UTIL_THROW_IF2(size < sizeof(Header), "File " << filePath
+                 << " is too small to be a hashed reordering table");
+  util::MapRead(util::LAZY, fd.get(), 0, size, m_mem);
+
+  const uint8_t* base = reinterpret_cast<const uint8_t*>(m_mem.get());
+  m_header = reinterpret_cast<const Header*>(base);
+  UTIL_THROW_IF2(std::memcmp(m_header->magic, kMagic, sizeof(kMagic)),
+                 "File " << filePath << " is not a hashed reordering table");
+  UTIL_THROW_IF2(m_header->version != kVersion,
+                 "File " << filePath << " has version " << m_header->version
+                 << ", expected " << kVersion);
+  UTIL_THROW_IF2(m_header->slotOffset + m_header->numSlots * m_header->slotSize
+                 > size, "File " << filePath << " is truncated");
+
+  m_offsets = reinterpret_cast<const float*>(base + sizeof(Header));
+  m_steps   = m_offsets + m_header->numScores;
+  m_slots   = base + m_header->slotOffset;
+  m_mask    = m_header->numSlots - 1;
+}
+
+uint64_t
+LexicalReorderingTableHashed::
+HashFactor(const StringPiece& factor, uint64_t h)
+{
+  return util::MurmurHash64A(factor.data(), factor.size(), h);
+}
+
+uint64_t
+LexicalReorderingTableHashed::
+HashWordEnd(uint64_t h)
+{
+  return util::MurmurHash64A(&h, sizeof(h), kWordSeed);
+}
+
+uint64_t
+LexicalReorderingTableHashed::
+HashPartEnd(uint64_t h)
+{
+  return util::MurmurHash64A(&h, sizeof(h), kPartSeed);
+}
+
+uint64_t
+LexicalReorderingTableHashed::
+HashText(const StringPiece& phrase, uint64_t h)
+{
+  for (util::TokenIter<util::AnyCharacter, true> w(phrase, " \t"); w; ++w) {
+    for (util::TokenIter<util::SingleCharacter> f(*w, '|'); f; ++f)
+      h = HashFactor(*f, h);
+    h = HashWordEnd(h);
+  }
+  return h;
+}
+
+uint64_t
+LexicalReorderingTableHashed::
+HashPhrase(const Phrase& p, const FactorList& factors, uint64_t h) const
+{
+  return HashPhrase(p, 0, factors, h);
+}
+
+uint64_t
+LexicalReorderingTableHashed::
+HashPhrase(const Phrase& p, size_t start, const FactorList& factors,
+           uint64_t h) const
+{
+  for (size_t i = start; i < p.GetSize(); ++i) {
+    const Word& w = p.GetWord(i);
+    for (size_t j = 0; j < factors.size(); ++j) {
+      const Factor* f = w[factors[j]];
+      if (f) h = HashFactor(f->GetString(), h);
+    }
+    h = HashWordEnd(h);
+  }
+  return h;
+}
+
+const uint8_t*
+LexicalReorderingTableHashed::
+Find(uint64_t key) const
+{
+  if (key == 0) key = 1; // 0 marks an empty slot
+  const size_t slotSize = m_header->slotSize;
+  for (uint64_t i = key & m_mask; ; i = (i + 1) & m_mask) {
+    const uint8_t* slot = m_slots + i * slotSize;
+    uint64_t stored = *reinterpret_cast<const uint64_t*>(slot);
+    if (stored == key) return slot;
+    if (stored == 0) return NULL;
+  }
+}
+
+void
+LexicalReorderingTableHashed::
+Decode(const uint8_t* slot, Scores& out) const
+{
+  const size_t n = m_header->numScores;
+  out.resize(n);
+  const uint8_t* codes = slot + sizeof(uint64_t);
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t code = (m_header->bits == 8)
+                    ? codes[i]
+                    : reinterpret_cast<const uint16_t*>(codes)[i];
+    out[i] = code ? m_offsets[i] + (code - 1) * m_steps[i] : LOWEST_SCORE;
+  }
+}
+
+Scores
+LexicalReorderingTableHashed::
+GetScore(const Phrase& f, const Phrase& e, const Phrase& c)
+{
+  Scores ret;
+  uint64_t key = 0;
+  if(!m_FactorsF.empty()) key = HashPartEnd(HashPhrase(f, m_FactorsF, key));
+  if(!m_FactorsE.empty()) key = HashPartEnd(HashPhrase(e, m_FactorsE, key));
+
+  if(m_FactorsC.empty()) {
+    if (const uint8_t* slot = Find(key)) Decode(slot, ret);
+    return ret;
+  }
+
+  // try from large to smaller context, as LexicalReorderingTableMemory does
+  for(size_t i = 0; i <= c.GetSize(); ++i) {
+    uint64_t ckey = HashPartEnd(HashPhrase(c, i, m_FactorsC, key));
+    if (const uint8_t* slot = Find(ckey)) {
+      Decode(slot, ret);
+      break;
+    }
+  }
+  return ret;
+}
+
+void
+LexicalReorderingTableHashed::
+DbgDump(std::ostream* out) const
+{
+  Scores scores;
+  for (uint64_t i = 0; i < m_header->numSlots; ++i) {
+    const uint8_t* slot = m_slots + i * m_header->slotSize;
+    uint64_t key = *reinterpret_cast<const uint64_t*>(slot);
+    if (!key) continue;
+    Decode(slot, scores);
+    *out << " key: " << key << " score: ";
+    for(size_t j = 0; j < scores.size(); ++j)
+      *out << scores[j] << " ";
+    *out << "\n";
+  }
+}
+
+bool
+LexicalReorderingTableHashed::
+Create(const std::string& inFilePath, const std::string& outFileName,
+       size_t bits)
+{
+  UTIL_THROW_IF2(bits != 8 && bits != 16,
+                 "Hashed reordering tables support 8 or 16 bit scores, not "
+                 << bits);
+
+  // pass 1: count entries and find the range of each score column
+  std::string line;
+  size_t numEntries = 0;
+  int numScores = -1;
+  std::vector<float> lo, hi;
+  {
+    InputFileStream file(inFilePath);
+    while(getline(file, line)) {
+      std::vector<std::string> tokens = TokenizeMultiCharSeparator(line, "|||");
+      std::vector<float> p = Scan<float>(Tokenize(tokens.back()));
+      if(-1 == numScores) {
+        numScores = (int)p.size();
+        lo.assign(numScores, std::numeric_limits<float>::max());
+        hi.assign(numScores, LOWEST_SCORE);
+      }
+      if((int)p.size() != numScores) {
+        TRACE_ERR("ERROR: found inconsistent number of probabilities... found "
+                  << p.size() << " expected " << numScores << std::endl);
+        return false;
+      }
+      for(size_t i = 0; i < p.size(); ++i) {
+        float s = FloorScore(TransformScore(p[i]));
+        if (s <= LOWEST_SCORE) continue;
+        lo[i] = std::min(lo[i], s);
+        hi[i] = std::max(hi[i], s);
+      }
+      ++numEntries;
+    }
+  }
+  if (numEntries == 0) {
+    TRACE_ERR("ERROR: empty lexicalised reordering file\n" << std::endl);
+    return false;
+  }
+
+  // code 0 is reserved for floored scores; the rest spread evenly over [lo,hi]
+  const size_t bytes = bits / 8;
+  const uint32_t maxCode = (1u << bits) - 1;
+  std::vector<float> steps(numScores, 0.0f);
+  for (int i = 0; i < numScores; ++i) {
+    if (lo[i] > hi[i]) lo[i] = hi[i] = LOWEST_SCORE;
+    steps[i] = (hi[i] - lo[i]) / (maxCode - 1);
+  }
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version    = kVersion;
+  header.numScores  = numScores;
+  header.bits       = bits;
+  header.slotSize   = NextPowerOfTwo(std::max<size_t>(16, sizeof(uint64_t)
+                                     + numScores * bytes));
+  header.numSlots   = NextPowerOfTwo(numEntries + numEntries / 2 + 1);
+  header.numEntries = 0;
+  header.slotOffset = AlignUp(sizeof(Header) + 2 * numScores * sizeof(float),
+                              kCacheLine);
+  if (header.slotSize > kCacheLine) {
+    TRACE_ERR("ERROR: " << numScores << " scores of " << bits
+              << " bits do not fit into one cache line" << std::endl);
+    return false;
+  }
+
+  const uint64_t total = header.slotOffset + header.numSlots * header.slotSize;
+  util::scoped_fd fd;
+  util::scoped_mmap mem(util::MapZeroedWrite(outFileName.c_str(), total, fd),
+                        total);
+  uint8_t* base = reinterpret_cast<uint8_t*>(mem.get());
+  float* offsets = reinterpret_cast<float*>(base + sizeof(Header));
+  std::copy(lo.begin(), lo.end(), offsets);
+  std::copy(steps.begin(), steps.end(), offsets + numScores);
+  uint8_t* slots = base + header.slotOffset;
+  const uint64_t mask = header.numSlots - 1;
+
+  // pass 2: insert every entry
+  InputFileStream file(inFilePath);
+  size_t lnc = 0;
+  while(getline(file, line)) {
+    ++lnc;
+    if(0 == lnc % 100000) TRACE_ERR(".");
+    std::vector<std::string> tokens = TokenizeMultiCharSeparator(line, "|||");
+    uint64_t key = 0;
+    for (size_t t = 0; t + 1 < tokens.size(); ++t)
+      key = HashPartEnd(HashText(tokens[t], key));
+    if (key == 0) key = 1;
+
+    uint8_t* slot;
+    uint64_t i = key & mask;
+    for (;; i = (i + 1) & mask) {
+      slot = slots + i * header.slotSize;
+      uint64_t stored = *reinterpret_cast<uint64_t*>(slot);
+      if (stored == 0 || stored == key) break;
+    }
+    if (*reinterpret_cast<uint64_t*>(slot) == key) {
+      TRACE_ERR("WARNING: duplicate or colliding key in line " << lnc
+                << ", keeping the first entry\n");
+      continue;
+    }
+    *reinterpret_cast<uint64_t*>(slot) = key;
+
+    std::vector<float> p = Scan<float>(Tokenize(tokens.back()));
+    uint8_t* codes = slot + sizeof(uint64_t);
+    for (int s = 0; s < numScores; ++s) {
+      float v = FloorScore(TransformScore(p[s]));
+      uint32_t code = 0;
+      if (v > LOWEST_SCORE) {
+        code = 1;
+        if (steps[s] > 0)
+          code += (uint32_t)std::min<float>(maxCode - 1,
+                                            floor((v - lo[s]) / steps[s] + 0.5f));
+      }
+      if (bits == 8) codes[s] = code;
+      else reinterpret_cast<uint16_t*>(codes)[s] = code;
+    }
+    ++header.numEntries;
+  }
+  std::memcpy(base, &header, sizeof(header));
+  TRACE_ERR("\n" << header.numEntries << " entries in " << header.numSlots
+            << " slots of " << header.slotSize << " bytes\n");
+  return true;
+}
+
+}
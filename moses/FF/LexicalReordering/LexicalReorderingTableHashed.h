@@ -0,0 +1,102 @@
+// -*- c++ -*-
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <istream>
+
+#include <stdint.h>
+
+#include "util/mmap.hh"
+#include "util/string_piece.hh"
+#include "LexicalReorderingTable.h"
+
+namespace Moses
+{
+
+//! Lexical reordering table backed by a memory-mapped open-addressing hash
+//! table. Keys are 64-bit hashes of the (f, e, c) factor strings; scores are
+//! quantized to 8 or 16 bits per orientation and stored next to the key in a
+//! slot that never straddles a cache line, so a lookup costs a single probe
+//! in the common case. The binary file (.hlexr) is built offline from the
+//! text table with processLexicalTable -hashed.
+class LexicalReorderingTableHashed
+  : public LexicalReorderingTable
+{
+public:
+  struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t numScores;
+    uint32_t bits;       // 8 or 16
+    uint32_t slotSize;   // power of two, at most one cache line
+    uint64_t numSlots;   // power of two
+    uint64_t numEntries;
+    uint64_t slotOffset; // byte offset of the slot array, cache-line aligned
+    char     padding[16];
+  };
+
+  static const std::string Extension;
+
+  LexicalReorderingTableHashed(const std::string& filePath,
+                               const std::vector<FactorType>& f_factors,
+                               const std::vector<FactorType>& e_factors,
+                               const std::vector<FactorType>& c_factors);
+
+  virtual
+  ~LexicalReorderingTableHashed();
+
+  static
+  LexicalReorderingTable*
+  CheckAndLoad(const std::string& filePath,
+               const std::vector<FactorType>& f_factors,
+               const std::vector<FactorType>& e_factors,
+               const std::vector<FactorType>& c_factors);
+
+  //! Build a .hlexr file from a (possibly gzipped) text table. The input is
+  //! read twice: once to find the score ranges, once to fill the table.
+  static
+  bool
+  Create(const std::string& inFilePath, const std::string& outFileName,
+         size_t bits = 16);
+
+  virtual
+  Scores
+  GetScore(const Phrase& f, const Phrase& e, const Phrase& c);
+
+  void
+  DbgDump(std::ostream* out) const;
+
+private:
+  // key hashing shared by the builder (text) and the decoder (Phrase)
+  static uint64_t HashFactor(const StringPiece& factor, uint64_t h);
+  static uint64_t HashWordEnd(uint64_t h);
+  static uint64_t HashPartEnd(uint64_t h);
+  static uint64_t HashText(const StringPiece& phrase, uint64_t h);
+
+  uint64_t
+  HashPhrase(const Phrase& p, const FactorList& factors, uint64_t h) const;
+
+  uint64_t
+  HashPhrase(const Phrase& p, size_t start, const FactorList& factors,
+             uint64_t h) const;
+
+  const uint8_t*
+  Find(uint64_t key) const;
+
+  void
+  Decode(const uint8_t* slot, Scores& out) const;
+
+  void
+  Load(const std::string& filePath);
+
+  util::scoped_memory m_mem;
+  const Header*       m_header;
+  const float*        m_offsets;  // per-score value of code 1
+  const float*        m_steps;    // per-score quantization step
+  const uint8_t*      m_slots;
+  uint64_t            m_mask;
+};
+
+}
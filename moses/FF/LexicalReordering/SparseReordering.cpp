@@ -109,6 +109,8 @@ SparseReordering::SparseReordering(const map<string,string>& config, const Lexic
 
 void SparseReordering::PreCalculateFeatureNames(size_t index, const string& id, SparseReorderingFeatureKey::Side side, const Factor* factor, bool isCluster)
 {
+  vector<SparseReorderingFeatureKey> keys;
+  vector<string> names;
   for (size_t type = SparseReorderingFeatureKey::Stack;
        type <= SparseReorderingFeatureKey::Between; ++type) {
     for (size_t position = SparseReorderingFeatureKey::First;
@@ -119,10 +121,16 @@ void SparseReordering::PreCalculateFeatureNames(size_t index, const string& id,
             factor, isCluster,
             static_cast<SparseReorderingFeatureKey::Position>(position),
             side, static_cast<LRModel::ReorderingType>(reoType));
-        m_featureMap.insert(pair<SparseReorderingFeatureKey, FName>(key,m_producer->GetFeatureName(key.Name(id))));
+        keys.push_back(key);
+        names.push_back(key.Name(id));
       }
     }
   }
+  vector<FName> fnames;
+  m_producer->GetFeatureNames(names, fnames);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    m_featureMap.insert(pair<SparseReorderingFeatureKey, FName>(keys[i], fnames[i]));
+  }
 }
 
 void SparseReordering::ReadWordList(const string& filename, const string& id, SparseReorderingFeatureKey::Side side, vector<WordList>* pWordLists)
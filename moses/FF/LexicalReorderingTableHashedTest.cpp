@@ -0,0 +1,185 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "LexicalReordering/LexicalReorderingTable.h"
+#include "LexicalReordering/LexicalReorderingTableHashed.h"
+#include "moses/Phrase.h"
+#include "moses/Util.h"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(hashed_lexical_reordering)
+
+namespace
+{
+
+const size_t kScores = 6;
+
+Phrase MakePhrase(const string &words)
+{
+  Phrase phrase;
+  phrase.CreateFromString(Input, vector<FactorType>(1, 0), words, NULL);
+  return phrase;
+}
+
+// A text table and the .hlexr built from it, in a directory of their own.
+class Tables
+{
+public:
+  Tables()
+    : m_dir(boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("hlexr-%%%%-%%%%")) {
+    boost::filesystem::create_directories(m_dir);
+  }
+
+  ~Tables() {
+    boost::filesystem::remove_all(m_dir);
+  }
+
+  string Text() const {
+    return (m_dir / "reordering").string();
+  }
+
+  string Hashed() const {
+    return Text() + LexicalReorderingTableHashed::Extension;
+  }
+
+private:
+  boost::filesystem::path m_dir;
+};
+
+// f ||| e ||| probabilities, with a zero probability now and then
+void WriteTable(const string &path, vector<pair<string, string> > &pairs)
+{
+  ofstream out(path.c_str());
+  unsigned r = 12345;
+  for (size_t i = 0; i < 500; ++i) {
+    const string f = "f" + SPrint(i % 50) + (i % 3 ? " g" + SPrint(i % 7) : "");
+    const string e = "e" + SPrint(i / 50) + " h" + SPrint(i % 11);
+    pairs.push_back(make_pair(f, e));
+    out << f << " ||| " << e << " |||";
+    for (size_t s = 0; s < kScores; ++s) {
+      r = r * 1103515245 + 12345;
+      const unsigned x = r >> 16;
+      out << " " << ((i + s) % 97 ? 0.01 + (x % 1000) / 1010.0 : 0.0);
+    }
+    out << "\n";
+  }
+}
+
+// Largest gap between neighbouring codes of each score: the spread of the
+// unfloored scores over the codes after the one for floored scores.
+vector<float> MaxSteps(LexicalReorderingTable &text, const vector<pair<string, string> > &pairs, size_t bits)
+{
+  vector<float> lo(kScores, numeric_limits<float>::max()), hi(kScores, LOWEST_SCORE);
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    const Scores scores = text.GetScore(MakePhrase(pairs[i].first), MakePhrase(pairs[i].second), Phrase());
+    for (size_t s = 0; s < kScores; ++s) {
+      if (scores[s] <= LOWEST_SCORE) continue;
+      lo[s] = min(lo[s], scores[s]);
+      hi[s] = max(hi[s], scores[s]);
+    }
+  }
+  vector<float> ret(kScores);
+  for (size_t s = 0; s < kScores; ++s) {
+    ret[s] = (hi[s] - lo[s]) / ((1u << bits) - 2);
+  }
+  return ret;
+}
+}
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+  const size_t bits[] = { 8, 16 };
+  for (size_t b = 0; b < 2; ++b) {
+    Tables tables;
+    vector<pair<string, string> > pairs;
+    WriteTable(tables.Text(), pairs);
+    BOOST_REQUIRE(LexicalReorderingTableHashed::Create(tables.Text(), tables.Hashed(), bits[b]));
+
+    const vector<FactorType> factors(1, 0), none;
+    LexicalReorderingTableMemory text(tables.Text(), factors, factors, none);
+    // found by the name of the text table, as the decoder loads it
+    boost::scoped_ptr<LexicalReorderingTable> hashed(
+      LexicalReorderingTableHashed::CheckAndLoad(tables.Text(), factors, factors, none));
+    BOOST_REQUIRE(hashed.get());
+
+    const vector<float> steps = MaxSteps(text, pairs, bits[b]);
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      const Phrase f = MakePhrase(pairs[i].first), e = MakePhrase(pairs[i].second);
+      const Scores expected = text.GetScore(f, e, Phrase());
+      const Scores got = hashed->GetScore(f, e, Phrase());
+      BOOST_REQUIRE_EQUAL(expected.size(), kScores);
+      BOOST_REQUIRE_EQUAL(got.size(), kScores);
+      for (size_t s = 0; s < kScores; ++s) {
+        if (expected[s] <= LOWEST_SCORE) {
+          // floored scores stay exact
+          BOOST_CHECK_EQUAL(got[s], expected[s]);
+        } else {
+          // rounded to the nearest code, and float arithmetic on top
+          BOOST_CHECK_SMALL(got[s] - expected[s], steps[s] * 0.5f + 1e-5f);
+        }
+      }
+    }
+
+    // pairs not in the table, including f and e swapped
+    BOOST_CHECK(hashed->GetScore(MakePhrase("f1 g1"), MakePhrase("e0 h2"), Phrase()).empty());
+    BOOST_CHECK(hashed->GetScore(MakePhrase("e0 h0"), MakePhrase("f0"), Phrase()).empty());
+    BOOST_CHECK(hashed->GetScore(MakePhrase("f0 g0"), MakePhrase("e0"), Phrase()).empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(longest_context_first)
+{
+  Tables tables;
+  {
+    ofstream out(tables.Text().c_str());
+    out << "a ||| x ||| c ||| 0.5 0.5\n"
+        << "a ||| x ||| b c ||| 0.25 0.125\n"
+        << "a ||| y ||| c ||| 0.75 0.75\n";
+  }
+  BOOST_REQUIRE(LexicalReorderingTableHashed::Create(tables.Text(), tables.Hashed(), 16));
+
+  const vector<FactorType> factors(1, 0);
+  LexicalReorderingTableMemory text(tables.Text(), factors, factors, factors);
+  LexicalReorderingTableHashed hashed(tables.Hashed(), factors, factors, factors);
+  const char *contexts[] = { "b c", "c", "d b c", "d c", "d" };
+  for (size_t i = 0; i < 5; ++i) {
+    for (size_t t = 0; t < 2; ++t) {
+      const Phrase f = MakePhrase("a"), e = MakePhrase(t ? "y" : "x"), c = MakePhrase(contexts[i]);
+      const Scores expected = text.GetScore(f, e, c), got = hashed.GetScore(f, e, c);
+      BOOST_REQUIRE_EQUAL(got.size(), expected.size());
+      for (size_t s = 0; s < got.size(); ++s) {
+        BOOST_CHECK_SMALL(got[s] - expected[s], 1e-3f);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -42,6 +42,17 @@ public:
     const FFState* prev_state,
     ScoreComponentCollection* accumulator) const = 0;
 
+  /**
+   * Called shortly before EvaluateWhenApplied() on the same hypothesis when
+   * hypotheses are scored in batches, so that features backed by large
+   * tables can start loading what they are going to look up. The default
+   * does nothing.
+   */
+  virtual void PrefetchWhenApplied(
+    const Hypothesis& /* cur_hypo */,
+    const FFState* /* prev_state */) const {
+  }
+
   // virtual FFState* EvaluateWhenAppliedWithContext(
   //   ttasksptr const& ttasks,
   //   const Hypothesis& cur_hypo,
@@ -23,11 +23,18 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <sstream>
 #include <stdexcept>
 
-#if defined __MINGW32__ && defined WITH_THREADS
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+
+#ifdef WITH_THREADS
 #include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/tss.hpp>
 #endif // WITH_THREADS
 
 #include "FeatureVector.h"
+#include "util/murmur_hash.hh"
 #include "util/string_piece_hash.hh"
 #include "util/string_stream.hh"
 
@@ -38,53 +45,205 @@ namespace Moses
 {
 
 const string FName::SEP = "_";
-FName::Name2Id FName::name2id;
-vector<string> FName::id2name;
-FName::Id2Count FName::id2hopeCount;
-FName::Id2Count FName::id2fearCount;
+
+/**
+ * Process-wide, append-only mapping between feature names and ids.
+ *
+ * name -> id is split into shards by hash, each behind its own reader-writer
+ * lock: lookups take it shared, inserts exclusively, so name -> id is not
+ * lock-free. GetOrInsert() memoises its results in a bounded per-thread
+ * cache; only lookups that miss it (names new to the thread, or all names
+ * after the cache filled up and was cleared) take the lock. Find() always
+ * takes it. id -> name takes no lock: names live in fixed-size chunks that
+ * are published with an atomic pointer and never moved.
+ **/
+class FName::Registry
+{
+public:
+  Registry() : m_size(0) {
+    for (size_t i = 0; i < kMaxChunks; ++i) m_chunks[i] = NULL;
+  }
+
+  ~Registry() {
+    for (size_t i = 0; i < kMaxChunks; ++i) delete [] m_chunks[i].load();
+  }
+
+  static Registry &Instance() {
+    static Registry instance;
+    return instance;
+  }
+
+  size_t GetOrInsert(const StringPiece &name) {
+#ifdef WITH_THREADS
+    Name2Id *cache = m_cache.get();
+    if (!cache) {
+      cache = new Name2Id;
+      m_cache.reset(cache);
+    }
+    Name2Id::const_iterator c = FindStringPiece(*cache, name);
+    if (c != cache->end()) return c->second;
+#endif
+    Shard &shard = GetShard(name);
+    size_t id;
+    {
 #ifdef WITH_THREADS
-boost::shared_mutex FName::m_idLock;
+      boost::shared_lock<boost::shared_mutex> lock(shard.lock);
 #endif
+      Name2Id::const_iterator i = FindStringPiece(shard.name2id, name);
+      if (i != shard.name2id.end()) {
+        id = i->second;
+      } else {
+#ifdef WITH_THREADS
+        lock.unlock();
+        boost::unique_lock<boost::shared_mutex> write_lock(shard.lock);
+#endif
+        // another thread may have inserted it since we let go of the lock
+        i = FindStringPiece(shard.name2id, name);
+        if (i != shard.name2id.end()) {
+          id = i->second;
+        } else {
+          id = Append(name);
+          shard.name2id.insert(make_pair(string(name.data(), name.size()), id));
+        }
+      }
+    }
+#ifdef WITH_THREADS
+    if (cache->size() >= kMaxCacheSize) cache->clear();
+    cache->insert(make_pair(string(name.data(), name.size()), id));
+#endif
+    return id;
+  }
 
-void FName::init(const StringPiece &name)
-{
+  bool Find(const StringPiece &name, size_t &id) {
+    Shard &shard = GetShard(name);
 #ifdef WITH_THREADS
-  //reader lock
-  boost::shared_lock<boost::shared_mutex> lock(m_idLock);
+    boost::shared_lock<boost::shared_mutex> lock(shard.lock);
 #endif
-  Name2Id::iterator i = FindStringPiece(name2id, name);
-  if (i != name2id.end()) {
-    m_id = i->second;
-  } else {
+    Name2Id::const_iterator i = FindStringPiece(shard.name2id, name);
+    if (i == shard.name2id.end()) return false;
+    id = i->second;
+    return true;
+  }
+
+  const string &Name(size_t id) const {
+    return m_chunks[id >> kChunkBits].load(boost::memory_order_acquire)
+           [id & (kChunkSize - 1)];
+  }
+
+  size_t Size() const {
+    return m_size.load();
+  }
+
+private:
+  static const size_t kShards = 64;
+  static const size_t kChunkBits = 14;
+  static const size_t kChunkSize = 1 << kChunkBits;
+  static const size_t kMaxChunks = 1 << 16;
+  static const size_t kMaxCacheSize = 1 << 16;
+
+  struct Shard {
+    Name2Id name2id;
+#ifdef WITH_THREADS
+    boost::shared_mutex lock;
+#endif
+  };
+
+  Shard &GetShard(const StringPiece &name) {
+    return m_shards[util::MurmurHashNative(name.data(), name.size()) % kShards];
+  }
+
+  // Called with the shard's write lock held.
+  size_t Append(const StringPiece &name) {
+    size_t id = m_size.fetch_add(1);
+    size_t chunk = id >> kChunkBits;
+    UTIL_THROW_IF2(chunk >= kMaxChunks, "Too many sparse feature names");
+    string *names = m_chunks[chunk].load(boost::memory_order_acquire);
+    if (!names) {
 #ifdef WITH_THREADS
-    //release the reader lock, and upgrade to writer lock
-    lock.unlock();
-    boost::unique_lock<boost::shared_mutex> write_lock(m_idLock);
+      boost::mutex::scoped_lock lock(m_growLock);
 #endif
-    std::pair<std::string, size_t> to_ins;
-    to_ins.first.assign(name.data(), name.size());
-    to_ins.second = name2id.size();
-    std::pair<Name2Id::iterator, bool> res(name2id.insert(to_ins));
-    if (res.second) {
-      // TODO this should be string pointers backed by the hash table.
-      id2name.push_back(to_ins.first);
+      names = m_chunks[chunk].load(boost::memory_order_acquire);
+      if (!names) {
+        names = new string[kChunkSize];
+        m_chunks[chunk].store(names, boost::memory_order_release);
+      }
     }
-    m_id = res.first->second;
+    names[id & (kChunkSize - 1)].assign(name.data(), name.size());
+    return id;
+  }
+
+  Shard m_shards[kShards];
+  boost::atomic<string*> m_chunks[kMaxChunks];
+  boost::atomic<size_t> m_size;
+#ifdef WITH_THREADS
+  boost::mutex m_growLock;
+  boost::thread_specific_ptr<Name2Id> m_cache;
+#endif
+};
+
+namespace
+{
+// hope/fear counts are only touched by online tuning
+FName::Id2Count id2hopeCount;
+FName::Id2Count id2fearCount;
+#ifdef WITH_THREADS
+boost::mutex countLock;
+#endif
+}
+
+FName::FName(const StringPiece &root, const StringPiece &name)
+{
+  // assemble short names on the stack, most lookups find an existing id
+  char buffer[256];
+  const size_t size = root.size() + SEP.size() + name.size();
+  if (size <= sizeof(buffer)) {
+    std::copy(root.data(), root.data() + root.size(), buffer);
+    std::copy(SEP.begin(), SEP.end(), buffer + root.size());
+    std::copy(name.data(), name.data() + name.size(),
+              buffer + root.size() + SEP.size());
+    init(StringPiece(buffer, size));
+  } else {
+    std::string assembled(root.data(), root.size());
+    assembled += SEP;
+    assembled.append(name.data(), name.size());
+    init(assembled);
   }
 }
 
+void FName::init(const StringPiece &name)
+{
+  m_id = Registry::Instance().GetOrInsert(name);
+}
+
+void FName::Register(const StringPiece& root,
+                     const vector<string>& names,
+                     vector<FName>& out)
+{
+  out.reserve(out.size() + names.size());
+  for (size_t i = 0; i < names.size(); ++i)
+    out.push_back(FName(root, names[i]));
+}
+
+size_t FName::NumRegistered()
+{
+  return Registry::Instance().Size();
+}
+
 size_t FName::getId(const string& name)
 {
-  Name2Id::iterator i = name2id.find(name);
-  assert (i != name2id.end());
-  return i->second;
+  size_t id = 0;
+  UTIL_THROW_IF2(!Registry::Instance().Find(name, id),
+                 "Unregistered feature " << name);
+  return id;
 }
 
 size_t FName::getHopeIdCount(const string& name)
 {
-  Name2Id::iterator i = name2id.find(name);
-  if (i != name2id.end()) {
-    float id = i->second;
+  size_t id;
+  if (Registry::Instance().Find(name, id)) {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(countLock);
+#endif
     return id2hopeCount[id];
   }
   return 0;
@@ -92,9 +251,11 @@ size_t FName::getHopeIdCount(const string& name)
 
 size_t FName::getFearIdCount(const string& name)
 {
-  Name2Id::iterator i = name2id.find(name);
-  if (i != name2id.end()) {
-    float id = i->second;
+  size_t id;
+  if (Registry::Instance().Find(name, id)) {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(countLock);
+#endif
     return id2fearCount[id];
   }
   return 0;
@@ -102,34 +263,26 @@ size_t FName::getFearIdCount(const string& name)
 
 void FName::incrementHopeId(const string& name)
 {
-  Name2Id::iterator i = name2id.find(name);
-  assert(i != name2id.end());
+  size_t id = getId(name);
 #ifdef WITH_THREADS
-  // get upgradable lock and upgrade to writer lock
-  boost::upgrade_lock<boost::shared_mutex> upgradeLock(m_idLock);
-  boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(upgradeLock);
+  boost::mutex::scoped_lock lock(countLock);
 #endif
-  id2hopeCount[i->second] += 1;
+  id2hopeCount[id] += 1;
 }
 
 void FName::incrementFearId(const string& name)
 {
-  Name2Id::iterator i = name2id.find(name);
-  assert(i != name2id.end());
+  size_t id = getId(name);
 #ifdef WITH_THREADS
-  // get upgradable lock and upgrade to writer lock
-  boost::upgrade_lock<boost::shared_mutex> upgradeLock(m_idLock);
-  boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(upgradeLock);
+  boost::mutex::scoped_lock lock(countLock);
 #endif
-  id2fearCount[i->second] += 1;
+  id2fearCount[id] += 1;
 }
 
 void FName::eraseId(size_t id)
 {
 #ifdef WITH_THREADS
-  // get upgradable lock and upgrade to writer lock
-  boost::upgrade_lock<boost::shared_mutex> upgradeLock(m_idLock);
-  boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(upgradeLock);
+  boost::mutex::scoped_lock lock(countLock);
 #endif
   id2hopeCount.erase(id);
   id2fearCount.erase(id);
@@ -148,7 +301,7 @@ size_t FName::hash() const
 
 const std::string& FName::name() const
 {
-  return id2name[m_id];
+  return Registry::Instance().Name(m_id);
 }
 
 
@@ -302,10 +455,122 @@ ostream& operator<<(ostream& out, const FVector& fv)
   return fv.print(out);
 }
 
+namespace
+{
+struct FeatureIdLess {
+  bool operator()(const std::pair<FName,FValue>& lhs, const FName& rhs) const {
+    return lhs.first < rhs;
+  }
+  bool operator()(const FName& lhs, const std::pair<FName,FValue>& rhs) const {
+    return lhs < rhs.first;
+  }
+};
+
+struct Plus {
+  FValue operator()(FValue lhs, FValue rhs) const {
+    return lhs + rhs;
+  }
+};
+
+struct Minus {
+  FValue operator()(FValue lhs, FValue rhs) const {
+    return lhs - rhs;
+  }
+};
+}
+
+FVector::const_iterator FVector::find(const FName& name) const
+{
+  const_iterator fi = std::lower_bound(m_features.begin(), m_features.end(),
+                                       name, FeatureIdLess());
+  if (fi != m_features.end() && fi->first == name) return fi;
+  return m_features.end();
+}
+
+FValue& FVector::ref(const FName& name)
+{
+  // features are mostly added in id order, so check the end first
+  if (m_features.empty() || m_features.back().first < name) {
+    m_features.push_back(std::make_pair(name, FValue(0)));
+    return m_features.back().second;
+  }
+  iterator fi = std::lower_bound(m_features.begin(), m_features.end(),
+                                 name, FeatureIdLess());
+  if (fi == m_features.end() || fi->first != name) {
+    fi = m_features.insert(fi, std::make_pair(name, FValue(0)));
+  }
+  return fi->second;
+}
+
+void FVector::erase(std::vector<FName> names)
+{
+  if (names.empty()) return;
+  std::sort(names.begin(), names.end());
+  std::vector<FName>::const_iterator n = names.begin();
+  iterator out = m_features.begin();
+  for (iterator i = m_features.begin(); i != m_features.end(); ++i) {
+    while (n != names.end() && *n < i->first) ++n;
+    if (n != names.end() && *n == i->first) continue;
+    *out++ = *i;
+  }
+  m_features.erase(out, m_features.end());
+}
+
+// Merge rhs into this vector, combining values with op(lhs, rhs) and taking
+// missing values as 0. The merge runs backwards in place after growing the
+// array by the number of new ids, so it allocates at most once.
+template <class Op>
+void FVector::sparseMerge(const FVector& rhs, Op op)
+{
+  const FNVmap& other = rhs.m_features;
+  if (other.empty()) return;
+
+  size_t added = 0;
+  const_iterator i = m_features.begin(), j = other.begin();
+  while (j != other.end()) {
+    if (i == m_features.end() || j->first < i->first) {
+      ++added;
+      ++j;
+    } else if (i->first < j->first) {
+      ++i;
+    } else {
+      ++i;
+      ++j;
+    }
+  }
+
+  if (added == 0) {
+    iterator l = m_features.begin();
+    for (j = other.begin(); j != other.end(); ++j) {
+      while (l->first < j->first) ++l;
+      l->second = op(l->second, j->second);
+    }
+    return;
+  }
+
+  size_t l = m_features.size();
+  size_t r = other.size();
+  m_features.resize(l + added, other.front());
+  size_t w = l + added;
+  while (r > 0) {
+    const std::pair<FName,FValue>& rv = other[r - 1];
+    if (l > 0 && rv.first < m_features[l - 1].first) {
+      m_features[--w] = m_features[--l];
+    } else if (l > 0 && rv.first == m_features[l - 1].first) {
+      m_features[--w] = std::make_pair(rv.first,
+                                       op(m_features[--l].second, rv.second));
+      --r;
+    } else {
+      m_features[--w] = std::make_pair(rv.first, op(FValue(0), rv.second));
+      --r;
+    }
+  }
+}
+
 const FValue& FVector::get(const FName& name) const
 {
   static const FValue DEFAULT = 0;
-  const_iterator fi = m_features.find(name);
+  const_iterator fi = find(name);
   if (fi == m_features.end()) {
     return DEFAULT;
   } else {
@@ -315,7 +580,7 @@ const FValue& FVector::get(const FName& name) const
 
 FValue FVector::getBackoff(const FName& name, float backoff) const
 {
-  const_iterator fi = m_features.find(name);
+  const_iterator fi = find(name);
   if (fi == m_features.end()) {
     return backoff;
   } else {
@@ -351,7 +616,7 @@ void FVector::capMin(FValue minValue)
 
 void FVector::set(const FName& name, const FValue& value)
 {
-  m_features[name] = value;
+  ref(name) = value;
 }
 
 void FVector::printCoreFeatures()
@@ -370,8 +635,7 @@ FVector& FVector::operator+= (const FVector& rhs)
 {
   if (rhs.m_coreFeatures.size() > m_coreFeatures.size())
     resize(rhs.m_coreFeatures.size());
-  for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i)
-    set(i->first, get(i->first) + i->second);
+  sparseMerge(rhs, Plus());
   for (size_t i = 0; i < rhs.m_coreFeatures.size(); ++i)
     m_coreFeatures[i] += rhs.m_coreFeatures[i];
   return *this;
@@ -380,8 +644,7 @@ FVector& FVector::operator+= (const FVector& rhs)
 // add only sparse features
 void FVector::sparsePlusEquals(const FVector& rhs)
 {
-  for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i)
-    set(i->first, get(i->first) + i->second);
+  sparseMerge(rhs, Plus());
 }
 
 // add only core features
@@ -450,8 +713,7 @@ size_t FVector::pruneSparseFeatures(size_t threshold)
     }
   }
 
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
 
   return count;
 }
@@ -470,8 +732,7 @@ size_t FVector::pruneZeroWeightFeatures()
     }
   }
 
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
 
   return count;
 }
@@ -548,8 +809,7 @@ FVector& FVector::operator-= (const FVector& rhs)
 {
   if (rhs.m_coreFeatures.size() > m_coreFeatures.size())
     resize(rhs.m_coreFeatures.size());
-  for (const_iterator i = rhs.cbegin(); i != rhs.cend(); ++i)
-    set(i->first, get(i->first) -(i->second));
+  sparseMerge(rhs, Minus());
   for (size_t i = 0; i < m_coreFeatures.size(); ++i) {
     if (i < rhs.m_coreFeatures.size()) {
       m_coreFeatures[i] -= rhs.m_coreFeatures[i];
@@ -725,8 +985,7 @@ size_t FVector::l1regularize(float lambda)
   }
 
   // erase features that have become zero
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
   numberPruned -= size();
   return numberPruned;
 }
@@ -775,8 +1034,7 @@ size_t FVector::sparseL1regularize(float lambda)
   }
 
   // erase features that have become zero
-  for (size_t i = 0; i < toErase.size(); ++i)
-    m_features.erase(toErase[i]);
+  erase(toErase);
   numberPruned -= size();
   return numberPruned;
 }
@@ -806,8 +1064,16 @@ FValue FVector::inner_product(const FVector& rhs) const
 {
   assert(m_coreFeatures.size() == rhs.m_coreFeatures.size());
   FValue product = 0.0;
-  for (const_iterator i = cbegin(); i != cend(); ++i) {
-    product += ((i->second)*(rhs.get(i->first)));
+  // walk the shorter sparse array, searching forward in the longer one
+  const FNVmap& shorter = m_features.size() <= rhs.m_features.size()
+                          ? m_features : rhs.m_features;
+  const FNVmap& longer = m_features.size() <= rhs.m_features.size()
+                         ? rhs.m_features : m_features;
+  const_iterator j = longer.begin();
+  for (const_iterator i = shorter.begin(); i != shorter.end() && j != longer.end(); ++i) {
+    j = std::lower_bound(j, longer.end(), i->first, FeatureIdLess());
+    if (j != longer.end() && j->first == i->first)
+      product += i->second * j->second;
   }
   for (size_t i = 0; i < m_coreFeatures.size(); ++i) {
     product += m_coreFeatures[i]*rhs.m_coreFeatures[i];
@@ -833,7 +1099,7 @@ void FVector::merge(const FVector &other)
   for (iter = other.m_features.begin(); iter != other.m_features.end(); ++iter) {
     const FName  &otherKey = iter->first;
     const FValue otherVal = iter->second;
-    m_features[otherKey] = otherVal;
+    set(otherKey, otherVal);
   }
 }
 
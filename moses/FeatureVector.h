@@ -40,10 +40,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <boost/serialization/valarray.hpp>
 #endif
 
-#ifdef WITH_THREADS
-#include <boost/thread/shared_mutex.hpp>
-#endif
-
 #include "util/exception.hh"
 #include "util/string_piece.hh"
 
@@ -61,32 +57,45 @@ struct FName {
 
   typedef boost::unordered_map<std::string,size_t> Name2Id;
   typedef boost::unordered_map<size_t,size_t> Id2Count;
-  //typedef std::map<std::string, size_t> Name2Id;
-  static Name2Id name2id;
-  static std::vector<std::string> id2name;
-  static Id2Count id2hopeCount;
-  static Id2Count id2fearCount;
 
   //A feature name can either be initialised as a pair of strings,
   //which will be concatenated with a SEP between them, or as
   //a single string, which will be used as-is.
-  FName(const StringPiece &root, const StringPiece &name) {
-    std::string assembled(root.data(), root.size());
-    assembled += SEP;
-    assembled.append(name.data(), name.size());
-    init(assembled);
-  }
+  FName(const StringPiece &root, const StringPiece &name);
   explicit FName(const StringPiece &name) {
     init(name);
   }
 
+  //! Name of an already registered feature id, e.g. one cached at Load() time
+  static FName FromId(size_t id) {
+    FName ret;
+    ret.m_id = id;
+    return ret;
+  }
+
   const std::string& name() const;
   //const std::string& root() const {return m_root;}
 
+  size_t id() const {
+    return m_id;
+  }
+
   size_t hash() const;
 
   bool operator==(const FName& rhs) const ;
   bool operator!=(const FName& rhs) const ;
+  bool operator<(const FName& rhs) const {
+    return m_id < rhs.m_id;
+  }
+
+  //! Intern a batch of names (each prefixed with root and SEP), e.g. from
+  //! FeatureFunction::Load().  Each name is interned as by the constructor,
+  //! under its shard's lock; the returned FNames carry their ids, so
+  //! decoding threads that keep them never look the names up again.
+  static void Register(const StringPiece& root,
+                       const std::vector<std::string>& names,
+                       std::vector<FName>& out);
+  static size_t NumRegistered();
 
   static size_t getId(const std::string& name);
   static size_t getHopeIdCount(const std::string& name);
@@ -96,12 +105,11 @@ struct FName {
   static void eraseId(size_t id);
 
 private:
+  class Registry;
+
+  FName() {}
   void init(const StringPiece& name);
   size_t m_id;
-#ifdef WITH_THREADS
-  //reader-writer lock
-  static boost::shared_mutex m_idLock;
-#endif
 };
 
 std::ostream& operator<<(std::ostream& out,const FName& name);
@@ -141,7 +149,10 @@ public:
   **/
   void resize(size_t newsize);
 
-  typedef boost::unordered_map<FName,FValue,FNameHash, FNameEquals> FNVmap;
+  /** Sparse features as a flat array of (name, value) pairs, kept sorted by
+   *  feature id so that arithmetic and dot products are merges rather than
+   *  hash lookups, and no map nodes are allocated per hypothesis. */
+  typedef std::vector<std::pair<FName,FValue> > FNVmap;
   /** Iterators */
   typedef FNVmap::iterator iterator;
   typedef FNVmap::const_iterator const_iterator;
@@ -152,14 +163,14 @@ public:
     return m_features.end();
   }
   const_iterator cbegin() const {
-    return m_features.cbegin();
+    return m_features.begin();
   }
   const_iterator cend() const {
-    return m_features.cend();
+    return m_features.end();
   }
 
   bool hasNonDefaultValue(FName name) const {
-    return m_features.find(name) != m_features.end();
+    return find(name) != m_features.end();
   }
   void clear();
 
@@ -272,6 +283,12 @@ private:
   FValue getBackoff(const FName& name, float backoff) const;
   void set(const FName& name, const FValue& value);
 
+  /** Sorted-array helpers */
+  const_iterator find(const FName& name) const;
+  FValue& ref(const FName& name);
+  void erase(std::vector<FName> names);
+  template <class Op> void sparseMerge(const FVector& rhs, Op op);
+
   FNVmap m_features;
   std::valarray<FValue> m_coreFeatures;
 
@@ -367,15 +384,15 @@ public:
    }*/
 
   FValue operator++() {
-    return ++m_fv->m_features[m_name];
+    return ++m_fv->ref(m_name);
   }
 
   FValue operator +=(FValue lhs) {
-    return (m_fv->m_features[m_name] += lhs);
+    return (m_fv->ref(m_name) += lhs);
   }
 
   FValue operator -=(FValue lhs) {
-    return (m_fv->m_features[m_name] -= lhs);
+    return (m_fv->ref(m_name) -= lhs);
   }
 
 private:
@@ -19,7 +19,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <boost/test/unit_test.hpp>
 
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
+
 #include "FeatureVector.h"
+#include "util/string_stream.hh"
 
 using namespace Moses;
 using namespace std;
@@ -307,5 +312,78 @@ BOOST_AUTO_TEST_CASE(ip)
 }
 
 
+BOOST_AUTO_TEST_CASE(sparse_merge)
+{
+  // insert out of id order, so the flat array has to interleave on merge
+  FName n1("m1");
+  FName n2("m2");
+  FName n3("m3");
+  FName n4("m4");
+  FName n5("m", "5");
+  FVector f1, f2;
+  f1[n4] = 4;
+  f1[n1] = 1;
+  f1[n3] = 3;
+  f2[n5] = 0.5;
+  f2[n2] = 2;
+  f2[n3] = 1;
+  f1 += f2;
+  BOOST_CHECK_EQUAL(f1.size(), 5);
+  BOOST_CHECK_CLOSE((FValue)f1[n1], 1, TOL);
+  BOOST_CHECK_CLOSE((FValue)f1[n2], 2, TOL);
+  BOOST_CHECK_CLOSE((FValue)f1[n3], 4, TOL);
+  BOOST_CHECK_CLOSE((FValue)f1[n4], 4, TOL);
+  BOOST_CHECK_CLOSE((FValue)f1[FName("m_5")], 0.5, TOL);
+  for (FVector::const_iterator i = f1.cbegin(); i + 1 < f1.cend(); ++i)
+    BOOST_CHECK(i->first < (i + 1)->first);
+
+  f1 -= f2;
+  BOOST_CHECK_EQUAL(f1.size(), 5);
+  BOOST_CHECK_CLOSE((FValue)f1[n3], 3, TOL);
+  BOOST_CHECK_CLOSE((FValue)f1[n5], 0, TOL);
+  BOOST_CHECK_CLOSE(inner_product(f1, f2), 3, TOL);
+}
+
+BOOST_AUTO_TEST_CASE(register_names)
+{
+  vector<string> names;
+  names.push_back("x");
+  names.push_back("y");
+  vector<FName> fnames;
+  FName::Register("reg", names, fnames);
+  BOOST_CHECK_EQUAL(fnames.size(), 2);
+  BOOST_CHECK_EQUAL(fnames[0], FName("reg_x"));
+  BOOST_CHECK_EQUAL(fnames[1].name(), "reg_y");
+  BOOST_CHECK_EQUAL(FName::FromId(fnames[1].id()), fnames[1]);
+  BOOST_CHECK(FName::NumRegistered() >= 2);
+}
+
+#ifdef WITH_THREADS
+namespace
+{
+void InternNames(vector<size_t>* ids)
+{
+  for (size_t i = 0; i < ids->size(); ++i) {
+    util::StringStream name;
+    name << "concurrent" << i;
+    (*ids)[i] = FName(name.str()).id();
+  }
+}
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_names)
+{
+  const size_t threads = 4;
+  vector<vector<size_t> > ids(threads, vector<size_t>(1000));
+  boost::thread_group group;
+  for (size_t t = 0; t < threads; ++t)
+    group.create_thread(boost::bind(&InternNames, &ids[t]));
+  group.join_all();
+  for (size_t t = 1; t < threads; ++t)
+    BOOST_CHECK(ids[t] == ids[0]);
+  BOOST_CHECK_EQUAL(FName::FromId(ids[0][7]).name(), "concurrent7");
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,129 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "TranslationModel/fuzzy-match/FuzzyMatchIndex.h"
+
+using namespace tmmt;
+using namespace std;
+
+namespace
+{
+
+template <class Sequence>
+unsigned int Reference(const Sequence &a, const Sequence &b)
+{
+  vector<unsigned int> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); ++j) row[j] = j;
+  for (size_t i = 1; i <= a.size(); ++i) {
+    unsigned int diag = row[0];
+    row[0] = i;
+    for (size_t j = 1; j <= b.size(); ++j) {
+      unsigned int up = row[j];
+      row[j] = min(min(row[j] + 1, row[j - 1] + 1), diag + (a[i - 1] == b[j - 1] ? 0 : 1));
+      diag = up;
+    }
+  }
+  return row[b.size()];
+}
+
+// small alphabet, so that sequences have plenty in common
+vector<WORD_ID> Sentence(unsigned int &seed, size_t length)
+{
+  vector<WORD_ID> ret(length);
+  for (size_t i = 0; i < length; ++i) {
+    seed = seed * 1103515245 + 12345;
+    ret[i] = (seed >> 16) % 5;
+  }
+  return ret;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(fuzzy_match_index)
+
+BOOST_AUTO_TEST_CASE(distance_matches_reference)
+{
+  unsigned int seed = 1;
+  const size_t lengths[] = {0, 1, 5, 63, 64, 65, 130, 200};
+  for (size_t a = 0; a < 8; ++a) {
+    for (size_t b = 0; b < 8; ++b) {
+      vector<WORD_ID> x = Sentence(seed, lengths[a]), y = Sentence(seed, lengths[b]);
+      unsigned int expected = Reference(x, y);
+      BOOST_CHECK_EQUAL(FuzzyMatchIndex::Distance(x, y, 1000), expected);
+      // beyond the bound, the exact value does not matter
+      if (expected > 0) {
+        BOOST_CHECK_EQUAL(FuzzyMatchIndex::Distance(x, y, expected - 1), expected);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(letters)
+{
+  BOOST_CHECK_EQUAL(FuzzyMatchIndex::Distance(string("their"), string("there"), 10), 2);
+  BOOST_CHECK_EQUAL(FuzzyMatchIndex::Distance(string(""), string("mat"), 10), 3);
+  string longer(100, 'a'), other(100, 'a');
+  other[3] = 'b';
+  other[90] = 'c';
+  BOOST_CHECK_EQUAL(FuzzyMatchIndex::Distance(longer, other, 10), 2);
+  BOOST_CHECK_EQUAL(FuzzyMatchIndex::Distance(longer, other, 1), 2);
+}
+
+BOOST_AUTO_TEST_CASE(find_best_matches_brute_force)
+{
+  unsigned int seed = 7;
+  vector< vector<WORD_ID> > corpus;
+  for (size_t i = 0; i < 500; ++i) {
+    corpus.push_back(Sentence(seed, 1 + i % 12));
+  }
+  FuzzyMatchIndex index(corpus);
+
+  for (size_t threads = 1; threads <= 3; threads += 2) {
+    index.SetThreads(threads);
+    for (size_t i = 0; i < 100; ++i) {
+      vector<WORD_ID> input = Sentence(seed, 1 + i % 10);
+      unsigned int maxCost = input.size() * 30 / 100 + 1;
+
+      unsigned int bestCost = maxCost + 1;
+      vector<size_t> expected;
+      for (size_t s = 0; s < corpus.size(); ++s) {
+        unsigned int cost = Reference(input, corpus[s]);
+        if (cost < bestCost) {
+          bestCost = cost;
+          expected.clear();
+        }
+        if (cost == bestCost && cost <= maxCost) {
+          expected.push_back(s);
+        }
+      }
+
+      vector<size_t> best;
+      BOOST_CHECK_EQUAL(index.FindBest(input, maxCost, best), bestCost);
+      BOOST_CHECK(best == expected);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -187,6 +187,22 @@ EvaluateWhenApplied(float estimatedScore)
   if (m_prevHypo) m_futureScore += m_prevHypo->GetScore();
 }
 
+void
+Hypothesis::
+PrefetchWhenApplied() const
+{
+  const StaticData &staticData = StaticData::Instance();
+  const vector<const StatefulFeatureFunction*>& ffs =
+    StatefulFeatureFunction::GetStatefulFeatureFunctions();
+  for (unsigned i = 0; i < ffs.size(); ++i) {
+    const StatefulFeatureFunction &ff = *ffs[i];
+    if(!staticData.IsFeatureFunctionIgnored(ff)) {
+      FFState const* s = m_prevHypo ? m_prevHypo->m_ffStates[i] : NULL;
+      ff.PrefetchWhenApplied(*this, s);
+    }
+  }
+}
+
 const Hypothesis* Hypothesis::GetPrevHypo()const
 {
   return m_prevHypo;
@@ -36,6 +36,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "ScoreComponentCollection.h"
 #include "InputType.h"
 #include "ObjectPool.h"
+#include "DecodeArena.h"
 #include "xmlrpc-c.h"
 
 namespace Moses
@@ -92,6 +93,14 @@ public:
   Hypothesis(const Hypothesis &prevHypo, const TranslationOption &transOpt, const Bitmap &bitmap, int id);
   ~Hypothesis();
 
+  //! allocated from the worker's DecodeArena
+  static void *operator new(size_t size) {
+    return DecodeArena::Allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    DecodeArena::Free(p, size);
+  }
+
   void PrintHypothesis() const;
 
   const InputType& GetInput() const {
@@ -122,6 +131,10 @@ public:
 
   void EvaluateWhenApplied(float estimatedScore);
 
+  /** Let stateful feature functions start loading what
+      EvaluateWhenApplied() will look up */
+  void PrefetchWhenApplied() const;
+
   int GetId()const {
     return m_id;
   }
@@ -246,6 +246,77 @@ ReadInput(boost::shared_ptr<std::vector<std::string> >* cw)
   return source;
 }
 
+namespace
+{
+bool IsDocumentStart(std::string const& line)
+{
+  size_t i = line.find_first_not_of(" \t");
+  return (i != std::string::npos && line.compare(i, 4, "<doc") == 0
+          && (line.size() == i + 4 || line[i+4] == '>' || line[i+4] == ' '));
+}
+
+bool IsDocumentEnd(std::string const& line)
+{
+  size_t i = line.find_first_not_of(" \t");
+  return i != std::string::npos && line.compare(i, 6, "</doc>") == 0;
+}
+
+// value of attribute name="..." of a <doc ...> line, empty if not given
+std::string GetDocumentAttribute(std::string const& line, std::string const& name)
+{
+  std::string const key = " " + name + "=\"";
+  size_t start = line.find(key);
+  if (start == std::string::npos) return "";
+  start += key.size();
+  size_t end = line.find('"', start);
+  if (end == std::string::npos) return "";
+  return line.substr(start, end - start);
+}
+}
+
+bool
+IOWrapper::
+ReadDocument(std::vector<boost::shared_ptr<InputType> >& doc,
+             std::string& contextWeights)
+{
+#ifdef WITH_THREADS
+  boost::lock_guard<boost::mutex> lock(m_lock);
+#endif
+  UTIL_THROW_IF2(m_inputType != SentenceInput
+                 && m_inputType != TabbedSentenceInput,
+                 "document-input requires plain or tabbed sentence input");
+  doc.clear();
+  contextWeights = m_openDocuments.empty() ? "" : m_openDocuments.back();
+  std::string line;
+  while (getline(*m_inputStream, line)) {
+    if (IsDocumentStart(line)) {
+      // a nested document ends the enclosing one's sentences so far, and
+      // uses its context weights unless it has its own
+      std::string weights = GetDocumentAttribute(line, "context-weights");
+      if (weights.empty() && !m_openDocuments.empty())
+        weights = m_openDocuments.back();
+      m_openDocuments.push_back(weights);
+      if (doc.size()) return true;
+      contextWeights = weights;
+      continue;
+    }
+    if (IsDocumentEnd(line)) {
+      if (!m_openDocuments.empty()) m_openDocuments.pop_back();
+      if (doc.size()) return true;
+      contextWeights = m_openDocuments.empty() ? "" : m_openDocuments.back();
+      continue;
+    }
+    boost::shared_ptr<InputType> source
+    = (m_inputType == SentenceInput
+       ? ParseLine<Sentence>(line) : ParseLine<TabbedSentence>(line));
+    if (!source) break;
+    source->SetTranslationId(m_currentLine++);
+    doc.push_back(source);
+    if (m_openDocuments.empty()) return true;
+  }
+  return doc.size() > 0;
+}
+
 boost::shared_ptr<std::vector<std::string> >
 IOWrapper::
 GetCurrentContextWindow() const
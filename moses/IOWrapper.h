@@ -121,6 +121,7 @@ protected:
   size_t m_look_ahead; /// for context-sensitive decoding: # of wrds to look ahead
   size_t m_look_back;  /// for context-sensitive decoding: # of wrds to look back
   size_t m_buffered_ahead; /// number of words buffered ahead
+  std::vector<std::string> m_openDocuments; /// document-input: context weights of the open <doc>s, innermost last
   // For context-sensitive decoding:
   // Number of context words ahead and before the current sentence.
 
@@ -135,6 +136,16 @@ public:
   boost::shared_ptr<InputType>
   ReadInput(boost::shared_ptr<std::vector<std::string> >* cw = NULL);
 
+  // document-input: read the sentences between the next <doc ...> and
+  // </doc> lines (or a single sentence outside of any document). Marker
+  // lines are consumed and do not get a translation id. A nested <doc>
+  // starts a new document, and the enclosing one goes on after its
+  // </doc>. contextWeights is the context-weights="..." attribute of the
+  // innermost <doc> line that has one, if any.
+  bool
+  ReadDocument(std::vector<boost::shared_ptr<InputType> >& doc,
+               std::string& contextWeights);
+
   Moses::OutputCollector *GetSingleBestOutputCollector() {
     return m_singleBestOutputCollector.get();
   }
@@ -207,6 +218,10 @@ private:
   boost::shared_ptr<InputType>
   BufferInput();
 
+  template<class itype>
+  boost::shared_ptr<InputType>
+  ParseLine(std::string const& line);
+
   boost::shared_ptr<InputType>
   GetBufferedInput();
 
@@ -241,6 +256,16 @@ BufferInput()
   return ret;
 }
 
+template<class itype>
+boost::shared_ptr<InputType>
+IOWrapper::
+ParseLine(std::string const& line)
+{
+  boost::shared_ptr<InputType> ret(new itype(m_options));
+  std::istringstream in(line + "\n");
+  if (!ret->Read(in)) ret.reset();
+  return ret;
+}
 
 }
 
@@ -189,34 +189,59 @@ size_t BilingualLM::getState(const Hypothesis& cur_hypo) const
   return hashCode;
 }
 
-FFState* BilingualLM::EvaluateWhenApplied(
+void BilingualLM::getNgrams(
   const Hypothesis& cur_hypo,
-  const FFState* prev_state,
-  ScoreComponentCollection* accumulator) const
+  std::vector<std::vector<int> > &source_words,
+  std::vector<std::vector<int> > &target_words) const
 {
   Manager& manager = cur_hypo.GetManager();
   const Sentence& source_sent = static_cast<const Sentence&>(manager.GetSource());
 
-  // Init vectors.
-  std::vector<int> source_words;
-  source_words.reserve(source_ngrams);
-  std::vector<int> target_words;
-  target_words.reserve(target_ngrams);
-
-  float value = 0;
   const TargetPhrase& currTargetPhrase = cur_hypo.GetCurrTargetPhrase();
   const Range& sourceWordRange = cur_hypo.GetCurrSourceWordsRange(); //Source words range to calculate offsets
 
-  // For each word in the current target phrase get its LM score.
+  source_words.assign(currTargetPhrase.GetSize(), std::vector<int>());
+  target_words.assign(currTargetPhrase.GetSize(), std::vector<int>());
   for (int i = 0; i < currTargetPhrase.GetSize(); i++) {
+    source_words[i].reserve(source_ngrams + target_ngrams + 1);
+    target_words[i].reserve(target_ngrams + 1);
     getSourceWords(
-      currTargetPhrase, i, source_sent, sourceWordRange, source_words);
-    getTargetWords(cur_hypo, currTargetPhrase, i, target_words);
-    value += Score(source_words, target_words);
+      currTargetPhrase, i, source_sent, sourceWordRange, source_words[i]);
+    getTargetWords(cur_hypo, currTargetPhrase, i, target_words[i]);
+  }
+}
 
-    // Clear the vectors.
-    source_words.clear();
-    target_words.clear();
+void BilingualLM::PrefetchWhenApplied(
+  const Hypothesis& cur_hypo,
+  const FFState* prev_state) const
+{
+  std::vector<std::vector<int> > source_words, target_words;
+  getNgrams(cur_hypo, source_words, target_words);
+  for (size_t i = 0; i < source_words.size(); i++) {
+    PrefetchNgram(source_words[i], target_words[i]);
+  }
+  MarkPrefetched(cur_hypo);
+}
+
+FFState* BilingualLM::EvaluateWhenApplied(
+  const Hypothesis& cur_hypo,
+  const FFState* prev_state,
+  ScoreComponentCollection* accumulator) const
+{
+  std::vector<std::vector<int> > source_words, target_words;
+  getNgrams(cur_hypo, source_words, target_words);
+
+  // Let the model compute the n-grams of the phrase together, unless they
+  // were queued by PrefetchWhenApplied() already, then get the LM score of
+  // each word in the current target phrase.
+  if (!TakePrefetched(cur_hypo)) {
+    for (size_t i = 0; i < source_words.size(); i++) {
+      PrefetchNgram(source_words[i], target_words[i]);
+    }
+  }
+  float value = 0;
+  for (size_t i = 0; i < source_words.size(); i++) {
+    value += Score(source_words[i], target_words[i]);
   }
 
   size_t new_state = getState(cur_hypo);
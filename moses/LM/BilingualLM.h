@@ -52,6 +52,17 @@ class BilingualLM : public StatefulFeatureFunction
 private:
   virtual float Score(std::vector<int>& source_words, std::vector<int>& target_words) const = 0;
 
+  //! Hint that the n-gram is going to be scored soon; does nothing by default.
+  virtual void PrefetchNgram(std::vector<int>& source_words, std::vector<int>& target_words) const {}
+
+  //! Remember that the n-grams of hypo were prefetched; does nothing by default.
+  virtual void MarkPrefetched(const Hypothesis& hypo) const {}
+
+  //! Whether MarkPrefetched(hypo) was called; forgets hypo.
+  virtual bool TakePrefetched(const Hypothesis& hypo) const {
+    return false;
+  }
+
   virtual int getNeuralLMId(const Word& word, bool is_source_word) const = 0;
 
   virtual void loadModel() = 0;
@@ -77,6 +88,12 @@ private:
 
   size_t getState(const Hypothesis &cur_hypo) const;
 
+  //! The source and target words of every n-gram the hypothesis adds.
+  void getNgrams(
+    const Hypothesis &cur_hypo,
+    std::vector<std::vector<int> > &source_words,
+    std::vector<std::vector<int> > &target_words) const;
+
   void requestPrevTargetNgrams(const Hypothesis &cur_hypo, int amount, std::vector<int> &words) const;
 
   //Chart decoder
@@ -119,6 +136,10 @@ public:
 
   void Load(AllOptions::ptr const& opts);
 
+  void PrefetchWhenApplied(
+    const Hypothesis& cur_hypo,
+    const FFState* prev_state) const;
+
   FFState* EvaluateWhenApplied(
     const Hypothesis& cur_hypo,
     const FFState* prev_state,
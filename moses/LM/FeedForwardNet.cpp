@@ -0,0 +1,582 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width:2  -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "FeedForwardNet.h"
+#include "moses/InputFileStream.h"
+#include "moses/Util.h"
+#include "util/exception.hh"
+#include "util/murmur_hash.hh"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FFNET_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+// n-grams scored together; bounds the size of the scratch matrices
+const size_t kBlock = 64;
+
+/* Kernels: the dot products of one weight row with four input vectors. Four
+ * inputs share each load of the weights. The AVX2 versions are picked at run
+ * time so that the same binary still runs on older CPUs.
+ */
+typedef void (*FloatKernel)(const float *w, const float *const *in, size_t n, float *out);
+typedef void (*ByteKernel)(const boost::int8_t *w, const float *const *in, size_t n, float *out);
+
+template <class Weight> void Dot4(const Weight *w, const float *const *in, size_t n, float *out)
+{
+  float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (size_t i = 0; i < n; ++i) {
+    float x = static_cast<float>(w[i]);
+    s0 += x * in[0][i];
+    s1 += x * in[1][i];
+    s2 += x * in[2][i];
+    s3 += x * in[3][i];
+  }
+  out[0] = s0;
+  out[1] = s1;
+  out[2] = s2;
+  out[3] = s3;
+}
+
+#ifdef FFNET_X86
+__attribute__((target("avx2,fma"))) inline float HorizontalSum(__m256 v)
+{
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) void Dot4FloatAVX2(const float *w, const float *const *in, size_t n, float *out)
+{
+  __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_loadu_ps(w + i);
+    a0 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[0] + i), a0);
+    a1 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[1] + i), a1);
+    a2 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[2] + i), a2);
+    a3 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[3] + i), a3);
+  }
+  float tail[4];
+  const float *rest[4] = {in[0] + i, in[1] + i, in[2] + i, in[3] + i};
+  Dot4(w + i, rest, n - i, tail);
+  out[0] = HorizontalSum(a0) + tail[0];
+  out[1] = HorizontalSum(a1) + tail[1];
+  out[2] = HorizontalSum(a2) + tail[2];
+  out[3] = HorizontalSum(a3) + tail[3];
+}
+
+__attribute__((target("avx2,fma"))) void Dot4ByteAVX2(const boost::int8_t *w, const float *const *in, size_t n, float *out)
+{
+  __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w + i));
+    __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+    a0 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[0] + i), a0);
+    a1 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[1] + i), a1);
+    a2 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[2] + i), a2);
+    a3 = _mm256_fmadd_ps(x, _mm256_loadu_ps(in[3] + i), a3);
+  }
+  float tail[4];
+  const float *rest[4] = {in[0] + i, in[1] + i, in[2] + i, in[3] + i};
+  Dot4(w + i, rest, n - i, tail);
+  out[0] = HorizontalSum(a0) + tail[0];
+  out[1] = HorizontalSum(a1) + tail[1];
+  out[2] = HorizontalSum(a2) + tail[2];
+  out[3] = HorizontalSum(a3) + tail[3];
+}
+
+bool HasAVX2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+const bool kAVX2 = HasAVX2();
+const FloatKernel kFloatKernel = kAVX2 ? &Dot4FloatAVX2 : &Dot4<float>;
+const ByteKernel kByteKernel = kAVX2 ? &Dot4ByteAVX2 : &Dot4<boost::int8_t>;
+#else
+const FloatKernel kFloatKernel = &Dot4<float>;
+const ByteKernel kByteKernel = &Dot4<boost::int8_t>;
+#endif
+
+// Dot products of row r with inputs in[0..3], scaled and without the bias.
+inline void RowTimes4(const FeedForwardNet::Layer &layer, size_t r, const float *const *in, float *out)
+{
+  if (layer.quantized.empty()) {
+    kFloatKernel(&layer.weights[r * layer.cols], in, layer.cols, out);
+  } else {
+    kByteKernel(&layer.quantized[r * layer.cols], in, layer.cols, out);
+    for (size_t k = 0; k < 4; ++k) out[k] *= layer.scales[r];
+  }
+}
+
+/* out (count x rows) = in (count x cols) times the transposed weights, plus
+ * the biases. Rows are the outer loop so that each weight row is loaded once
+ * per block of inputs.
+ */
+void Multiply(const FeedForwardNet::Layer &layer, const float *in, size_t count, float *out)
+{
+  for (size_t start = 0; start < count; start += kBlock) {
+    size_t end = std::min(count, start + kBlock);
+    for (size_t r = 0; r < layer.rows; ++r) {
+      for (size_t b = start; b < end; b += 4) {
+        const float *inputs[4];
+        for (size_t k = 0; k < 4; ++k) {
+          inputs[k] = in + std::min(b + k, end - 1) * layer.cols;
+        }
+        float dots[4];
+        RowTimes4(layer, r, inputs, dots);
+        for (size_t k = 0; k < 4 && b + k < end; ++k) {
+          out[(b + k) * layer.rows + r] = dots[k] + layer.biases[r];
+        }
+      }
+    }
+  }
+}
+
+// to += row r of the layer
+inline void AddRow(const FeedForwardNet::Layer &layer, size_t r, float *to)
+{
+  if (layer.quantized.empty()) {
+    const float *from = &layer.weights[r * layer.cols];
+    for (size_t i = 0; i < layer.cols; ++i) to[i] += from[i];
+  } else {
+    const boost::int8_t *from = &layer.quantized[r * layer.cols];
+    const float scale = layer.scales[r];
+    for (size_t i = 0; i < layer.cols; ++i) to[i] += scale * from[i];
+  }
+}
+
+void ReadValues(istream &in, size_t count, vector<float> &to, const string &section)
+{
+  to.resize(count);
+  size_t read = 0;
+  string line;
+  while (read < count && getline(in, line)) {
+    const char *pos = line.c_str();
+    char *end;
+    for (float value = strtof(pos, &end); end != pos; value = strtof(pos, &end)) {
+      UTIL_THROW_IF2(read == count, "Too many values in " << section);
+      to[read++] = value;
+      pos = end;
+    }
+  }
+  UTIL_THROW_IF2(read < count, "Expected " << count << " values in " << section << " but found " << read);
+}
+
+void ReadWords(istream &in, vector<string> &words)
+{
+  words.clear();
+  string line;
+  while (getline(in, line)) {
+    line = Trim(line);
+    if (line.empty()) break;
+    words.push_back(line);
+  }
+}
+
+void Index(const vector<string> &words, boost::unordered_map<string, int> &ids, int &unk)
+{
+  ids.clear();
+  for (size_t i = 0; i < words.size(); ++i) {
+    ids[words[i]] = i;
+  }
+  // as in NPLM, a vocabulary without <unk> maps unknown words to 0
+  boost::unordered_map<string, int>::const_iterator found = ids.find("<unk>");
+  unk = found == ids.end() ? 0 : found->second;
+}
+
+}
+
+void FeedForwardNet::Layer::Quantize()
+{
+  if (weights.empty()) return;
+  quantized.resize(weights.size());
+  scales.resize(rows);
+  for (size_t r = 0; r < rows; ++r) {
+    const float *row = &weights[r * cols];
+    float largest = 0;
+    for (size_t i = 0; i < cols; ++i) largest = std::max(largest, std::fabs(row[i]));
+    scales[r] = largest / 127;
+    for (size_t i = 0; i < cols; ++i) {
+      quantized[r * cols + i] = largest == 0 ? 0 : static_cast<boost::int8_t>(floor(row[i] / scales[r] + 0.5));
+    }
+  }
+  vector<float>().swap(weights);
+}
+
+FeedForwardNet::FeedForwardNet()
+  : m_order(0)
+  , m_inputDim(0)
+  , m_hidden(0)
+  , m_outputDim(0)
+  , m_activation(Rectifier)
+  , m_normalize(false)
+  , m_inputUnk(0)
+  , m_outputUnk(0)
+  , m_premultiplied(false)
+  , m_runs(0)
+  , m_cacheMask(0)
+{
+}
+
+void FeedForwardNet::ReadConfig(istream &in)
+{
+  size_t inputVocab = 0, outputVocab = 0;
+  string line;
+  while (getline(in, line)) {
+    vector<string> toks = Tokenize(line);
+    if (toks.empty()) break;
+    UTIL_THROW_IF2(toks.size() != 2, "Bad configuration line in neural network: " << line);
+    const string &key = toks[0], &value = toks[1];
+    if (key == "ngram_size") {
+      m_order = Scan<int>(value);
+    } else if (key == "vocab_size") {
+      inputVocab = outputVocab = Scan<size_t>(value);
+    } else if (key == "input_vocab_size") {
+      inputVocab = Scan<size_t>(value);
+    } else if (key == "output_vocab_size") {
+      outputVocab = Scan<size_t>(value);
+    } else if (key == "input_embedding_dimension") {
+      m_inputDim = Scan<size_t>(value);
+    } else if (key == "num_hidden") {
+      m_hidden = Scan<size_t>(value);
+    } else if (key == "output_embedding_dimension") {
+      m_outputDim = Scan<size_t>(value);
+    } else if (key == "activation_function") {
+      if (value == "identity") m_activation = Identity;
+      else if (value == "rectifier") m_activation = Rectifier;
+      else if (value == "tanh") m_activation = Tanh;
+      else if (value == "hardtanh") m_activation = HardTanh;
+      else UTIL_THROW2("Unknown activation function in neural network: " << value);
+    }
+  }
+  UTIL_THROW_IF2(m_order < 2 || !inputVocab || !outputVocab || !m_inputDim || !m_outputDim,
+                 "Incomplete neural network configuration");
+
+  m_inputWords.resize(inputVocab);
+  m_outputWords.resize(outputVocab);
+  m_embeddings.resize(inputVocab * m_inputDim);
+
+  // With num_hidden 0 the first layer produces the output embedding.
+  m_first.rows = m_hidden ? m_hidden : m_outputDim;
+  m_first.cols = (m_order - 1) * m_inputDim;
+  m_second.rows = m_hidden ? m_outputDim : 0;
+  m_second.cols = m_hidden;
+  m_output.rows = outputVocab;
+  m_output.cols = m_outputDim;
+}
+
+void FeedForwardNet::Load(const string &path)
+{
+  InputFileStream in(path);
+  size_t inputVocab = 0, outputVocab = 0;
+  bool ended = false;
+  string line;
+  while (!ended && getline(in, line)) {
+    line = Trim(line);
+    if (line.empty()) {
+      continue;
+    } else if (line == "\\config") {
+      ReadConfig(in);
+      inputVocab = m_inputWords.size();
+      outputVocab = m_outputWords.size();
+      continue;
+    }
+    UTIL_THROW_IF2(!m_order, "Neural network " << path << " does not start with \\config");
+    if (line == "\\vocab") {
+      ReadWords(in, m_inputWords);
+      m_outputWords = m_inputWords;
+    } else if (line == "\\input_vocab") {
+      ReadWords(in, m_inputWords);
+    } else if (line == "\\output_vocab") {
+      ReadWords(in, m_outputWords);
+    } else if (line == "\\input_embeddings") {
+      ReadValues(in, m_embeddings.size(), m_embeddings, line);
+    } else if (line == "\\hidden_weights 1") {
+      ReadValues(in, m_first.rows * m_first.cols, m_first.weights, line);
+    } else if (line == "\\hidden_biases 1") {
+      ReadValues(in, m_first.rows, m_first.biases, line);
+    } else if (line == "\\hidden_weights 2") {
+      ReadValues(in, m_second.rows * m_second.cols, m_second.weights, line);
+    } else if (line == "\\hidden_biases 2") {
+      ReadValues(in, m_second.rows, m_second.biases, line);
+    } else if (line == "\\output_weights") {
+      ReadValues(in, m_output.rows * m_output.cols, m_output.weights, line);
+    } else if (line == "\\output_biases") {
+      ReadValues(in, m_output.rows, m_output.biases, line);
+    } else if (line == "\\end") {
+      ended = true;
+    } else {
+      UTIL_THROW2("Unknown section in neural network " << path << ": " << line);
+    }
+  }
+  UTIL_THROW_IF2(!ended, "Neural network " << path << " is truncated");
+  UTIL_THROW_IF2(m_inputWords.size() != inputVocab || m_outputWords.size() != outputVocab,
+                 "Vocabulary size of neural network " << path << " does not match its configuration");
+  UTIL_THROW_IF2(m_first.biases.empty() || m_output.biases.empty() || (m_second.rows && m_second.biases.empty()),
+                 "Neural network " << path << " is missing weights");
+
+  Index(m_inputWords, m_inputIds, m_inputUnk);
+  Index(m_outputWords, m_outputIds, m_outputUnk);
+}
+
+void FeedForwardNet::Premultiply()
+{
+  if (m_premultiplied) return;
+  UTIL_THROW_IF2(!m_first.quantized.empty(), "Premultiply the neural network before quantizing it");
+  const size_t vocab = m_inputWords.size(), context = m_order - 1;
+  Layer table;
+  table.rows = context * vocab;
+  table.cols = m_first.rows;
+  table.weights.resize(table.rows * table.cols);
+  table.biases = m_first.biases;
+
+  // the block of the first layer that applies to one context position
+  Layer block;
+  block.rows = m_first.rows;
+  block.cols = m_inputDim;
+  block.weights.resize(block.rows * block.cols);
+  block.biases.assign(block.rows, 0);
+  for (size_t pos = 0; pos < context; ++pos) {
+    for (size_t r = 0; r < block.rows; ++r) {
+      const float *from = &m_first.weights[r * m_first.cols + pos * m_inputDim];
+      std::copy(from, from + m_inputDim, &block.weights[r * block.cols]);
+    }
+    Multiply(block, &m_embeddings[0], vocab, &table.weights[pos * vocab * table.cols]);
+  }
+  std::swap(m_first, table);
+  vector<float>().swap(m_embeddings);
+  m_premultiplied = true;
+}
+
+void FeedForwardNet::Quantize()
+{
+  m_first.Quantize();
+  m_second.Quantize();
+  m_output.Quantize();
+}
+
+void FeedForwardNet::SetCache(size_t entries)
+{
+  if (!entries) {
+    m_cache.reset();
+    m_cacheMask = 0;
+    return;
+  }
+  size_t size = 1;
+  while (size < entries) size <<= 1;
+  m_cache.reset(new boost::atomic<boost::uint64_t>[size]);
+  for (size_t i = 0; i < size; ++i) {
+    m_cache[i].store(0, boost::memory_order_relaxed);
+  }
+  m_cacheMask = size - 1;
+}
+
+int FeedForwardNet::LookupInputWord(const string &word) const
+{
+  boost::unordered_map<string, int>::const_iterator found = m_inputIds.find(word);
+  return found == m_inputIds.end() ? m_inputUnk : found->second;
+}
+
+int FeedForwardNet::LookupOutputWord(const string &word) const
+{
+  boost::unordered_map<string, int>::const_iterator found = m_outputIds.find(word);
+  return found == m_outputIds.end() ? m_outputUnk : found->second;
+}
+
+/* A cache entry packs 32 bits of the hash, which are not used to choose the
+ * slot, with the bits of the score, so it can be read and written in one
+ * atomic operation. The check bits are never 0, which marks an empty slot.
+ */
+boost::uint64_t FeedForwardNet::Hash(const int *ngram) const
+{
+  return util::MurmurHashNative(ngram, m_order * sizeof(int));
+}
+
+bool FeedForwardNet::FindCached(boost::uint64_t hash, float &score) const
+{
+  if (!m_cache) return false;
+  boost::uint64_t entry = m_cache[hash & m_cacheMask].load(boost::memory_order_relaxed);
+  boost::uint32_t check = static_cast<boost::uint32_t>(hash >> 32) | 1;
+  if (static_cast<boost::uint32_t>(entry >> 32) != check) return false;
+  boost::uint32_t bits = static_cast<boost::uint32_t>(entry);
+  std::memcpy(&score, &bits, sizeof(float));
+  return true;
+}
+
+void FeedForwardNet::Cache(boost::uint64_t hash, float score) const
+{
+  if (!m_cache) return;
+  boost::uint32_t bits;
+  std::memcpy(&bits, &score, sizeof(float));
+  boost::uint64_t check = static_cast<boost::uint32_t>(hash >> 32) | 1;
+  m_cache[hash & m_cacheMask].store((check << 32) | bits, boost::memory_order_relaxed);
+}
+
+float FeedForwardNet::Score(const int *ngram) const
+{
+  float score;
+  boost::uint64_t hash = Hash(ngram);
+  if (FindCached(hash, score)) return score;
+  Compute(ngram, 1, &score);
+  Cache(hash, score);
+  return score;
+}
+
+void FeedForwardNet::Score(const int *ngrams, size_t count, float *out) const
+{
+  vector<int> missing;
+  vector<size_t> where;
+  vector<boost::uint64_t> hashes;
+  for (size_t i = 0; i < count; ++i) {
+    const int *ngram = ngrams + i * m_order;
+    boost::uint64_t hash = Hash(ngram);
+    if (!FindCached(hash, out[i])) {
+      missing.insert(missing.end(), ngram, ngram + m_order);
+      where.push_back(i);
+      hashes.push_back(hash);
+    }
+  }
+  if (where.empty()) return;
+  vector<float> scores(where.size());
+  Compute(&missing[0], where.size(), &scores[0]);
+  for (size_t i = 0; i < where.size(); ++i) {
+    out[where[i]] = scores[i];
+    Cache(hashes[i], scores[i]);
+  }
+}
+
+void FeedForwardNet::Activate(vector<float> &values) const
+{
+  switch (m_activation) {
+  case Identity:
+    break;
+  case Rectifier:
+    for (size_t i = 0; i < values.size(); ++i) values[i] = std::max(values[i], 0.0f);
+    break;
+  case Tanh:
+    for (size_t i = 0; i < values.size(); ++i) values[i] = std::tanh(values[i]);
+    break;
+  case HardTanh:
+    for (size_t i = 0; i < values.size(); ++i) values[i] = std::min(1.0f, std::max(-1.0f, values[i]));
+    break;
+  }
+}
+
+void FeedForwardNet::Compute(const int *ngrams, size_t count, float *out) const
+{
+  m_runs.fetch_add(1, boost::memory_order_relaxed);
+  const size_t context = m_order - 1;
+  const size_t width = m_premultiplied ? m_first.cols : m_first.rows;
+  vector<float> embedded, first, second, logits;
+  for (size_t start = 0; start < count; start += kBlock) {
+    const size_t block = std::min(kBlock, count - start);
+    const int *ngram = ngrams + start * m_order;
+
+    // first hidden layer
+    first.resize(block * width);
+    if (m_premultiplied) {
+      for (size_t b = 0; b < block; ++b) {
+        float *to = &first[b * width];
+        std::copy(m_first.biases.begin(), m_first.biases.end(), to);
+        for (size_t pos = 0; pos < context; ++pos) {
+          AddRow(m_first, pos * m_inputWords.size() + ngram[b * m_order + pos], to);
+        }
+      }
+    } else {
+      embedded.resize(block * m_first.cols);
+      for (size_t b = 0; b < block; ++b) {
+        for (size_t pos = 0; pos < context; ++pos) {
+          const float *from = &m_embeddings[ngram[b * m_order + pos] * m_inputDim];
+          std::copy(from, from + m_inputDim, &embedded[(b * context + pos) * m_inputDim]);
+        }
+      }
+      Multiply(m_first, &embedded[0], block, &first[0]);
+    }
+    Activate(first);
+
+    // second hidden layer
+    const float *hidden = &first[0];
+    if (m_second.rows) {
+      second.resize(block * m_second.rows);
+      Multiply(m_second, &first[0], block, &second[0]);
+      Activate(second);
+      hidden = &second[0];
+    }
+
+    // output layer; normalizing needs every output row, which is then read
+    // once for the whole block
+    if (m_normalize) {
+      logits.resize(block * m_output.rows);
+      Multiply(m_output, hidden, block, &logits[0]);
+    }
+    for (size_t b = 0; b < block; ++b) {
+      const float *h = hidden + b * m_outputDim;
+      const size_t word = ngram[b * m_order + context];
+      if (m_normalize) {
+        const float *l = &logits[b * m_output.rows];
+        float largest = *std::max_element(l, l + m_output.rows);
+        double sum = 0;
+        for (size_t i = 0; i < m_output.rows; ++i) sum += std::exp(l[i] - largest);
+        out[start + b] = l[word] - largest - std::log(sum);
+      } else {
+        const float *same[4] = {h, h, h, h};
+        float dots[4];
+        RowTimes4(m_output, word, same, dots);
+        out[start + b] = dots[0] + m_output.biases[word];
+      }
+    }
+  }
+}
+
+void FeedForwardNet::Batch::Add(const int *ngram)
+{
+  float score;
+  if (!m_net.m_cache || m_net.FindCached(m_net.Hash(ngram), score)) return;
+  m_ngrams.insert(m_ngrams.end(), ngram, ngram + m_net.GetOrder());
+}
+
+void FeedForwardNet::Batch::Flush()
+{
+  if (m_ngrams.empty()) return;
+  const size_t count = m_ngrams.size() / m_net.GetOrder();
+  m_scores.resize(count);
+  m_net.Score(&m_ngrams[0], count, &m_scores[0]);
+  m_ngrams.clear();
+}
+
+}
@@ -0,0 +1,205 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width:2  -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#ifndef moses_FeedForwardNet_h
+#define moses_FeedForwardNet_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+namespace Moses
+{
+
+/** Inference for feed-forward n-gram networks in the text format written by
+ * NPLM (http://nlg.isi.edu/software/nplm/), as used by NeuralLM,
+ * BilingualNPLM and RDLM.
+ *
+ * An n-gram is n ints: n-1 context words from the input vocabulary followed
+ * by the predicted word from the output vocabulary. Its score is the natural
+ * log probability of the predicted word, or the unnormalized output score
+ * unless SetNormalization(true) was called, as in NPLM.
+ *
+ * After loading, the network is read-only and can be shared by all threads.
+ * Scores are remembered in a cache of fixed size that all threads share
+ * without locking; entries are overwritten by collisions, and are only
+ * trusted if 32 further bits of their hash match.
+ *
+ * Several n-grams are best scored together, either with Score(ngrams, count,
+ * out) or through a Batch: each weight matrix is then read once for the
+ * whole group instead of once per n-gram.
+ */
+class FeedForwardNet
+{
+public:
+  FeedForwardNet();
+
+  //! Read a network in NPLM text format (optionally compressed).
+  void Load(const std::string &path);
+
+  /** Precompute the product of the first hidden layer with the embedding of
+   * every input word at every context position, so that the first layer is
+   * a sum of n-1 table rows. Costs (n-1) x input vocabulary x hidden floats.
+   */
+  void Premultiply();
+
+  /** Store the weights as bytes with one scale per row. Quarters the memory
+   * read per n-gram, at the price of slightly different scores.
+   */
+  void Quantize();
+
+  void SetNormalization(bool normalize) {
+    m_normalize = normalize;
+  }
+
+  //! Number of entries in the score cache; 0 disables it.
+  void SetCache(std::size_t entries);
+
+  int GetOrder() const {
+    return m_order;
+  }
+
+  //! Returns the id of <unk> for unknown words.
+  int LookupInputWord(const std::string &word) const;
+  int LookupOutputWord(const std::string &word) const;
+
+  const std::vector<std::string> &GetInputWords() const {
+    return m_inputWords;
+  }
+  const std::vector<std::string> &GetOutputWords() const {
+    return m_outputWords;
+  }
+
+  float Score(const int *ngram) const;
+
+  float Score(const std::vector<int> &ngram) const {
+    return Score(&ngram[0]);
+  }
+
+  //! Score count n-grams stored one after the other in ngrams.
+  void Score(const int *ngrams, std::size_t count, float *out) const;
+
+  //! How often the network was run, each time on one or more n-grams.
+  std::size_t GetRuns() const {
+    return m_runs.load(boost::memory_order_relaxed);
+  }
+
+  /** Collects n-grams that are going to be scored soon and scores those not
+   * yet in the cache together, so that Score() finds them there. Not
+   * thread-safe; keep one per thread.
+   *
+   * Features queue the n-grams of a hypothesis when it is prefetched, and
+   * when it is evaluated only if it was not: MarkPrefetched() and
+   * TakePrefetched() keep track of which ones were.
+   */
+  class Batch
+  {
+  public:
+    explicit Batch(const FeedForwardNet &net) : m_net(net) {}
+
+    void Add(const int *ngram);
+
+    void Add(const std::vector<int> &ngram) {
+      Add(&ngram[0]);
+    }
+
+    void Flush();
+
+    //! Remember that the n-grams of owner (e.g. a hypothesis) were added.
+    void MarkPrefetched(const void *owner) {
+      m_prefetched.insert(owner);
+    }
+
+    //! Whether MarkPrefetched(owner) was called; forgets owner.
+    bool TakePrefetched(const void *owner) {
+      return m_prefetched.erase(owner) != 0;
+    }
+
+  private:
+    const FeedForwardNet &m_net;
+    std::vector<int> m_ngrams;
+    std::vector<float> m_scores;
+    boost::unordered_set<const void*> m_prefetched;
+  };
+
+  //! y = W x + b, with W either in floats or in bytes with a scale per row
+  struct Layer {
+    std::size_t rows, cols;
+    std::vector<float> weights;
+    std::vector<boost::int8_t> quantized;
+    std::vector<float> scales;
+    std::vector<float> biases;
+
+    Layer() : rows(0), cols(0) {}
+
+    void Quantize();
+  };
+
+private:
+  enum Activation {
+    Identity,
+    Rectifier,
+    Tanh,
+    HardTanh
+  };
+
+  void ReadConfig(std::istream &in);
+
+  void Activate(std::vector<float> &values) const;
+  void Compute(const int *ngrams, std::size_t count, float *out) const;
+
+  boost::uint64_t Hash(const int *ngram) const;
+  bool FindCached(boost::uint64_t hash, float &score) const;
+  void Cache(boost::uint64_t hash, float score) const;
+
+  int m_order;
+  std::size_t m_inputDim, m_hidden, m_outputDim;
+  Activation m_activation;
+  bool m_normalize;
+
+  std::vector<std::string> m_inputWords, m_outputWords;
+  boost::unordered_map<std::string, int> m_inputIds, m_outputIds;
+  int m_inputUnk, m_outputUnk;
+
+  // input vocabulary x input dimension
+  std::vector<float> m_embeddings;
+  // rows (n-1) x input vocabulary when premultiplied, otherwise the weights
+  // applied to the concatenated context embeddings
+  Layer m_first;
+  bool m_premultiplied;
+  // absent when the network has a single hidden layer (num_hidden 0)
+  Layer m_second;
+  Layer m_output;
+
+  mutable boost::atomic<std::size_t> m_runs;
+
+  std::size_t m_cacheMask;
+  boost::scoped_array<boost::atomic<boost::uint64_t> > m_cache;
+};
+
+}
+
+#endif
@@ -0,0 +1,219 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+#define BOOST_TEST_MODULE FeedForwardNetTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "moses/LM/FeedForwardNet.h"
+
+using namespace Moses;
+
+namespace
+{
+
+const int kOrder = 4;
+const char *kWords[] = {"<unk>", "<s>", "</s>", "the", "cat", "sat", "on", "mat"};
+const size_t kVocab = 8, kInput = 6, kHidden = 11, kOutput = 9;
+
+typedef std::vector<std::vector<double> > Matrix;
+
+// Deterministic weights with both signs, so that some rectifiers are off.
+Matrix Weights(size_t rows, size_t cols, double seed)
+{
+  Matrix ret(rows, std::vector<double>(cols));
+  for (size_t r = 0; r < rows; ++r) {
+    for (size_t c = 0; c < cols; ++c) {
+      char buf[32];
+      sprintf(buf, "%.6f", 0.6 * std::sin(seed + 0.37 * (r * cols + c)));
+      ret[r][c] = atof(buf);
+    }
+  }
+  return ret;
+}
+
+void Write(std::ostream &out, const char *section, const Matrix &m)
+{
+  out << section << '\n';
+  for (size_t r = 0; r < m.size(); ++r) {
+    for (size_t c = 0; c < m[r].size(); ++c) {
+      out << (c ? "\t" : "") << m[r][c];
+    }
+    out << '\n';
+  }
+  out << '\n';
+}
+
+class Model
+{
+public:
+  Model()
+    : m_path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("nplm-%%%%-%%%%"))
+    , m_embeddings(Weights(kVocab, kInput, 1))
+    , m_first(Weights(kHidden, (kOrder - 1) * kInput, 2))
+    , m_firstBias(Weights(kHidden, 1, 3))
+    , m_second(Weights(kOutput, kHidden, 4))
+    , m_secondBias(Weights(kOutput, 1, 5))
+    , m_output(Weights(kVocab, kOutput, 6))
+    , m_outputBias(Weights(kVocab, 1, 7)) {
+    std::ofstream out(m_path.string().c_str());
+    out.precision(6);
+    out << std::fixed;
+    out << "\\config\nversion 1\nngram_size " << kOrder
+        << "\ninput_vocab_size " << kVocab << "\noutput_vocab_size " << kVocab
+        << "\ninput_embedding_dimension " << kInput << "\nnum_hidden " << kHidden
+        << "\noutput_embedding_dimension " << kOutput
+        << "\nactivation_function rectifier\n\n\\input_vocab\n";
+    for (size_t i = 0; i < kVocab; ++i) out << kWords[i] << '\n';
+    out << "\n\\output_vocab\n";
+    for (size_t i = 0; i < kVocab; ++i) out << kWords[i] << '\n';
+    out << '\n';
+    Write(out, "\\input_embeddings", m_embeddings);
+    Write(out, "\\hidden_weights 1", m_first);
+    Write(out, "\\hidden_biases 1", m_firstBias);
+    Write(out, "\\hidden_weights 2", m_second);
+    Write(out, "\\hidden_biases 2", m_secondBias);
+    Write(out, "\\output_weights", m_output);
+    Write(out, "\\output_biases", m_outputBias);
+    out << "\\end\n";
+  }
+
+  ~Model() {
+    boost::filesystem::remove(m_path);
+  }
+
+  std::string Path() const {
+    return m_path.string();
+  }
+
+  // Straightforward forward pass in doubles.
+  double Reference(const int *ngram, bool normalize) const {
+    std::vector<double> input;
+    for (int i = 0; i < kOrder - 1; ++i) {
+      input.insert(input.end(), m_embeddings[ngram[i]].begin(), m_embeddings[ngram[i]].end());
+    }
+    std::vector<double> first = Layer(m_first, m_firstBias, input, true);
+    std::vector<double> second = Layer(m_second, m_secondBias, first, true);
+    std::vector<double> output = Layer(m_output, m_outputBias, second, false);
+    double sum = 0;
+    for (size_t i = 0; i < output.size(); ++i) sum += std::exp(output[i]);
+    return output[ngram[kOrder - 1]] - (normalize ? std::log(sum) : 0);
+  }
+
+private:
+  static std::vector<double> Layer(const Matrix &w, const Matrix &b, const std::vector<double> &in, bool rectify) {
+    std::vector<double> ret(w.size());
+    for (size_t r = 0; r < w.size(); ++r) {
+      ret[r] = b[r][0];
+      for (size_t c = 0; c < in.size(); ++c) ret[r] += w[r][c] * in[c];
+      if (rectify && ret[r] < 0) ret[r] = 0;
+    }
+    return ret;
+  }
+
+  boost::filesystem::path m_path;
+  Matrix m_embeddings, m_first, m_firstBias, m_second, m_secondBias, m_output, m_outputBias;
+};
+
+std::vector<int> AllNgrams()
+{
+  std::vector<int> ret;
+  for (int i = 0; i < 200; ++i) {
+    ret.push_back(i % kVocab);
+    ret.push_back((i * 3 + 1) % kVocab);
+    ret.push_back((i * 5 + 2) % kVocab);
+    ret.push_back((i * 7 + 3) % kVocab);
+  }
+  return ret;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(matches_reference)
+{
+  Model model;
+  std::vector<int> ngrams = AllNgrams();
+  const size_t count = ngrams.size() / kOrder;
+  for (int variant = 0; variant < 4; ++variant) {
+    bool premultiply = variant & 1, normalize = variant & 2;
+    FeedForwardNet net;
+    net.Load(model.Path());
+    if (premultiply) net.Premultiply();
+    net.SetNormalization(normalize);
+    BOOST_REQUIRE_EQUAL(net.GetOrder(), kOrder);
+
+    std::vector<float> batch(count);
+    net.Score(&ngrams[0], count, &batch[0]);
+    for (size_t i = 0; i < count; ++i) {
+      double expected = model.Reference(&ngrams[i * kOrder], normalize);
+      BOOST_CHECK_SMALL(batch[i] - expected, 1e-4);
+      BOOST_CHECK_EQUAL(net.Score(&ngrams[i * kOrder]), batch[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(vocabulary)
+{
+  Model model;
+  FeedForwardNet net;
+  net.Load(model.Path());
+  BOOST_CHECK_EQUAL(net.LookupInputWord("cat"), 4);
+  BOOST_CHECK_EQUAL(net.LookupOutputWord("mat"), 7);
+  BOOST_CHECK_EQUAL(net.LookupInputWord("dog"), 0);
+  BOOST_CHECK(net.GetInputWords() == net.GetOutputWords());
+}
+
+BOOST_AUTO_TEST_CASE(cache_and_batch)
+{
+  Model model;
+  FeedForwardNet net;
+  net.Load(model.Path());
+  net.Premultiply();
+  net.SetCache(16);
+  std::vector<int> ngrams = AllNgrams();
+  const size_t count = ngrams.size() / kOrder;
+
+  FeedForwardNet::Batch batch(net);
+  for (size_t i = 0; i < count; ++i) batch.Add(&ngrams[i * kOrder]);
+  batch.Flush();
+  // A cache much smaller than the batch loses entries but never the results.
+  for (size_t i = 0; i < count; ++i) {
+    BOOST_CHECK_SMALL(net.Score(&ngrams[i * kOrder]) - model.Reference(&ngrams[i * kOrder], false), 1e-4);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(quantized)
+{
+  Model model;
+  FeedForwardNet net;
+  net.Load(model.Path());
+  net.Premultiply();
+  net.Quantize();
+  std::vector<int> ngrams = AllNgrams();
+  for (size_t i = 0; i < ngrams.size() / kOrder; ++i) {
+    BOOST_CHECK_SMALL(net.Score(&ngrams[i * kOrder]) - model.Reference(&ngrams[i * kOrder], false), 0.05);
+  }
+}
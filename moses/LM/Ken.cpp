@@ -17,6 +17,7 @@ License along with this library; if not, write to the Free Software
 Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 ***********************************************************************/
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -250,6 +251,29 @@ template <class Model> FFState *LanguageModelKen<Model>::EvaluateWhenApplied(con
   return ret.release();
 }
 
+template <class Model> void LanguageModelKen<Model>::PrefetchWhenApplied(const Hypothesis &hypo, const FFState *ps) const
+{
+  if (!hypo.GetCurrTargetLength()) return;
+  const lm::ngram::State &in_state = static_cast<const KenLMState&>(*ps).state;
+
+  // The same n-grams as EvaluateWhenApplied looks up from the previous
+  // state: the context of each word is the phrase so far, most recent word
+  // first, followed by the previous state.
+  const std::size_t begin = hypo.GetCurrTargetWordsRange().GetStartPos();
+  const std::size_t end = hypo.GetCurrTargetWordsRange().GetEndPos() + 1;
+  const std::size_t adjust_end = std::min(end, begin + m_ngram->Order() - 1);
+
+  lm::WordIndex context[2 * KENLM_MAX_ORDER];
+  lm::WordIndex *const context_end = context + (adjust_end - begin - 1);
+  std::copy(in_state.words, in_state.words + in_state.length, context_end);
+  for (std::size_t position = begin; position < adjust_end; ++position) {
+    lm::WordIndex *const rbegin = context_end - (position - begin);
+    const lm::WordIndex word = TranslateID(hypo.GetWord(position));
+    m_ngram->Prefetch(rbegin, context_end + in_state.length, word);
+    if (rbegin != context) rbegin[-1] = word;
+  }
+}
+
 class LanguageModelChartStateKenLM : public FFState
 {
 public:
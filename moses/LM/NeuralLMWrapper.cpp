@@ -1,9 +1,8 @@
-
 #include "moses/StaticData.h"
 #include "moses/FactorCollection.h"
+#include "moses/Hypothesis.h"
 #include <boost/functional/hash.hpp>
 #include "NeuralLMWrapper.h"
-#include "neuralLM.h"
 
 using namespace std;
 
@@ -11,6 +10,9 @@ namespace Moses
 {
 NeuralLMWrapper::NeuralLMWrapper(const std::string &line)
   :LanguageModelSingleFactor(line)
+  ,m_premultiply(true)
+  ,m_quantize(false)
+  ,m_cacheSize(1000000)
 {
   ReadParameters();
 }
@@ -18,7 +20,20 @@ NeuralLMWrapper::NeuralLMWrapper(const std::string &line)
 
 NeuralLMWrapper::~NeuralLMWrapper()
 {
-  delete m_neuralLM_shared;
+}
+
+
+void NeuralLMWrapper::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "premultiply") {
+    m_premultiply = Scan<bool>(value);
+  } else if (key == "quantize") {
+    m_quantize = Scan<bool>(value);
+  } else if (key == "cache_size") {
+    m_cacheSize = Scan<size_t>(value);
+  } else {
+    LanguageModelSingleFactor::SetParameter(key, value);
+  }
 }
 
 
@@ -32,36 +47,107 @@ void NeuralLMWrapper::Load(AllOptions::ptr const& opts)
   m_sentenceEnd		= factorCollection.AddFactor(Output, m_factorType, EOS_);
   m_sentenceEndWord[m_factorType] = m_sentenceEnd;
 
-  m_neuralLM_shared = new nplm::neuralLM();
-  m_neuralLM_shared->read(m_filePath);
-  m_neuralLM_shared->premultiply();
-  //TODO: config option?
-  m_neuralLM_shared->set_cache(1000000);
+  m_neuralLM.Load(m_filePath);
+  if (m_premultiply) {
+    m_neuralLM.Premultiply();
+  }
+  if (m_quantize) {
+    m_neuralLM.Quantize();
+  }
+  m_neuralLM.SetCache(m_cacheSize);
 
-  m_unk = m_neuralLM_shared->lookup_word("<unk>");
+  m_unk = m_neuralLM.LookupOutputWord("<unk>");
 
-  UTIL_THROW_IF2(m_nGramOrder != m_neuralLM_shared->get_order(),
-                 "Wrong order of neuralLM: LM has " << m_neuralLM_shared->get_order() << ", but Moses expects " << m_nGramOrder);
+  UTIL_THROW_IF2(m_nGramOrder != size_t(m_neuralLM.GetOrder()),
+                 "Wrong order of neuralLM: LM has " << m_neuralLM.GetOrder() << ", but Moses expects " << m_nGramOrder);
 
 }
 
 
-LMResult NeuralLMWrapper::GetValue(const vector<const Word*> &contextFactor, State* finalState) const
+FeedForwardNet::Batch &NeuralLMWrapper::GetBatch() const
 {
-
-  if (!m_neuralLM.get()) {
-    m_neuralLM.reset(new nplm::neuralLM(*m_neuralLM_shared));
-    //TODO: config option?
-    m_neuralLM->set_cache(1000000);
+  if (!m_batch.get()) {
+    m_batch.reset(new FeedForwardNet::Batch(m_neuralLM));
   }
+  return *m_batch;
+}
+
 
-  vector<int> words(contextFactor.size());
+void NeuralLMWrapper::AddNgram(vector<int> &ngram, const vector<const Word*> &contextFactor) const
+{
   const size_t n = contextFactor.size();
-  for (size_t i=0; i<n; i++) {
-    const Word* word = contextFactor[i];
+  for (size_t i = 0; i < n; i++) {
+    const std::string string = contextFactor[i]->GetFactor(m_factorType)->GetString().as_string();
+    ngram[i] = (i + 1 < n) ? m_neuralLM.LookupInputWord(string) : m_neuralLM.LookupOutputWord(string);
+  }
+  GetBatch().Add(ngram);
+}
+
+
+// Queue the n-grams that EvaluateWhenApplied() is going to look up, in order.
+void NeuralLMWrapper::AddNgrams(const Hypothesis &hypo) const
+{
+  if (GetNGramOrder() <= 1 || hypo.GetCurrTargetLength() == 0) return;
+
+  const size_t order = GetNGramOrder();
+  const size_t startPos = hypo.GetCurrTargetWordsRange().GetStartPos();
+  const size_t currEndPos = hypo.GetCurrTargetWordsRange().GetEndPos();
+  const size_t endPos = std::min(startPos + order - 2, currEndPos);
+  vector<const Word*> contextFactor(order);
+  vector<int> ngram(order);
+  for (size_t currPos = startPos; currPos <= endPos; currPos++) {
+    for (size_t i = 0; i < order; i++) {
+      int pos = (int) currPos - (int) order + 1 + (int) i;
+      contextFactor[i] = pos >= 0 ? &hypo.GetWord(pos) : &GetSentenceStartWord();
+    }
+    AddNgram(ngram, contextFactor);
+  }
+
+  if (hypo.IsSourceCompleted()) {
+    const size_t size = hypo.GetSize();
+    for (size_t i = 0 ; i < order - 1 ; i ++) {
+      int currPos = (int)(size - order + i + 1);
+      contextFactor[i] = currPos < 0 ? &GetSentenceStartWord() : &hypo.GetWord((size_t)currPos);
+    }
+    contextFactor.back() = &GetSentenceEndWord();
+    AddNgram(ngram, contextFactor);
+  }
+}
+
+
+/* Cube pruning prefetches a whole group of hypotheses before evaluating
+ * them, so that the n-grams of the group are computed together.
+ */
+void NeuralLMWrapper::PrefetchWhenApplied(const Hypothesis &hypo, const FFState *ps) const
+{
+  AddNgrams(hypo);
+  GetBatch().MarkPrefetched(&hypo);
+}
+
+
+FFState *NeuralLMWrapper::EvaluateWhenApplied(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out) const
+{
+  // Without a prefetch (normal search), still compute the n-grams of this
+  // hypothesis together; with one, they are already queued.
+  if (!GetBatch().TakePrefetched(&hypo)) {
+    AddNgrams(hypo);
+  }
+  GetBatch().Flush();
+  return LanguageModelImplementation::EvaluateWhenApplied(hypo, ps, out);
+}
+
+
+LMResult NeuralLMWrapper::GetValue(const vector<const Word*> &contextFactor, State* finalState) const
+{
+  // Shorter contexts are padded with <s>, as NPLM does.
+  const size_t n = m_neuralLM.GetOrder();
+  const size_t missing = n - std::min(n, contextFactor.size());
+  vector<int> words(n, m_neuralLM.LookupInputWord(BOS_));
+  for (size_t i=missing; i<n; i++) {
+    const Word* word = contextFactor[i - missing];
     const Factor* factor = word->GetFactor(m_factorType);
     const std::string string = factor->GetString().as_string();
-    int neuralLM_wordID = m_neuralLM->lookup_word(string);
+    int neuralLM_wordID = (i + 1 < n) ? m_neuralLM.LookupInputWord(string) : m_neuralLM.LookupOutputWord(string);
     words[i] = neuralLM_wordID;
   }
   // Generate hashCode for only the last n-1 words, that represents the next LM
@@ -71,7 +157,7 @@ LMResult NeuralLMWrapper::GetValue(const vector<const Word*> &contextFactor, Sta
     boost::hash_combine(hashCode, words[i]);
   }
 
-  double value = m_neuralLM->lookup_ngram(words);
+  double value = m_neuralLM.Score(words);
 
   // Create a new struct to hold the result
   LMResult ret;
@@ -84,5 +170,3 @@ LMResult NeuralLMWrapper::GetValue(const vector<const Word*> &contextFactor, Sta
 }
 
 }
-
-
@@ -1,14 +1,10 @@
 #pragma once
 
 #include "SingleFactor.h"
+#include "FeedForwardNet.h"
 
 #include <boost/thread/tss.hpp>
 
-namespace nplm
-{
-class neuralLM;
-}
-
 namespace Moses
 {
 
@@ -16,10 +12,17 @@ class NeuralLMWrapper : public LanguageModelSingleFactor
 {
 protected:
   // big data (vocab, weights, cache) shared among threads
-  nplm::neuralLM *m_neuralLM_shared;
-  // thread-specific nplm for thread-safety
-  mutable boost::thread_specific_ptr<nplm::neuralLM> m_neuralLM;
+  FeedForwardNet m_neuralLM;
+  // n-grams of hypotheses about to be scored, per thread
+  mutable boost::thread_specific_ptr<FeedForwardNet::Batch> m_batch;
   int m_unk;
+  bool m_premultiply;
+  bool m_quantize;
+  size_t m_cacheSize;
+
+  FeedForwardNet::Batch &GetBatch() const;
+  void AddNgram(std::vector<int> &ngram, const std::vector<const Word*> &contextFactor) const;
+  void AddNgrams(const Hypothesis &hypo) const;
 
 public:
   NeuralLMWrapper(const std::string &line);
@@ -27,14 +30,16 @@ public:
 
   virtual LMResult GetValue(const std::vector<const Word*> &contextFactor, State* finalState = 0) const;
 
-  virtual void Load(AllOptions::ptr const& opts);
-
-};
+  virtual void PrefetchWhenApplied(const Hypothesis &hypo, const FFState *ps) const;
 
+  using LanguageModelImplementation::EvaluateWhenApplied;
+  virtual FFState *EvaluateWhenApplied(const Hypothesis &hypo, const FFState *ps, ScoreComponentCollection *out) const;
 
-} // namespace
-
+  virtual void Load(AllOptions::ptr const& opts);
 
+  virtual void SetParameter(const std::string& key, const std::string& value);
 
+};
 
 
+} // namespace
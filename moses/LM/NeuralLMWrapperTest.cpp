@@ -0,0 +1,188 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+#define BOOST_TEST_MODULE NeuralLMWrapperTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "moses/Bitmaps.h"
+#include "moses/FF/FFState.h"
+#include "moses/LM/NeuralLMWrapper.h"
+#include "moses/MockHypothesis.h"
+#include "moses/ScoreComponentCollection.h"
+#include "moses/StaticData.h"
+#include "moses/TranslationOption.h"
+#include "moses/Util.h"
+
+using namespace Moses;
+using namespace MosesTest;
+
+namespace
+{
+
+const char *kWords[] = {"<unk>", "<s>", "</s>", "the", "cat", "sat", "on", "mat"};
+const size_t kVocab = 8, kDim = 3;
+
+// A trigram network without hidden layer; the scores do not matter here.
+class Model
+{
+public:
+  Model()
+    : m_path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("nplm-%%%%-%%%%")) {
+    std::ofstream out(m_path.string().c_str());
+    out << "\\config\nversion 1\nngram_size 3\nvocab_size " << kVocab
+        << "\ninput_embedding_dimension " << kDim << "\nnum_hidden 0"
+        << "\noutput_embedding_dimension " << kDim
+        << "\nactivation_function rectifier\n\n\\vocab\n";
+    for (size_t i = 0; i < kVocab; ++i) out << kWords[i] << '\n';
+    Write(out, "\\input_embeddings", kVocab, kDim);
+    Write(out, "\\hidden_weights 1", kDim, 2 * kDim);
+    Write(out, "\\hidden_biases 1", kDim, 1);
+    Write(out, "\\output_weights", kVocab, kDim);
+    Write(out, "\\output_biases", kVocab, 1);
+    out << "\n\\end\n";
+  }
+
+  ~Model() {
+    boost::filesystem::remove(m_path);
+  }
+
+  std::string Path() const {
+    return m_path.string();
+  }
+
+private:
+  static void Write(std::ostream &out, const char *section, size_t rows, size_t cols) {
+    out << '\n' << section << '\n';
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        out << (c ? "\t" : "") << std::sin(double(r * cols + c + rows));
+      }
+      out << '\n';
+    }
+  }
+
+  boost::filesystem::path m_path;
+};
+
+class CountingNeuralLM : public NeuralLMWrapper
+{
+public:
+  CountingNeuralLM(const std::string &name, const Model &model)
+    : NeuralLMWrapper("NeuralLM name=" + name + " order=3 factor=0 path=" + model.Path()) {
+    Load(StaticData::Instance().options());
+  }
+
+  //! Times the network was run.
+  size_t Runs() const {
+    return m_neuralLM.GetRuns();
+  }
+};
+
+// Hypotheses that each add two words after "the", so two new trigrams, like
+// the successors that cube pruning prefetches together. A mock hypothesis
+// brings features of which there can only be one, hence a single one as
+// their predecessor.
+class Group
+{
+public:
+  Group()
+    : m_base("x y z w", std::vector<Alignment>(1, Alignment(0, 0)), std::vector<std::string>(1, "the"))
+    , m_bitmaps(4, std::vector<bool>(4, false)) {
+    const char *phrases[] = {"cat sat", "mat sat", "cat on"};
+    const Hypothesis &base = **m_base;
+    const Range range(1, 2);
+    const Bitmap &first = m_bitmaps.GetBitmap(m_bitmaps.GetInitialBitmap(), Range(0, 0));
+    const Bitmap &bitmap = m_bitmaps.GetBitmap(first, range);
+    for (size_t i = 0; i < 3; ++i) {
+      TargetPhrase phrase(NULL);
+      phrase.CreateFromString(Output, StaticData::Instance().options()->output.factor_order, phrases[i], NULL);
+      m_options.push_back(new TranslationOption(range, phrase));
+      m_hypotheses.push_back(new Hypothesis(base, *m_options.back(), bitmap, base.GetManager().GetNextHypoId()));
+    }
+  }
+
+  ~Group() {
+    RemoveAllInColl(m_hypotheses);
+    RemoveAllInColl(m_options);
+  }
+
+  const Hypothesis &operator[](size_t i) const {
+    return *m_hypotheses[i];
+  }
+
+  size_t size() const {
+    return m_hypotheses.size();
+  }
+
+private:
+  MockHypothesisGuard m_base;
+  Bitmaps m_bitmaps;
+  std::vector<TranslationOption*> m_options;
+  std::vector<Hypothesis*> m_hypotheses;
+};
+
+float Evaluate(const CountingNeuralLM &lm, const Hypothesis &hypo)
+{
+  ScoreComponentCollection scores;
+  boost::scoped_ptr<const FFState> empty(lm.EmptyHypothesisState(hypo.GetInput()));
+  delete lm.EvaluateWhenApplied(hypo, empty.get(), &scores);
+  return scores.GetScoreForProducer(&lm);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(prefetched_ngrams_are_queued_once)
+{
+  Model model;
+  // features stay registered, so these outlive everything that walks them
+  CountingNeuralLM normal("NLM0", model), cube("NLM1", model);
+  FeatureFunction::Register(&normal);
+  FeatureFunction::Register(&cube);
+  Group group;
+
+  // Normal search evaluates without prefetching: one run per hypothesis,
+  // for both of its trigrams.
+  std::vector<float> expected;
+  for (size_t i = 0; i < group.size(); ++i) {
+    expected.push_back(Evaluate(normal, group[i]));
+    BOOST_CHECK_EQUAL(normal.Runs(), i + 1);
+  }
+
+  // Cube pruning prefetches the group first: a single run for all of it,
+  // with the same scores.
+  for (size_t i = 0; i < group.size(); ++i) {
+    cube.PrefetchWhenApplied(group[i], NULL);
+  }
+  for (size_t i = 0; i < group.size(); ++i) {
+    BOOST_CHECK_EQUAL(Evaluate(cube, group[i]), expected[i]);
+  }
+  BOOST_CHECK_EQUAL(cube.Runs(), 1);
+
+  // Evaluating again finds everything in the cache.
+  BOOST_CHECK_EQUAL(Evaluate(cube, group[0]), expected[0]);
+  BOOST_CHECK_EQUAL(cube.Runs(), 1);
+}
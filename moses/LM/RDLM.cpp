@@ -6,33 +6,20 @@
 #include "moses/InputFileStream.h"
 #include "moses/Util.h"
 #include "util/exception.hh"
-#include "neuralTM.h"
 
 namespace Moses
 {
 
 namespace rdlm
 {
-ThreadLocal::ThreadLocal(nplm::neuralTM *lm_head_base_instance_, nplm::neuralTM *lm_label_base_instance_, bool normalizeHeadLM, bool normalizeLabelLM, int cacheSize)
+ThreadLocal::ThreadLocal(const FeedForwardNet *lm_head_base_instance_, const FeedForwardNet *lm_label_base_instance_)
+  : lm_head(lm_head_base_instance_)
+  , lm_label(lm_label_base_instance_)
 {
-  lm_head = new nplm::neuralTM(*lm_head_base_instance_);
-  lm_label = new nplm::neuralTM(*lm_label_base_instance_);
-  lm_head->set_normalization(normalizeHeadLM);
-  lm_label->set_normalization(normalizeLabelLM);
-  lm_head->set_cache(cacheSize);
-  lm_label->set_cache(cacheSize);
-}
-
-ThreadLocal::~ThreadLocal()
-{
-  delete lm_head;
-  delete lm_label;
 }
 
 }
 
-typedef Eigen::Map<Eigen::Matrix<int,Eigen::Dynamic,1> > EigenMap;
-
 RDLM::~RDLM()
 {
   delete lm_head_base_instance_;
@@ -42,22 +29,28 @@ RDLM::~RDLM()
 void RDLM::Load(AllOptions::ptr const& opts)
 {
 
-  lm_head_base_instance_ = new nplm::neuralTM();
-  lm_head_base_instance_->read(m_path_head_lm);
+  lm_head_base_instance_ = new FeedForwardNet();
+  lm_head_base_instance_->Load(m_path_head_lm);
 
-  m_sharedVocab = lm_head_base_instance_->get_input_vocabulary().words() == lm_head_base_instance_->get_output_vocabulary().words();
+  m_sharedVocab = lm_head_base_instance_->GetInputWords() == lm_head_base_instance_->GetOutputWords();
 //   std::cerr << "Does head RDLM share vocabulary for input/output? " << m_sharedVocab << std::endl;
 
-  lm_label_base_instance_ = new nplm::neuralTM();
-  lm_label_base_instance_->read(m_path_label_lm);
+  lm_label_base_instance_ = new FeedForwardNet();
+  lm_label_base_instance_->Load(m_path_label_lm);
 
   if (m_premultiply) {
-    lm_head_base_instance_->premultiply();
-    lm_label_base_instance_->premultiply();
+    lm_head_base_instance_->Premultiply();
+    lm_label_base_instance_->Premultiply();
+  }
+  if (m_quantize) {
+    lm_head_base_instance_->Quantize();
+    lm_label_base_instance_->Quantize();
   }
 
-  lm_head_base_instance_->set_cache(m_cacheSize);
-  lm_label_base_instance_->set_cache(m_cacheSize);
+  lm_head_base_instance_->SetNormalization(m_normalizeHeadLM);
+  lm_label_base_instance_->SetNormalization(m_normalizeLabelLM);
+  lm_head_base_instance_->SetCache(m_cacheSize);
+  lm_label_base_instance_->SetCache(m_cacheSize);
 
   StaticData &staticData = StaticData::InstanceNonConst();
   if (staticData.GetTreeStructure() == NULL) {
@@ -70,42 +63,42 @@ void RDLM::Load(AllOptions::ptr const& opts)
   size_head = 2*m_context_left + 2*m_context_right + 2*m_context_up + 2;
   size_label = 2*m_context_left + 2*m_context_right + 2*m_context_up + 1;
 
-  UTIL_THROW_IF2(size_head != lm_head_base_instance_->get_order(),
-                 "Error: order of head LM (" << lm_head_base_instance_->get_order() << ") does not match context size specified (left_context=" << m_context_left << " , right_context=" << m_context_right << " , up_context=" << m_context_up << " for a total order of " << size_head);
-  UTIL_THROW_IF2(size_label != lm_label_base_instance_->get_order(),
-                 "Error: order of label LM (" << lm_label_base_instance_->get_order() << ") does not match context size specified (left_context=" << m_context_left << " , right_context=" << m_context_right << " , up_context=" << m_context_up << " for a total order of " << size_label);
+  UTIL_THROW_IF2(size_head != size_t(lm_head_base_instance_->GetOrder()),
+                 "Error: order of head LM (" << lm_head_base_instance_->GetOrder() << ") does not match context size specified (left_context=" << m_context_left << " , right_context=" << m_context_right << " , up_context=" << m_context_up << " for a total order of " << size_head);
+  UTIL_THROW_IF2(size_label != size_t(lm_label_base_instance_->GetOrder()),
+                 "Error: order of label LM (" << lm_label_base_instance_->GetOrder() << ") does not match context size specified (left_context=" << m_context_left << " , right_context=" << m_context_right << " , up_context=" << m_context_up << " for a total order of " << size_label);
 
   //get int value of commonly used tokens
   static_head_null.resize(size_head);
   for (unsigned int i = 0; i < size_head; i++) {
     char numstr[20];
     sprintf(numstr, "<null_%d>", i);
-    static_head_null[i] = lm_head_base_instance_->lookup_input_word(numstr);
+    static_head_null[i] = lm_head_base_instance_->LookupInputWord(numstr);
   }
 
   static_label_null.resize(size_label);
   for (unsigned int i = 0; i < size_label; i++) {
     char numstr[20];
     sprintf(numstr, "<null_%d>", i);
-    static_label_null[i] = lm_label_base_instance_->lookup_input_word(numstr);
+    static_label_null[i] = lm_label_base_instance_->LookupInputWord(numstr);
   }
 
-  static_dummy_head = lm_head_base_instance_->lookup_input_word(dummy_head.GetString(0).as_string());
+  static_dummy_head = lm_head_base_instance_->LookupInputWord(dummy_head.GetString(0).as_string());
 
-  static_start_head = lm_head_base_instance_->lookup_input_word("<start_head>");
-  static_start_label = lm_head_base_instance_->lookup_input_word("<start_label>");
+  static_start_head = lm_head_base_instance_->LookupInputWord("<start_head>");
+  static_start_label = lm_head_base_instance_->LookupInputWord("<start_label>");
 
-  static_head_head = lm_head_base_instance_->lookup_input_word("<head_head>");
-  static_head_label = lm_head_base_instance_->lookup_input_word("<head_label>");
-  static_head_label_output = lm_label_base_instance_->lookup_output_word("<head_label>");
+  static_head_head = lm_head_base_instance_->LookupInputWord("<head_head>");
+  static_head_label = lm_head_base_instance_->LookupInputWord("<head_label>");
+  static_head_label_output = lm_label_base_instance_->LookupOutputWord("<head_label>");
 
-  static_stop_head = lm_head_base_instance_->lookup_input_word("<stop_head>");
-  static_stop_label = lm_head_base_instance_->lookup_input_word("<stop_label>");
-  static_stop_label_output = lm_label_base_instance_->lookup_output_word("<stop_label>");
-  static_start_label_output = lm_label_base_instance_->lookup_output_word("<start_label>");
+  static_stop_head = lm_head_base_instance_->LookupInputWord("<stop_head>");
+  static_stop_label = lm_head_base_instance_->LookupInputWord("<stop_label>");
+  static_stop_label_output = lm_label_base_instance_->LookupOutputWord("<stop_label>");
+  static_start_label_output = lm_label_base_instance_->LookupOutputWord("<start_label>");
 
-  static_root_head = lm_head_base_instance_->lookup_input_word("<root_head>");
-  static_root_label = lm_head_base_instance_->lookup_input_word("<root_label>");
+  static_root_head = lm_head_base_instance_->LookupInputWord("<root_head>");
+  static_root_label = lm_head_base_instance_->LookupInputWord("<root_label>");
 
   // just score provided file, then exit.
   if (!m_debugPath.empty()) {
@@ -121,7 +114,7 @@ void RDLM::Load(AllOptions::ptr const& opts)
 //
 //     rdlm::ThreadLocal *thread_objects = thread_objects_backend_.get();
 //     if (!thread_objects) {
-//       thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_, m_normalizeHeadLM, m_normalizeLabelLM, m_cacheSize);
+//       thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_);
 //       thread_objects_backend_.reset(thread_objects);
 //     }
 //
@@ -179,7 +172,7 @@ void RDLM::Load(AllOptions::ptr const& opts)
 //
 //    rdlm::ThreadLocal *thread_objects = thread_objects_backend_.get();
 //     if (!thread_objects) {
-//       thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_, m_normalizeHeadLM, m_normalizeLabelLM, m_cacheSize);
+//       thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_);
 //       thread_objects_backend_.reset(thread_objects);
 //     }
 //
@@ -297,10 +290,10 @@ void RDLM::Score(InternalTree* root, const TreePointerMap & back_pointers, boost
         it = std::copy(ancestor_labels.end()-context_up_nonempty, ancestor_labels.end(), it);
       }
       if (ancestor_labels.size() >= m_context_up && !num_virtual) {
-        score[0] += FloorScore(thread_objects.lm_head->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+        score[0] += FloorScore(thread_objects.lm_head->Score(ngram));
       } else {
         boost::hash_combine(boundary_hash, ngram.back());
-        score[1] += FloorScore(thread_objects.lm_head->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+        score[1] += FloorScore(thread_objects.lm_head->Score(ngram));
       }
     }
     return;
@@ -339,8 +332,8 @@ void RDLM::Score(InternalTree* root, const TreePointerMap & back_pointers, boost
     }
     // with 'full' binarization, direction is encoded in 2nd char
     StringPiece clipped_label = (m_binarized == 3) ? head_label.substr(2,head_label.size()-2) : head_label.substr(1,head_label.size()-1);
-    label_idx = lm_label_base_instance_->lookup_input_word(clipped_label.as_string());
-    label_idx_out = lm_label_base_instance_->lookup_output_word(clipped_label.as_string());
+    label_idx = lm_label_base_instance_->LookupInputWord(clipped_label.as_string());
+    label_idx_out = lm_label_base_instance_->LookupOutputWord(clipped_label.as_string());
   } else {
     reached_end = 3; // indicate that we've seen first and last symbol of the RHS
     label_idx = Factor2ID(root->GetLabel()[0], LABEL_INPUT);
@@ -366,19 +359,19 @@ void RDLM::Score(InternalTree* root, const TreePointerMap & back_pointers, boost
       it += m_context_right;
       it = std::copy(ancestor_heads.end()-context_up_nonempty, ancestor_heads.end(), it);
       it = std::copy(ancestor_labels.end()-context_up_nonempty, ancestor_labels.end(), it);
-      score[2] += FloorScore(thread_objects.lm_label->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+      score[2] += FloorScore(thread_objects.lm_label->Score(ngram));
     } else {
       boost::hash_combine(boundary_hash, ngram.back());
-      score[3] += FloorScore(thread_objects.lm_label->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+      score[3] += FloorScore(thread_objects.lm_label->Score(ngram));
     }
     if (head_idx != static_dummy_head && head_idx != static_head_head) {
       ngram.push_back(head_ids.second);
       *(ngram.end()-2) = label_idx;
       if (ancestor_heads.size() == m_context_up && ancestor_heads.back() == static_root_head && !num_virtual) {
-        score[0] += FloorScore(thread_objects.lm_head->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+        score[0] += FloorScore(thread_objects.lm_head->Score(ngram));
       } else {
         boost::hash_combine(boundary_hash, ngram.back());
-        score[1] += FloorScore(thread_objects.lm_head->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+        score[1] += FloorScore(thread_objects.lm_head->Score(ngram));
       }
     }
   }
@@ -493,10 +486,10 @@ void RDLM::Score(InternalTree* root, const TreePointerMap & back_pointers, boost
     ngram.back() = labels_output[i];
 
     if (ancestor_labels.size() >= m_context_up && !num_virtual) {
-      score[2] += FloorScore(thread_objects.lm_label->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+      score[2] += FloorScore(thread_objects.lm_label->Score(ngram));
     } else {
       boost::hash_combine(boundary_hash, ngram.back());
-      score[3] += FloorScore(thread_objects.lm_label->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+      score[3] += FloorScore(thread_objects.lm_label->Score(ngram));
     }
 
     // construct context of head model and predict head
@@ -506,10 +499,10 @@ void RDLM::Score(InternalTree* root, const TreePointerMap & back_pointers, boost
       ngram.push_back(heads_output[i]);
 
       if (ancestor_labels.size() >= m_context_up && !num_virtual) {
-        score[0] += FloorScore(thread_objects.lm_head->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+        score[0] += FloorScore(thread_objects.lm_head->Score(ngram));
       } else {
         boost::hash_combine(boundary_hash, ngram.back());
-        score[1] += FloorScore(thread_objects.lm_head->lookup_ngram(EigenMap(ngram.data(), ngram.size())));
+        score[1] += FloorScore(thread_objects.lm_head->Score(ngram));
       }
       ngram.pop_back();
     }
@@ -697,16 +690,16 @@ int RDLM::Factor2ID(const Factor * const factor, int model_type) const
   if (ret == -1) {
     switch(model_type) {
     case LABEL_INPUT:
-      ret = lm_label_base_instance_->lookup_input_word(factor->GetString().as_string());
+      ret = lm_label_base_instance_->LookupInputWord(factor->GetString().as_string());
       break;
     case LABEL_OUTPUT:
-      ret = lm_label_base_instance_->lookup_output_word(factor->GetString().as_string());
+      ret = lm_label_base_instance_->LookupOutputWord(factor->GetString().as_string());
       break;
     case HEAD_INPUT:
-      ret = lm_head_base_instance_->lookup_input_word(factor->GetString().as_string());
+      ret = lm_head_base_instance_->LookupInputWord(factor->GetString().as_string());
       break;
     case HEAD_OUTPUT:
-      ret = lm_head_base_instance_->lookup_output_word(factor->GetString().as_string());
+      ret = lm_head_base_instance_->LookupOutputWord(factor->GetString().as_string());
       break;
     }
     (*cache)[ID] = ret;
@@ -715,17 +708,17 @@ int RDLM::Factor2ID(const Factor * const factor, int model_type) const
   return ret;
 }
 
-void RDLM::PrintInfo(std::vector<int> &ngram, nplm::neuralTM* lm) const
+void RDLM::PrintInfo(std::vector<int> &ngram, const FeedForwardNet* lm) const
 {
   for (size_t i = 0; i < ngram.size()-1; i++) {
-    std::cerr << lm->get_input_vocabulary().words()[ngram[i]] << " ";
+    std::cerr << lm->GetInputWords()[ngram[i]] << " ";
   }
-  std::cerr << lm->get_output_vocabulary().words()[ngram.back()] << " ";
+  std::cerr << lm->GetOutputWords()[ngram.back()] << " ";
 
   for (size_t i = 0; i < ngram.size(); i++) {
     std::cerr << ngram[i] << " ";
   }
-  std::cerr << "score: " << lm->lookup_ngram(ngram) << std::endl;
+  std::cerr << "score: " << lm->Score(ngram) << std::endl;
 }
 
 
@@ -752,7 +745,7 @@ void RDLM::ScoreFile(std::string &path)
   InputFileStream inStream(path);
   rdlm::ThreadLocal *thread_objects = thread_objects_backend_.get();
   if (!thread_objects) {
-    thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_, m_normalizeHeadLM, m_normalizeLabelLM, m_cacheSize);
+    thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_);
     thread_objects_backend_.reset(thread_objects);
   }
   std::string line, null;
@@ -801,6 +794,8 @@ void RDLM::SetParameter(const std::string& key, const std::string& value)
     m_debugPath = value;
   } else if (key == "premultiply") {
     m_premultiply = Scan<bool>(value);
+  } else if (key == "quantize") {
+    m_quantize = Scan<bool>(value);
   } else if (key == "rerank") {
     m_rerank = Scan<bool>(value);
   } else if (key == "normalize_head_lm") {
@@ -868,7 +863,7 @@ FFState* RDLM::EvaluateWhenApplied(const ChartHypothesis& cur_hypo
 #endif
       rdlm::ThreadLocal *thread_objects = thread_objects_backend_.get();
       if (!thread_objects) {
-        thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_, m_normalizeHeadLM, m_normalizeLabelLM, m_cacheSize);
+        thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_);
         thread_objects_backend_.reset(thread_objects);
       }
       thread_objects->ancestor_heads.resize(0);
@@ -890,7 +885,7 @@ FFState* RDLM::EvaluateWhenApplied(const ChartHypothesis& cur_hypo
 #endif
       rdlm::ThreadLocal *thread_objects = thread_objects_backend_.get();
       if (!thread_objects) {
-        thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_, m_normalizeHeadLM, m_normalizeLabelLM, m_cacheSize);
+        thread_objects = new rdlm::ThreadLocal(lm_head_base_instance_, lm_label_base_instance_);
         thread_objects_backend_.reset(thread_objects);
       }
       thread_objects->ancestor_heads.resize(0);
@@ -4,6 +4,7 @@
 #include "moses/FF/FFState.h"
 #include "moses/FF/InternalTree.h"
 #include "moses/Word.h"
+#include "moses/LM/FeedForwardNet.h"
 
 #include <boost/thread/tss.hpp>
 #include <boost/array.hpp>
@@ -17,11 +18,6 @@
 // Sennrich, Rico (2015). Modelling and Optimizing on Syntactic N-Grams for Statistical Machine Translation. Transactions of the Association for Computational Linguistics.
 // see 'scripts/training/rdlm' for training scripts
 
-namespace nplm
-{
-class neuralTM;
-}
-
 namespace Moses
 {
 
@@ -42,11 +38,10 @@ public:
   std::vector<int> heads_output;
   std::vector<int> labels_output;
   std::vector<std::pair<InternalTree*,std::vector<TreePointer>::const_iterator> > stack;
-  nplm::neuralTM* lm_head;
-  nplm::neuralTM* lm_label;
+  const FeedForwardNet* lm_head;
+  const FeedForwardNet* lm_label;
 
-  ThreadLocal(nplm::neuralTM *lm_head_base_instance_, nplm::neuralTM *lm_label_base_instance_, bool normalizeHeadLM, bool normalizeLabelLM, int cacheSize);
-  ~ThreadLocal();
+  ThreadLocal(const FeedForwardNet *lm_head_base_instance_, const FeedForwardNet *lm_label_base_instance_);
 };
 }
 
@@ -86,8 +81,9 @@ class RDLM : public StatefulFeatureFunction
 {
   typedef std::map<InternalTree*,TreePointer> TreePointerMap;
 
-  nplm::neuralTM* lm_head_base_instance_;
-  nplm::neuralTM* lm_label_base_instance_;
+  // shared among threads, with one score cache each
+  FeedForwardNet* lm_head_base_instance_;
+  FeedForwardNet* lm_label_base_instance_;
 
   mutable boost::thread_specific_ptr<rdlm::ThreadLocal> thread_objects_backend_;
 
@@ -104,6 +100,7 @@ class RDLM : public StatefulFeatureFunction
   size_t m_context_right;
   size_t m_context_up;
   bool m_premultiply;
+  bool m_quantize;
   bool m_rerank;
   bool m_normalizeHeadLM;
   bool m_normalizeLabelLM;
@@ -158,6 +155,7 @@ public:
     , m_context_right(0)
     , m_context_up(2)
     , m_premultiply(true)
+    , m_quantize(false)
     , m_rerank(false)
     , m_normalizeHeadLM(false)
     , m_normalizeLabelLM(false)
@@ -187,7 +185,7 @@ public:
   void GetIDs(const Word & head, const Word & preterminal, std::pair<int,int> & IDs) const;
   int Factor2ID(const Factor * const factor, int model_type) const;
   void ScoreFile(std::string &path); //for debugging
-  void PrintInfo(std::vector<int> &ngram, nplm::neuralTM* lm) const; //for debugging
+  void PrintInfo(std::vector<int> &ngram, const FeedForwardNet* lm) const; //for debugging
 
   TreePointerMap AssociateLeafNTs(InternalTree* root, const std::vector<TreePointer> &previous) const;
 
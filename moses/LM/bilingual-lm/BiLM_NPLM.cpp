@@ -1,6 +1,4 @@
 #include "BiLM_NPLM.h"
-#include "neuralLM.h"
-#include "vocabulary.h"
 
 namespace Moses
 {
@@ -8,6 +6,7 @@ namespace Moses
 BilingualLM_NPLM::BilingualLM_NPLM(const std::string &line)
   : BilingualLM(line),
     premultiply(true),
+    quantize(false),
     factored(false),
     neuralLM_cache(1000000)
 {
@@ -22,7 +21,25 @@ float BilingualLM_NPLM::Score(std::vector<int>& source_words, std::vector<int>&
 {
   source_words.reserve(source_ngrams+target_ngrams+1);
   source_words.insert( source_words.end(), target_words.begin(), target_words.end() );
-  return FloorScore(m_neuralLM->lookup_ngram(source_words));
+  GetBatch().Flush();
+  return FloorScore(m_neuralLM.Score(source_words));
+}
+
+void BilingualLM_NPLM::PrefetchNgram(std::vector<int>& source_words, std::vector<int>& target_words) const
+{
+  std::vector<int> ngram(source_words);
+  ngram.insert(ngram.end(), target_words.begin(), target_words.end());
+  GetBatch().Add(ngram);
+}
+
+void BilingualLM_NPLM::MarkPrefetched(const Hypothesis& hypo) const
+{
+  GetBatch().MarkPrefetched(&hypo);
+}
+
+bool BilingualLM_NPLM::TakePrefetched(const Hypothesis& hypo) const
+{
+  return GetBatch().TakePrefetched(&hypo);
 }
 
 const Word& BilingualLM_NPLM::getNullWord() const
@@ -32,8 +49,6 @@ const Word& BilingualLM_NPLM::getNullWord() const
 
 int BilingualLM_NPLM::getNeuralLMId(const Word& word, bool is_source_word) const
 {
-  initSharedPointer();
-
   //Decide if we are doing source or target side first.
   boost::unordered_map<const Factor*, int> * neuralLMids;
   int unknown_word_id;
@@ -67,11 +82,12 @@ int BilingualLM_NPLM::getNeuralLMId(const Word& word, bool is_source_word) const
   }
 }
 
-void BilingualLM_NPLM::initSharedPointer() const
+FeedForwardNet::Batch &BilingualLM_NPLM::GetBatch() const
 {
-  if (!m_neuralLM.get()) {
-    m_neuralLM.reset(new nplm::neuralLM(*m_neuralLM_shared));
+  if (!m_batch.get()) {
+    m_batch.reset(new FeedForwardNet::Batch(m_neuralLM));
   }
+  return *m_batch;
 }
 
 void BilingualLM_NPLM::SetParameter(const std::string& key, const std::string& value)
@@ -92,7 +108,8 @@ void BilingualLM_NPLM::SetParameter(const std::string& key, const std::string& v
     neuralLM_cache = atoi(value.c_str());
   } else if (key == "premultiply") {
     premultiply = Scan<bool>(value);
-    //TODO: doesn't currently do anything (constructor doesn't know about parameters)
+  } else if (key == "quantize") {
+    quantize = Scan<bool>(value);
   } else if (key == "null_word") {
     NULL_string = value;
     NULL_overwrite = true;
@@ -103,19 +120,21 @@ void BilingualLM_NPLM::SetParameter(const std::string& key, const std::string& v
 
 void BilingualLM_NPLM::loadModel()
 {
-  m_neuralLM_shared = new nplm::neuralLM();
-  m_neuralLM_shared->read(m_filePath);
+  m_neuralLM.Load(m_filePath);
   if (premultiply) {
-    m_neuralLM_shared->premultiply();
+    m_neuralLM.Premultiply();
+  }
+  if (quantize) {
+    m_neuralLM.Quantize();
   }
 
   int ngram_order = target_ngrams + source_ngrams + 1;
   UTIL_THROW_IF2(
-    ngram_order != m_neuralLM_shared->get_order(),
-    "Wrong order of neuralLM: LM has " << m_neuralLM_shared->get_order() <<
+    ngram_order != m_neuralLM.GetOrder(),
+    "Wrong order of neuralLM: LM has " << m_neuralLM.GetOrder() <<
     ", but Moses expects " << ngram_order);
 
-  m_neuralLM_shared->set_cache(neuralLM_cache); //Default 1000000
+  m_neuralLM.SetCache(neuralLM_cache); //Default 1000000
 
   //Setup factor -> NeuralLMId cache. First target words
   FactorCollection& factorFactory = FactorCollection::Instance(); //To do the conversion from string to vocabID
@@ -1,13 +1,9 @@
 #include "moses/LM/BilingualLM.h"
+#include "moses/LM/FeedForwardNet.h"
 #include <boost/unordered_map.hpp>
 #include <utility> //make_pair
 #include <fstream> //Read vocabulary files
 
-namespace nplm
-{
-class neuralLM;
-}
-
 namespace Moses
 {
 
@@ -19,9 +15,15 @@ public:
 private:
   float Score(std::vector<int>& source_words, std::vector<int>& target_words) const;
 
+  void PrefetchNgram(std::vector<int>& source_words, std::vector<int>& target_words) const;
+
+  void MarkPrefetched(const Hypothesis& hypo) const;
+
+  bool TakePrefetched(const Hypothesis& hypo) const;
+
   int getNeuralLMId(const Word& word, bool is_source_word) const;
 
-  void initSharedPointer() const;
+  FeedForwardNet::Batch &GetBatch() const;
 
   void loadModel();
 
@@ -29,8 +31,9 @@ private:
 
   const Word& getNullWord() const;
 
-  nplm::neuralLM *m_neuralLM_shared;
-  mutable boost::thread_specific_ptr<nplm::neuralLM> m_neuralLM;
+  FeedForwardNet m_neuralLM;
+  // n-grams about to be scored, per thread
+  mutable boost::thread_specific_ptr<FeedForwardNet::Batch> m_batch;
 
   mutable boost::unordered_map<const Factor*, int> target_neuralLMids;
   mutable boost::unordered_map<const Factor*, int> source_neuralLMids;
@@ -43,6 +46,7 @@ private:
   std::string source_vocab_path;
   std::string target_vocab_path;
   bool premultiply;
+  bool quantize;
   bool factored;
   int neuralLM_cache;
   int source_unknown_word_id;
@@ -11,6 +11,11 @@
 #include "moses/StaticData.h"
 #include <algorithm>
 #include <set>
+#include <limits>
+#include <boost/bind.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
 
 using namespace std;
 
@@ -19,6 +24,7 @@ namespace Moses
 
 size_t bleu_order = 4;
 float UNKNGRAMLOGPROB = -20;
+const float UNREACHED = -numeric_limits<float>::infinity();
 void GetOutputWords(const TrellisPath &path, vector <Word> &translation)
 {
   const std::vector<const Hypothesis *> &edges = path.GetEdges();
@@ -50,30 +56,139 @@ void extract_ngrams(const vector<Word >& sentence, map < Phrase, int >  & allngr
 
 
 
-void NgramScores::addScore(const Hypothesis* node, const Phrase& ngram, float score)
+namespace
 {
-  set<Phrase>::const_iterator ngramIter = m_ngrams.find(ngram);
-  if (ngramIter == m_ngrams.end()) {
-    ngramIter = m_ngrams.insert(ngram).first;
-  }
-  map<const Phrase*,float>& ngramScores = m_scores[node];
-  map<const Phrase*,float>::iterator scoreIter = ngramScores.find(&(*ngramIter));
-  if (scoreIter == ngramScores.end()) {
-    ngramScores[&(*ngramIter)] = score;
-  } else {
-    ngramScores[&(*ngramIter)] = log_sum(score,scoreIter->second);
+
+// Runs work(start, stride) for start = 0 .. threads - 1, on as many threads.
+template <class Work>
+void RunStrided(const Work& work, size_t threads)
+{
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    boost::thread_group workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.create_thread(boost::bind<void>(boost::cref(work), t, threads));
+    }
+    workers.join_all();
+    return;
   }
+#endif
+  work(0, 1);
 }
 
-NgramScores::NodeScoreIterator NgramScores::nodeBegin(const Hypothesis* node)
+// only worth starting threads for long lists
+size_t ThreadsFor(size_t threads, size_t items)
 {
-  return m_scores[node].begin();
+  return min(threads, items / 64 + 1);
 }
 
+// Lattice MBR scores of solutions start, start + stride, ...
+struct SolutionScorer {
+  vector<LatticeMBRSolution>& solutions;
+  const NgramIndex& ngramIndex;
+  const vector<float>& ngramPosteriors;
+  const vector<float>& thetas;
+  float mapWeight;
+
+  void operator()(size_t start, size_t stride) const {
+    for (size_t i = start; i < solutions.size(); i += stride) {
+      solutions[i].CalcScore(ngramIndex, ngramPosteriors, thetas, mapWeight);
+    }
+  }
+};
+
+// Smoothed BLEU of paths start, start + stride, ... against the expected
+// ngram counts of the lattice (De Nero et al. 2009)
+struct ConsensusScorer {
+  const vector<const TrellisPath*>& paths;
+  const NgramIndex& ngramIndex;
+  const vector<float>& ngramExpectations;
+  float ref_length;
+  vector<float>& scores;
+
+  void operator()(size_t start, size_t stride) const {
+    static const int BLEU_ORDER = 4;
+    static const float SMOOTH = 1;
+
+    for (size_t p = start; p < paths.size(); p += stride) {
+      vector<Word> words;
+      map<Phrase,int> ngrams;
+      GetOutputWords(*paths[p],words);
+      extract_ngrams(words,ngrams);
+
+      vector<float> comps(2*BLEU_ORDER+1);
+      float logbleu = 0.0;
+      float brevity = 0.0;
+      int hyp_length = words.size();
+      for (int i = 0; i < BLEU_ORDER; ++i) {
+        comps[2*i] = 0.0;
+        comps[2*i+1] = max(hyp_length-i,0);
+      }
+
+      for (map<Phrase,int>::const_iterator hyp_iter = ngrams.begin();
+           hyp_iter != ngrams.end(); ++hyp_iter) {
+        size_t id = ngramIndex.Find(hyp_iter->first);
+        if (id != NOT_FOUND) {
+          comps[2*(hyp_iter->first.GetSize()-1)] += min(exp(ngramExpectations[id]), (float)(hyp_iter->second));
+        }
+      }
+      comps[comps.size()-1] = ref_length;
+
+      float score = 0.0f;
+      if (comps[0] != 0) {
+        for (int i=0; i<BLEU_ORDER; i++) {
+          if ( i > 0 ) {
+            logbleu += log((float)comps[2*i]+SMOOTH)-log((float)comps[2*i+1]+SMOOTH);
+          } else {
+            logbleu += log((float)comps[2*i])-log((float)comps[2*i+1]);
+          }
+        }
+        logbleu /= BLEU_ORDER;
+        brevity = 1.0-(float)comps[comps.size()-1]/comps[1]; // comps[comps_n-1] is the ref length, comps[1] is the test length
+        if (brevity < 0.0) {
+          logbleu += brevity;
+        }
+        score =  exp(logbleu);
+      }
+      scores[p] = score;
+    }
+  }
+};
 
-NgramScores::NodeScoreIterator NgramScores::nodeEnd(const Hypothesis* node)
+}
+
+bool PathComparator::operator()(const Path& a, const Path& b) const
+{
+  for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+    if (a[i]->GetIndex() != b[i]->GetIndex()) {
+      return a[i]->GetIndex() < b[i]->GetIndex();
+    }
+  }
+  return a.size() < b.size();
+}
+
+size_t NgramIndex::Add(const Phrase& ngram)
 {
-  return m_scores[node].end();
+  pair<boost::unordered_map<Phrase, size_t>::iterator, bool> added = m_ids.insert(make_pair(ngram, m_ngrams.size()));
+  if (added.second) {
+    // nodes of the map do not move, so the key can stand for the ngram
+    m_ngrams.push_back(&added.first->first);
+  }
+  return added.first->second;
+}
+
+size_t NgramIndex::Find(const Phrase& ngram) const
+{
+  boost::unordered_map<Phrase, size_t>::const_iterator it = m_ids.find(ngram);
+  return it == m_ids.end() ? NOT_FOUND : it->second;
+}
+
+void NgramScores::addScore(size_t node, size_t ngram, float score)
+{
+  pair<boost::unordered_map<size_t, float>::iterator, bool> added = m_scores[node].insert(make_pair(ngram, score));
+  if (!added.second) {
+    added.first->second = log_sum(score, added.first->second);
+  }
 }
 
 LatticeMBRSolution::LatticeMBRSolution(const TrellisPath& path, bool isMap) :
@@ -97,7 +212,7 @@ LatticeMBRSolution::LatticeMBRSolution(const TrellisPath& path, bool isMap) :
 }
 
 
-void LatticeMBRSolution::CalcScore(map<Phrase, float>& finalNgramScores, const vector<float>& thetas, float mapWeight)
+void LatticeMBRSolution::CalcScore(const NgramIndex& ngramIndex, const vector<float>& finalNgramScores, const vector<float>& thetas, float mapWeight)
 {
   m_ngramScores.assign(thetas.size()-1, -10000);
 
@@ -110,9 +225,9 @@ void LatticeMBRSolution::CalcScore(map<Phrase, float>& finalNgramScores, const v
   //Calculate the ngramScores, working in log space at first
   for (map < Phrase, int >::iterator ngrams = counts.begin(); ngrams != counts.end(); ++ngrams) {
     float ngramPosterior = UNKNGRAMLOGPROB;
-    map<Phrase,float>::const_iterator ngramPosteriorIt = finalNgramScores.find(ngrams->first);
-    if (ngramPosteriorIt != finalNgramScores.end()) {
-      ngramPosterior = ngramPosteriorIt->second;
+    size_t id = ngramIndex.Find(ngrams->first);
+    if (id != NOT_FOUND && finalNgramScores[id] != UNREACHED) {
+      ngramPosterior = finalNgramScores[id];
     }
     size_t ngramSize = ngrams->first.GetSize();
     m_ngramScores[ngramSize-1] = log_sum(log((float)ngrams->second) + ngramPosterior,m_ngramScores[ngramSize-1]);
@@ -276,43 +391,51 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
 }
 
 void calcNgramExpectations(Lattice & connectedHyp, map<const Hypothesis*, vector<Edge> >& incomingEdges,
-                           map<Phrase, float>& finalNgramScores, bool posteriors)
+                           NgramIndex& ngramIndex, vector<float>& finalNgramScores, bool posteriors)
 {
 
   sort(connectedHyp.begin(),connectedHyp.end(),ascendingCoverageCmp); //sort by increasing source word cov
 
-  /*cerr << "Lattice:" << endl;
-  for (Lattice::const_iterator i = connectedHyp.begin(); i != connectedHyp.end(); ++i) {
-      const Hypothesis* h = *i;
-      cerr << *h << endl;
-      const vector<Edge>& edges = incomingEdges[h];
-      for (size_t e = 0; e < edges.size(); ++e) {
-          cerr << edges[e];
+  //number the nodes and edges by their position, so that per node data lives in
+  //arrays and the order of summation does not depend on where things are in memory
+  boost::unordered_map<const Hypothesis*, size_t> nodeIds;
+  vector<vector<Edge>*> nodeEdges(connectedHyp.size());
+  size_t edgeIndex = 0;
+  for (size_t i = 0; i < connectedHyp.size(); ++i) {
+    nodeIds[connectedHyp[i]] = i;
+    map<const Hypothesis*, vector<Edge> >::iterator edges = incomingEdges.find(connectedHyp[i]);
+    if (edges != incomingEdges.end()) {
+      nodeEdges[i] = &edges->second;
+      stable_sort(edges->second.begin(), edges->second.end());
+      for (size_t e = 0; e < edges->second.size(); ++e) {
+        edges->second[e].SetIndex(edgeIndex++);
       }
-  }*/
+    }
+  }
 
-  map<const Hypothesis*, float> forwardScore;
-  forwardScore[connectedHyp[0]] = 0.0f; //forward score of hyp 0 is 1 (or 0 in logprob space)
-  set< const Hypothesis *> finalHyps; //store completed hyps
+  vector<float> forwardScore(connectedHyp.size(), 0.0f); //forward score of hyp 0 is 1 (or 0 in logprob space)
+  vector<size_t> finalHyps; //store completed hyps
 
-  NgramScores ngramScores;//ngram scores for each hyp
+  NgramScores ngramScores(connectedHyp.size());//ngram scores for each hyp
 
   for (size_t i = 1; i < connectedHyp.size(); ++i) {
     const Hypothesis* currHyp = connectedHyp[i];
     if (currHyp->GetWordsBitmap().IsComplete()) {
-      finalHyps.insert(currHyp);
+      finalHyps.push_back(i);
     }
 
     VERBOSE(3, "Processing hyp: " << currHyp->GetId() << ", num words cov= " << currHyp->GetWordsBitmap().GetNumWordsCovered() <<  endl)
 
-    vector <Edge> & edges = incomingEdges[currHyp];
+    if (!nodeEdges[i]) continue;
+    vector <Edge> & edges = *nodeEdges[i];
     for (size_t e = 0; e < edges.size(); ++e) {
       const Edge& edge = edges[e];
-      if (forwardScore.find(currHyp) == forwardScore.end()) {
-        forwardScore[currHyp] = forwardScore[edge.GetTailNode()] + edge.GetScore();
+      float tailScore = forwardScore[nodeIds[edge.GetTailNode()]];
+      if (e == 0) {
+        forwardScore[i] = tailScore + edge.GetScore();
         VERBOSE(3, "Fwd score["<<currHyp->GetId()<<"] = fwdScore["<<edge.GetTailNode()->GetId() << "] + edge Score: " << edge.GetScore() << endl)
       } else {
-        forwardScore[currHyp] = log_sum(forwardScore[currHyp], forwardScore[edge.GetTailNode()] + edge.GetScore());
+        forwardScore[i] = log_sum(forwardScore[i], tailScore + edge.GetScore());
         VERBOSE(3, "Fwd score["<<currHyp->GetId()<<"] += fwdScore["<<edge.GetTailNode()->GetId() << "] + edge Score: " << edge.GetScore() << endl)
       }
     }
@@ -320,42 +443,39 @@ void calcNgramExpectations(Lattice & connectedHyp, map<const Hypothesis*, vector
     //Process ngrams now
     for (size_t j =0 ; j < edges.size(); ++j) {
       Edge& edge = edges[j];
-      const NgramHistory & incomingPhrases = edge.GetNgrams(incomingEdges);
+      const NgramHistory & incomingPhrases = edge.GetNgrams(incomingEdges, ngramIndex);
 
       //let's first score ngrams introduced by this edge
       for (NgramHistory::const_iterator it = incomingPhrases.begin(); it != incomingPhrases.end(); ++it) {
-        const Phrase& ngram = it->first;
         const PathCounts& pathCounts = it->second;
-        VERBOSE(4, "Calculating score for: " << it->first << endl)
+        VERBOSE(4, "Calculating score for: " << ngramIndex.GetNgram(it->first) << endl)
 
         for (PathCounts::const_iterator pathCountIt = pathCounts.begin(); pathCountIt != pathCounts.end(); ++pathCountIt) {
           //Score of an n-gram is forward score of head node of leftmost edge + all edge scores
           const Path&  path = pathCountIt->first;
-          //cerr << "path count for " << ngram << " is " << pathCountIt->second << endl;
-          float score = forwardScore[path[0]->GetTailNode()];
-          for (size_t i = 0; i < path.size(); ++i) {
-            score += path[i]->GetScore();
+          float score = forwardScore[nodeIds[path[0]->GetTailNode()]];
+          for (size_t p = 0; p < path.size(); ++p) {
+            score += path[p]->GetScore();
           }
           //if we're doing expectations, then the number of times the ngram
           //appears on the path is relevant.
           size_t count = posteriors ? 1 : pathCountIt->second;
           for (size_t k = 0; k < count; ++k) {
-            ngramScores.addScore(currHyp,ngram,score);
+            ngramScores.addScore(i,it->first,score);
           }
         }
       }
 
       //Now score ngrams that are just being propagated from the history
-      for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(edge.GetTailNode());
-           it != ngramScores.nodeEnd(edge.GetTailNode()); ++it) {
-        const Phrase & currNgram = *(it->first);
-        float currNgramScore = it->second;
-        VERBOSE(4, "Calculating score for: " << currNgram << endl)
+      size_t tail = nodeIds[edge.GetTailNode()];
+      for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(tail);
+           it != ngramScores.nodeEnd(tail); ++it) {
+        VERBOSE(4, "Calculating score for: " << ngramIndex.GetNgram(it->first) << endl)
 
         // For posteriors, don't double count ngrams
-        if (!posteriors || incomingPhrases.find(currNgram) == incomingPhrases.end()) {
-          float score = edge.GetScore() + currNgramScore;
-          ngramScores.addScore(currHyp,currNgram,score);
+        if (!posteriors || incomingPhrases.find(it->first) == incomingPhrases.end()) {
+          float score = edge.GetScore() + it->second;
+          ngramScores.addScore(i,it->first,score);
         }
       }
 
@@ -365,15 +485,16 @@ void calcNgramExpectations(Lattice & connectedHyp, map<const Hypothesis*, vector
   float Z = 9999999; //the total score of the lattice
 
   //Done - Print out ngram posteriors for final hyps
-  for (set< const Hypothesis *>::iterator finalHyp = finalHyps.begin(); finalHyp != finalHyps.end(); ++finalHyp) {
-    const Hypothesis* hyp = *finalHyp;
+  finalNgramScores.assign(ngramIndex.GetSize(), UNREACHED);
+  for (size_t f = 0; f < finalHyps.size(); ++f) {
+    size_t hyp = finalHyps[f];
 
     for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(hyp); it != ngramScores.nodeEnd(hyp); ++it) {
-      const Phrase& ngram = *(it->first);
-      if (finalNgramScores.find(ngram) == finalNgramScores.end()) {
-        finalNgramScores[ngram] = it->second;
+      float& finalScore = finalNgramScores[it->first];
+      if (finalScore == UNREACHED) {
+        finalScore = it->second;
       } else {
-        finalNgramScores[ngram] = log_sum(it->second,  finalNgramScores[ngram]);
+        finalScore = log_sum(it->second, finalScore);
       }
     }
 
@@ -386,16 +507,17 @@ void calcNgramExpectations(Lattice & connectedHyp, map<const Hypothesis*, vector
 
   //Z *= scale;  //scale the score
 
-  for (map<Phrase, float>::iterator finalScoresIt = finalNgramScores.begin();  finalScoresIt != finalNgramScores.end(); ++finalScoresIt) {
-    finalScoresIt->second =  finalScoresIt->second - Z;
+  for (size_t id = 0; id < finalNgramScores.size(); ++id) {
+    if (finalNgramScores[id] == UNREACHED) continue;
+    finalNgramScores[id] -= Z;
     IFVERBOSE(2) {
-      VERBOSE(2,finalScoresIt->first << " [" << finalScoresIt->second << "]" << endl);
+      VERBOSE(2,ngramIndex.GetNgram(id) << " [" << finalNgramScores[id] << "]" << endl);
     }
   }
 
 }
 
-const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & incomingEdges)
+const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & incomingEdges, NgramIndex& ngramIndex)
 {
 
   if (m_ngrams.size() > 0)
@@ -413,7 +535,7 @@ const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & inco
         //cout << "Inserting Phrase : " << edgeNgram << endl;
         vector<const Edge*> edgeHistory;
         edgeHistory.push_back(this);
-        storeNgramHistory(edgeNgram, edgeHistory);
+        storeNgramHistory(ngramIndex.Add(edgeNgram), edgeHistory);
       } else {
         break;
       }
@@ -425,9 +547,9 @@ const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & inco
     vector<Edge> & inEdges = it->second;
 
     for (vector<Edge>::iterator edge = inEdges.begin(); edge != inEdges.end(); ++edge) {//add the ngrams straddling prev and curr edge
-      const NgramHistory & edgeIncomingNgrams = edge->GetNgrams(incomingEdges);
+      const NgramHistory & edgeIncomingNgrams = edge->GetNgrams(incomingEdges, ngramIndex);
       for (NgramHistory::const_iterator edgeInNgramHist = edgeIncomingNgrams.begin(); edgeInNgramHist != edgeIncomingNgrams.end(); ++edgeInNgramHist) {
-        const Phrase& edgeIncomingNgram = edgeInNgramHist->first;
+        const Phrase& edgeIncomingNgram = ngramIndex.GetNgram(edgeInNgramHist->first);
         const PathCounts &  edgeIncomingNgramPaths = edgeInNgramHist->second;
         size_t back = min(edgeIncomingNgram.GetSize(), edge->GetWordsSize());
         const Phrase&  edgeWords = edge->GetWords();
@@ -451,11 +573,12 @@ const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & inco
               newNgram.AddWord(GetWords().GetWord(j));
             }
             VERBOSE(3, "Inserting New Phrase : " << newNgram << endl)
+            size_t newNgramId = ngramIndex.Add(newNgram);
 
             for (PathCounts::const_iterator pathIt = edgeIncomingNgramPaths.begin(); pathIt !=  edgeIncomingNgramPaths.end(); ++pathIt) {
               Path newNgramPath = pathIt->first;
               newNgramPath.push_back(this);
-              storeNgramHistory(newNgram, newNgramPath, pathIt->second);
+              storeNgramHistory(newNgramId, newNgramPath, pathIt->second);
             }
           }
         }
@@ -499,9 +622,12 @@ ostream& operator<< (ostream& out, const Edge& edge)
 
 bool ascendingCoverageCmp(const Hypothesis* a, const Hypothesis* b)
 {
-  return (a->GetWordsBitmap().GetNumWordsCovered()
-          <
-          b->GetWordsBitmap().GetNumWordsCovered());
+  size_t coveredA = a->GetWordsBitmap().GetNumWordsCovered();
+  size_t coveredB = b->GetWordsBitmap().GetNumWordsCovered();
+  if (coveredA != coveredB) {
+    return coveredA < coveredB;
+  }
+  return a->GetId() < b->GetId();
 }
 
 void getLatticeMBRNBest(const Manager& manager, const TrellisPathList& nBestList,
@@ -509,7 +635,8 @@ void getLatticeMBRNBest(const Manager& manager, const TrellisPathList& nBestList
 {
   std::map < int, bool > connected;
   std::vector< const Hypothesis *> connectedList;
-  map<Phrase, float> ngramPosteriors;
+  NgramIndex ngramIndex;
+  vector<float> ngramPosteriors;
   std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
   map<const Hypothesis*, vector<Edge> > incomingEdges;
   vector< float> estimatedScores;
@@ -519,7 +646,7 @@ void getLatticeMBRNBest(const Manager& manager, const TrellisPathList& nBestList
   MBR_Options  const& mbr  = manager.options()->mbr;
   pruneLatticeFB(connectedList, outgoingHyps, incomingEdges, estimatedScores,
                  manager.GetBestHypothesis(), lmbr.pruning_factor, mbr.scale);
-  calcNgramExpectations(connectedList, incomingEdges, ngramPosteriors,true);
+  calcNgramExpectations(connectedList, incomingEdges, ngramIndex, ngramPosteriors,true);
 
   vector<float> mbrThetas = lmbr.theta;
   float p = lmbr.precision;
@@ -541,16 +668,18 @@ void getLatticeMBRNBest(const Manager& manager, const TrellisPathList& nBestList
     VERBOSE(2,endl);
   }
   TrellisPathList::const_iterator iter;
-  size_t ctr = 0;
-  LatticeMBRSolutionComparator comparator;
-  for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter, ++ctr) {
+  solutions.reserve(nBestList.GetSize());
+  for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
     const TrellisPath &path = **iter;
     solutions.push_back(LatticeMBRSolution(path,iter==nBestList.begin()));
-    solutions.back().CalcScore(ngramPosteriors, mbrThetas, mapWeight);
-    sort(solutions.begin(), solutions.end(), comparator);
-    while (solutions.size() > n) {
-      solutions.pop_back();
-    }
+  }
+  SolutionScorer scorer = { solutions, ngramIndex, ngramPosteriors, mbrThetas, mapWeight };
+  RunStrided(scorer, ThreadsFor(mbr.threads, solutions.size()));
+
+  //sort once, keeping n-best order among equal scores
+  stable_sort(solutions.begin(), solutions.end(), LatticeMBRSolutionComparator());
+  if (solutions.size() > n) {
+    solutions.erase(solutions.begin() + n, solutions.end());
   }
   VERBOSE(2,"LMBR Score: " << solutions[0].GetScore() << endl);
 }
@@ -565,14 +694,11 @@ vector<Word> doLatticeMBR(const Manager& manager, const TrellisPathList& nBestLi
 
 const TrellisPath doConsensusDecoding(const Manager& manager, const TrellisPathList& nBestList)
 {
-  static const int BLEU_ORDER = 4;
-  static const float SMOOTH = 1;
-
   //calculate the ngram expectations
-  const StaticData& staticData = StaticData::Instance();
   std::map < int, bool > connected;
   std::vector< const Hypothesis *> connectedList;
-  map<Phrase, float> ngramExpectations;
+  NgramIndex ngramIndex;
+  vector<float> ngramExpectations;
   std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
   map<const Hypothesis*, vector<Edge> > incomingEdges;
   vector< float> estimatedScores;
@@ -581,100 +707,39 @@ const TrellisPath doConsensusDecoding(const Manager& manager, const TrellisPathL
   MBR_Options  const&  mbr = manager.options()->mbr;
   pruneLatticeFB(connectedList, outgoingHyps, incomingEdges, estimatedScores,
                  manager.GetBestHypothesis(), lmbr.pruning_factor, mbr.scale);
-  calcNgramExpectations(connectedList, incomingEdges, ngramExpectations,false);
+  calcNgramExpectations(connectedList, incomingEdges, ngramIndex, ngramExpectations,false);
 
   //expected length is sum of expected unigram counts
-  //cerr << "Thread " << pthread_self() <<  " Ngram expectations size: " << ngramExpectations.size() << endl;
   float ref_length = 0.0f;
-  for (map<Phrase,float>::const_iterator ref_iter = ngramExpectations.begin();
-       ref_iter != ngramExpectations.end(); ++ref_iter) {
-    //cerr << "Ngram: " << ref_iter->first << " score: " <<
-    //    ref_iter->second << endl;
-    if (ref_iter->first.GetSize() == 1) {
-      ref_length += exp(ref_iter->second);
-      //    cerr << "Expected for " << ref_iter->first << " is " << exp(ref_iter->second) << endl;
+  for (size_t id = 0; id < ngramExpectations.size(); ++id) {
+    if (ngramIndex.GetNgram(id).GetSize() == 1) {
+      ref_length += exp(ngramExpectations[id]);
     }
   }
 
   VERBOSE(2,"REF Length: " << ref_length << endl);
 
   //use the ngram expectations to rescore the nbest list.
-  TrellisPathList::const_iterator iter;
-  TrellisPathList::const_iterator best = nBestList.end();
-  float bestScore = -100000;
-  //cerr << "nbest list size: " << nBestList.GetSize() << endl;
-  for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
-    const TrellisPath &path = **iter;
-    vector<Word> words;
-    map<Phrase,int> ngrams;
-    GetOutputWords(path,words);
-    /*for (size_t i = 0; i < words.size(); ++i) {
-        cerr << words[i].GetFactor(0)->GetString() << " ";
-    }
-    cerr << endl;
-    */
-    extract_ngrams(words,ngrams);
-
-    vector<float> comps(2*BLEU_ORDER+1);
-    float logbleu = 0.0;
-    float brevity = 0.0;
-    int hyp_length = words.size();
-    for (int i = 0; i < BLEU_ORDER; ++i) {
-      comps[2*i] = 0.0;
-      comps[2*i+1] = max(hyp_length-i,0);
-    }
-
-    for (map<Phrase,int>::const_iterator hyp_iter = ngrams.begin();
-         hyp_iter != ngrams.end(); ++hyp_iter) {
-      map<Phrase,float>::const_iterator ref_iter = ngramExpectations.find(hyp_iter->first);
-      if (ref_iter != ngramExpectations.end()) {
-        comps[2*(hyp_iter->first.GetSize()-1)] += min(exp(ref_iter->second), (float)(hyp_iter->second));
-      }
-
-    }
-    comps[comps.size()-1] = ref_length;
-    /*for (size_t i = 0; i < comps.size(); ++i) {
-        cerr << comps[i] << " ";
-    }
-    cerr << endl;
-    */
-
-    float score = 0.0f;
-    if (comps[0] != 0) {
-      for (int i=0; i<BLEU_ORDER; i++) {
-        if ( i > 0 ) {
-          logbleu += log((float)comps[2*i]+SMOOTH)-log((float)comps[2*i+1]+SMOOTH);
-        } else {
-          logbleu += log((float)comps[2*i])-log((float)comps[2*i+1]);
-        }
-      }
-      logbleu /= BLEU_ORDER;
-      brevity = 1.0-(float)comps[comps.size()-1]/comps[1]; // comps[comps_n-1] is the ref length, comps[1] is the test length
-      if (brevity < 0.0) {
-        logbleu += brevity;
-      }
-      score =  exp(logbleu);
-    }
+  vector<const TrellisPath*> paths;
+  for (TrellisPathList::const_iterator iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
+    paths.push_back(*iter);
+  }
+  vector<float> scores(paths.size());
+  ConsensusScorer scorer = { paths, ngramIndex, ngramExpectations, ref_length, scores };
+  RunStrided(scorer, ThreadsFor(mbr.threads, paths.size()));
 
-    //cerr << "score: " << score << " bestScore: " << bestScore <<  endl;
-    if (score > bestScore) {
-      bestScore = score;
-      best = iter;
-      VERBOSE(2,"NEW BEST: " << score << endl);
-      //for (size_t i = 0; i < comps.size(); ++i) {
-      //    cerr << comps[i] << " ";
-      //}
-      //cerr << endl;
+  size_t best = paths.size();
+  float bestScore = -100000;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (scores[i] > bestScore) {
+      bestScore = scores[i];
+      best = i;
+      VERBOSE(2,"NEW BEST: " << scores[i] << endl);
     }
   }
 
-  assert (best != nBestList.end());
-  return **best;
-  //vector<Word> bestWords;
-  //GetOutputWords(**best,bestWords);
-  //return bestWords;
+  assert (best != paths.size());
+  return *paths[best];
 }
 
 }
-
-
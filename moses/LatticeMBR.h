@@ -13,6 +13,7 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <boost/unordered_map.hpp>
 #include "moses/Hypothesis.h"
 #include "moses/Manager.h"
 #include "moses/TrellisPathList.h"
@@ -26,8 +27,40 @@ class Edge;
 
 typedef std::vector< const Moses::Hypothesis *> Lattice;
 typedef std::vector<const Edge*> Path;
-typedef std::map<Path, size_t> PathCounts;
-typedef std::map<Moses::Phrase, PathCounts > NgramHistory;
+
+/** Orders paths by the lattice positions of their edges, not their addresses */
+struct PathComparator {
+  bool operator()(const Path& a, const Path& b) const;
+};
+
+typedef std::map<Path, size_t, PathComparator> PathCounts;
+typedef boost::unordered_map<size_t, PathCounts > NgramHistory; //! keyed by n-gram id
+
+/**
+* Numbers the ngrams found in the lattice, so that per node and per solution
+* statistics are small tables keyed by integer id
+*/
+class NgramIndex
+{
+public:
+  /** id of ngram, numbering it if it is new */
+  size_t Add(const Moses::Phrase& ngram);
+
+  /** id of ngram, or NOT_FOUND */
+  size_t Find(const Moses::Phrase& ngram) const;
+
+  const Moses::Phrase& GetNgram(size_t id) const {
+    return *m_ngrams[id];
+  }
+
+  size_t GetSize() const {
+    return m_ngrams.size();
+  }
+
+private:
+  boost::unordered_map<Moses::Phrase, size_t> m_ids;
+  std::vector<const Moses::Phrase*> m_ngrams; //! keys of m_ids, by id
+};
 
 class Edge
 {
@@ -36,9 +69,10 @@ class Edge
   float m_score;
   Moses::TargetPhrase m_targetPhrase;
   NgramHistory m_ngrams;
+  size_t m_index;
 
 public:
-  Edge(const Moses::Hypothesis* from, const Moses::Hypothesis* to, float score, const Moses::TargetPhrase& targetPhrase) : m_tailNode(from), m_headNode(to), m_score(score), m_targetPhrase(targetPhrase) {
+  Edge(const Moses::Hypothesis* from, const Moses::Hypothesis* to, float score, const Moses::TargetPhrase& targetPhrase) : m_tailNode(from), m_headNode(to), m_score(score), m_targetPhrase(targetPhrase), m_index(0) {
     //cout << "Creating new edge from Node " << from->GetId() << ", to Node : " << to->GetId() << ", score: " << score << " phrase: " << targetPhrase << endl;
   }
 
@@ -54,6 +88,15 @@ public:
     return m_score;
   }
 
+  /** position of the edge in the sorted lattice */
+  size_t GetIndex() const {
+    return m_index;
+  }
+
+  void SetIndex(size_t index) {
+    m_index = index;
+  }
+
   size_t GetWordsSize() const {
     return m_targetPhrase.GetSize();
   }
@@ -64,37 +107,41 @@ public:
 
   friend std::ostream& operator<< (std::ostream& out, const Edge& edge);
 
-  const NgramHistory&  GetNgrams(  std::map<const Moses::Hypothesis*, std::vector<Edge> > & incomingEdges) ;
+  const NgramHistory&  GetNgrams(  std::map<const Moses::Hypothesis*, std::vector<Edge> > & incomingEdges, NgramIndex& ngramIndex) ;
 
   bool operator < (const Edge & compare) const;
 
   void GetPhraseSuffix(const Moses::Phrase& origPhrase, size_t lastN, Moses::Phrase& targetPhrase) const;
 
-  void storeNgramHistory(const Moses::Phrase& phrase, Path & path, size_t count = 1) {
-    m_ngrams[phrase][path]+= count;
+  void storeNgramHistory(size_t ngram, Path & path, size_t count = 1) {
+    m_ngrams[ngram][path]+= count;
   }
 
 };
 
 /**
-* Data structure to hold the ngram scores as we traverse the lattice. Maps (hypo,ngram) to score
+* Data structure to hold the ngram scores as we traverse the lattice. Maps (node,ngram id) to
+* score, where nodes are numbered by their position in the lattice
 */
 class NgramScores
 {
 public:
-  NgramScores() {}
+  explicit NgramScores(size_t nodes) : m_scores(nodes) {}
 
   /** logsum this score to the existing score */
-  void addScore(const Moses::Hypothesis* node, const Moses::Phrase& ngram, float score);
+  void addScore(size_t node, size_t ngram, float score);
 
   /** Iterate through ngrams for selected node */
-  typedef std::map<const Moses::Phrase*, float>::const_iterator NodeScoreIterator;
-  NodeScoreIterator nodeBegin(const Moses::Hypothesis* node);
-  NodeScoreIterator nodeEnd(const Moses::Hypothesis* node);
+  typedef boost::unordered_map<size_t, float>::const_iterator NodeScoreIterator;
+  NodeScoreIterator nodeBegin(size_t node) const {
+    return m_scores[node].begin();
+  }
+  NodeScoreIterator nodeEnd(size_t node) const {
+    return m_scores[node].end();
+  }
 
 private:
-  std::set<Moses::Phrase> m_ngrams;
-  std::map<const Moses::Hypothesis*, std::map<const Moses::Phrase*, float> > m_scores;
+  std::vector<boost::unordered_map<size_t, float> > m_scores;
 };
 
 
@@ -117,8 +164,8 @@ public:
     return m_score;
   }
 
-  /** Initialise ngram scores */
-  void CalcScore(std::map<Moses::Phrase, float>& finalNgramScores, const std::vector<float>& thetas, float mapWeight);
+  /** Initialise ngram scores from the posteriors of the indexed ngrams */
+  void CalcScore(const NgramIndex& ngramIndex, const std::vector<float>& finalNgramScores, const std::vector<float>& thetas, float mapWeight);
 
 private:
   std::vector<Moses::Word> m_words;
@@ -128,7 +175,7 @@ private:
 };
 
 struct LatticeMBRSolutionComparator {
-  bool operator()(const LatticeMBRSolution& a, const LatticeMBRSolution& b) {
+  bool operator()(const LatticeMBRSolution& a, const LatticeMBRSolution& b) const {
     return a.GetScore() > b.GetScore();
   }
 };
@@ -139,8 +186,9 @@ void pruneLatticeFB(Lattice & connectedHyp, std::map < const Moses::Hypothesis*,
 //Use the ngram scores to rerank the nbest list, return at most n solutions
 void getLatticeMBRNBest(const Moses::Manager& manager, const Moses::TrellisPathList& nBestList, std::vector<LatticeMBRSolution>& solutions, size_t n);
 //calculate expectated ngram counts, clipping at 1 (ie calculating posteriors) if posteriors==true.
-void calcNgramExpectations(Lattice & connectedHyp, std::map<const Moses::Hypothesis*, std::vector<Edge> >& incomingEdges, std::map<Moses::Phrase,
-                           float>& finalNgramScores, bool posteriors);
+//finalNgramScores is indexed by the ids in ngramIndex.
+void calcNgramExpectations(Lattice & connectedHyp, std::map<const Moses::Hypothesis*, std::vector<Edge> >& incomingEdges, NgramIndex& ngramIndex,
+                           std::vector<float>& finalNgramScores, bool posteriors);
 void GetOutputFactors(const Moses::TrellisPath &path, std::vector <Moses::Word> &translation);
 void extract_ngrams(const std::vector<Moses::Word >& sentence, std::map < Moses::Phrase, int >  & allngrams);
 bool ascendingCoverageCmp(const Moses::Hypothesis* a, const Moses::Hypothesis* b);
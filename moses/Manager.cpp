@@ -34,7 +34,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "Util.h"
 #include "TargetPhrase.h"
 #include "TrellisPath.h"
-#include "TrellisPathCollection.h"
+#include "TrellisPathKBestExtractor.h"
 #include "TranslationOption.h"
 #include "TranslationOptionCollection.h"
 #include "Timer.h"
@@ -247,7 +247,7 @@ printThisHypothesis(long translationId, const Hypothesis* hypo,
 /**
  * After decoding, the hypotheses in the stacks and additional arcs
  * form a search graph that can be mined for n-best lists.
- * The heavy lifting is done in the TrellisPath and TrellisPathCollection
+ * The heavy lifting is done in the TrellisPath and TrellisPathKBestExtractor
  * this function controls this for one sentence.
  *
  * \param count the number of n-best translations to produce
@@ -265,51 +265,8 @@ void Manager::CalcNBest(size_t count, TrellisPathList &ret, bool onlyDistinct) c
   if (sortedPureHypo.size() == 0)
     return;
 
-  TrellisPathCollection contenders;
-
-  set<Phrase> distinctHyps;
-
-  // add all pure paths
-  vector<const Hypothesis*>::const_iterator iterBestHypo;
-  for (iterBestHypo = sortedPureHypo.begin()
-                      ; iterBestHypo != sortedPureHypo.end()
-       ; ++iterBestHypo) {
-    contenders.Add(new TrellisPath(*iterBestHypo));
-  }
-
-  // factor defines stopping point for distinct n-best list if too
-  // many candidates identical
-  size_t nBestFactor = options()->nbest.factor;
-  if (nBestFactor < 1) nBestFactor = 1000; // 0 = unlimited
-
-  // MAIN loop
-  for (size_t iteration = 0 ; (onlyDistinct ? distinctHyps.size() : ret.GetSize()) < count && contenders.GetSize() > 0 && (iteration < count * nBestFactor) ; iteration++) {
-    // get next best from list of contenders
-    TrellisPath *path = contenders.pop();
-    UTIL_THROW_IF2(path == NULL, "path is NULL");
-    // create deviations from current best
-    path->CreateDeviantPaths(contenders);
-    if(onlyDistinct) {
-      Phrase tgtPhrase = path->GetSurfacePhrase();
-      if (distinctHyps.insert(tgtPhrase).second) {
-        ret.Add(path);
-      } else {
-        delete path;
-        path = NULL;
-      }
-    } else {
-      ret.Add(path);
-    }
-
-
-    if(onlyDistinct) {
-      const size_t nBestFactor = options()->nbest.factor;
-      if (nBestFactor > 0)
-        contenders.Prune(count * nBestFactor);
-    } else {
-      contenders.Prune(count);
-    }
-  }
+  TrellisPathKBestExtractor extractor(count, onlyDistinct, options()->nbest.factor);
+  extractor.Extract(sortedPureHypo, ret);
 }
 
 struct SGNReverseCompare {
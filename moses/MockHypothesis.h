@@ -64,8 +64,9 @@ private:
   Moses::WordPenaltyProducer m_wp;
   Moses::UnknownWordPenaltyProducer m_uwp;
   Moses::DistortionScoreProducer m_dist;
-  boost::shared_ptr<Moses::Manager> m_manager;
+  // the manager hands the task to the features when it is destroyed
   boost::shared_ptr<Moses::TranslationTask> m_ttask;
+  boost::shared_ptr<Moses::Manager> m_manager;
   Moses::Hypothesis* m_hypothesis;
   std::vector<Moses::TargetPhrase> m_targetPhrases;
   std::vector<Moses::TranslationOption*> m_toptions;
@@ -121,6 +121,7 @@ Parameter::Parameter()
   po::options_description cube_opts("Cube pruning options.");
   AddParam(cube_opts,"cube-pruning-pop-limit", "cbp", "How many hypotheses should be popped for each stack. (default = 1000)");
   AddParam(cube_opts,"cube-pruning-diversity", "cbd", "How many hypotheses should be created for each coverage. (default = 0)");
+  AddParam(cube_opts,"cube-pruning-lookahead", "cbla", "Pop this many hypotheses from a coverage at a time and score their successors together, prefetching language model lookups. (default = 1)");
   AddParam(cube_opts,"cube-pruning-lazy-scoring", "cbls", "Don't fully score a hypothesis until it is popped");
   AddParam(cube_opts,"cube-pruning-deterministic-search", "cbds", "Break ties deterministically during search");
 
@@ -131,6 +132,7 @@ Parameter::Parameter()
   AddParam(mbr_opts,"minimum-bayes-risk", "mbr", "use miminum Bayes risk to determine best translation");
   AddParam(mbr_opts,"mbr-size", "number of translation candidates considered in MBR decoding (default 200)");
   AddParam(mbr_opts,"mbr-scale", "scaling factor to convert log linear score probability in MBR decoding (default 1.0)");
+  AddParam(mbr_opts,"mbr-threads", "number of threads scoring the candidate translations of one sentence in (lattice) MBR and consensus decoding (default 1)");
 
   AddParam(mbr_opts,"lminimum-bayes-risk", "lmbr", "use lattice miminum Bayes risk to determine best translation");
   AddParam(mbr_opts,"consensus-decoding", "con", "use consensus decoding (De Nero et. al. 2009)");
@@ -162,6 +164,7 @@ Parameter::Parameter()
   AddParam(input_opts,"xml-input", "xi", "allows markup of input with desired translations and probabilities. values can be 'pass-through' (default), 'inclusive', 'exclusive', 'constraint', 'ignore'");
   AddParam(input_opts,"xml-brackets", "xb", "specify strings to be used as xml tags opening and closing, e.g. \"{{ }}\" (default \"< >\"). Avoid square brackets because of configuration file format. Valid only with text input mode" );
   AddParam(input_opts,"start-translation-id", "Id of 1st input. Default = 0");
+  AddParam(input_opts,"document-input", "lines between <doc ...> and </doc> form one document, decoded in order by a single thread; <doc context-weights=\"...\"> gives a document its own context weights (default false)");
   AddParam(input_opts,"alternate-weight-setting", "aws", "alternate set of weights to used per xml specification");
 
   ///////////////////////////////////////////////////////////////////////////////////////
@@ -1319,6 +1322,8 @@ Validate()
     ext.push_back(".binlexr.idx");
     //prefix tree format
     ext.push_back(".minlexr");
+    //hashed, quantized format
+    ext.push_back(".hlexr");
     noErrorFlag = FilesExist("distortion-file", 3, ext);
   }
   return noErrorFlag;
@@ -0,0 +1,154 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "StaticData.h"
+#include "TargetPhrase.h"
+#include "TargetPhraseCollection.h"
+#include "TranslationModel/PhraseDictionaryMemory.h"
+#include "TranslationModel/RuleTable/LoaderBinary.h"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(rule_table_snapshot)
+
+namespace
+{
+const char *rules[] = {
+  "das haus [X] ||| the house [X] ||| 0.5 0.25 ||| 0-0 1-1 |||",
+  "das haus [X] ||| the home [X] ||| 0.125 0.5 ||| 0-0 1-1 |||",
+  "das [X][X] [X] ||| the [X][X] [X] ||| 0.75 0.5 ||| 0-0 1-1 |||",
+  "klein [X] ||| small [X] ||| 1 0.5 ||| 0-0 |||"
+};
+
+const char *sources[] = { "das haus", "klein", "das", "haus" };
+
+struct TempDir {
+  boost::filesystem::path dir;
+  TempDir() : dir(boost::filesystem::temp_directory_path()
+                    / boost::filesystem::unique_path()) {
+    boost::filesystem::create_directory(dir);
+  }
+  ~TempDir() {
+    boost::filesystem::remove_all(dir);
+  }
+};
+
+// The decoder keeps its features registered for its whole run, and so do
+// these: they are never deleted.
+PhraseDictionaryMemory *LoadTable(const string &name, const string &table,
+                                  const string &snapshot)
+{
+  PhraseDictionaryMemory *pt = new PhraseDictionaryMemory(
+    "PhraseDictionaryMemory name=" + name + " num-features=2 input-factor=0"
+    " output-factor=0 path=" + table + " snapshot=" + snapshot);
+  FeatureFunction::Register(pt);
+  AllOptions::ptr opts(new AllOptions(*StaticData::Instance().options()));
+  pt->Load(opts);
+  return pt;
+}
+
+// target phrases and scores of source, as text
+vector<string> Lookup(const PhraseDictionaryMemory &pt, const string &source)
+{
+  vector<FactorType> factors(1, 0);
+  Phrase phrase;
+  phrase.CreateFromString(Input, factors, source, NULL);
+  vector<string> ret;
+  TargetPhraseCollection::shared_ptr tpc = pt.GetTargetPhraseCollectionLEGACY(phrase);
+  if (!tpc) return ret;
+  for (TargetPhraseCollection::const_iterator it = tpc->begin(); it != tpc->end(); ++it) {
+    ostringstream out;
+    out << (*it)->GetStringRep(factors);
+    vector<float> scores = (*it)->GetScoreBreakdown().GetScoresForProducer(&pt);
+    for (size_t i = 0; i < scores.size(); ++i) out << " " << scores[i];
+    ret.push_back(out.str());
+  }
+  return ret;
+}
+}
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+  TempDir tmp;
+  string table = (tmp.dir / "rule-table").string();
+  string snapshot = (tmp.dir / "rule-table.bin").string();
+  {
+    ofstream out(table.c_str());
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); ++i) {
+      out << rules[i] << "\n";
+    }
+  }
+
+  // parses the text table and writes the snapshot
+  const PhraseDictionaryMemory *text = LoadTable("SnapshotText", table, snapshot);
+  BOOST_REQUIRE(RuleTableLoaderBinary::IsUpToDate(snapshot, table));
+
+  // reads the snapshot
+  const PhraseDictionaryMemory *binary = LoadTable("SnapshotBinary", table, snapshot);
+
+  BOOST_CHECK_EQUAL(Lookup(*text, "das haus").size(), 2);
+  BOOST_CHECK_EQUAL(Lookup(*text, "klein").size(), 1);
+  for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i) {
+    vector<string> expected = Lookup(*text, sources[i]);
+    vector<string> actual = Lookup(*binary, sources[i]);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  actual.begin(), actual.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(stale_after_edit_with_same_mtime)
+{
+  TempDir tmp;
+  string table = (tmp.dir / "rule-table").string();
+  string snapshot = (tmp.dir / "rule-table.bin").string();
+  {
+    ofstream out(table.c_str());
+    out << rules[0] << "\n";
+  }
+  LoadTable("SnapshotStale", table, snapshot);
+  BOOST_REQUIRE(RuleTableLoaderBinary::IsUpToDate(snapshot, table));
+
+  // edit the table, but keep its modification time
+  struct stat before;
+  BOOST_REQUIRE(stat(table.c_str(), &before) == 0);
+  {
+    ofstream out(table.c_str(), ios::app);
+    out << rules[3] << "\n";
+  }
+  struct utimbuf times;
+  times.actime = before.st_atime;
+  times.modtime = before.st_mtime;
+  BOOST_REQUIRE(utime(table.c_str(), &times) == 0);
+
+  BOOST_CHECK(!RuleTableLoaderBinary::IsUpToDate(snapshot, table));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 #include "StaticData.h"
 #include "InputType.h"
 #include "TranslationOptionCollection.h"
+#include <algorithm>
 #include <boost/foreach.hpp>
 using namespace std;
 
@@ -92,6 +93,9 @@ void SearchCubePruning::Decode()
 
   const size_t Diversity = m_manager.options()->cube.diversity;
   VERBOSE(2,"Cube Pruning diversity is " << Diversity << std::endl);
+
+  const size_t Lookahead = m_manager.options()->cube.lookahead;
+  VERBOSE(2,"Cube Pruning lookahead is " << Lookahead << std::endl);
   VERBOSE(2,"Max Phrase length is "
           << m_manager.options()->search.max_phrase_length << std::endl);
 
@@ -129,23 +133,25 @@ void SearchCubePruning::Decode()
     }
 
     // main search loop, pop k best hyps
-    for (size_t numpops = 1; numpops <= PopLimit && !BCQueue.empty(); numpops++) {
+    for (size_t numpops = 1; numpops <= PopLimit && !BCQueue.empty(); ) {
       // get currently best hypothesis in queue
       m_manager.GetSentenceStats().StartTimeManageCubes();
       BitmapContainer *bc = BCQueue.top();
       BCQueue.pop();
       m_manager.GetSentenceStats().StopTimeManageCubes();
-      IFVERBOSE(2) {
-        m_manager.GetSentenceStats().AddPopped();
-      }
-      // push on stack and create successors
+      // push on stack and create successors, Lookahead hypotheses at a time
       IFVERBOSE(2) {
         m_manager.GetSentenceStats().StartTimeOtherScore();
       }
-      bc->ProcessBestHypothesis();
+      const size_t popped = bc->ProcessBestHypotheses(std::min(Lookahead, PopLimit - numpops + 1));
+      numpops += popped;
       IFVERBOSE(2) {
         m_manager.GetSentenceStats().StopTimeOtherScore();
       }
+      IFVERBOSE(2) {
+        for (size_t i = 0; i < popped; ++i)
+          m_manager.GetSentenceStats().AddPopped();
+      }
       // if there are any hypothesis left in this specific container, add back to queue
       m_manager.GetSentenceStats().StartTimeManageCubes();
       if (!bc->Empty())
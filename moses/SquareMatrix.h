@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "TypeDef.h"
 #include "Util.h"
 #include "Bitmap.h"
+#include "DecodeArena.h"
 
 namespace Moses
 {
@@ -44,10 +45,10 @@ protected:
 public:
   SquareMatrix(size_t size)
     :m_size(size) {
-    m_array = (float*) malloc(sizeof(float) * size * size);
+    m_array = (float*) DecodeArena::Allocate(sizeof(float) * size * size);
   }
   ~SquareMatrix() {
-    free(m_array);
+    DecodeArena::Free(m_array, sizeof(float) * m_size * m_size);
   }
 
   // set upper triangle
@@ -0,0 +1,100 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Sentence.h"
+#include "StaticData.h"
+#include "TranslationTask.h"
+#include "TranslationModel/UG/mm/ug_tiered_bitext.h"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(tiered_bitext)
+
+namespace
+{
+typedef sapt::L2R_Token<sapt::SimpleWordId> Token;
+typedef sapt::TieredBitext<Token> tbitext;
+
+struct TwoTiers {
+  SPTR<sapt::TokenIndex> V1, V2;
+  tbitext bt;
+  ttasksptr ttask;
+
+  // one sentence pair per segment, never merged
+  TwoTiers()
+    : V1(new sapt::TokenIndex), V2(new sapt::TokenIndex)
+    , bt(V1, V2, 100, 1, 1, 100)
+    , ttask(TranslationTask::create(boost::shared_ptr<InputType>(new Sentence(
+        AllOptions::ptr(new AllOptions(*StaticData::Instance().options())),
+        0, "a")))) {
+    Add("a b", "x y", "0-0 1-1");
+    Add("c", "x", "0-0");
+  }
+
+  void Add(const string &s1, const string &s2, const string &aln) {
+    bt.add(vector<string>(1, s1), vector<string>(1, s2), vector<string>(1, aln));
+  }
+
+  // phrase pairs of the L1 word w
+  vector<sapt::PhrasePair<Token> > Lookup(const string &w) const {
+    vector<tpt::id_type> phrase(1, (*V1)[w]);
+    vector<sapt::PhrasePair<Token> > ret;
+    BOOST_REQUIRE(bt.snapshot()->lookup(ttask, phrase, ret, NULL));
+    return ret;
+  }
+
+  string Target(const sapt::PhrasePair<Token> &pp) const {
+    return (*V2)[pp.start2->id()];
+  }
+};
+}
+
+BOOST_FIXTURE_TEST_CASE(target_marginal_counts_every_tier, TwoTiers)
+{
+  BOOST_REQUIRE_EQUAL(bt.snapshot()->segments.size(), 2);
+
+  // "a" is in the first tier only, its translation "x" in both
+  vector<sapt::PhrasePair<Token> > pps = Lookup("a");
+  BOOST_REQUIRE_EQUAL(pps.size(), 1);
+  BOOST_CHECK_EQUAL(Target(pps[0]), "x");
+  BOOST_CHECK_EQUAL(pps[0].raw1, 1);
+  BOOST_CHECK_EQUAL(pps[0].joint, 1);
+  BOOST_CHECK_EQUAL(pps[0].raw2, 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(source_in_two_tiers, TwoTiers)
+{
+  Add("a", "x", "0-0");
+  BOOST_REQUIRE_EQUAL(bt.snapshot()->segments.size(), 3);
+
+  vector<sapt::PhrasePair<Token> > pps = Lookup("a");
+  BOOST_REQUIRE_EQUAL(pps.size(), 1);
+  BOOST_CHECK_EQUAL(Target(pps[0]), "x");
+  BOOST_CHECK_EQUAL(pps[0].raw1, 2);
+  BOOST_CHECK_EQUAL(pps[0].joint, 2);
+  BOOST_CHECK_EQUAL(pps[0].raw2, 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
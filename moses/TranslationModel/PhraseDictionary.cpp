@@ -197,6 +197,16 @@ void PhraseDictionary::ReduceCache() const
           << reduceCacheTime << " seconds." << std::endl);
 }
 
+void
+PhraseDictionary::
+InitializeForDocument()
+{
+  for (size_t i = 0; i < s_staticColl.size(); ++i) {
+    CacheColl *cache = s_staticColl[i]->m_cache.get();
+    if (cache) cache->clear();
+  }
+}
+
 CacheColl &
 PhraseDictionary::
 GetCache() const
@@ -131,6 +131,12 @@ public:
   virtual void CleanUpAfterSentenceProcessing(const InputType& source) {
   }
 
+  //! document-input: called by the thread that is about to decode a
+  //! document. Empties this thread's lookup cache (cache-size) in every
+  //! phrase table, so that the cached lookups are only reused by the
+  //! sentences of one document.
+  static void InitializeForDocument();
+
   //! Create a sentence-specific manager for SCFG rule lookup.
   virtual ChartRuleLookupManager *CreateRuleLookupManager(
     const ChartParser &,
@@ -12,19 +12,42 @@ namespace Moses
 {
 PhraseDictionaryTransliteration::PhraseDictionaryTransliteration(const std::string &line)
   : PhraseDictionary(line, true)
+  , m_mode("script")
+  , m_nBestSize(50)
+  , m_decoderThreads(1)
+  , m_transliterationCacheSize(10000)
 {
   ReadParameters();
-  UTIL_THROW_IF2(m_mosesDir.empty() ||
-                 m_scriptDir.empty() ||
-                 m_externalDir.empty() ||
-                 m_inputLang.empty() ||
-                 m_outputLang.empty(), "Must specify all arguments");
+  if (m_mode == "decoder") {
+    UTIL_THROW_IF2(m_mosesDir.empty(), "Must specify moses-dir");
+    if (m_config.empty()) {
+      m_config = m_filePath + "/tuning/moses.tuned.ini";
+    }
+  } else {
+    UTIL_THROW_IF2(m_mode != "script", "Unknown transliteration mode " << m_mode);
+    UTIL_THROW_IF2(m_mosesDir.empty() ||
+                   m_scriptDir.empty() ||
+                   m_externalDir.empty() ||
+                   m_inputLang.empty() ||
+                   m_outputLang.empty(), "Must specify all arguments");
+  }
+}
+
+PhraseDictionaryTransliteration::~PhraseDictionaryTransliteration()
+{
 }
 
 void PhraseDictionaryTransliteration::Load(AllOptions::ptr const& opts)
 {
   m_options = opts;
   SetFeaturesToApply();
+
+  if (m_mode == "decoder") {
+    vector<string> argv = TransliterationDecoder::MosesArgs(m_mosesDir, m_config, m_nBestSize, m_decoderThreads);
+    UTIL_THROW_IF2(!FileExists(argv[0]), "Transliteration decoder " << argv[0] << " not found");
+    UTIL_THROW_IF2(!FileExists(m_config), "Transliteration model " << m_config << " not found");
+    m_decoder.reset(new TransliterationDecoder(argv, m_transliterationCacheSize));
+  }
 }
 
 void PhraseDictionaryTransliteration::CleanUpAfterSentenceProcessing(const InputType& source)
@@ -34,6 +57,7 @@ void PhraseDictionaryTransliteration::CleanUpAfterSentenceProcessing(const Input
 
 void PhraseDictionaryTransliteration::GetTargetPhraseCollectionBatch(const InputPathList &inputPathQueue) const
 {
+  vector<InputPath*> decoderPaths;
 
   InputPathList::const_iterator iter;
   for (iter = inputPathQueue.begin(); iter != inputPathQueue.end(); ++iter) {
@@ -50,7 +74,38 @@ void PhraseDictionaryTransliteration::GetTargetPhraseCollectionBatch(const Input
       continue;
     }
 
-    GetTargetPhraseCollection(inputPath);
+    if (m_decoder) {
+      decoderPaths.push_back(&inputPath);
+    } else {
+      GetTargetPhraseCollection(inputPath);
+    }
+  }
+
+  if (!decoderPaths.empty()) {
+    GetTargetPhraseCollectionsFromDecoder(decoderPaths);
+  }
+}
+
+void
+PhraseDictionaryTransliteration::
+GetTargetPhraseCollectionsFromDecoder(const std::vector<InputPath*> &inputPaths) const
+{
+  // all of the sentence's words in one go
+  vector<string> words(inputPaths.size());
+  for (size_t i = 0; i < inputPaths.size(); ++i) {
+    words[i] = inputPaths[i]->GetPhrase().GetWord(0).GetString(m_input, false);
+  }
+  vector<Transliterations> transliterations;
+  m_decoder->Transliterate(words, transliterations);
+
+  for (size_t i = 0; i < inputPaths.size(); ++i) {
+    const Phrase &sourcePhrase = inputPaths[i]->GetPhrase();
+    TargetPhraseCollection::shared_ptr tpColl(new TargetPhraseCollection);
+    vector<TargetPhrase*> targetPhrases = CreateTargetPhrases(sourcePhrase, transliterations[i]);
+    for (vector<TargetPhrase*>::const_iterator iter = targetPhrases.begin(); iter != targetPhrases.end(); ++iter) {
+      tpColl->Add(*iter);
+    }
+    inputPaths[i]->SetTargetPhrases(*this, tpColl, NULL);
   }
 }
 
@@ -135,6 +190,26 @@ std::vector<TargetPhrase*> PhraseDictionaryTransliteration::CreateTargetPhrases(
   return ret;
 }
 
+std::vector<TargetPhrase*> PhraseDictionaryTransliteration::CreateTargetPhrases(const Phrase &sourcePhrase, const Transliterations &transliterations) const
+{
+  std::vector<TargetPhrase*> ret;
+
+  for (Transliterations::const_iterator iter = transliterations.begin(); iter != transliterations.end(); ++iter) {
+    TargetPhrase *tp = new TargetPhrase(this);
+    Word &word = tp->AddWord();
+    word.CreateFromString(Output, m_output, iter->first, false);
+
+    tp->GetScoreBreakdown().PlusEquals(this, iter->second);
+
+    // score of all other ff when this rule is being loaded
+    tp->EvaluateInIsolation(sourcePhrase, GetFeaturesToApply());
+
+    ret.push_back(tp);
+  }
+
+  return ret;
+}
+
 ChartRuleLookupManager* PhraseDictionaryTransliteration::CreateRuleLookupManager(const ChartParser &parser,
     const ChartCellCollectionBase &cellCollection,
     std::size_t /*maxChartSpan*/)
@@ -157,6 +232,16 @@ SetParameter(const std::string& key, const std::string& value)
     m_inputLang = value;
   } else if (key == "output-lang") {
     m_outputLang = value;
+  } else if (key == "mode") {
+    m_mode = value;
+  } else if (key == "config") {
+    m_config = value;
+  } else if (key == "nbest") {
+    m_nBestSize = Scan<size_t>(value);
+  } else if (key == "decoder-threads") {
+    m_decoderThreads = Scan<size_t>(value);
+  } else if (key == "transliteration-cache-size") {
+    m_transliterationCacheSize = Scan<size_t>(value);
   } else {
     PhraseDictionary::SetParameter(key, value);
   }
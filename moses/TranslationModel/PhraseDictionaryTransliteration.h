@@ -2,7 +2,9 @@
 #pragma once
 
 #include "PhraseDictionary.h"
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread/tss.hpp>
+#include "TransliterationDecoder.h"
 
 namespace Moses
 {
@@ -11,12 +13,28 @@ class ChartCellCollectionBase;
 class ChartRuleLookupManager;
 class InputPath;
 
+/** Transliterates unknown single words with a character-based Moses model.
+ *
+ * With mode=script (the default), every word is run through
+ * scripts/Transliteration/prepare-transliteration-phrase-table.pl.
+ *
+ * With mode=decoder, one decoder for the transliteration model is started at
+ * load time and kept running. The unknown words of each sentence are sent
+ * to it together, and its n-best lists are remembered in a cache shared by
+ * all threads, of at most transliteration-cache-size words.
+ *
+ * Unlike the script, the decoder does not filter and binarize the model's
+ * tables for the words: it loads config (by default the unfiltered
+ * tuning/moses.tuned.ini of the model) as it is. Give it a config with
+ * binarized tables for large models.
+ */
 class PhraseDictionaryTransliteration : public PhraseDictionary
 {
   friend std::ostream& operator<<(std::ostream&, const PhraseDictionaryTransliteration&);
 
 public:
   PhraseDictionaryTransliteration(const std::string &line);
+  ~PhraseDictionaryTransliteration();
 
   void Load(AllOptions::ptr const& opts);
 
@@ -33,12 +51,22 @@ public:
   TO_STRING();
 
 protected:
+  typedef TransliterationDecoder::Transliterations Transliterations;
+
   std::string m_mosesDir, m_scriptDir, m_externalDir, m_inputLang, m_outputLang;
 
+  std::string m_mode, m_config;
+  size_t m_nBestSize, m_decoderThreads, m_transliterationCacheSize;
+
   std::vector<TargetPhrase*> CreateTargetPhrases(const Phrase &sourcePhrase, const std::string &outDir) const;
+  std::vector<TargetPhrase*> CreateTargetPhrases(const Phrase &sourcePhrase, const Transliterations &transliterations) const;
 
   void GetTargetPhraseCollection(InputPath &inputPath) const;
 
+  // decoder mode
+  void GetTargetPhraseCollectionsFromDecoder(const std::vector<InputPath*> &inputPaths) const;
+
+  mutable boost::scoped_ptr<TransliterationDecoder> m_decoder;
 };
 
 }  // namespace Moses
@@ -0,0 +1,406 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2011 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "LoaderBinary.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "Trie.h"
+#include "moses/FactorCollection.h"
+#include "moses/Word.h"
+#include "moses/Util.h"
+#include "moses/StaticData.h"
+#include "moses/TargetPhrase.h"
+#include "util/file.hh"
+#include "util/mmap.hh"
+#include "util/exception.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+const char kMagic[8] = "mosrtbl";
+const uint32_t kVersion = 2;
+
+// fixed part of a rule record; followed by the scores, the words as
+// (isNonTerminal, factor id...) tuples, the alignment points, the sparse
+// score and property strings, and padding to a multiple of 4 bytes.
+struct RuleRecord {
+  uint16_t sourceSize;
+  uint16_t targetSize;
+  uint16_t numAlign;
+  uint8_t  flags;
+  uint8_t  padding;
+  uint32_t sparseSize;
+  uint32_t propertiesSize;
+};
+
+struct VocabEntry {
+  uint64_t offset;  // into the string blob after the entries
+  uint32_t size;
+  uint32_t isNonTerminal;
+};
+
+const uint8_t kSourceLHS = 1;
+const uint8_t kTargetLHS = 2;
+const uint32_t kNoFactor = 0xffffffff;
+
+template <class T>
+void Append(vector<char> &buf, const T &val)
+{
+  const char *p = reinterpret_cast<const char*>(&val);
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+inline size_t Padded(size_t size)
+{
+  return (size + 3) & ~size_t(3);
+}
+
+bool ReadHeader(const string &path, RuleTableBinaryHeader &header)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) return false;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1
+            && memcmp(header.magic, kMagic, sizeof(kMagic)) == 0;
+  fclose(file);
+  return ok;
+}
+}
+
+RuleTableBinaryWriter::
+RuleTableBinaryWriter(const std::string &path,
+                      const std::string &textTable,
+                      const std::vector<FactorType> &input,
+                      const std::vector<FactorType> &output,
+                      size_t numScores)
+  : m_path(path)
+  , m_tmpPath(path + ".tmp")
+  , m_out(m_tmpPath.c_str(), ios::out | ios::binary | ios::trunc)
+  , m_input(input)
+  , m_output(output)
+  , m_finished(false)
+{
+  UTIL_THROW_IF2(!m_out.good(), "Cannot write rule table snapshot " << m_tmpPath);
+
+  memset(&m_header, 0, sizeof(m_header));
+  memcpy(m_header.magic, kMagic, sizeof(kMagic));
+  m_header.version = kVersion;
+  m_header.numScores = numScores;
+  m_header.numInputFactors = input.size();
+  m_header.numOutputFactors = output.size();
+  m_header.ruleOffset = sizeof(m_header);
+
+  struct stat textStat;
+  UTIL_THROW_IF2(stat(textTable.c_str(), &textStat) != 0,
+                 "Cannot stat rule table " << textTable);
+  m_header.sourceSize = textStat.st_size;
+  m_header.sourceMTime = textStat.st_mtime;
+
+  // placeholder, rewritten by Finish()
+  m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+}
+
+RuleTableBinaryWriter::~RuleTableBinaryWriter()
+{
+  if (!m_finished) {
+    // incomplete snapshot, e.g. the text table threw half way
+    m_out.close();
+    remove(m_tmpPath.c_str());
+  }
+}
+
+uint32_t RuleTableBinaryWriter::GetVocabId(const Factor *factor,
+    bool isNonTerminal)
+{
+  if (factor == NULL) return kNoFactor;
+  boost::unordered_map<const Factor*, uint32_t>::const_iterator iter
+  = m_vocabIds.find(factor);
+  if (iter != m_vocabIds.end()) return iter->second;
+
+  uint32_t id = m_vocab.size();
+  m_vocabIds[factor] = id;
+  m_vocab.push_back(factor);
+  m_vocabNonTerm.push_back(isNonTerminal);
+  return id;
+}
+
+void RuleTableBinaryWriter::WriteWord(const Word &word,
+                                      const std::vector<FactorType> &factors)
+{
+  Append<uint32_t>(m_record, word.IsNonTerminal());
+  for (size_t i = 0; i < factors.size(); ++i) {
+    Append<uint32_t>(m_record, GetVocabId(word[factors[i]], word.IsNonTerminal()));
+  }
+}
+
+void RuleTableBinaryWriter::Align()
+{
+  m_record.resize(Padded(m_record.size()), 0);
+}
+
+void RuleTableBinaryWriter::Add(const Phrase &source, const Word *sourceLHS,
+                                const TargetPhrase &target, const Word *targetLHS,
+                                const std::vector<float> &scores,
+                                const StringPiece &sparse,
+                                const StringPiece &properties)
+{
+  const AlignmentInfo &alignTerm = target.GetAlignTerm();
+  const AlignmentInfo &alignNonTerm = target.GetAlignNonTerm();
+
+  RuleRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  UTIL_THROW_IF2(source.GetSize() > 0xffff || target.GetSize() > 0xffff,
+                 "Rule too long for snapshot: " << source);
+  rec.sourceSize = source.GetSize();
+  rec.targetSize = target.GetSize();
+  rec.numAlign = alignTerm.GetSize() + alignNonTerm.GetSize();
+  rec.flags = (sourceLHS ? kSourceLHS : 0) | (targetLHS ? kTargetLHS : 0);
+  rec.sparseSize = sparse.size();
+  rec.propertiesSize = properties.size();
+
+  m_record.clear();
+  Append(m_record, rec);
+  if (!scores.empty()) {
+    const char *p = reinterpret_cast<const char*>(&scores[0]);
+    m_record.insert(m_record.end(), p, p + scores.size() * sizeof(float));
+  }
+
+  for (size_t i = 0; i < source.GetSize(); ++i) {
+    WriteWord(source.GetWord(i), m_input);
+  }
+  if (sourceLHS) WriteWord(*sourceLHS, m_input);
+  for (size_t i = 0; i < target.GetSize(); ++i) {
+    WriteWord(target.GetWord(i), m_output);
+  }
+  if (targetLHS) WriteWord(*targetLHS, m_output);
+
+  AlignmentInfo::const_iterator iter;
+  for (iter = alignTerm.begin(); iter != alignTerm.end(); ++iter) {
+    Append<uint16_t>(m_record, iter->first);
+    Append<uint16_t>(m_record, iter->second);
+  }
+  for (iter = alignNonTerm.begin(); iter != alignNonTerm.end(); ++iter) {
+    Append<uint16_t>(m_record, iter->first);
+    Append<uint16_t>(m_record, iter->second);
+  }
+
+  m_record.insert(m_record.end(), sparse.data(), sparse.data() + sparse.size());
+  m_record.insert(m_record.end(), properties.data(), properties.data() + properties.size());
+  Align();
+
+  m_out.write(&m_record[0], m_record.size());
+  ++m_header.numRules;
+}
+
+void RuleTableBinaryWriter::Finish()
+{
+  // records are 4-byte aligned, the vocabulary entries need 8
+  uint64_t pos = m_out.tellp();
+  if (pos % 8) {
+    m_out.write("\0\0\0\0", 8 - pos % 8);
+    pos += 8 - pos % 8;
+  }
+  m_header.vocabSize = m_vocab.size();
+  m_header.vocabOffset = pos;
+
+  uint64_t offset = 0;
+  for (size_t i = 0; i < m_vocab.size(); ++i) {
+    VocabEntry entry;
+    StringPiece str = m_vocab[i]->GetString();
+    entry.offset = offset;
+    entry.size = str.size();
+    entry.isNonTerminal = m_vocabNonTerm[i];
+    m_out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    offset += str.size();
+  }
+  for (size_t i = 0; i < m_vocab.size(); ++i) {
+    StringPiece str = m_vocab[i]->GetString();
+    m_out.write(str.data(), str.size());
+  }
+
+  m_out.seekp(0);
+  m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  m_out.close();
+  UTIL_THROW_IF2(m_out.fail(), "Error writing rule table snapshot " << m_tmpPath);
+  UTIL_THROW_IF2(rename(m_tmpPath.c_str(), m_path.c_str()) != 0,
+                 "Cannot rename " << m_tmpPath << " to " << m_path);
+  m_finished = true;
+
+  VERBOSE(1, "Wrote rule table snapshot " << m_path << " with "
+          << m_header.numRules << " rules" << endl);
+}
+
+bool RuleTableLoaderBinary::IsBinary(const std::string &path)
+{
+  RuleTableBinaryHeader header;
+  return ReadHeader(path, header);
+}
+
+bool RuleTableLoaderBinary::IsUpToDate(const std::string &snapshot,
+                                       const std::string &textTable)
+{
+  RuleTableBinaryHeader header;
+  if (!ReadHeader(snapshot, header) || header.version != kVersion) return false;
+  struct stat textStat;
+  if (stat(textTable.c_str(), &textStat) != 0) return true;
+  return header.sourceSize == uint64_t(textStat.st_size)
+         && header.sourceMTime == int64_t(textStat.st_mtime);
+}
+
+namespace
+{
+// Reads one word of a record and advances the cursor.
+const uint32_t *ReadWord(const uint32_t *p, Word &word,
+                         const std::vector<FactorType> &factors,
+                         const std::vector<const Factor*> &vocab)
+{
+  word.SetIsNonTerminal(*p++ != 0);
+  for (size_t i = 0; i < factors.size(); ++i, ++p) {
+    word.SetFactor(factors[i], *p == kNoFactor ? NULL : vocab[*p]);
+  }
+  return p;
+}
+}
+
+bool RuleTableLoaderBinary::Load(AllOptions const& opts
+                                 , const std::vector<FactorType> &input
+                                 , const std::vector<FactorType> &output
+                                 , const std::string &inFile
+                                 , size_t /* tableLimit */
+                                 , RuleTableTrie &ruleTable)
+{
+  PrintUserTime("Start loading binary rule table snapshot " + inFile);
+
+  util::scoped_fd file(util::OpenReadOrThrow(inFile.c_str()));
+  const uint64_t size = util::SizeOrThrow(file.get());
+  UTIL_THROW_IF2(size < sizeof(RuleTableBinaryHeader),
+                 "Truncated rule table snapshot " << inFile);
+  util::scoped_memory mem;
+  util::MapRead(util::POPULATE_OR_READ, file.get(), 0, size, mem);
+
+  const char *base = static_cast<const char*>(mem.get());
+  const RuleTableBinaryHeader &header
+  = *reinterpret_cast<const RuleTableBinaryHeader*>(base);
+  UTIL_THROW_IF2(memcmp(header.magic, kMagic, sizeof(kMagic)) != 0,
+                 inFile << " is not a rule table snapshot");
+  UTIL_THROW_IF2(header.version != kVersion,
+                 "Rule table snapshot " << inFile << " has version "
+                 << header.version << ", expected " << kVersion);
+  UTIL_THROW_IF2(header.numScores != ruleTable.GetNumScoreComponents(),
+                 "Rule table snapshot " << inFile << " has "
+                 << header.numScores << " scores but the feature expects "
+                 << ruleTable.GetNumScoreComponents());
+  UTIL_THROW_IF2(header.numInputFactors != input.size()
+                 || header.numOutputFactors != output.size(),
+                 "Rule table snapshot " << inFile
+                 << " was written with a different factor configuration");
+  UTIL_THROW_IF2(header.vocabOffset + header.vocabSize * sizeof(VocabEntry) > size,
+                 "Truncated rule table snapshot " << inFile);
+
+  // intern the vocabulary once; rules refer to it by position
+  FactorCollection &factorCollection = FactorCollection::Instance();
+  const VocabEntry *entries
+  = reinterpret_cast<const VocabEntry*>(base + header.vocabOffset);
+  const char *strings = reinterpret_cast<const char*>(entries + header.vocabSize);
+  std::vector<const Factor*> vocab(header.vocabSize);
+  for (size_t i = 0; i < header.vocabSize; ++i) {
+    StringPiece str(strings + entries[i].offset, entries[i].size);
+    vocab[i] = factorCollection.AddFactor(str, entries[i].isNonTerminal != 0);
+  }
+
+  std::vector<float> scoreVector(header.numScores);
+  const char *p = base + header.ruleOffset;
+  const char *end = base + header.vocabOffset;
+  for (size_t count = 0; count < header.numRules; ++count) {
+    UTIL_THROW_IF2(p + sizeof(RuleRecord) > end,
+                   "Truncated rule table snapshot " << inFile);
+    const RuleRecord &rec = *reinterpret_cast<const RuleRecord*>(p);
+    const float *scores = reinterpret_cast<const float*>(p + sizeof(RuleRecord));
+    std::copy(scores, scores + header.numScores, scoreVector.begin());
+
+    const uint32_t *w = reinterpret_cast<const uint32_t*>(scores + header.numScores);
+
+    Phrase sourcePhrase(rec.sourceSize);
+    for (size_t i = 0; i < rec.sourceSize; ++i) {
+      w = ReadWord(w, sourcePhrase.AddWord(), input, vocab);
+    }
+    Word *sourceLHS = NULL;
+    if (rec.flags & kSourceLHS) {
+      sourceLHS = new Word(true);
+      w = ReadWord(w, *sourceLHS, input, vocab);
+    }
+
+    TargetPhrase *targetPhrase = new TargetPhrase(&ruleTable);
+    for (size_t i = 0; i < rec.targetSize; ++i) {
+      w = ReadWord(w, targetPhrase->AddWord(), output, vocab);
+    }
+    Word *targetLHS = NULL;
+    if (rec.flags & kTargetLHS) {
+      targetLHS = new Word(true);
+      w = ReadWord(w, *targetLHS, output, vocab);
+    }
+
+    AlignmentInfo::CollType alignTerm, alignNonTerm;
+    const uint16_t *a = reinterpret_cast<const uint16_t*>(w);
+    for (size_t i = 0; i < rec.numAlign; ++i, a += 2) {
+      std::pair<size_t, size_t> point(a[0], a[1]);
+      if (targetPhrase->GetWord(point.second).IsNonTerminal()) {
+        alignNonTerm.insert(point);
+      } else {
+        alignTerm.insert(point);
+      }
+    }
+    targetPhrase->SetAlignTerm(alignTerm);
+    targetPhrase->SetAlignNonTerm(alignNonTerm);
+    targetPhrase->SetTargetLHS(targetLHS);
+
+    const char *str = reinterpret_cast<const char*>(a);
+    if (rec.sparseSize) {
+      targetPhrase->SetSparseScore(&ruleTable, StringPiece(str, rec.sparseSize));
+    }
+    str += rec.sparseSize;
+    if (rec.propertiesSize) {
+      targetPhrase->SetProperties(StringPiece(str, rec.propertiesSize));
+    }
+    str += rec.propertiesSize;
+    p = base + Padded(str - base);
+
+    targetPhrase->GetScoreBreakdown().Assign(&ruleTable, scoreVector);
+    targetPhrase->EvaluateInIsolation(sourcePhrase, ruleTable.GetFeaturesToApply());
+
+    TargetPhraseCollection::shared_ptr phraseColl
+    = GetOrCreateTargetPhraseCollection(ruleTable, sourcePhrase,
+                                        *targetPhrase, sourceLHS);
+    phraseColl->Add(targetPhrase);
+
+    delete sourceLHS;
+  }
+
+  SortAndPrune(ruleTable);
+
+  return true;
+}
+
+}  // namespace Moses
@@ -0,0 +1,123 @@
+/***********************************************************************
+ Moses - statistical machine translation system
+ Copyright (C) 2006-2011 University of Edinburgh
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#pragma once
+
+#include "Loader.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <boost/unordered_map.hpp>
+
+#include "util/string_piece.hh"
+
+namespace Moses
+{
+
+class Factor;
+
+/** Binary snapshot of a text rule table.
+ *
+ * The snapshot holds the rules exactly as RuleTableLoaderStandard parsed
+ * them: words as ids into an interned vocabulary, scores already transformed
+ * and floored, alignment points as integer pairs. All references inside the
+ * file are offsets, so it is loaded with a single mmap and no tokenizing or
+ * number parsing. Sparse scores and properties are kept verbatim and handed
+ * to TargetPhrase as before.
+ *
+ * Layout: Header, rule records (4-byte aligned), vocabulary entries, string
+ * blob.
+ *
+ * The header records the size and modification time of the text table the
+ * snapshot was written from; the snapshot is only used while both match.
+ */
+struct RuleTableBinaryHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t numScores;
+  uint32_t numInputFactors;
+  uint32_t numOutputFactors;
+  uint64_t numRules;
+  uint64_t ruleOffset;
+  uint64_t vocabSize;
+  uint64_t vocabOffset;  // VocabEntry[vocabSize], followed by the strings
+  uint64_t sourceSize;   // of the text table, in bytes
+  int64_t  sourceMTime;  // of the text table, in seconds
+};
+
+//! Writes a snapshot while the text table is being loaded.
+class RuleTableBinaryWriter
+{
+public:
+  //! \param textTable the table being loaded, recorded in the header
+  RuleTableBinaryWriter(const std::string &path,
+                        const std::string &textTable,
+                        const std::vector<FactorType> &input,
+                        const std::vector<FactorType> &output,
+                        size_t numScores);
+  ~RuleTableBinaryWriter();
+
+  void Add(const Phrase &source, const Word *sourceLHS,
+           const TargetPhrase &target, const Word *targetLHS,
+           const std::vector<float> &scores,
+           const StringPiece &sparse, const StringPiece &properties);
+
+  //! Write the vocabulary and header, then move the file into place.
+  void Finish();
+
+private:
+  void WriteWord(const Word &word, const std::vector<FactorType> &factors);
+  uint32_t GetVocabId(const Factor *factor, bool isNonTerminal);
+  void Align();
+
+  std::string m_path, m_tmpPath;
+  std::ofstream m_out;
+  std::vector<FactorType> m_input, m_output;
+  RuleTableBinaryHeader m_header;
+  std::vector<char> m_record;
+  boost::unordered_map<const Factor*, uint32_t> m_vocabIds;
+  std::vector<const Factor*> m_vocab;
+  std::vector<bool> m_vocabNonTerm;
+  bool m_finished;
+};
+
+//! Loader for rule table snapshots written by RuleTableBinaryWriter
+class RuleTableLoaderBinary : public RuleTableLoader
+{
+public:
+  bool Load(AllOptions const& opts,
+            const std::vector<FactorType> &input,
+            const std::vector<FactorType> &output,
+            const std::string &inFile,
+            size_t tableLimit,
+            RuleTableTrie &);
+
+  //! True if path starts with the snapshot magic.
+  static bool IsBinary(const std::string &path);
+
+  //! True if snapshot exists and was written from the text table as it is
+  //! now (same size and modification time), or if there is no text table.
+  static bool IsUpToDate(const std::string &snapshot,
+                         const std::string &textTable);
+};
+
+}  // namespace Moses
@@ -27,7 +27,9 @@
 #include <sys/stat.h>
 #include <cstdlib>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "Trie.h"
+#include "LoaderBinary.h"
 #include "moses/FactorCollection.h"
 #include "moses/Word.h"
 #include "moses/Util.h"
@@ -165,6 +167,13 @@ bool RuleTableLoaderStandard::Load(AllOptions const& opts, FormatType format
 
   double_conversion::StringToDoubleConverter converter(double_conversion::StringToDoubleConverter::NO_FLAGS, NAN, NAN, "inf", "nan");
 
+  // write the parsed rules out as we go, so the next start can skip parsing
+  boost::scoped_ptr<RuleTableBinaryWriter> snapshot;
+  if (!ruleTable.GetSnapshotPath().empty()) {
+    snapshot.reset(new RuleTableBinaryWriter(ruleTable.GetSnapshotPath(), inFile,
+                   input, output, ruleTable.GetNumScoreComponents()));
+  }
+
   while(true) {
     try {
       line = in.ReadLine();
@@ -227,16 +236,22 @@ bool RuleTableLoaderStandard::Load(AllOptions const& opts, FormatType format
 
     ++pipes;  // skip over counts field
 
+    StringPiece sparseString, propertiesString;
     if (++pipes) {
-      StringPiece sparseString(*pipes);
+      sparseString = *pipes;
       targetPhrase->SetSparseScore(&ruleTable, sparseString);
     }
 
     if (++pipes) {
-      StringPiece propertiesString(*pipes);
+      propertiesString = *pipes;
       targetPhrase->SetProperties(propertiesString);
     }
 
+    if (snapshot) {
+      snapshot->Add(sourcePhrase, sourceLHS, *targetPhrase, targetLHS,
+                    scoreVector, sparseString, propertiesString);
+    }
+
     targetPhrase->GetScoreBreakdown().Assign(&ruleTable, scoreVector);
     targetPhrase->EvaluateInIsolation(sourcePhrase, ruleTable.GetFeaturesToApply());
 
@@ -251,6 +266,8 @@ bool RuleTableLoaderStandard::Load(AllOptions const& opts, FormatType format
     count++;
   }
 
+  if (snapshot) snapshot->Finish();
+
   // sort and prune each target phrase collection
   SortAndPrune(ruleTable);
 
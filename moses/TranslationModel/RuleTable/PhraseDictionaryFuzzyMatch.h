@@ -20,6 +20,10 @@
 
 #pragma once
 
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
+
 #include "Trie.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
 #include "moses/InputType.h"
@@ -74,8 +78,14 @@ protected:
   void SortAndPrune(PhraseDictionaryNodeMemory &rootNode);
   PhraseDictionaryNodeMemory &GetRootNode(const InputType &source);
 
+  // one trie per sentence being translated
   std::map<long, PhraseDictionaryNodeMemory> m_collection;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_collectionMutex;
+#endif
   std::vector<std::string> m_config;
+  // threads verifying the match candidates of each sentence
+  size_t m_searchThreads;
 
   tmmt::FuzzyMatchWrapper *m_FuzzyMatchWrapper;
 
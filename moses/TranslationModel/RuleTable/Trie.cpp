@@ -23,7 +23,9 @@
 #include "moses/StaticData.h"
 #include "Trie.h"
 #include "Loader.h"
+#include "LoaderBinary.h"
 #include "LoaderFactory.h"
+#include "LoaderStandard.h"
 
 using namespace std;
 
@@ -39,15 +41,37 @@ void RuleTableTrie::Load(AllOptions::ptr const& opts)
   m_options = opts;
   SetFeaturesToApply();
 
-  std::auto_ptr<Moses::RuleTableLoader> loader =
-    Moses::RuleTableLoaderFactory::Create(m_filePath);
+  std::string path = m_filePath;
+  std::auto_ptr<Moses::RuleTableLoader> loader;
+  if (!m_snapshotPath.empty()
+      && RuleTableLoaderBinary::IsUpToDate(m_snapshotPath, m_filePath)) {
+    path = m_snapshotPath;
+    loader.reset(new RuleTableLoaderBinary());
+  } else {
+    loader = Moses::RuleTableLoaderFactory::Create(m_filePath);
+  }
   if (!loader.get()) {
-    throw runtime_error("Error: Loading " + m_filePath);
+    throw runtime_error("Error: Loading " + path);
   }
+  // only the text loaders write snapshots
+  UTIL_THROW_IF2(!m_snapshotPath.empty() && path == m_filePath
+                 && !dynamic_cast<RuleTableLoaderStandard*>(loader.get()),
+                 GetScoreProducerDescription() << ": snapshot= is only "
+                 "supported for text rule tables (Moses or Hiero format), not "
+                 << m_filePath);
 
-  bool ret = loader->Load(*opts, m_input, m_output, m_filePath, m_tableLimit, *this);
+  bool ret = loader->Load(*opts, m_input, m_output, path, m_tableLimit, *this);
   if (!ret) {
-    throw runtime_error("Error: Loading " + m_filePath);
+    throw runtime_error("Error: Loading " + path);
+  }
+}
+
+void RuleTableTrie::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "snapshot") {
+    m_snapshotPath = value;
+  } else {
+    PhraseDictionary::SetParameter(key, value);
   }
 }
 
@@ -48,6 +48,18 @@ public:
 
   void Load(AllOptions::ptr const& opts);
 
+  void SetParameter(const std::string& key, const std::string& value);
+
+  //! Binary snapshot of the text table; read instead of it when up to date,
+  //! written while loading the text table otherwise. Only text tables (Moses
+  //! or Hiero format) can be snapshot.
+  const std::string &GetSnapshotPath() const {
+    return m_snapshotPath;
+  }
+
+protected:
+  std::string m_snapshotPath;
+
 private:
   friend class RuleTableLoader;
 
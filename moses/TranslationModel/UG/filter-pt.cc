@@ -30,11 +30,20 @@
 #endif
 
 #include "mm/ug_bitext.h"
+#include "moses/OutputCollector.h"
+#include "moses/ThreadPool.h"
+#ifdef HAVE_CMPH
+#include "moses/TranslationModel/CompactPT/PhraseTableCreator.h"
+#endif
+#include "probingpt/storing.h"
+#include "util/string_piece.hh"
 
 // constants
 const size_t MINIMUM_SIZE_TO_KEEP = 10000;     // increase this to improve memory usage,
 // reduce for speed
 const std::string SEPARATOR       = " ||| ";
+const size_t CHUNK_SIZE = 10000;               // phrase table lines handed to
+// a thread at once, at least
 
 const double ALPHA_PLUS_EPS  = -1000.0;        // dummy value
 const double ALPHA_MINUS_EPS = -2000.0;        // dummy value
@@ -60,9 +69,7 @@ typedef sapt::TokenIndex tind_t;
 
 int num_lines;
 
-boost::mutex in_mutex;
-boost::mutex out_mutex;
-boost::mutex err_mutex;
+boost::mutex stats_mutex;
 
 typedef size_t TextLenType;
 
@@ -105,9 +112,11 @@ class Cache {
           clock_t out = clocks[m_cont.size() - s_max_cache];
           
           boost::upgrade_to_unique_lock<boost::shared_mutex> uniq_lock(lock);
-          for(ClockedMap::iterator it = m_cont.begin(); it != m_cont.end(); it++)
+          for(ClockedMap::iterator it = m_cont.begin(); it != m_cont.end(); )
             if(it->second.second < out)
-              m_cont.erase(it);
+              it = m_cont.erase(it);
+            else
+              ++it;
         }
       }
     }
@@ -120,11 +129,37 @@ class Cache {
 
 size_t Cache::s_max_cache = 0;
 
+// Where in a suffix array the last phrase looked up by this thread was
+// found.  A phrase that shares a prefix with it continues from there
+// instead of starting at the root again.
+struct PrefixWalker {
+  PrefixWalker(tsa_t const* sa) : m(sa) {}
+  tsa_t::tree_iterator m;
+  std::vector<sapt::id_type> path; // the words m has matched
+
+  bool find(const std::vector<sapt::id_type>& snt) {
+    size_t k = 0;
+    while (k < path.size() && k < snt.size() && path[k] == snt[k]) ++k;
+    while (path.size() > k) {
+      m.up();
+      path.pop_back();
+    }
+    while (k < snt.size() && m.extend(snt[k])) path.push_back(snt[k++]);
+    return !snt.empty() && k == snt.size();
+  }
+};
+
 struct SA {
   tind_t V;
   boost::shared_ptr<ttrack_t> T;
   tsa_t I;
   Cache cache;
+  boost::thread_specific_ptr<PrefixWalker> walker;
+
+  PrefixWalker& get_walker() {
+    if (!walker.get()) walker.reset(new PrefixWalker(&I));
+    return *walker;
+  }
 };
 
 std::vector<boost::shared_ptr<SA> > e_sas;
@@ -277,19 +312,17 @@ void ordered_set_intersect(setType& out, const setType set_1, const setType set_
 }
 
 
-void lookup_phrase(SentIdSet& ids, const std::string& phrase,
-                   tsa_t &my_sa, tind_t &my_v, Cache& cache)
+void lookup_phrase(SentIdSet& ids, const std::string& phrase, SA& sa)
 {
-    ids = cache.get(phrase);
+    ids = sa.cache.get(phrase);
     if(ids->empty()) {
       
       std::vector<sapt::id_type> snt;
-      my_v.fillIdSeq(phrase, snt);
+      sa.V.fillIdSeq(phrase, snt);
 
-      tsa_t::tree_iterator m(&my_sa);
-      size_t k = 0;
-      while (k < snt.size() && m.extend(snt[k])) ++k;
-      if(k == snt.size()) {
+      PrefixWalker& walker = sa.get_walker();
+      if(walker.find(snt)) {
+        tsa_t::tree_iterator& m = walker.m;
         ids->reserve(m.approxOccurrenceCount()+10);
         sapt::tsa::ArrayEntry I(m.lower_bound(-1));
         char const* stop = m.upper_bound(-1);
@@ -304,28 +337,27 @@ void lookup_phrase(SentIdSet& ids, const std::string& phrase,
         ids->resize(it - ids->begin());
         
         if(ids->size() >= MINIMUM_SIZE_TO_KEEP)
-          cache.put(phrase, ids);
+          sa.cache.put(phrase, ids);
       }
     }
 }
 
 void lookup_multiple_phrases(SentIdSet& ids, std::vector<std::string> & phrases,
-                             tsa_t & my_sa, tind_t &my_v,
-                             const std::string & rule, Cache& cache) 
+                             SA& sa, const std::string & rule) 
 { 
 
     if (phrases.size() == 1) {
-        lookup_phrase(ids, phrases.front(), my_sa, my_v, cache);
+        lookup_phrase(ids, phrases.front(), sa);
     }
     else {
         SentIdSet main_set( new SentIdSet::element_type() );
         bool first = true;
         SentIdSet first_set( new SentIdSet::element_type() );
-        lookup_phrase(first_set, phrases.front(), my_sa, my_v, cache);
+        lookup_phrase(first_set, phrases.front(), sa);
         for (std::vector<std::string>::iterator phrase=phrases.begin()+1;
              phrase != phrases.end(); ++phrase) {
             SentIdSet temp_set( new SentIdSet::element_type() );
-            lookup_phrase(temp_set, *phrase, my_sa, my_v, cache);
+            lookup_phrase(temp_set, *phrase, sa);
             if (first) {
                 ordered_set_intersect(main_set, first_set, temp_set);
                 first = false;
@@ -341,8 +373,7 @@ void lookup_multiple_phrases(SentIdSet& ids, std::vector<std::string> & phrases,
 }
 
 
-void find_occurrences(SentIdSet& ids, const std::string& rule,
-                      tsa_t& my_sa, tind_t &my_v, Cache& cache)
+void find_occurrences(SentIdSet& ids, const std::string& rule, SA& sa)
 {
     // we search for hierarchical rules by stripping away NT and looking for terminals sequences
     // if a rule contains multiple sequences of terminals, we intersect their occurrences.
@@ -367,19 +398,43 @@ void find_occurrences(SentIdSet& ids, const std::string& rule,
             phrases.push_back(rule.substr(pos,NTStartPos-pos));
         }
 
-        lookup_multiple_phrases(ids, phrases, my_sa, my_v, rule, cache);
+        lookup_multiple_phrases(ids, phrases, sa, rule);
     }
     else {
-        lookup_phrase(ids, rule, my_sa, my_v, cache);
+        lookup_phrase(ids, rule, sa);
+    }
+}
+
+// size of the intersection of two sorted sets
+size_t ordered_set_overlap(const SentIdSet& set_1, const SentIdSet& set_2)
+{
+  size_t n = 0;
+  SentIdSet::element_type::const_iterator a = set_1->begin(), b = set_2->begin();
+  while (a != set_1->end() && b != set_2->end()) {
+    if (*a < *b) ++a;
+    else if (*b < *a) ++b;
+    else {
+      ++n;
+      ++a;
+      ++b;
     }
+  }
+  return n;
 }
 
+struct EPhraseComparer {
+  bool operator()(const PTEntry* a, const PTEntry* b) const {
+    return a->e_phrase < b->e_phrase;
+  }
+};
+
 
 // input: unordered list of translation options for a single source phrase
-void compute_cooc_stats_and_filter(std::vector<PTEntry*>& options)
+void compute_cooc_stats_and_filter(std::vector<PTEntry*>& options,
+                                   size_t& removed_pfe, size_t& removed_sig)
 {
   if (pfe_filter_limit > 0 && options.size() > pfe_filter_limit) {
-    nremoved_pfefilter += (options.size() - pfe_filter_limit);
+    removed_pfe += (options.size() - pfe_filter_limit);
     std::nth_element(options.begin(), options.begin() + pfe_filter_limit,
                      options.end(), PfeComparer());
     for (std::vector<PTEntry*>::iterator i = options.begin() + pfe_filter_limit;
@@ -398,27 +453,25 @@ void compute_cooc_stats_and_filter(std::vector<PTEntry*>& options)
   std::vector<SentIdSet> fsets;
   BOOST_FOREACH(boost::shared_ptr<SA>& f_sa, f_sas) {
     fsets.push_back( boost::shared_ptr<SentIdSet::element_type>(new SentIdSet::element_type()) );
-    find_occurrences(fsets.back(), options.front()->f_phrase, f_sa->I, f_sa->V, f_sa->cache);
+    find_occurrences(fsets.back(), options.front()->f_phrase, *f_sa);
     cf += fsets.back()->size();
   }
   
-  for (std::vector<PTEntry*>::iterator i = options.begin();
-       i != options.end(); ++i) {
+  // look up the target phrases in sorted order, so that each lookup can
+  // start from the prefix it shares with the one before
+  std::vector<PTEntry*> sorted(options);
+  std::sort(sorted.begin(), sorted.end(), EPhraseComparer());
+  for (std::vector<PTEntry*>::iterator i = sorted.begin();
+       i != sorted.end(); ++i) {
     const std::string& e_phrase = (*i)->e_phrase;
     
     size_t ce = 0;
-    std::vector<SentIdSet> esets;
-    BOOST_FOREACH(boost::shared_ptr<SA>& e_sa,  e_sas) {
-      esets.push_back( boost::shared_ptr<SentIdSet::element_type>(new SentIdSet::element_type()) );
-      find_occurrences(esets.back(), e_phrase, e_sa->I, e_sa->V, e_sa->cache);
-      ce += esets.back()->size();
-    }
-      
     size_t cef = 0;
-    for(size_t j = 0; j < fsets.size(); ++j) {
-      SentIdSet efset( new SentIdSet::element_type() );
-      ordered_set_intersect(efset, fsets[j], esets[j]);
-      cef += efset->size();
+    for(size_t j = 0; j < e_sas.size(); ++j) {
+      SentIdSet eset( new SentIdSet::element_type() );
+      find_occurrences(eset, e_phrase, *e_sas[j]);
+      ce += eset->size();
+      cef += ordered_set_overlap(fsets[j], eset);
     }
     
     double nlp = -log(fisher_exact(cef, cf, ce));
@@ -428,94 +481,143 @@ void compute_cooc_stats_and_filter(std::vector<PTEntry*>& options)
   std::vector<PTEntry*>::iterator new_end =
     std::remove_if(options.begin(), options.end(),
                    NlogSigThresholder(sig_filter_limit));
-  nremoved_sigfilter += (options.end() - new_end);
+  removed_sig += (options.end() - new_end);
   options.erase(new_end,options.end());
 }
 
-void filter_thread(std::istream* in, std::ostream* out, int pfe_index) {
-      
-  std::vector<std::string> lines;
-  std::string prev = "";
-  std::vector<PTEntry*> options;
-  while(true) {
-    {
-      boost::mutex::scoped_lock lock(in_mutex);
-      if(in->eof())
-        break;
-      
-      lines.clear();
-      std::string line;
-      while(getline(*in, line) && lines.size() < 500000)
-        lines.push_back(line);
+void print_stats(std::ostream& out)
+{
+  float pfefper = (100.0*(float)nremoved_pfefilter)/(float)pt_lines;
+  float sigfper = (100.0*(float)nremoved_sigfilter)/(float)pt_lines;
+  out << "------------------------------------------------------\n"
+      << "  unfiltered phrases pairs: " << pt_lines << "\n"
+      << "\n"
+      << "     P(f|e) filter [first]: " << nremoved_pfefilter << "   (" << pfefper << "%)\n"
+      << "       significance filter: " << nremoved_sigfilter << "   (" << sigfper << "%)\n"
+      << "            TOTAL FILTERED: " << (nremoved_pfefilter + nremoved_sigfilter) << "   (" << (sigfper + pfefper) << "%)\n"
+      << "\n"
+      << "     FILTERED phrase pairs: " << (pt_lines - nremoved_pfefilter - nremoved_sigfilter) << "   (" << (100.0-sigfper - pfefper) << "%)\n"
+      << "------------------------------------------------------\n";
+}
+
+// Filters a chunk of the phrase table that holds all translation options
+// of its source phrases, and passes the result on in input order.
+class FilterTask : public Moses::Task
+{
+public:
+  FilterTask(int chunk_id, std::vector<std::string>* lines,
+             Moses::OutputCollector& collector, int pfe_index)
+    : m_chunk_id(chunk_id), m_lines(lines), m_collector(collector),
+      m_pfe_index(pfe_index) {}
+
+  ~FilterTask() {
+    delete m_lines;
+  }
+
+  void Run() {
+    std::ostringstream out;
+    size_t removed_pfe = 0, removed_sig = 0;
+    std::vector<PTEntry*> options;
+    for(std::vector<std::string>::iterator it = m_lines->begin(); it != m_lines->end(); it++) {
+      if(it->length() == 0)
+        continue;
+      PTEntry* pp = new PTEntry(*it, m_pfe_index);
+      if (!options.empty() && options.front()->f_phrase != pp->f_phrase)
+        flush(options, out, removed_pfe, removed_sig);
+      options.push_back(pp);
     }
-    
-    std::stringstream out_temp;
-    for(std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); it++) {
-      size_t tmp_lines = ++pt_lines;
-      if(tmp_lines % 10000 == 0) {
-        boost::mutex::scoped_lock lock(err_mutex);
-        std::cerr << ".";
-      
-        if(tmp_lines % 500000 == 0)
-          std::cerr << "[n:" << tmp_lines << "]\n";
-  
-        if(tmp_lines % 10000000 == 0) {
-          float pfefper = (100.0*(float)nremoved_pfefilter)/(float)pt_lines;
-          float sigfper = (100.0*(float)nremoved_sigfilter)/(float)pt_lines;
-          std::cerr << "------------------------------------------------------\n"
-                    << "  unfiltered phrases pairs: " << pt_lines << "\n"
-                    << "\n"
-                    << "     P(f|e) filter [first]: " << nremoved_pfefilter << "   (" << pfefper << "%)\n"
-                    << "       significance filter: " << nremoved_sigfilter << "   (" << sigfper << "%)\n"
-                    << "            TOTAL FILTERED: " << (nremoved_pfefilter + nremoved_sigfilter) << "   (" << (sigfper + pfefper) << "%)\n"
-                    << "\n"
-                    << "     FILTERED phrase pairs: " << (pt_lines - nremoved_pfefilter - nremoved_sigfilter) << "   (" << (100.0-sigfper - pfefper) << "%)\n"
-                    << "------------------------------------------------------\n";
-        }
-      }
+    flush(options, out, removed_pfe, removed_sig);
+    m_collector.Write(m_chunk_id, out.str());
+
+    boost::mutex::scoped_lock lock(stats_mutex);
+    nremoved_pfefilter += removed_pfe;
+    nremoved_sigfilter += removed_sig;
+  }
+
+private:
+  static void flush(std::vector<PTEntry*>& options, std::ostream& out,
+                    size_t& removed_pfe, size_t& removed_sig) {
+    compute_cooc_stats_and_filter(options, removed_pfe, removed_sig);
+    for (std::vector<PTEntry*>::iterator i = options.begin();
+         i != options.end(); ++i) {
+      out << **i << '\n';
+      delete *i;
+    }
+    options.clear();
+  }
+
+  int m_chunk_id;
+  std::vector<std::string>* m_lines;
+  Moses::OutputCollector& m_collector;
+  int m_pfe_index;
+};
+
+// the source phrase field of a phrase table line
+inline StringPiece source_phrase(const std::string& line)
+{
+  return StringPiece(line.data(), std::min(line.find(SEPARATOR), line.size()));
+}
+
+void filter(std::istream& in, std::ostream& out, int threads, int pfe_index)
+{
+  Moses::OutputCollector collector(&out);
+  Moses::ThreadPool pool(threads);
+  pool.SetQueueLimit(threads * 2);
+
+  // cut the phrase table into chunks between source phrases, so that
+  // each is filtered on its own
+  std::vector<std::string>* chunk = new std::vector<std::string>();
+  int chunk_id = 0;
+  std::string line;
+  while (true) {
+    bool eof = !getline(in, line);
+    if (eof || (chunk->size() >= CHUNK_SIZE &&
+                source_phrase(line) != source_phrase(chunk->back()))) {
+      pool.Submit(boost::shared_ptr<Moses::Task>(
+                    new FilterTask(chunk_id++, chunk, collector, pfe_index)));
+      chunk = new std::vector<std::string>();
+    }
+    if (eof)
+      break;
+    chunk->push_back(line);
+
+    size_t tmp_lines = ++pt_lines;
+    if(tmp_lines % 10000 == 0) {
+      std::cerr << ".";
       
-      if(pt_lines % 10000 == 0) {
-        BOOST_FOREACH(boost::shared_ptr<SA> f_sa, f_sas)
-          f_sa->cache.prune();
-        BOOST_FOREACH(boost::shared_ptr<SA> e_sa, e_sas)
-          e_sa->cache.prune();
-      }
+      if(tmp_lines % 500000 == 0)
+        std::cerr << "[n:" << tmp_lines << "]\n";
       
-      if(it->length() > 0) {
-        PTEntry* pp = new PTEntry(it->c_str(), pfe_index);
-        if (prev != pp->f_phrase) {
-          prev = pp->f_phrase;
-  
-          if (!options.empty()) {  // always true after first line
-            compute_cooc_stats_and_filter(options);
-          }
-          
-          for (std::vector<PTEntry*>::iterator i = options.begin();
-               i != options.end(); ++i) {
-            out_temp << **i << '\n';
-            delete *i;
-          }
-        
-          options.clear();
-          options.push_back(pp);
-  
-        } else {
-          options.push_back(pp);
-        }
+      if(tmp_lines % 10000000 == 0) {
+        boost::mutex::scoped_lock lock(stats_mutex);
+        print_stats(std::cerr);
       }
+
+      BOOST_FOREACH(boost::shared_ptr<SA> f_sa, f_sas)
+        f_sa->cache.prune();
+      BOOST_FOREACH(boost::shared_ptr<SA> e_sa, e_sas)
+        e_sa->cache.prune();
     }
-    boost::mutex::scoped_lock lock(out_mutex);
-    *out << out_temp.str() << std::flush;
   }
-  compute_cooc_stats_and_filter(options);
-  
-  boost::mutex::scoped_lock lock(out_mutex);
-  for (std::vector<PTEntry*>::iterator i = options.begin();
-       i != options.end(); ++i) {
-    *out << **i << '\n';
-    delete *i;
-  }
-  *out << std::flush;
+  delete chunk;
+  pool.Stop(true);
+  out << std::flush;
+}
+
+// Tokens in the scores field of the first line of a text phrase table.
+size_t count_scores(const std::string& path)
+{
+  std::ifstream in(path.c_str());
+  std::string line;
+  if (!getline(in, line))
+    return 0;
+  PTEntry pp(line, 0);
+  std::istringstream scores(pp.scores);
+  size_t n = 0;
+  std::string score;
+  while (scores >> score)
+    ++n;
+  return n;
 }
 
 namespace po = boost::program_options;
@@ -529,6 +631,9 @@ int main(int argc, char * argv[])
   int threads = 1;
   size_t max_cache = 0;
   std::string str_sig_filter_limit;
+  std::string output = "-";
+  std::string format = "text";
+  bool log_prob = false;
    
   po::options_description general("General options");
   general.add_options()
@@ -550,6 +655,13 @@ int main(int argc, char * argv[])
      "add -log(significance) to the phrase table")
     ("hierarchical,x", po::value(&hierarchical)->zero_tokens()->default_value(false),
      "filter hierarchical rule table")
+    ("output,o", po::value(&output)->default_value(output),
+     "where to write the filtered table, - for stdout")
+    ("format", po::value(&format)->default_value(format),
+     "text, compact (as processPhraseTableMin) or probing (as CreateProbingPT); "
+     "binary formats need --output")
+    ("log-prob", po::value(&log_prob)->zero_tokens()->default_value(false),
+     "with --format probing: log (and floor) probabilities before storing")
     ("sig-filter-limit,l", po::value(&str_sig_filter_limit),
      ">0.0, a+e, or a-e: keep values that have a -log significance > this")
     ("help,h", po::value(&help)->zero_tokens()->default_value(false),
@@ -599,6 +711,27 @@ int main(int argc, char * argv[])
     }
   }
     
+  if (format != "text" && format != "compact" && format != "probing") {
+    std::cerr << "Unknown output format " << format << "\n";
+    usage();
+    exit(1);
+  }
+  if (format != "text" && output == "-") {
+    std::cerr << "Output format " << format << " needs --output\n";
+    exit(1);
+  }
+#ifndef HAVE_CMPH
+  if (format == "compact") {
+    std::cerr << "Output format compact needs moses built --with-cmph\n";
+    exit(1);
+  }
+#endif
+  if (format == "probing" && hierarchical) {
+    std::cerr << "Write hierarchical rule tables as text and convert them "
+              << "with CreateProbingPT --scfg\n";
+    exit(1);
+  }
+
   if (sig_filter_limit == 0.0) pef_filter_only = true;
   //-----------------------------------------------------------------------------
   if (optind != argc || ((efiles.empty() || ffiles.empty()) && !pef_filter_only)) {
@@ -649,21 +782,40 @@ int main(int argc, char * argv[])
   Cache::set_max_cache(max_cache);
   std::ios_base::sync_with_stdio(false);
   
-  boost::thread_group threadGroup;
-  for(int i = 0; i < threads; i++) 
-    threadGroup.add_thread(new boost::thread(filter_thread, &std::cin, &std::cout, pfe_index));
-  threadGroup.join_all();
+  // binary formats are built from the filtered text table
+  std::string text_output = output;
+  if (format != "text")
+    text_output = output + ".filtered.txt";
+  if (text_output == "-") {
+    filter(std::cin, std::cout, threads, pfe_index);
+  } else {
+    std::ofstream out(text_output.c_str());
+    if (!out) {
+      std::cerr << "Could not open " << text_output << " for writing\n";
+      exit(1);
+    }
+    filter(std::cin, out, threads, pfe_index);
+  }
 
-  float pfefper = (100.0*(float)nremoved_pfefilter)/(float)pt_lines;
-  float sigfper = (100.0*(float)nremoved_sigfilter)/(float)pt_lines;
-  
-  std::cerr << "\n\n------------------------------------------------------\n"
-            << "  unfiltered phrases pairs: " << pt_lines << "\n"
-            << "\n"
-            << "     P(f|e) filter [first]: " << nremoved_pfefilter << "   (" << pfefper << "%)\n"
-            << "       significance filter: " << nremoved_sigfilter << "   (" << sigfper << "%)\n"
-            << "            TOTAL FILTERED: " << (nremoved_pfefilter + nremoved_sigfilter) << "   (" << (sigfper + pfefper) << "%)\n"
-            << "\n"
-            << "     FILTERED phrase pairs: " << (pt_lines - nremoved_pfefilter - nremoved_sigfilter) << "   (" << (100.0-sigfper - pfefper) << "%)\n"
-            << "------------------------------------------------------\n";  
+  std::cerr << "\n\n";
+  print_stats(std::cerr);
+
+#ifdef HAVE_CMPH
+  if (format == "compact") {
+    std::string path = output;
+    if(path.rfind(".minphr") != path.size() - 7)
+      path += ".minphr";
+    std::string tempdir = path.substr(0, path.rfind('/') + 1);
+    Moses::PhraseTableCreator(text_output, path, tempdir,
+                              count_scores(text_output), pfe_index,
+                              Moses::PhraseTableCreator::PREnc, 10, 16,
+                              true, true, 0, 100, true, threads);
+    std::remove(text_output.c_str());
+  }
+#endif
+  if (format == "probing") {
+    probingpt::createProbingPT(text_output, output, count_scores(text_output),
+                               0, log_prob, 50000, false);
+    std::remove(text_output.c_str());
+  }
 }
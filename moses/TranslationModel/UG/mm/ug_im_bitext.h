@@ -22,6 +22,10 @@ namespace sapt
     imBitext(size_t max_sample = 5000, size_t num_workers=4);
     imBitext(imBitext const& other);
 
+    // concatenate several in-memory bitexts into a new one; the suffix
+    // arrays are rebuilt from scratch rather than merged pairwise
+    imBitext(std::vector<SPTR<imBitext<TKN> > > const& parts);
+
     // SPTR<imBitext<TKN> >
     // add(std::vector<TKN> const& s1, std::vector<TKN> const& s2, std::vector<ushort> & a);
 
@@ -86,6 +90,60 @@ namespace sapt
     ++my_revision;
   }
 
+  template<typename T>
+  void
+  copy_snt(Ttrack<T> const& track, size_t const sid,
+           std::vector<std::vector<T> >& dest)
+  {
+    T const* a = track.sntStart(sid);
+    T const* z = track.sntEnd(sid);
+    dest.push_back(a ? std::vector<T>(a, z) : std::vector<T>());
+  }
+
+  template<typename TKN>
+  imBitext<TKN>::
+  imBitext(std::vector<SPTR<imBitext<TKN> > > const& parts)
+  {
+    assert(parts.size());
+    this->V1 = parts.front()->V1;
+    this->V2 = parts.front()->V2;
+    this->m_default_sample_size = parts.front()->m_default_sample_size;
+    this->m_num_workers = parts.front()->m_num_workers;
+
+    typedef std::vector<std::vector<TKN> > tdata_t;
+    typedef std::vector<std::vector<char> > xdata_t;
+    SPTR<tdata_t> d1(new tdata_t), d2(new tdata_t);
+    SPTR<xdata_t> dx(new xdata_t);
+    size_t n = 0;
+    BOOST_FOREACH(SPTR<imBitext<TKN> > const& p, parts)
+      if (p->T1) n += p->T1->size();
+    d1->reserve(n); d2->reserve(n); dx->reserve(n);
+
+    BOOST_FOREACH(SPTR<imBitext<TKN> > const& p, parts)
+      {
+        if (!p->T1) continue;
+        for (size_t sid = 0; sid < p->T1->size(); ++sid)
+          {
+            copy_snt(*p->T1, sid, *d1);
+            copy_snt(*p->T2, sid, *d2);
+            copy_snt(*p->Tx, sid, *dx);
+          }
+      }
+
+    myT1.reset(new imTtrack<TKN>(d1));
+    myT2.reset(new imTtrack<TKN>(d2));
+    myTx.reset(new imTtrack<char>(dx));
+    size_t threads = std::max(this->m_num_workers, size_t(1));
+    myI1.reset(new imTSA<TKN>(myT1, NULL, NULL, threads));
+    myI2.reset(new imTSA<TKN>(myT2, NULL, NULL, threads));
+    this->Tx = myTx;
+    this->T1 = myT1;
+    this->T2 = myT2;
+    this->I1 = myI1;
+    this->I2 = myI2;
+    ++my_revision;
+  }
+
   template<>
   SPTR<imBitext<L2R_Token<SimpleWordId> > >
   imBitext<L2R_Token<SimpleWordId> >::
@@ -3,9 +3,7 @@
 #ifndef _ug_im_tsa_h
 #define _ug_im_tsa_h
 
-// TO DO:
-// - multi-threaded sorting during TSA construction (currently painfully slow!)
-
+#include <algorithm>
 #include <iostream>
 
 #include <boost/iostreams/device/mapped_file.hpp>
@@ -26,6 +24,11 @@ namespace sapt
 {
   namespace bio=boost::iostreams;
 
+  // Sorts one bucket [begin,end) of a suffix array under construction. All
+  // suffixes in the bucket share their first /depth/ tokens. Buckets larger
+  // than /threshold/ are radix-partitioned on the token at position /depth/
+  // and the parts are sorted as separate jobs in /pool/, so that the buckets
+  // of frequent words don't end up being sorted by a single thread.
   template<typename TOKEN, typename SORTER>
   class TsaSorter
   {
@@ -34,23 +37,116 @@ namespace sapt
     typedef typename std::vector<cpos>::iterator iter;
   private:
     SORTER m_sorter;
+    Ttrack<TOKEN> const* m_corpus;
     iter m_begin;
     iter m_end;
+    size_t m_depth;
+    size_t m_threshold;
+    ug::ThreadPool* m_pool;
+
+    static id_type const END = id_type(-1);
+    // beyond this depth we assume a run of duplicate sentences and
+    // leave the rest to std::sort
+    static size_t const MAX_DEPTH = 32;
+    // smaller parts are sorted right away rather than queued
+    static size_t const MIN_JOB = 1024;
+
+    id_type key(cpos const& p) const;
+    void partition(std::vector<id_type>& keys) const;
   public:
     TsaSorter(SORTER sorter, iter& begin, iter& end)
-      : m_sorter(sorter),
-        m_begin(begin),
-        m_end(end) { }
+      : m_sorter(sorter), m_corpus(NULL),
+        m_begin(begin), m_end(end),
+        m_depth(0), m_threshold(0), m_pool(NULL) { }
+
+    TsaSorter(SORTER sorter, Ttrack<TOKEN> const* corpus,
+              iter const& begin, iter const& end, size_t depth,
+              size_t threshold, ug::ThreadPool* pool)
+      : m_sorter(sorter), m_corpus(corpus),
+        m_begin(begin), m_end(end),
+        m_depth(depth), m_threshold(threshold), m_pool(pool) { }
     
     bool 
-    operator()()
-    {
-      std::sort(m_begin, m_end, m_sorter);
-      return true;
-    }
-    
+    operator()();
   };
 
+  // id of the token /m_depth/ positions into the suffix starting at p;
+  // END if the sentence ends before that
+  template<typename TOKEN, typename SORTER>
+  id_type
+  TsaSorter<TOKEN,SORTER>::
+  key(cpos const& p) const
+  {
+    TOKEN const* t = m_corpus->getToken(p)->next(m_depth);
+    TOKEN const* bos = m_corpus->sntStart(p.sid);
+    TOKEN const* eos = m_corpus->sntEnd(p.sid);
+    return (t < bos || t >= eos) ? END : t->id();
+  }
+
+  // stable LSD radix sort of the bucket by key (two 16-bit digits); END
+  // sorts first because a suffix that ends is smaller than its extensions
+  template<typename TOKEN, typename SORTER>
+  void
+  TsaSorter<TOKEN,SORTER>::
+  partition(std::vector<id_type>& keys) const
+  {
+    size_t const n = m_end - m_begin;
+    keys.resize(n);
+    for (size_t i = 0; i < n; ++i)
+      keys[i] = key(m_begin[i]) + 1; // END wraps around to 0
+
+    std::vector<cpos> buf(n);
+    std::vector<id_type> kbuf(n);
+    std::vector<size_t> cnt(65537);
+    for (int shift = 0; shift < 32; shift += 16)
+      {
+        std::fill(cnt.begin(), cnt.end(), 0);
+        for (size_t i = 0; i < n; ++i)
+          ++cnt[((keys[i] >> shift) & 0xffff) + 1];
+        for (size_t d = 1; d < cnt.size(); ++d)
+          cnt[d] += cnt[d-1];
+        for (size_t i = 0; i < n; ++i)
+          {
+            size_t& k = cnt[(keys[i] >> shift) & 0xffff];
+            buf[k] = m_begin[i];
+            kbuf[k++] = keys[i];
+          }
+        std::copy(buf.begin(), buf.end(), m_begin);
+        keys.swap(kbuf);
+      }
+  }
+
+  template<typename TOKEN, typename SORTER>
+  bool
+  TsaSorter<TOKEN,SORTER>::
+  operator()()
+  {
+    size_t const n = m_end - m_begin;
+    if (!m_corpus || n <= m_threshold || m_depth >= MAX_DEPTH)
+      {
+        std::sort(m_begin, m_end, m_sorter);
+        return true;
+      }
+
+    std::vector<id_type> keys;
+    partition(keys);
+
+    // keys are now grouped; sort each group on the following tokens
+    for (size_t i = 0; i < n;)
+      {
+        size_t k = i;
+        while (++k < n && keys[k] == keys[i]);
+        if (keys[i] != 0 && k - i > 1) // group 0: suffixes that ended
+          {
+            TsaSorter job(m_sorter, m_corpus, m_begin + i, m_begin + k,
+                          m_depth + 1, m_threshold, m_pool);
+            if (m_pool && k - i >= MIN_JOB) m_pool->add(job);
+            else job();
+          }
+        i = k;
+      }
+    return true;
+  }
 
  //-----------------------------------------------------------------------
   template<typename TOKEN>
@@ -236,6 +332,9 @@ namespace sapt
     index.resize(wcnt.size()+1,0);
     typedef typename ttrack::Position::LESS<Ttrack<TOKEN> > sorter_t;
     sorter_t sorter(c.get());
+    // buckets bigger than this are split further on the following tokens
+    // so that all threads have work even if a few words dominate
+    size_t threshold = std::max(size_t(1) << 16, sufa.size() / (16 * threads));
     for (size_t i = 0; i < wcnt.size(); i++)
       {
         // if (log && wcnt[i] > 5000)
@@ -248,7 +347,8 @@ namespace sapt
 	    typename std::vector<cpos>::iterator b,e;
 	    b = sufa.begin()+index[i];
 	    e = sufa.begin()+index[i+1];
-	    TsaSorter<TOKEN,sorter_t> foo(sorter,b,e);
+	    TsaSorter<TOKEN,sorter_t> foo(sorter,c.get(),b,e,1,threshold,
+                                          tpool.get());
 	    tpool->add(foo);
 	    // sort(sufa.begin()+index[i],sufa.begin()+index[i+1],sorter);
 	  }
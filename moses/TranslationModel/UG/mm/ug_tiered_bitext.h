@@ -0,0 +1,409 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width:2  -*-
+// Log-structured dynamic bitext for online updates.
+//
+// Rebuilding one in-memory bitext per update (imBitext::add) merges the
+// new sentences into a copy of the complete suffix arrays, so every update
+// costs O(corpus). A TieredBitext instead keeps a sequence of immutable
+// imBitext segments. Updates only touch the newest (small) segment; once
+// /fanout/ sealed segments of the same size class have accumulated, a
+// background thread concatenates them into one larger segment and swaps it
+// in. Readers take a snapshot of the segment list and query every segment
+// in it; phrase pair statistics are pooled across segments.
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+
+#include "ug_bitext.h"
+#include "ug_im_bitext.h"
+
+namespace sapt
+{
+  template<typename TKN>
+  class TieredBitext
+  {
+  public:
+    typedef imBitext<TKN> segment_t;
+    typedef typename TSA<TKN>::tree_iterator iter;
+
+    // immutable view of the segments at one point in time
+    class Snapshot
+    {
+    public:
+      std::vector<SPTR<segment_t> > segments; // oldest (largest) first
+      SPTR<segment_t> empty; // stands in for main() while there are none
+      size_t revision;
+
+      Snapshot() : revision(0) { }
+
+      // total number of sentence pairs
+      size_t size() const;
+
+      // the largest segment, for feature functions that need one bitext
+      SPTR<segment_t> main() const;
+
+      // is /phrase/ (L1 ids) found in any segment?
+      bool contains(std::vector<id_type> const& phrase) const;
+
+      // approximate occurrence count of an L2 phrase in all segments
+      size_t approxOccurrenceCount2(TKN const* start, uint32_t len) const;
+
+#ifndef NO_MOSES
+      // launch sampling for /phrase/ in every segment that contains it
+      void prep(ttasksptr const& ttask, std::vector<id_type> const& phrase,
+                bool const track_sids) const;
+
+      // phrase pairs for /phrase/ pooled over all segments, sorted by
+      // target id sequence; returns false if no segment contains /phrase/
+      bool lookup(ttasksptr const& ttask, std::vector<id_type> const& phrase,
+                  std::vector<PhrasePair<TKN> >& dest,
+                  std::ostream* log) const;
+#endif
+    };
+
+    TieredBitext(SPTR<TokenIndex> const& V1, SPTR<TokenIndex> const& V2,
+                 size_t max_sample = 5000, size_t num_workers = 4,
+                 size_t segment_size = 1000, size_t fanout = 4);
+    ~TieredBitext();
+
+    SPTR<Snapshot const> snapshot() const;
+
+    // add sentence pairs; visible to snapshots taken after this returns
+    void add(std::vector<std::string> const& s1,
+             std::vector<std::string> const& s2,
+             std::vector<std::string> const& aln);
+
+    // block until no more merges are pending
+    void flush();
+
+  private:
+    SPTR<TokenIndex> V1, V2;
+    size_t m_max_sample;
+    size_t m_num_workers;
+    size_t m_segment_size; // sentence pairs per segment before it's sealed
+    size_t m_fanout;       // number of segments merged at a time
+
+    SPTR<segment_t> m_empty;
+
+    mutable boost::mutex m_lock;   // protects everything below
+    boost::mutex m_update_lock;    // serializes writers
+    boost::condition_variable m_wake;
+    boost::condition_variable m_idle;
+    SPTR<Snapshot const> m_current;
+    size_t m_revision;
+    bool m_stop;
+    bool m_busy;
+    boost::thread m_merger;
+
+    size_t tier(size_t const n) const;
+    bool find_merge(Snapshot const& snap, size_t& start) const;
+    void publish(std::vector<SPTR<segment_t> > const& segments);
+    void merge_loop();
+  };
+
+  template<typename TKN>
+  size_t
+  TieredBitext<TKN>::
+  Snapshot::
+  size() const
+  {
+    size_t n = 0;
+    BOOST_FOREACH(SPTR<segment_t> const& s, segments)
+      n += s->T1->size();
+    return n;
+  }
+
+  template<typename TKN>
+  SPTR<typename TieredBitext<TKN>::segment_t>
+  TieredBitext<TKN>::
+  Snapshot::
+  main() const
+  {
+    SPTR<segment_t> ret = empty;
+    BOOST_FOREACH(SPTR<segment_t> const& s, segments)
+      if (ret == empty || s->T1->size() > ret->T1->size()) ret = s;
+    return ret;
+  }
+
+  template<typename TKN>
+  bool
+  TieredBitext<TKN>::
+  Snapshot::
+  contains(std::vector<id_type> const& phrase) const
+  {
+    BOOST_FOREACH(SPTR<segment_t> const& s, segments)
+      {
+        iter m(s->I1.get(), &phrase[0], phrase.size());
+        if (m.size() == phrase.size()) return true;
+      }
+    return false;
+  }
+
+  template<typename TKN>
+  size_t
+  TieredBitext<TKN>::
+  Snapshot::
+  approxOccurrenceCount2(TKN const* start, uint32_t len) const
+  {
+    size_t ret = 0;
+    BOOST_FOREACH(SPTR<segment_t> const& s, segments)
+      {
+        iter m(s->I2.get(), start, len);
+        if (m.size() == len) ret += m.approxOccurrenceCount();
+      }
+    return ret;
+  }
+
+#ifndef NO_MOSES
+  template<typename TKN>
+  void
+  TieredBitext<TKN>::
+  Snapshot::
+  prep(ttasksptr const& ttask, std::vector<id_type> const& phrase,
+       bool const track_sids) const
+  {
+    BOOST_FOREACH(SPTR<segment_t> const& s, segments)
+      {
+        iter m(s->I1.get(), &phrase[0], phrase.size());
+        if (m.size() == phrase.size()) s->prep(ttask, m, track_sids);
+      }
+  }
+
+  template<typename TKN>
+  bool
+  TieredBitext<TKN>::
+  Snapshot::
+  lookup(ttasksptr const& ttask, std::vector<id_type> const& phrase,
+         std::vector<PhrasePair<TKN> >& dest, std::ostream* log) const
+  {
+    size_t found = 0;
+    size_t raw1 = 0, sample1 = 0, good1 = 0;
+    BOOST_FOREACH(SPTR<segment_t> const& s, segments)
+      {
+        iter m(s->I1.get(), &phrase[0], phrase.size());
+        if (m.size() != phrase.size()) continue;
+        SPTR<pstats> ps = s->lookup(ttask, m);
+        if (!ps) continue;
+        ++found;
+        raw1 += ps->raw_cnt;
+        sample1 += ps->sample_cnt;
+        good1 += ps->good;
+        expand(m, *s, *ps, dest, log);
+      }
+    if (!found) return false;
+
+    typename PhrasePair<TKN>::SortByTargetIdSeq sorter;
+    std::sort(dest.begin(), dest.end(), sorter);
+
+    // pool the statistics of identical phrase pairs from different segments
+    size_t k = 0;
+    for (size_t i = 0; i < dest.size(); ++k)
+      {
+        if (k != i) dest[k] = dest[i];
+        bool pooled = false;
+        while (++i < dest.size() && sorter.cmp(dest[k], dest[i]) == 0)
+          {
+            // the sid list is shared with the cached sampling results
+            if (!pooled && dest[k].sids)
+              dest[k].sids.reset(new std::vector<uint32_t>(*dest[k].sids));
+            pooled = true;
+            dest[k] += dest[i];
+          }
+      }
+    dest.resize(k);
+
+    // marginals must count all segments, not only those in which the
+    // phrase pair was sampled; even a source phrase found in one segment
+    // may have target phrases that occur in others
+    BOOST_FOREACH(PhrasePair<TKN>& pp, dest)
+      {
+        pp.raw1 = raw1;
+        pp.sample1 = sample1;
+        pp.good1 = good1;
+        pp.raw2 = approxOccurrenceCount2(pp.start2, pp.len2);
+      }
+    return true;
+  }
+#endif
+
+  template<typename TKN>
+  TieredBitext<TKN>::
+  TieredBitext(SPTR<TokenIndex> const& v1, SPTR<TokenIndex> const& v2,
+               size_t max_sample, size_t num_workers,
+               size_t segment_size, size_t fanout)
+    : V1(v1), V2(v2)
+    , m_max_sample(max_sample)
+    , m_num_workers(num_workers)
+    , m_segment_size(std::max(segment_size, size_t(1)))
+    , m_fanout(std::max(fanout, size_t(2)))
+    , m_empty(new segment_t(v1, v2, max_sample, num_workers))
+    , m_revision(0)
+    , m_stop(false)
+    , m_busy(false)
+  {
+    publish(std::vector<SPTR<segment_t> >());
+    m_merger = boost::thread(&TieredBitext<TKN>::merge_loop, this);
+  }
+
+  template<typename TKN>
+  TieredBitext<TKN>::
+  ~TieredBitext()
+  {
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    m_merger.join();
+  }
+
+  template<typename TKN>
+  SPTR<typename TieredBitext<TKN>::Snapshot const>
+  TieredBitext<TKN>::
+  snapshot() const
+  {
+    boost::lock_guard<boost::mutex> guard(m_lock);
+    return m_current;
+  }
+
+  // size class of a segment with /n/ sentence pairs
+  template<typename TKN>
+  size_t
+  TieredBitext<TKN>::
+  tier(size_t const n) const
+  {
+    size_t t = 0;
+    for (size_t cap = m_segment_size * m_fanout; n >= cap; cap *= m_fanout)
+      ++t;
+    return t;
+  }
+
+  // find /fanout/ adjacent sealed segments of the same tier; the newest
+  // segment may still receive updates and is never merged
+  template<typename TKN>
+  bool
+  TieredBitext<TKN>::
+  find_merge(Snapshot const& snap, size_t& start) const
+  {
+    if (snap.segments.size() <= m_fanout) return false;
+    size_t const sealed = snap.segments.size() - 1;
+    size_t run = 0, t = 0;
+    for (size_t i = 0; i < sealed; ++i)
+      {
+        size_t ti = tier(snap.segments[i]->T1->size());
+        if (run && ti == t) ++run;
+        else { run = 1; t = ti; }
+        if (run == m_fanout)
+          {
+            start = i + 1 - m_fanout;
+            return true;
+          }
+      }
+    return false;
+  }
+
+  // caller must hold m_lock
+  template<typename TKN>
+  void
+  TieredBitext<TKN>::
+  publish(std::vector<SPTR<segment_t> > const& segments)
+  {
+    SPTR<Snapshot> snap(new Snapshot);
+    snap->segments = segments;
+    snap->empty = m_empty;
+    snap->revision = ++m_revision;
+    m_current = snap;
+  }
+
+  template<typename TKN>
+  void
+  TieredBitext<TKN>::
+  add(std::vector<std::string> const& s1,
+      std::vector<std::string> const& s2,
+      std::vector<std::string> const& aln)
+  {
+    if (s1.empty()) return;
+    boost::lock_guard<boost::mutex> writer(m_update_lock);
+
+    // only writers replace the newest segment, so it can't change under us
+    SPTR<segment_t> open;
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      if (m_current->segments.size())
+        open = m_current->segments.back();
+    }
+
+    SPTR<segment_t> seg;
+    bool extend = open && open->T1->size() + s1.size() <= m_segment_size;
+    if (extend) seg = open->add(s1, s2, aln);
+    else
+      {
+        segment_t fresh(V1, V2, m_max_sample, m_num_workers);
+        seg = fresh.add(s1, s2, aln);
+      }
+
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      std::vector<SPTR<segment_t> > segments = m_current->segments;
+      if (extend) segments.back() = seg;
+      else segments.push_back(seg);
+      publish(segments);
+    }
+    m_wake.notify_one();
+  }
+
+  template<typename TKN>
+  void
+  TieredBitext<TKN>::
+  flush()
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    size_t start;
+    while (m_busy || find_merge(*m_current, start))
+      m_idle.wait(lock);
+  }
+
+  template<typename TKN>
+  void
+  TieredBitext<TKN>::
+  merge_loop()
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    while (!m_stop)
+      {
+        size_t start;
+        if (!find_merge(*m_current, start))
+          {
+            m_busy = false;
+            m_idle.notify_all();
+            m_wake.wait(lock);
+            continue;
+          }
+        m_busy = true;
+        std::vector<SPTR<segment_t> > parts
+          (m_current->segments.begin() + start,
+           m_current->segments.begin() + start + m_fanout);
+        lock.unlock();
+
+        SPTR<segment_t> merged(new segment_t(parts));
+
+        lock.lock();
+        // writers only touch the newest segment, so the parts are still
+        // adjacent in the current list
+        std::vector<SPTR<segment_t> > segments = m_current->segments;
+        typename std::vector<SPTR<segment_t> >::iterator i
+          = std::find(segments.begin(), segments.end(), parts.front());
+        assert(i + m_fanout <= segments.end());
+        i = segments.erase(i, i + m_fanout);
+        segments.insert(i, merged);
+        publish(segments);
+      }
+    m_busy = false;
+    m_idle.notify_all();
+  }
+
+} // end of namespace sapt
@@ -10,6 +10,7 @@
 #include "util/exception.hh"
 #include <set>
 #include "util/usage.hh"
+#include "util/murmur_hash.hh"
 
 namespace Moses
 {
@@ -202,6 +203,13 @@ namespace Moses
     m_cache_size = max(10000,atoi(param.insert(dflt).first->second.c_str()));
 
     m_cache.reset(new TPCollCache(m_cache_size));
+
+    // online updates go into small segments of the dynamic bitext that are
+    // merged in the background, see ug_tiered_bitext.h
+    dflt = pair<string,string>("dyn-segment-size","1000");
+    m_dyn_segment_size = atoi(param.insert(dflt).first->second.c_str());
+    dflt = pair<string,string>("dyn-fanout","4");
+    m_dyn_fanout = atoi(param.insert(dflt).first->second.c_str());
     // m_history.reserve(hsize);
     // in plain language: cache size is at least 1000, and 10,000 by default
     // this cache keeps track of the most frequently used target
@@ -337,6 +345,8 @@ namespace Moses
     known_parameters.push_back("lr-func"); // associated lexical reordering function
     known_parameters.push_back("lrfunc");  // associated lexical reordering function
     known_parameters.push_back("method");
+    known_parameters.push_back("dyn-fanout");
+    known_parameters.push_back("dyn-segment-size");
     known_parameters.push_back("name");
     known_parameters.push_back("num-features");
     known_parameters.push_back("output-factor");
@@ -393,9 +403,8 @@ namespace Moses
 
     scoped_ptr<boost::unique_lock<shared_mutex> > guard;
     if (locking) guard.reset(new boost::unique_lock<shared_mutex>(m_lock));
-    btdyn = btdyn->add(text1,text2,symal);
-    assert(btdyn);
-    cerr << "Loaded " << btdyn->T1->size() << " sentence pairs" << endl;
+    btdyn->add(text1,text2,symal);
+    cerr << "Loaded " << text1.size() << " sentence pairs" << endl;
   }
 
   template<typename fftype>
@@ -538,7 +547,8 @@ namespace Moses
     btfix->open(m_bname, L1, L2);
     btfix->setDefaultSampleSize(m_default_sample_size);
 
-    btdyn.reset(new imbitext(btfix->V1, btfix->V2, m_default_sample_size, m_workers));
+    btdyn.reset(new tbitext(btfix->V1, btfix->V2, m_default_sample_size,
+                            m_workers, m_dyn_segment_size, m_dyn_fanout));
     if (m_bias_file.size())
       load_bias(m_bias_file);
 
@@ -566,8 +576,7 @@ namespace Moses
     vector<string> S1(1,s1);
     vector<string> S2(1,s2);
     vector<string> ALN(1,a);
-    boost::unique_lock<boost::shared_mutex> guard(m_lock);
-    btdyn = btdyn->add(S1,S2,ALN);
+    btdyn->add(S1,S2,ALN);
   }
 
 
@@ -577,12 +586,15 @@ namespace Moses
             Phrase const& src,
             PhrasePair<Token>* fix,
             PhrasePair<Token>* dyn,
-            SPTR<Bitext<Token> > const& dynbt) const
+            tbitext::Snapshot const& dynbt) const
   {
     UTIL_THROW_IF2(!fix && !dyn, HERE <<
                    ": Can't create target phrase from nothing.");
     vector<float> fvals(this->m_numScoreComponents);
     PhrasePair<Token> pool = fix ? *fix : *dyn;
+    // feature functions that need a bitext for the dynamic side see the
+    // largest segment; counts have already been pooled over all segments
+    SPTR<imbitext> dynmain = dynbt.main();
     if (fix)
       {
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_fix)
@@ -591,19 +603,17 @@ namespace Moses
     if (dyn)
       {
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_dyn)
-          (*ff)(*dynbt, *dyn, &fvals);
+          (*ff)(*dynmain, *dyn, &fvals);
       }
 
     if (fix && dyn) { pool += *dyn; }
     else if (fix)
       {
         PhrasePair<Token> zilch; zilch.init();
-        TSA<Token>::tree_iterator m(dynbt->I2.get(), fix->start2, fix->len2);
-        if (m.size() == fix->len2)
-          zilch.raw2 = m.approxOccurrenceCount();
+        zilch.raw2 = dynbt.approxOccurrenceCount2(fix->start2, fix->len2);
         pool += zilch;
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_dyn)
-          (*ff)(*dynbt, ff->allowPooling() ? pool : zilch, &fvals);
+          (*ff)(*dynmain, ff->allowPooling() ? pool : zilch, &fvals);
       }
     else if (dyn)
       {
@@ -613,7 +623,7 @@ namespace Moses
           zilch.raw2 = m.approxOccurrenceCount();
         pool += zilch;
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_fix)
-          (*ff)(*dynbt, ff->allowPooling() ? pool : zilch, &fvals);
+          (*ff)(*dynmain, ff->allowPooling() ? pool : zilch, &fvals);
       }
     if (fix)
       {
@@ -623,7 +633,7 @@ namespace Moses
     else
       {
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_common)
-          (*ff)(*dynbt, pool, &fvals);
+          (*ff)(*dynmain, pool, &fvals);
       }
 
     TargetPhrase* tp = new TargetPhrase(const_cast<ttasksptr&>(ttask), this);
@@ -720,38 +730,32 @@ namespace Moses
     fillIdSeq(src, m_ifactor, *(btfix->V1), sphrase);
     if (sphrase.size() == 0) return ret;
     
-    // Reserve a local copy of the dynamic bitext in its current form. /btdyn/
-    // is set to a new copy of the dynamic bitext every time a sentence pair
-    // is added. /dyn/ keeps the old bitext around as long as we need it.
-    SPTR<imBitext<Token> > dyn;
-    { // braces are needed for scoping mutex lock guard!
-      boost::unique_lock<boost::shared_mutex> guard(m_lock);
-      assert(btdyn);
-      dyn = btdyn;
-    }
-    assert(dyn);
+    // Take a snapshot of the dynamic bitext in its current form. Updates
+    // and background merges publish new snapshots; /dyn/ keeps the segments
+    // we look at alive as long as we need them.
+    SPTR<tbitext::Snapshot const> dyn = btdyn->snapshot();
 
     // lookup phrases in both bitexts
     TSA<Token>::tree_iterator mfix(btfix->I1.get(), &sphrase[0], sphrase.size());
-    TSA<Token>::tree_iterator mdyn(dyn->I1.get());
-    if (dyn->I1.get()) // we have a dynamic bitext
-      for (size_t i = 0; mdyn.size() == i && i < sphrase.size(); ++i)
-        mdyn.extend(sphrase[i]);
+    bool indyn = dyn->contains(sphrase);
 
-    if (mdyn.size() != sphrase.size() && mfix.size() != sphrase.size())
+    if (!indyn && mfix.size() != sphrase.size())
       return ret; // phrase not found in either bitext
 
-    // do we have cached results for this phrase?
+    // do we have cached results for this phrase? Phrase ids differ between
+    // the segments of the dynamic bitext, so phrases that occur only there
+    // are keyed by their id sequence.
     uint64_t phrasekey = (mfix.size() == sphrase.size()
                           ? (mfix.getPid()<<1) 
-                          : (mdyn.getPid()<<1)+1);
+                          : (util::MurmurHashNative(&sphrase[0], sphrase.size()
+                                                    * sizeof(id_type))<<1)+1);
 
     // get context-specific cache of items previously looked up
     SPTR<ContextScope> const& scope = ttask->GetScope();
     SPTR<TPCollCache> cache = scope->get<TPCollCache>(cache_key);
     if (!cache) cache = m_cache; // no context-specific cache, use global one
 
-    ret = cache->get(phrasekey, dyn->revision());
+    ret = cache->get(phrasekey, dyn->revision);
     // TO DO: we should revise the revision mechanism: we take the
     // length of the dynamic bitext (in sentences) at the time the PT
     // entry was stored as the time stamp. For each word in the
@@ -777,7 +781,7 @@ namespace Moses
     // TO DO: have Bitexts return lists of PhrasePairs instead of pstats
     // no need to expand pstats at every single lookup again, especially
     // for btfix.
-    SPTR<pstats> sfix,sdyn;
+    SPTR<pstats> sfix;
 
     if (mfix.size() == sphrase.size()) 
       {
@@ -796,9 +800,6 @@ namespace Moses
           }
       }
 
-    if (mdyn.size() == sphrase.size()) 
-      sdyn = dyn->lookup(ttask, mdyn);
-
     vector<PhrasePair<Token> > ppfix,ppdyn;
     PhrasePair<Token>::SortByTargetIdSeq sort_by_tgt_id;
     if (sfix)
@@ -806,11 +807,8 @@ namespace Moses
         expand(mfix, *btfix, *sfix, ppfix, m_bias_log);
         sort(ppfix.begin(), ppfix.end(),sort_by_tgt_id);
       }
-    if (sdyn)
-      {
-        expand(mdyn, *dyn, *sdyn, ppdyn, m_bias_log);
-        sort(ppdyn.begin(), ppdyn.end(),sort_by_tgt_id);
-      }
+    if (indyn) // pooled over all segments and sorted by target
+      dyn->lookup(ttask, sphrase, ppdyn, m_bias_log);
 
     // now we have two lists of Phrase Pairs, let's merge them
     PhrasePair<Token>::SortByTargetIdSeq sorter;
@@ -818,12 +816,12 @@ namespace Moses
     while (i < ppfix.size() && k < ppdyn.size())
       {
         int cmp = sorter.cmp(ppfix[i], ppdyn[k]);
-        if      (cmp  < 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,dyn));
-        else if (cmp == 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],&ppdyn[k++],dyn));
-        else               ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],dyn));
+        if      (cmp  < 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,*dyn));
+        else if (cmp == 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],&ppdyn[k++],*dyn));
+        else               ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],*dyn));
       }
-    while (i < ppfix.size()) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,dyn));
-    while (k < ppdyn.size()) ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],dyn));
+    while (i < ppfix.size()) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,*dyn));
+    while (k < ppdyn.size()) ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],*dyn));
 
     // Pruning should not be done here but outside!
     if (m_tableLimit) ret->Prune(true, m_tableLimit);
@@ -987,21 +985,11 @@ namespace Moses
         return true;
       }
 
-    SPTR<imBitext<Token> > dyn;
-    { // braces are needed for scoping lock!
-      boost::unique_lock<boost::shared_mutex> guard(m_lock);
-      dyn = btdyn;
-    }
-    assert(dyn);
-    TSA<Token>::tree_iterator mdyn(dyn->I1.get());
-    if (dyn->I1.get())
-      {
-        for (size_t i = 0; mdyn.size() == i && i < myphrase.size(); ++i)
-          mdyn.extend(myphrase[i]);
-        // let's assume a uniform bias over the foreground corpus
-        if (mdyn.size() == myphrase.size()) dyn->prep(ttask, mdyn, m_track_coord);
-      }
-    return mdyn.size() == myphrase.size();
+    SPTR<tbitext::Snapshot const> dyn = btdyn->snapshot();
+    if (!dyn->contains(myphrase)) return false;
+    // let's assume a uniform bias over the foreground corpus
+    dyn->prep(ttask, myphrase, m_track_coord);
+    return true;
   }
 
 #if 0
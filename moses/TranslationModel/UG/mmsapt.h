@@ -21,6 +21,7 @@
 #include "moses/TranslationModel/UG/mm/ug_typedefs.h"
 #include "moses/TranslationModel/UG/mm/tpt_pickler.h"
 #include "moses/TranslationModel/UG/mm/ug_bitext.h"
+#include "moses/TranslationModel/UG/mm/ug_tiered_bitext.h"
 #include "moses/TranslationModel/UG/mm/ug_bitext_sampler.h"
 #include "moses/TranslationModel/UG/mm/ug_lexical_phrase_scorer2.h"
 
@@ -66,13 +67,14 @@ namespace Moses
     typedef sapt::L2R_Token<sapt::SimpleWordId> Token;
     typedef sapt::mmBitext<Token> mmbitext;
     typedef sapt::imBitext<Token> imbitext;
+    typedef sapt::TieredBitext<Token> tbitext;
     typedef sapt::Bitext<Token>     bitext;
     typedef sapt::TSA<Token>           tsa;
     typedef sapt::PhraseScorer<Token> pscorer;
   private:
     // vector<SPTR<bitext> > shards;
     SPTR<mmbitext> btfix;
-    SPTR<imbitext> btdyn;
+    SPTR<tbitext> btdyn;
     std::string m_bname, m_extra_data, m_bias_file,m_bias_server;
     std::string L1;
     std::string L2;
@@ -102,6 +104,8 @@ namespace Moses
     boost::shared_ptr<sapt::SamplingBias> m_bias; // for global default bias
     boost::shared_ptr<TPCollCache> m_cache; // for global default bias
     size_t m_cache_size;  //
+    size_t m_dyn_segment_size; // sentence pairs per dynamic bitext segment
+    size_t m_dyn_fanout;       // dynamic segments merged at a time
     // size_t input_factor;  //
     // size_t output_factor; // we can actually return entire Tokens!
 
@@ -185,7 +189,7 @@ namespace Moses
               Phrase const& src,
               sapt::PhrasePair<Token>* fix,
               sapt::PhrasePair<Token>* dyn,
-              SPTR<sapt::Bitext<Token> > const& dynbt) const;
+              tbitext::Snapshot const& dynbt) const;
 
     void
     process_pstats
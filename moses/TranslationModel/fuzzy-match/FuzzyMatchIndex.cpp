@@ -0,0 +1,372 @@
+//
+//  FuzzyMatchIndex.cpp
+//  moses
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef WITH_THREADS
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+#include "FuzzyMatchIndex.h"
+
+using namespace std;
+
+namespace tmmt
+{
+
+namespace
+{
+
+// Bit masks of the pattern positions holding each word, in 64 bit blocks.
+class WordPeq
+{
+public:
+  explicit WordPeq(const vector< WORD_ID > &pattern)
+    : m_blocks((pattern.size() + 63) / 64), m_words(pattern), m_zero(m_blocks, 0) {
+    sort(m_words.begin(), m_words.end());
+    m_words.erase(unique(m_words.begin(), m_words.end()), m_words.end());
+    m_masks.resize(m_words.size() * m_blocks);
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      size_t word = lower_bound(m_words.begin(), m_words.end(), pattern[i]) - m_words.begin();
+      m_masks[word * m_blocks + i / 64] |= boost::uint64_t(1) << (i % 64);
+    }
+  }
+
+  const boost::uint64_t *Row(WORD_ID word) const {
+    vector< WORD_ID >::const_iterator it = lower_bound(m_words.begin(), m_words.end(), word);
+    if (it == m_words.end() || *it != word) {
+      return &m_zero[0];
+    }
+    return &m_masks[(it - m_words.begin()) * m_blocks];
+  }
+
+private:
+  size_t m_blocks;
+  vector< WORD_ID > m_words;
+  vector< boost::uint64_t > m_masks;
+  vector< boost::uint64_t > m_zero;
+};
+
+// The same for the bytes of a word.
+class CharPeq
+{
+public:
+  explicit CharPeq(const string &pattern)
+    : m_blocks((pattern.size() + 63) / 64), m_masks(256 * m_blocks, 0) {
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      m_masks[(unsigned char) pattern[i] * m_blocks + i / 64] |= boost::uint64_t(1) << (i % 64);
+    }
+  }
+
+  const boost::uint64_t *Row(char c) const {
+    return &m_masks[(unsigned char) c * m_blocks];
+  }
+
+private:
+  size_t m_blocks;
+  vector< boost::uint64_t > m_masks;
+};
+
+/* Edit distance between the pattern of length m described by peq and text,
+ * computed a column of m cells at a time as vertical deltas in bit vectors
+ * (Myers 1999), one 64 bit block after the other with the horizontal delta
+ * carried between them (Hyyro 2003). Returns maxCost + 1 as soon as the
+ * distance must exceed maxCost.
+ */
+template <class Peq, class Symbol>
+unsigned int BitParallelDistance(const Peq &peq, size_t m, const Symbol *text, size_t n, unsigned int maxCost)
+{
+  if ((m > n ? m - n : n - m) > maxCost) {
+    return maxCost + 1;
+  }
+  if (m == 0 || n == 0) {
+    return m + n;
+  }
+
+  const size_t blocks = (m + 63) / 64;
+  const boost::uint64_t lastBit = boost::uint64_t(1) << ((m - 1) % 64);
+  const boost::uint64_t highBit = boost::uint64_t(1) << 63;
+  vector< boost::uint64_t > pv(blocks, ~boost::uint64_t(0)), mv(blocks, 0);
+
+  // edit distance between the whole pattern and the text read so far
+  unsigned int score = m;
+  for (size_t j = 0; j < n; ++j) {
+    const boost::uint64_t *eqs = peq.Row(text[j]);
+    // horizontal delta entering the block from above: the first row grows by 1
+    int carry = 1;
+    for (size_t b = 0; b < blocks; ++b) {
+      boost::uint64_t eq = eqs[b];
+      const boost::uint64_t p = pv[b], mi = mv[b];
+      if (carry < 0) {
+        eq |= 1;
+      }
+      const boost::uint64_t xv = eq | mi;
+      const boost::uint64_t xh = (((eq & p) + p) ^ p) | eq;
+      boost::uint64_t ph = mi | ~(xh | p);
+      boost::uint64_t mh = p & xh;
+
+      const boost::uint64_t bit = (b + 1 == blocks) ? lastBit : highBit;
+      const int out = (ph & bit) ? 1 : ((mh & bit) ? -1 : 0);
+
+      ph <<= 1;
+      mh <<= 1;
+      if (carry < 0) {
+        mh |= 1;
+      } else if (carry > 0) {
+        ph |= 1;
+      }
+      pv[b] = mh | ~(xv | ph);
+      mv[b] = ph & xv;
+      carry = out;
+    }
+    score += carry;
+
+    // every remaining text symbol lowers the distance by at most one
+    if (score > maxCost + (n - 1 - j)) {
+      return maxCost + 1;
+    }
+  }
+  return score;
+}
+
+struct Scored {
+  unsigned int cost;
+  boost::uint32_t sentence;
+};
+
+#ifdef WITH_THREADS
+typedef boost::atomic<unsigned int> Bound;
+#else
+typedef unsigned int Bound;
+#endif
+
+// Verify candidates start, start + stride, ... against the bound, which
+// shrinks as better matches are found (by any thread).
+void Verify(const vector< vector< WORD_ID > > &corpus, const WordPeq &peq, size_t inputLength,
+            const vector< boost::uint32_t > &candidates, size_t start, size_t stride,
+            Bound &bound, vector< Scored > &found)
+{
+  for (size_t i = start; i < candidates.size(); i += stride) {
+    const vector< WORD_ID > &sentence = corpus[candidates[i]];
+    unsigned int limit = bound;
+    if (sentence.empty()) {
+      // BitParallelDistance needs text
+      if (inputLength <= limit) {
+        Scored scored = { (unsigned int) inputLength, candidates[i] };
+        found.push_back(scored);
+      }
+      continue;
+    }
+    unsigned int cost = BitParallelDistance(peq, inputLength, &sentence[0], sentence.size(), limit);
+    if (cost > limit) {
+      continue;
+    }
+    Scored scored = { cost, candidates[i] };
+    found.push_back(scored);
+#ifdef WITH_THREADS
+    while (cost < limit && !bound.compare_exchange_weak(limit, cost)) {}
+#else
+    bound = cost;
+#endif
+  }
+}
+
+} // namespace
+
+FuzzyMatchIndex::FuzzyMatchIndex(const vector< vector< WORD_ID > > &corpus)
+  : m_corpus(corpus)
+  , m_threads(1)
+{
+  // count postings per gram, then lay them out one gram after the other
+  for (size_t s = 0; s < corpus.size(); ++s) {
+    const vector< WORD_ID > &sentence = corpus[s];
+    for (size_t i = 0; i < sentence.size(); ++i) {
+      ++m_postings[Unigram(sentence[i])].end;
+      if (i + 1 < sentence.size()) {
+        ++m_postings[Bigram(sentence[i], sentence[i + 1])].end;
+      }
+    }
+    if (sentence.size() >= m_byLength.size()) {
+      m_byLength.resize(sentence.size() + 1);
+    }
+    m_byLength[sentence.size()].push_back(s);
+  }
+
+  size_t total = 0;
+  for (Postings::iterator it = m_postings.begin(); it != m_postings.end(); ++it) {
+    it->second.begin = total;
+    total += it->second.end;
+    it->second.end = it->second.begin;
+  }
+
+  m_sentences.resize(total);
+  for (size_t s = 0; s < corpus.size(); ++s) {
+    const vector< WORD_ID > &sentence = corpus[s];
+    for (size_t i = 0; i < sentence.size(); ++i) {
+      m_sentences[m_postings[Unigram(sentence[i])].end++] = s;
+      if (i + 1 < sentence.size()) {
+        m_sentences[m_postings[Bigram(sentence[i], sentence[i + 1])].end++] = s;
+      }
+    }
+  }
+  cerr << "fuzzy match index: " << m_postings.size() << " grams, " << total << " postings" << endl;
+}
+
+void FuzzyMatchIndex::Candidates(const vector< WORD_ID > &input, unsigned int maxCost, vector< boost::uint32_t > &candidates) const
+{
+  const int n = input.size(), k = maxCost;
+
+  // bigrams filter better, but only promise common grams for longer input
+  const int q = (n - 1 - 2 * k >= 1) ? 2 : 1;
+  const int minCommon = n - q + 1 - q * k;
+
+  vector< boost::uint64_t > grams;
+  for (int i = 0; i + q <= n; ++i) {
+    grams.push_back(q == 2 ? Bigram(input[i], input[i + 1]) : Unigram(input[i]));
+  }
+  sort(grams.begin(), grams.end());
+
+  // distinct grams of the corpus, with their count in the input, rarest first
+  vector< pair< size_t, pair< const Range*, int > > > postings;
+  int rest = 0;
+  for (size_t i = 0; i < grams.size(); ) {
+    size_t j = i;
+    while (j < grams.size() && grams[j] == grams[i]) ++j;
+    Postings::const_iterator found = m_postings.find(grams[i]);
+    if (found != m_postings.end()) {
+      const Range &range = found->second;
+      postings.push_back(make_pair(range.end - range.begin, make_pair(&range, int(j - i))));
+      rest += j - i;
+    }
+    i = j;
+  }
+  sort(postings.begin(), postings.end());
+
+  // sentence id -> number of grams shared with the input
+  boost::unordered_map< boost::uint32_t, int > common;
+  for (size_t g = 0; g < postings.size(); ++g) {
+    const boost::uint32_t *begin = &m_sentences[postings[g].second.first->begin];
+    const boost::uint32_t *end = begin + postings[g].first;
+    const int count = postings[g].second.second;
+
+    if (rest >= minCommon) {
+      // a sentence without any of the grams so far may still qualify
+      for (const boost::uint32_t *it = begin; it != end; ) {
+        const boost::uint32_t *next = upper_bound(it, end, *it);
+        common[*it] += min< int >(count, next - it);
+        it = next;
+      }
+    } else if (common.empty()) {
+      break;
+    } else if (common.size() * 16 < size_t(end - begin)) {
+      // look the candidates up in the long list
+      for (boost::unordered_map< boost::uint32_t, int >::iterator it = common.begin(); it != common.end(); ++it) {
+        pair< const boost::uint32_t*, const boost::uint32_t* > found = equal_range(begin, end, it->first);
+        it->second += min< int >(count, found.second - found.first);
+      }
+    } else {
+      for (const boost::uint32_t *it = begin; it != end; ) {
+        const boost::uint32_t *next = upper_bound(it, end, *it);
+        boost::unordered_map< boost::uint32_t, int >::iterator found = common.find(*it);
+        if (found != common.end()) {
+          found->second += min< int >(count, next - it);
+        }
+        it = next;
+      }
+    }
+    rest -= count;
+  }
+
+  // most shared grams first, so that good matches tighten the bound early
+  vector< pair< int, boost::uint32_t > > ordered;
+  for (boost::unordered_map< boost::uint32_t, int >::const_iterator it = common.begin(); it != common.end(); ++it) {
+    const int m = m_corpus[it->first].size();
+    if (abs(m - n) > k || it->second < max(n, m) - q + 1 - q * k) {
+      continue;
+    }
+    ordered.push_back(make_pair(-it->second, it->first));
+  }
+
+  // input so short that sentences sharing no word are close enough
+  if (minCommon <= 0) {
+    for (int m = max(0, n - k); m <= k && m < int(m_byLength.size()); ++m) {
+      if (max(n, m) - q + 1 - q * k > 0) {
+        continue;
+      }
+      const vector< boost::uint32_t > &sentences = m_byLength[m];
+      for (size_t i = 0; i < sentences.size(); ++i) {
+        if (common.find(sentences[i]) == common.end()) {
+          ordered.push_back(make_pair(0, sentences[i]));
+        }
+      }
+    }
+  }
+
+  sort(ordered.begin(), ordered.end());
+  candidates.resize(ordered.size());
+  for (size_t i = 0; i < ordered.size(); ++i) {
+    candidates[i] = ordered[i].second;
+  }
+}
+
+unsigned int FuzzyMatchIndex::FindBest(const vector< WORD_ID > &input, unsigned int maxCost, vector< size_t > &best) const
+{
+  best.clear();
+
+  vector< boost::uint32_t > candidates;
+  Candidates(input, maxCost, candidates);
+
+  const WordPeq peq(input);
+  Bound bound(maxCost);
+  vector< vector< Scored > > found(1);
+
+#ifdef WITH_THREADS
+  // only worth starting threads for many candidates
+  const size_t threads = min(m_threads, candidates.size() / 256 + 1);
+  if (threads > 1) {
+    found.resize(threads);
+    boost::thread_group workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.create_thread(boost::bind(&Verify, boost::cref(m_corpus), boost::cref(peq), input.size(),
+                                        boost::cref(candidates), t, threads, boost::ref(bound), boost::ref(found[t])));
+    }
+    workers.join_all();
+  } else
+#endif
+  {
+    Verify(m_corpus, peq, input.size(), candidates, 0, 1, bound, found[0]);
+  }
+
+  const unsigned int cost = bound;
+  for (size_t t = 0; t < found.size(); ++t) {
+    for (size_t i = 0; i < found[t].size(); ++i) {
+      if (found[t][i].cost == cost) {
+        best.push_back(found[t][i].sentence);
+      }
+    }
+  }
+  sort(best.begin(), best.end());
+
+  return best.empty() ? maxCost + 1 : cost;
+}
+
+unsigned int FuzzyMatchIndex::Distance(const vector< WORD_ID > &a, const vector< WORD_ID > &b, unsigned int maxCost)
+{
+  if (b.empty()) {
+    return a.size() <= maxCost ? a.size() : maxCost + 1;
+  }
+  return BitParallelDistance(WordPeq(a), a.size(), &b[0], b.size(), maxCost);
+}
+
+unsigned int FuzzyMatchIndex::Distance(const string &a, const string &b, unsigned int maxCost)
+{
+  return BitParallelDistance(CharPeq(a), a.size(), b.data(), b.size(), maxCost);
+}
+
+}
@@ -0,0 +1,84 @@
+//
+//  FuzzyMatchIndex.h
+//  moses
+//
+
+#ifndef moses_FuzzyMatchIndex_h
+#define moses_FuzzyMatchIndex_h
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "Vocabulary.h"
+
+namespace tmmt
+{
+
+/** Finds the translation memory sentences with the smallest word edit
+ * distance to an input sentence.
+ *
+ * Candidates come from an inverted index of word unigrams and bigrams: a
+ * sentence within edit distance k of an input of n words shares at least
+ * max(n, m) - q + 1 - q * k of its q-grams, and differs in length by at most
+ * k. Postings are visited rarest first, and only as many of them introduce
+ * new candidates as that bound requires; the frequent rest only counts
+ * towards candidates already found.
+ *
+ * Candidates are then verified with the bit-parallel edit distance of Myers
+ * (1999) in the blocked form of Hyyrö (2003), which gives up as soon as the
+ * distance must exceed the best one found so far.
+ */
+class FuzzyMatchIndex
+{
+public:
+  //! corpus must outlive the index
+  explicit FuzzyMatchIndex(const std::vector< std::vector< WORD_ID > > &corpus);
+
+  //! Threads that verify the candidates of one input; default 1.
+  void SetThreads(std::size_t threads) {
+    m_threads = threads ? threads : 1;
+  }
+
+  /** Fill best with the ids (ascending) of all sentences at the smallest
+   * word edit distance from input, if that is at most maxCost, and return
+   * the distance. Returns maxCost + 1 and leaves best empty otherwise.
+   */
+  unsigned int FindBest(const std::vector< WORD_ID > &input, unsigned int maxCost, std::vector< std::size_t > &best) const;
+
+  //! Word edit distance, or maxCost + 1 if it is larger than maxCost.
+  static unsigned int Distance(const std::vector< WORD_ID > &a, const std::vector< WORD_ID > &b, unsigned int maxCost);
+
+  //! Letter edit distance, or maxCost + 1 if it is larger than maxCost.
+  static unsigned int Distance(const std::string &a, const std::string &b, unsigned int maxCost);
+
+private:
+  struct Range {
+    std::size_t begin, end;
+  };
+  typedef boost::unordered_map< boost::uint64_t, Range > Postings;
+
+  static boost::uint64_t Unigram(WORD_ID word) {
+    return word;
+  }
+  static boost::uint64_t Bigram(WORD_ID first, WORD_ID second) {
+    return ((boost::uint64_t(first) + 1) << 32) | second;
+  }
+
+  void Candidates(const std::vector< WORD_ID > &input, unsigned int maxCost, std::vector< boost::uint32_t > &candidates) const;
+
+  const std::vector< std::vector< WORD_ID > > &m_corpus;
+  Postings m_postings;
+  // sentence ids, grouped by gram
+  std::vector< boost::uint32_t > m_sentences;
+  // sentence ids by sentence length, for inputs so short that a match
+  // need not share any word
+  std::vector< std::vector< boost::uint32_t > > m_byLength;
+  std::size_t m_threads;
+};
+
+}
+
+#endif
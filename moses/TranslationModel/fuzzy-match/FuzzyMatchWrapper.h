@@ -17,37 +17,49 @@
 #include <string>
 #include "SuffixArray.h"
 #include "Vocabulary.h"
-#include "Match.h"
 #include "moses/InputType.h"
 
 namespace tmmt
 {
-class Match;
 struct SentenceAlignment;
+class FuzzyMatchIndex;
+
+/** A hierarchical rule extracted from the translation memory matches of one
+ * input sentence, with the counts that train-model.perl -score-options
+ * --NoLex would turn into p(s|t) = count/targetCount and
+ * p(t|s) = count/sourceCount.
+ */
+struct ScoredRule {
+  std::string source, target; // without the [X] left-hand side
+  std::string alignment; // most frequent alignment, ordered by target
+  float count, sourceCount, targetCount;
+};
 
 class FuzzyMatchWrapper
 {
 public:
   FuzzyMatchWrapper(const std::string &source, const std::string &target, const std::string &alignment);
+  ~FuzzyMatchWrapper();
+
+  //! Threads searching the translation memory for each input; default 1.
+  void SetThreads(std::size_t threads);
 
-  std::string Extract(long translationId, const std::string &dirNameStr);
+  //! Rules for the space-separated words of input. Thread-safe.
+  void Extract(long translationId, const std::string &input, std::vector<ScoredRule> &rules);
 
 protected:
   // tm-mt
   std::vector< std::vector< tmmt::SentenceAlignment > > targetAndAlignment;
   tmmt::SuffixArray *suffixArray;
+  tmmt::FuzzyMatchIndex *m_index;
   int basic_flag;
   int lsed_flag;
-  int refined_flag;
   int length_filter_flag;
-  int parse_flag;
   int min_match;
   int multiple_flag;
   int multiple_slack;
   int multiple_max;
 
-  typedef std::map< WORD_ID,std::vector< int > > WordIndex;
-
   // global cache for word pairs
   std::map< std::pair< WORD_ID, WORD_ID >, unsigned int > m_lsed;
 #ifdef WITH_THREADS
@@ -68,15 +80,17 @@ protected:
   unsigned int compute_length( const std::vector< tmmt::WORD_ID > &sentence );
   unsigned int letter_sed( WORD_ID aIdx, WORD_ID bIdx );
   unsigned int sed( const std::vector< WORD_ID > &a, const std::vector< WORD_ID > &b, std::string &best_path, bool use_letter_sed );
-  void init_short_matches(WordIndex &wordIndex, long translationId, const std::vector< WORD_ID > &input );
-  int short_match_max_length( int input_length );
-  void add_short_matches(WordIndex &wordIndex, long translationId, std::vector< Match > &match, const std::vector< WORD_ID > &tm, int input_length, int best_cost );
-  std::vector< Match > prune_matches( const std::vector< Match > &match, int best_cost );
-  int parse_matches( std::vector< Match > &match, int input_length, int tm_length, int &best_cost );
 
-  void create_extract(int sentenceInd, int cost, const std::vector< WORD_ID > &sourceSentence, const std::vector<SentenceAlignment> &targets, const std::string &inputStr, const std::string  &path, std::ofstream &outputFile);
+  //! One line of what used to be the extract file.
+  struct ExtractedRule {
+    std::string source, target, alignment;
+    int count;
+  };
+
+  void create_extract(int sentenceInd, int cost, const std::vector< WORD_ID > &sourceSentence, const std::vector<SentenceAlignment> &targets, const std::string &inputStr, const std::string  &path, std::vector<ExtractedRule> &extracted);
 
-  std::string ExtractTM(WordIndex &wordIndex, long translationId, const std::string &inputPath);
+  void ExtractTM(const std::vector< WORD_ID > &input, std::vector<ExtractedRule> &extracted);
+  void ScoreRules(const std::vector<ExtractedRule> &extracted, std::vector<ScoredRule> &rules) const;
   Vocabulary &GetVocabulary() {
     return suffixArray->GetVocabulary();
   }
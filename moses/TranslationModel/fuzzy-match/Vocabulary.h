@@ -7,11 +7,13 @@
 #include <cassert>
 #include <cstdlib>
 #include <string>
+#include <deque>
 #include <queue>
 #include <map>
 #include <cmath>
 
 #ifdef WITH_THREADS
+#include <boost/thread/locks.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #endif
 
@@ -24,11 +26,16 @@ class Vocabulary
 {
 public:
   std::map<WORD, WORD_ID> lookup;
-  std::vector< WORD > vocab;
+  // a deque, so that words stay put while input words of other threads
+  // are added
+  std::deque< WORD > vocab;
   WORD_ID StoreIfNew( const WORD& );
   WORD_ID GetWordID( const WORD& );
   std::vector<WORD_ID> Tokenize( const char[] );
   inline WORD &GetWord( WORD_ID id ) const {
+#ifdef WITH_THREADS
+    boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
+#endif
     WORD &i = (WORD&) vocab[ id ];
     return i;
   }
@@ -6,6 +6,7 @@
 #include <string>
 #include "moses/Util.h"
 #include "Alignments.h"
+#include "create_xml.h"
 
 using namespace std;
 using namespace Moses;
@@ -17,96 +18,6 @@ inline const std::string TrimInternal(const std::string& str, const std::string
   return res.erase(0, res.find_first_not_of(dropChars));
 }
 
-class CreateXMLRetValues
-{
-public:
-  string frame, ruleS, ruleT, ruleAlignment, ruleAlignmentInv;
-};
-
-CreateXMLRetValues createXML(int ruleCount, const string &source, const string &input, const string &target, const string &align, const string &path );
-
-void create_xml(const string &inPath)
-{
-  ifstream inStrme(inPath.c_str());
-  ofstream rule((inPath + ".extract").c_str());
-  ofstream ruleInv((inPath + ".extract.inv").c_str());
-
-  // int setenceId;
-  // float score;
-  string source, target, align, path;
-  string *input = NULL;
-  int count;
-
-  int lineCount = 1;
-  int ruleCount = 1;
-  string inLine;
-
-  int step = 0;
-  while (!inStrme.eof()) {
-    getline(inStrme, inLine);
-    //cout << inLine << endl;
-    switch (step) {
-    case 0:
-      /*setenceId = */
-      Scan<int>(inLine);
-      ++step;
-      break;
-    case 1:
-      /*score = */
-      Scan<float>(inLine);
-      ++step;
-      break;
-    case 2:
-      source = inLine;
-      ++step;
-      break;
-    case 3:
-      if (input == NULL) {
-        input = new string(inLine);
-      } else {
-        assert(inLine == *input);
-      }
-      ++step;
-      break;
-    case 4:
-      target = inLine;
-      ++step;
-      break;
-    case 5:
-      align = inLine;
-      ++step;
-      break;
-    case 6:
-      path = inLine + "X";
-      ++step;
-      break;
-    case 7:
-      count = Scan<int>(inLine);
-      CreateXMLRetValues ret = createXML(ruleCount, source, *input, target, align, path);
-
-      //print STDOUT $frame."\n";
-      rule << ret.ruleS << " [X] ||| " << ret.ruleT << " [X] ||| " << ret.ruleAlignment
-           << " ||| " << count << endl;
-      ruleInv << ret.ruleT << " [X] ||| " << ret.ruleS << " [X] ||| " << ret.ruleAlignmentInv
-              << " ||| " << count << endl;
-
-      //print STDOUT "$sentenceInd ||| $score ||| $count\n";
-      ++ruleCount;
-      step = 0;
-      break;
-    }
-
-    ++lineCount;
-  }
-
-  delete input;
-  ruleInv.close();
-  rule.close();
-  inStrme.close();
-
-}
-
-
 CreateXMLRetValues createXML(int ruleCount, const string &source, const string &input, const string &target, const string &align, const string &path)
 {
   CreateXMLRetValues ret;
@@ -378,7 +289,6 @@ CreateXMLRetValues createXML(int ruleCount, const string &source, const string &
 
   } //for (int t = 0
 
-  cerr << ret.frame << "\n-------------------------------------\n";
   return ret;
 
 }
@@ -2,4 +2,13 @@
 
 #include <string>
 
-void create_xml(const std::string &inPath);
+class CreateXMLRetValues
+{
+public:
+  std::string frame, ruleS, ruleT, ruleAlignment, ruleAlignmentInv;
+};
+
+/** Turn the match of input against the translation memory sentence source
+ * (edit path path, target and alignment align) into a hierarchical rule
+ * whose mismatched parts are non-terminals. */
+CreateXMLRetValues createXML(int ruleCount, const std::string &source, const std::string &input, const std::string &target, const std::string &align, const std::string &path);
@@ -27,6 +27,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <vector>
 #include <boost/functional/hash.hpp>
 #include "Bitmap.h"
+#include "DecodeArena.h"
 #include "Range.h"
 #include "Phrase.h"
 #include "TargetPhrase.h"
@@ -94,6 +95,14 @@ public:
   TranslationOption(const Range &range
                     , const TargetPhrase &targetPhrase);
 
+  //! allocated from the worker's DecodeArena
+  static void *operator new(size_t size) {
+    return DecodeArena::Allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    DecodeArena::Free(p, size);
+  }
+
   /** returns true if all feature types in featuresToCheck are compatible between the two phrases */
   bool IsCompatible(const Phrase& phrase, const std::vector<FactorType>& featuresToCheck) const;
 
@@ -0,0 +1,133 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "TranslationModel/TransliterationDecoder.h"
+#include "util/exception.hh"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(transliteration_decoder)
+
+namespace
+{
+
+// Stands in for the decoder: answers sentence n with its own characters at
+// score -n and, unless it is empty, with an x appended at score -100.
+vector<string> FakeDecoder()
+{
+  vector<string> argv;
+  argv.push_back("sh");
+  argv.push_back("-c");
+  argv.push_back("n=0; while IFS= read -r line; do"
+                 "  printf '%d ||| %s ||| f= 0 ||| %d\\n' $n \"$line\" $((-n));"
+                 "  if [ -n \"$line\" ]; then printf '%d ||| %s x ||| f= 0 ||| -100\\n' $n \"$line\"; fi;"
+                 "  n=$((n + 1)); done");
+  return argv;
+}
+
+void CheckBest(const TransliterationDecoder::Transliterations &got, const string &word, float score)
+{
+  BOOST_REQUIRE_EQUAL(2, got.size());
+  BOOST_CHECK_EQUAL(word, got[0].first);
+  BOOST_CHECK_EQUAL(score, got[0].second);
+  BOOST_CHECK_EQUAL(word + "x", got[1].first);
+  BOOST_CHECK_EQUAL(-100, got[1].second);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(characters)
+{
+  BOOST_CHECK_EQUAL("w \xC3\xB6 r d", SpaceCharacters("w\xC3\xB6rd"));
+  BOOST_CHECK_EQUAL("", SpaceCharacters(""));
+}
+
+BOOST_AUTO_TEST_CASE(protocol)
+{
+  TransliterationDecoder decoder(FakeDecoder(), 2);
+  vector<string> words;
+  vector<TransliterationDecoder::Transliterations> out;
+
+  // Distinct words are sent once, sorted: ab is sentence 0, cd 1, and the
+  // empty line ending the batch 2.
+  words.push_back("cd");
+  words.push_back("ab");
+  words.push_back("cd");
+  decoder.Transliterate(words, out);
+  BOOST_REQUIRE_EQUAL(3, out.size());
+  CheckBest(out[0], "cd", -1);
+  CheckBest(out[1], "ab", 0);
+  CheckBest(out[2], "cd", -1);
+
+  // cd is cached; ef is sentence 3. The cache then drops ab, which was used
+  // least recently.
+  words.clear();
+  words.push_back("ef");
+  words.push_back("cd");
+  decoder.Transliterate(words, out);
+  BOOST_REQUIRE_EQUAL(2, out.size());
+  CheckBest(out[0], "ef", -3);
+  CheckBest(out[1], "cd", -1);
+
+  words.clear();
+  words.push_back("ab");
+  decoder.Transliterate(words, out);
+  BOOST_REQUIRE_EQUAL(1, out.size());
+  CheckBest(out[0], "ab", -5);
+}
+
+BOOST_AUTO_TEST_CASE(many_words)
+{
+  // more than one batch
+  TransliterationDecoder decoder(FakeDecoder(), 1000);
+  vector<string> words;
+  for (char a = 'a'; a <= 'z'; ++a) {
+    for (char b = 'a'; b <= 'z'; ++b) {
+      words.push_back(string(1, a) + b);
+    }
+  }
+  vector<TransliterationDecoder::Transliterations> out;
+  decoder.Transliterate(words, out);
+  BOOST_REQUIRE_EQUAL(words.size(), out.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(2, out[i].size());
+    BOOST_CHECK_EQUAL(words[i], out[i][0].first);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(decoder_exits)
+{
+  // Reads the first word, so that writing it can't fail, and exits.
+  vector<string> argv;
+  argv.push_back("head");
+  argv.push_back("-n");
+  argv.push_back("1");
+  TransliterationDecoder decoder(argv, 10);
+  vector<string> words(1, "ab");
+  vector<TransliterationDecoder::Transliterations> out;
+  BOOST_CHECK_THROW(decoder.Transliterate(words, out), util::Exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -44,6 +44,7 @@ class TrellisPath
 {
   friend std::ostream& operator<<(std::ostream&, const TrellisPath&);
   friend class Manager;
+  friend class TrellisPathKBestExtractor;
 
 protected:
   std::vector<const Hypothesis *> m_path; //< list of hypotheses/arcs
@@ -55,7 +56,7 @@ protected:
   float m_totalScore;
   mutable boost::shared_ptr<ScoreComponentCollection> m_scoreBreakdown;
 
-  //Used by Manager::LatticeSample()
+  //Used by Manager::LatticeSample() and TrellisPathKBestExtractor
   explicit TrellisPath(const std::vector<const Hypothesis*> edges);
 
   void InitTotalScore();
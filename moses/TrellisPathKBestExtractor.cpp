@@ -0,0 +1,217 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width:2  -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include "TrellisPathKBestExtractor.h"
+#include "TrellisPath.h"
+#include "TrellisPathList.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/unordered_set.hpp>
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+// orders positions in an arc list best arc first, earlier first on ties
+class ArcRankOrderer
+{
+public:
+  ArcRankOrderer(const ArcList &arcs) : m_arcs(arcs) {}
+
+  bool operator()(size_t a, size_t b) const {
+    return m_arcs[a]->GetFutureScore() > m_arcs[b]->GetFutureScore();
+  }
+
+private:
+  const ArcList &m_arcs;
+};
+
+}
+
+bool TrellisPathKBestExtractor::CandidateOrderer::operator()(const Candidate &a, const Candidate &b) const
+{
+  if (a.score != b.score) {
+    return a.score < b.score;
+  }
+  // TrellisPathCollection pops equal scores first in first out, and queues
+  // the pure hypos first, then the deviations of each popped path by edge
+  // and arc list position
+  size_t parentA = a.parent ? a.parent->index + 1 : 0;
+  size_t parentB = b.parent ? b.parent->index + 1 : 0;
+  if (parentA != parentB) {
+    return parentA > parentB;
+  }
+  if (a.edgeIndex != b.edgeIndex) {
+    return a.edgeIndex > b.edgeIndex;
+  }
+  return a.arcPos > b.arcPos;
+}
+
+TrellisPathKBestExtractor::TrellisPathKBestExtractor(size_t count, bool onlyDistinct, size_t nBestFactor)
+  : m_count(count)
+  , m_onlyDistinct(onlyDistinct)
+  , m_nBestFactor(nBestFactor)
+{
+}
+
+void TrellisPathKBestExtractor::Extract(const vector<const Hypothesis*> &sortedPureHypo, TrellisPathList &ret)
+{
+  // add all pure paths
+  for (size_t i = 0; i < sortedPureHypo.size(); ++i) {
+    Candidate pure = { sortedPureHypo[i]->GetFutureScore(), NULL, sortedPureHypo[i], i, 0, 0 };
+    m_queue.push_back(pure);
+    push_heap(m_queue.begin(), m_queue.end(), CandidateOrderer());
+  }
+
+  // factor defines stopping point for distinct n-best list if too
+  // many candidates identical
+  const size_t maxIterations = m_count * (m_nBestFactor < 1 ? 1000 : m_nBestFactor);
+
+  boost::unordered_set<Phrase> distinctHyps;
+
+  for (size_t iteration = 0 ; (m_onlyDistinct ? distinctHyps.size() : ret.GetSize()) < m_count && !m_queue.empty() && iteration < maxIterations ; iteration++) {
+    // get next best from list of contenders
+    pop_heap(m_queue.begin(), m_queue.end(), CandidateOrderer());
+    const Candidate best = m_queue.back();
+    m_queue.pop_back();
+
+    const Hypothesis *arc = best.edge;
+    if (best.parent) {
+      arc = (*best.edge->GetArcList())[best.arcPos];
+    }
+    Path popped = { best.parent, best.parent ? best.edgeIndex : 0, arc, best.score, m_extracted.size() };
+    m_extracted.push_back(popped);
+    const Path &path = m_extracted.back();
+
+    // queue what may come next from this path
+    PushSuccessors(best, path);
+
+    TrellisPath *trellisPath = CreateTrellisPath(path);
+    if (m_onlyDistinct) {
+      if (distinctHyps.insert(trellisPath->GetSurfacePhrase()).second) {
+        ret.Add(trellisPath);
+      } else {
+        delete trellisPath;
+      }
+      if (m_nBestFactor > 0) {
+        Prune(m_count * m_nBestFactor);
+      }
+    } else {
+      ret.Add(trellisPath);
+      Prune(m_count - ret.GetSize());
+    }
+  }
+}
+
+const vector<size_t> &TrellisPathKBestExtractor::GetSortedArcs(const Hypothesis &hypo)
+{
+  vector<size_t> &sorted = m_sortedArcs[&hypo];
+  if (sorted.empty()) {
+    const ArcList &arcs = *hypo.GetArcList();
+    sorted.resize(arcs.size());
+    for (size_t i = 0; i < arcs.size(); ++i) {
+      sorted[i] = i;
+    }
+    stable_sort(sorted.begin(), sorted.end(), ArcRankOrderer(arcs));
+  }
+  return sorted;
+}
+
+void TrellisPathKBestExtractor::PushDeviation(const Path *parent, const Hypothesis &edge, size_t edgeIndex, size_t arcRank)
+{
+  const vector<size_t> &sorted = GetSortedArcs(edge);
+  if (arcRank >= sorted.size()) {
+    return;
+  }
+  const Hypothesis *arc = (*edge.GetArcList())[sorted[arcRank]];
+
+  // the same sum as TrellisPath::InitTotalScore(), since edges after the
+  // deviation are winning hypos
+  float score = parent->score;
+  score += arc->GetFutureScore() - arc->GetWinningHypo()->GetFutureScore();
+
+  Candidate deviation = { score, parent, &edge, edgeIndex, arcRank, sorted[arcRank] };
+  m_queue.push_back(deviation);
+  push_heap(m_queue.begin(), m_queue.end(), CandidateOrderer());
+}
+
+void TrellisPathKBestExtractor::PushSuccessors(const Candidate &popped, const Path &path)
+{
+  // the next best arc for the same edge of the same path
+  if (popped.parent) {
+    PushDeviation(popped.parent, *popped.edge, popped.edgeIndex, popped.arcRank + 1);
+  }
+
+  // the best arc for each edge that may still be wiggled: the pure hypo and
+  // its back pointers, or those of the arc
+  size_t currEdge = path.edgeIndex;
+  const Hypothesis *edge = path.arc;
+  if (path.parent) {
+    ++currEdge;
+    edge = edge->GetPrevHypo();
+  }
+  for (; edge != NULL; edge = edge->GetPrevHypo(), ++currEdge) {
+    if (edge->GetArcList()) {
+      PushDeviation(&path, *edge, currEdge, 0);
+    }
+  }
+}
+
+void TrellisPathKBestExtractor::Prune(size_t newSize)
+{
+  // leave some slack so that the queue is not cut after every pop
+  if (m_queue.size() <= 2 * newSize) {
+    return;
+  }
+  nth_element(m_queue.begin(), m_queue.begin() + newSize, m_queue.end(),
+              boost::bind<bool>(CandidateOrderer(), _2, _1));
+  m_queue.resize(newSize);
+  make_heap(m_queue.begin(), m_queue.end(), CandidateOrderer());
+}
+
+TrellisPath *TrellisPathKBestExtractor::CreateTrellisPath(const Path &path) const
+{
+  if (!path.parent) {
+    return new TrellisPath(path.arc);
+  }
+  vector<const Hypothesis*> edges;
+  GetEdges(path, edges);
+  return new TrellisPath(vector<const Hypothesis*>(edges.rbegin(), edges.rend()));
+}
+
+void TrellisPathKBestExtractor::GetEdges(const Path &path, vector<const Hypothesis*> &edges) const
+{
+  // last hypo first, as in TrellisPath::GetEdges()
+  if (path.parent) {
+    GetEdges(*path.parent, edges);
+    edges.resize(path.edgeIndex);
+  }
+  for (const Hypothesis *edge = path.arc; edge != NULL; edge = edge->GetPrevHypo()) {
+    edges.push_back(edge);
+  }
+}
+
+}
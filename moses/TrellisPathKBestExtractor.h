@@ -0,0 +1,103 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width:2  -*-
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include "Hypothesis.h"
+
+namespace Moses
+{
+
+class TrellisPath;
+class TrellisPathList;
+
+/** Lazy n-best extraction from the phrase-based search graph, in the style
+ *  of the ChartKBestExtractor.  Neither contenders nor extracted paths are
+ *  full TrellisPath objects: a path is its parent path, the edge it deviates
+ *  at and the arc replacing that edge, whose back pointers give the rest.
+ *  A TrellisPath is only built for a path that is output (or, for a distinct
+ *  list, checked for its surface string, and dropped at once if that was
+ *  seen).  The arcs of each hypothesis are tried best first, so extracting a
+ *  path only queues the best arc of each of its edges plus the next arc of
+ *  the edge it deviated at, and the queue is cut down to the number of paths
+ *  that can still be output.  Paths come out in the same order as
+ *  enumerating every deviation with TrellisPathCollection.
+ *  Used by phrase-based decoding
+ */
+class TrellisPathKBestExtractor
+{
+public:
+  /** \param nBestFactor as the n-best-factor option: for a distinct list,
+   *  the queue keeps at most count * nBestFactor contenders (0 = unlimited),
+   *  and at most count * nBestFactor paths are extracted (1000 if 0)
+   */
+  TrellisPathKBestExtractor(size_t count, bool onlyDistinct, size_t nBestFactor);
+
+  //! extract n-best paths, given the sorted hypotheses of the last stack
+  void Extract(const std::vector<const Hypothesis*> &sortedPureHypo, TrellisPathList &ret);
+
+private:
+  //! a path that was extracted
+  struct Path {
+    const Path *parent;     //!< NULL for a pure hypo
+    size_t edgeIndex;       //!< edge replaced by arc (0 for a pure hypo)
+    const Hypothesis *arc;  //!< the arc, or the pure hypo
+    float score;
+    size_t index;           //!< extraction order
+  };
+
+  struct Candidate {
+    float score;
+    const Path *parent;     //!< NULL for a pure hypo
+    const Hypothesis *edge; //!< edge replaced by the arc, or the pure hypo
+    size_t edgeIndex;       //!< position of the edge, or index of the pure hypo
+    size_t arcRank;         //!< position of the arc in the sorted arc list
+    size_t arcPos;          //!< position of the arc in the edge's own arc list
+  };
+
+  //! orders candidates worst first, ties as they would be queued eagerly
+  struct CandidateOrderer {
+    bool operator()(const Candidate &a, const Candidate &b) const;
+  };
+
+  const std::vector<size_t> &GetSortedArcs(const Hypothesis &hypo);
+  void PushDeviation(const Path *parent, const Hypothesis &edge, size_t edgeIndex, size_t arcRank);
+  void PushSuccessors(const Candidate &popped, const Path &path);
+  void Prune(size_t newSize);
+  TrellisPath *CreateTrellisPath(const Path &path) const;
+  void GetEdges(const Path &path, std::vector<const Hypothesis*> &edges) const;
+
+  size_t m_count;
+  bool m_onlyDistinct;
+  size_t m_nBestFactor;
+
+  std::vector<Candidate> m_queue; //!< heap
+  std::deque<Path> m_extracted; //!< every path popped, in order
+
+  //! arc list positions of each hypo, best arc first
+  boost::unordered_map<const Hypothesis*, std::vector<size_t> > m_sortedArcs;
+};
+
+}
@@ -0,0 +1,227 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2006 University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Bitmaps.h"
+#include "Hypothesis.h"
+#include "Manager.h"
+#include "Sentence.h"
+#include "StaticData.h"
+#include "TranslationOption.h"
+#include "TranslationTask.h"
+#include "TrellisPath.h"
+#include "TrellisPathCollection.h"
+#include "TrellisPathKBestExtractor.h"
+#include "TrellisPathList.h"
+#include "Util.h"
+
+using namespace Moses;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(trellis_path_kbest_extractor)
+
+namespace
+{
+// a hypothesis scored by the test rather than by feature functions
+class ScoredHypothesis : public Hypothesis
+{
+public:
+  ScoredHypothesis(const Hypothesis &prevHypo, const TranslationOption &transOpt,
+                   const Bitmap &bitmap, int id, float score)
+    : Hypothesis(prevHypo, transOpt, bitmap, id) {
+    m_futureScore = score;
+  }
+};
+
+bool BetterHypo(const Hypothesis *a, const Hypothesis *b)
+{
+  return a->GetFutureScore() > b->GetFutureScore();
+}
+
+/** A monotone search graph over a five word sentence: every hypothesis is
+ *  extended with four options per word ("x" twice, so that surface strings
+ *  repeat), and the extensions are recombined into three hypotheses, the
+ *  others becoming their arcs.
+ */
+class Trellis
+{
+public:
+  Trellis() : m_seed(42) {
+    AllOptions::ptr opts(new AllOptions(*StaticData::Instance().options()));
+    m_sentence.reset(new Sentence(opts, 0, "a b c d e"));
+    m_ttask = TranslationTask::create(m_sentence);
+    m_manager.reset(new Manager(m_ttask));
+    m_manager->ResetSentenceStats(*m_sentence);
+    m_bitmaps.reset(new Bitmaps(m_sentence->GetSize(), m_sentence->m_sourceCompleted));
+
+    const char *words[] = { "x", "y", "x", "z" };
+    const size_t numWords = sizeof(words) / sizeof(words[0]);
+    const size_t numStates = 3;
+
+    Hypothesis *initial = new Hypothesis(*m_manager, *m_sentence, m_initialTransOpt,
+                                         m_bitmaps->GetInitialBitmap(),
+                                         m_manager->GetNextHypoId());
+    m_winners.push_back(initial);
+    vector<Hypothesis*> stack(1, initial);
+    for (size_t pos = 0; pos < m_sentence->GetSize(); ++pos) {
+      Range range(pos, pos);
+      vector<TranslationOption*> options;
+      for (size_t i = 0; i < numWords; ++i) {
+        m_targetPhrases.push_back(TargetPhrase(NULL));
+        m_targetPhrases.back().CreateFromString(Output, opts->output.factor_order,
+                                                words[i], NULL);
+        m_toptions.push_back(new TranslationOption(range, m_targetPhrases.back()));
+        options.push_back(m_toptions.back());
+      }
+
+      vector<vector<Hypothesis*> > states(numStates);
+      for (size_t h = 0; h < stack.size(); ++h) {
+        const Bitmap &bitmap = m_bitmaps->GetBitmap(stack[h]->GetWordsBitmap(), range);
+        for (size_t i = 0; i < options.size(); ++i) {
+          float score = stack[h]->GetFutureScore() + NextScore();
+          states[(h + i) % numStates].push_back(
+            new ScoredHypothesis(*stack[h], *options[i], bitmap,
+                                 m_manager->GetNextHypoId(), score));
+        }
+      }
+
+      stack.clear();
+      for (size_t s = 0; s < numStates; ++s) {
+        vector<Hypothesis*> &state = states[s];
+        stable_sort(state.begin(), state.end(), BetterHypo);
+        for (size_t i = 1; i < state.size(); ++i) {
+          state[0]->AddArc(state[i]);
+        }
+        stack.push_back(state[0]);
+        m_winners.push_back(state[0]);
+      }
+    }
+
+    // sets the winning hypo of the hypos and their arcs
+    for (size_t i = 0; i < m_winners.size(); ++i) {
+      m_winners[i]->CleanupArcList(1000, true);
+    }
+    m_sortedPureHypo.assign(stack.begin(), stack.end());
+    stable_sort(m_sortedPureHypo.begin(), m_sortedPureHypo.end(), BetterHypo);
+  }
+
+  ~Trellis() {
+    // the hypos delete their arcs
+    RemoveAllInColl(m_winners);
+    RemoveAllInColl(m_toptions);
+  }
+
+  const vector<const Hypothesis*> &GetSortedPureHypo() const {
+    return m_sortedPureHypo;
+  }
+
+private:
+  // scores from a fixed sequence, with repeats
+  float NextScore() {
+    m_seed = m_seed * 1103515245 + 12345;
+    return -float((m_seed >> 16) % 200) / 8;
+  }
+
+  unsigned m_seed;
+  boost::shared_ptr<Sentence> m_sentence;
+  boost::shared_ptr<TranslationTask> m_ttask;
+  boost::shared_ptr<Manager> m_manager;
+  boost::scoped_ptr<Bitmaps> m_bitmaps;
+  TranslationOption m_initialTransOpt;
+  deque<TargetPhrase> m_targetPhrases;
+  vector<TranslationOption*> m_toptions;
+  vector<Hypothesis*> m_winners;
+  vector<const Hypothesis*> m_sortedPureHypo;
+};
+
+// n-best extraction as Manager::CalcNBest did it before the extractor:
+// every deviation of every popped path is queued as a full TrellisPath
+void EagerNBest(const vector<const Hypothesis*> &sortedPureHypo, size_t count,
+                bool onlyDistinct, size_t nBestFactor, TrellisPathList &ret)
+{
+  TrellisPathCollection contenders;
+  set<Phrase> distinctHyps;
+  for (size_t i = 0; i < sortedPureHypo.size(); ++i) {
+    contenders.Add(new TrellisPath(sortedPureHypo[i]));
+  }
+  const size_t maxIterations = count * (nBestFactor < 1 ? 1000 : nBestFactor);
+  for (size_t iteration = 0 ; (onlyDistinct ? distinctHyps.size() : ret.GetSize()) < count && contenders.GetSize() > 0 && iteration < maxIterations ; iteration++) {
+    TrellisPath *path = contenders.pop();
+    path->CreateDeviantPaths(contenders);
+    if (onlyDistinct) {
+      if (distinctHyps.insert(path->GetSurfacePhrase()).second) {
+        ret.Add(path);
+      } else {
+        delete path;
+      }
+      if (nBestFactor > 0) {
+        contenders.Prune(count * nBestFactor);
+      }
+    } else {
+      ret.Add(path);
+      contenders.Prune(count);
+    }
+  }
+}
+
+void CheckSameAsEager(const Trellis &trellis, size_t count, bool onlyDistinct,
+                      size_t nBestFactor)
+{
+  TrellisPathList expected;
+  EagerNBest(trellis.GetSortedPureHypo(), count, onlyDistinct, nBestFactor, expected);
+  TrellisPathList actual;
+  TrellisPathKBestExtractor extractor(count, onlyDistinct, nBestFactor);
+  extractor.Extract(trellis.GetSortedPureHypo(), actual);
+
+  BOOST_REQUIRE_EQUAL(actual.GetSize(), expected.GetSize());
+  TrellisPathList::const_iterator e = expected.begin();
+  for (TrellisPathList::const_iterator a = actual.begin(); a != actual.end(); ++a, ++e) {
+    BOOST_CHECK_EQUAL((*a)->GetFutureScore(), (*e)->GetFutureScore());
+    const vector<const Hypothesis *> &actualEdges = (*a)->GetEdges();
+    const vector<const Hypothesis *> &expectedEdges = (*e)->GetEdges();
+    BOOST_CHECK(actualEdges == expectedEdges);
+  }
+}
+}
+
+BOOST_AUTO_TEST_CASE(nbest_as_eager)
+{
+  Trellis trellis;
+  CheckSameAsEager(trellis, 1, false, 0);
+  CheckSameAsEager(trellis, 100, false, 0);
+  // more than there are paths
+  CheckSameAsEager(trellis, 100000, false, 0);
+}
+
+BOOST_AUTO_TEST_CASE(distinct_nbest_as_eager)
+{
+  Trellis trellis;
+  CheckSameAsEager(trellis, 20, true, 0);
+  CheckSameAsEager(trellis, 20, true, 2);
+  CheckSameAsEager(trellis, 100000, true, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
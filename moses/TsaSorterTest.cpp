@@ -0,0 +1,140 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "TranslationModel/UG/mm/ug_im_tsa.h"
+#include "TranslationModel/UG/mm/ug_im_ttrack.h"
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(tsa_sorter)
+
+namespace
+{
+typedef sapt::L2R_Token<sapt::SimpleWordId> Token;
+typedef sapt::imTtrack<Token> Corpus;
+typedef sapt::ttrack::Position Position;
+typedef Position::LESS<sapt::Ttrack<Token> > Less;
+typedef sapt::TsaSorter<Token, Less> Sorter;
+
+// Mostly the three most frequent words, so that their buckets are split
+// several levels deep, and a long sentence repeated often enough for the
+// splitting to give up on it.
+boost::shared_ptr<Corpus> SkewedCorpus()
+{
+  boost::shared_ptr<vector<vector<Token> > > sentences(new vector<vector<Token> >);
+  unsigned int r = 12345;
+  for (size_t s = 0; s < 3000; ++s) {
+    sentences->push_back(vector<Token>());
+    for (size_t i = 0; i < 1 + s % 17; ++i) {
+      r = r * 1103515245 + 12345;
+      const unsigned int x = r >> 16;
+      sentences->back().push_back(Token(x % 8 ? x % 3 : x % 50));
+    }
+  }
+  vector<Token> repeated;
+  for (size_t i = 0; i < 40; ++i) {
+    repeated.push_back(Token(i % 2));
+  }
+  sentences->insert(sentences->end(), 100, repeated);
+  return boost::shared_ptr<Corpus>(new Corpus(sentences));
+}
+
+vector<Position> AllPositions(const Corpus &corpus)
+{
+  vector<Position> ret;
+  for (size_t sid = 0; sid < corpus.size(); ++sid) {
+    for (size_t offset = 0; offset < corpus.sntLen(sid); ++offset) {
+      ret.push_back(Position(sid, offset));
+    }
+  }
+  return ret;
+}
+
+// Equal suffixes may come in any order, so compare by the sort order and
+// check separately that no position was lost or duplicated.
+void CheckSame(const Corpus &corpus, const vector<Position> &expected, const vector<Position> &got)
+{
+  const Less less(&corpus);
+  BOOST_REQUIRE_EQUAL(expected.size(), got.size());
+  size_t mismatches = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (less(expected[i], got[i]) || less(got[i], expected[i])) ++mismatches;
+  }
+  BOOST_CHECK_EQUAL(mismatches, 0);
+
+  vector<pair<tpt::id_type, ushort> > a, b;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    a.push_back(make_pair(expected[i].sid, expected[i].offset));
+    b.push_back(make_pair(got[i].sid, got[i].offset));
+  }
+  sort(a.begin(), a.end());
+  sort(b.begin(), b.end());
+  BOOST_CHECK(a == b);
+}
+
+// Sort all of positions with TsaSorter at the given threshold.
+void SortSplit(const Corpus &corpus, vector<Position> &positions, size_t depth, size_t threshold, size_t threads)
+{
+  boost::scoped_ptr<ug::ThreadPool> pool(threads ? new ug::ThreadPool(threads) : NULL);
+  Sorter sorter(Less(&corpus), &corpus, positions.begin(), positions.end(), depth, threshold, pool.get());
+  sorter();
+  // waits for the parts that were queued
+  pool.reset();
+}
+}
+
+BOOST_AUTO_TEST_CASE(split_buckets_sort_like_std_sort)
+{
+  boost::shared_ptr<Corpus> corpus = SkewedCorpus();
+  vector<Position> expected = AllPositions(*corpus);
+  sort(expected.begin(), expected.end(), Less(corpus.get()));
+
+  // from the first token on, splitting everything above 64 suffixes, both
+  // right away and on a pool
+  for (size_t threads = 0; threads <= 4; threads += 4) {
+    vector<Position> got = AllPositions(*corpus);
+    SortSplit(*corpus, got, 0, 64, threads);
+    CheckSame(*corpus, expected, got);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(split_one_bucket)
+{
+  // the bucket of the most frequent word, as imTSA hands it over
+  boost::shared_ptr<Corpus> corpus = SkewedCorpus();
+  vector<Position> bucket;
+  const vector<Position> all = AllPositions(*corpus);
+  for (size_t i = 0; i < all.size(); ++i) {
+    if (corpus->getToken(all[i])->id() == 0) bucket.push_back(all[i]);
+  }
+  vector<Position> expected = bucket;
+  sort(expected.begin(), expected.end(), Less(corpus.get()));
+
+  SortSplit(*corpus, bucket, 1, 16, 2);
+  CheckSame(*corpus, expected, bucket);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
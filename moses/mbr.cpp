@@ -14,6 +14,12 @@
 #include "moses/Util.h"
 #include "mbr.h"
 
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
+
 using namespace std ;
 using namespace Moses;
 
@@ -35,21 +41,73 @@ using namespace Moses;
 int BLEU_ORDER = 4;
 int SMOOTH = 1;
 float min_interval = 1e-4;
-void extract_ngrams(const vector<const Factor* >& sentence, map < vector < const Factor* >, int >  & allngrams)
+
+namespace
+{
+
+typedef boost::unordered_map<vector<const Factor*>, size_t> NgramIds;
+
+void extract_ngrams(const vector<const Factor* >& sentence, NgramIds & ids,
+                    vector<size_t> & ngram_order, NgramCounts & counts)
 {
+  vector<size_t> found;
   vector< const Factor* > ngram;
   for (int k = 0; k < BLEU_ORDER; k++) {
     for(int i =0; i < max((int)sentence.size()-k,0); i++) {
-      for ( int j = i; j<= i+k; j++) {
-        ngram.push_back(sentence[j]);
+      ngram.assign(sentence.begin() + i, sentence.begin() + i + k + 1);
+      pair<NgramIds::iterator, bool> id = ids.insert(make_pair(ngram, ids.size()));
+      if (id.second) {
+        ngram_order.push_back(k + 1);
       }
-      ++allngrams[ngram];
-      ngram.clear();
+      found.push_back(id.first->second);
     }
   }
+  sort(found.begin(), found.end());
+  counts.clear();
+  for (size_t i = 0; i < found.size(); ++i) {
+    if (counts.empty() || counts.back().first != found[i]) {
+      counts.push_back(make_pair(found[i], 0));
+    }
+    ++counts.back().second;
+  }
 }
 
-float calculate_score(const vector< vector<const Factor*> > & sents, int ref, int hyp,  vector < map < vector < const Factor *>, int > > & ngram_stats )
+// Expected loss of hypotheses start, start + stride, ... against the rest of
+// the list.  A hypothesis is abandoned once its loss exceeds the best seen by
+// this worker, so the reported loss is exact for the best one.
+struct LossWorker {
+  const vector< vector<const Factor*> > &translations;
+  const vector<NgramCounts> &ngram_stats;
+  const vector<size_t> &ngram_order;
+  const vector<float> &joint_prob_vec;
+  float marginal;
+
+  void operator()(size_t start, size_t stride, float &minMBRLoss, int &minMBRLossIdx) const {
+    minMBRLoss = 1000000;
+    minMBRLossIdx = -1;
+    for (size_t i = start; i < translations.size(); i += stride) {
+      float weightedLossCumul = 0;
+      for (size_t j = 0; j < translations.size(); j++) {
+        if ( i != j) {
+          float bleu = calculate_score(translations, j, i, ngram_stats, ngram_order);
+          float weightedLoss = ( 1 - bleu) * ( joint_prob_vec[j]/marginal);
+          weightedLossCumul += weightedLoss;
+          if (weightedLossCumul > minMBRLoss)
+            break;
+        }
+      }
+      if (weightedLossCumul < minMBRLoss) {
+        minMBRLoss = weightedLossCumul;
+        minMBRLossIdx = i;
+      }
+    }
+  }
+};
+
+} // namespace
+
+float calculate_score(const vector< vector<const Factor*> > & sents, int ref, int hyp,
+                      const vector<NgramCounts> & ngram_stats, const vector<size_t> & ngram_order)
 {
   int comps_n = 2*BLEU_ORDER+1;
   vector<int> comps(comps_n);
@@ -62,14 +120,19 @@ float calculate_score(const vector< vector<const Factor*> > & sents, int ref, in
     comps[2*i+1] = max(hyp_length-i,0);
   }
 
-  map< vector < const Factor * > ,int > & hyp_ngrams = ngram_stats[hyp] ;
-  map< vector < const Factor * >, int > & ref_ngrams = ngram_stats[ref] ;
-
-  for (map< vector< const Factor * >, int >::iterator it = hyp_ngrams.begin();
-       it != hyp_ngrams.end(); it++) {
-    map< vector< const Factor * >, int >::iterator ref_it = ref_ngrams.find(it->first);
-    if(ref_it != ref_ngrams.end()) {
-      comps[2* (it->first.size()-1)] += min(ref_it->second,it->second);
+  // both lists are sorted by n-gram id, so clip by merging them
+  const NgramCounts & hyp_ngrams = ngram_stats[hyp];
+  const NgramCounts & ref_ngrams = ngram_stats[ref];
+  NgramCounts::const_iterator it = hyp_ngrams.begin(), ref_it = ref_ngrams.begin();
+  while (it != hyp_ngrams.end() && ref_it != ref_ngrams.end()) {
+    if (it->first < ref_it->first) {
+      ++it;
+    } else if (ref_it->first < it->first) {
+      ++ref_it;
+    } else {
+      comps[2* (ngram_order[it->first]-1)] += min(ref_it->second,it->second);
+      ++it;
+      ++ref_it;
     }
   }
   comps[comps_n-1] = sents[ref].size();
@@ -96,7 +159,9 @@ const TrellisPath doMBR(const TrellisPathList& nBestList, AllOptions const& opts
   vector<float> joint_prob_vec;
   vector< vector<const Factor*> > translations;
   float joint_prob;
-  vector< map < vector <const Factor *>, int > > ngram_stats;
+  NgramIds ngram_ids;
+  vector<size_t> ngram_order;
+  vector<NgramCounts> ngram_stats;
 
   TrellisPathList::const_iterator iter;
 
@@ -110,6 +175,7 @@ const TrellisPath doMBR(const TrellisPathList& nBestList, AllOptions const& opts
 
   vector<FactorType> const& oFactors = opts.output.factor_order;
   UTIL_THROW_IF2(oFactors.size() != 1, "Need exactly one output factor!");
+  ngram_stats.reserve(nBestList.GetSize());
   for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
     const TrellisPath &path = **iter;
     joint_prob = UntransformScore(mbr_scale * path.GetScoreBreakdown()->GetWeightedScore() - maxScore);
@@ -121,41 +187,43 @@ const TrellisPath doMBR(const TrellisPathList& nBestList, AllOptions const& opts
     GetOutputFactors(path, oFactors[0], translation);
 
     // collect n-gram counts
-    map < vector < const Factor *>, int > counts;
-    extract_ngrams(translation,counts);
+    ngram_stats.push_back(NgramCounts());
+    extract_ngrams(translation, ngram_ids, ngram_order, ngram_stats.back());
 
-    ngram_stats.push_back(counts);
     translations.push_back(translation);
   }
 
-  vector<float> mbr_loss;
-  float bleu, weightedLoss;
-  float weightedLossCumul = 0;
-  float minMBRLoss = 1000000;
-  int minMBRLossIdx = -1;
-
   /* Main MBR computation done here */
-  iter = nBestList.begin();
-  for (unsigned int i = 0; i < nBestList.GetSize(); i++) {
-    weightedLossCumul = 0;
-    for (unsigned int j = 0; j < nBestList.GetSize(); j++) {
-      if ( i != j) {
-        bleu = calculate_score(translations, j, i,ngram_stats );
-        weightedLoss = ( 1 - bleu) * ( joint_prob_vec[j]/marginal);
-        weightedLossCumul += weightedLoss;
-        if (weightedLossCumul > minMBRLoss)
-          break;
-      }
+  LossWorker worker = { translations, ngram_stats, ngram_order, joint_prob_vec, marginal };
+  // only worth starting threads for long lists
+  const size_t threads = min(opts.mbr.threads, translations.size() / 64 + 1);
+  vector<float> minMBRLoss(threads);
+  vector<int> minMBRLossIdx(threads);
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    boost::thread_group workers;
+    for (size_t t = 0; t < threads; ++t) {
+      workers.create_thread(boost::bind<void>(boost::cref(worker), t, threads,
+                                              boost::ref(minMBRLoss[t]), boost::ref(minMBRLossIdx[t])));
     }
-    if (weightedLossCumul < minMBRLoss) {
-      minMBRLoss = weightedLossCumul;
-      minMBRLossIdx = i;
+    workers.join_all();
+  } else
+#endif
+  {
+    worker(0, 1, minMBRLoss[0], minMBRLossIdx[0]);
+  }
+
+  /* Find sentence that minimises Bayes Risk under 1- BLEU loss, preferring
+     the earliest on ties as the sequential search does */
+  size_t best = 0;
+  for (size_t t = 1; t < threads; ++t) {
+    if (minMBRLossIdx[t] == -1) continue;
+    if (minMBRLossIdx[best] == -1 || minMBRLoss[t] < minMBRLoss[best]
+        || (minMBRLoss[t] == minMBRLoss[best] && minMBRLossIdx[t] < minMBRLossIdx[best])) {
+      best = t;
     }
-    iter++;
   }
-  /* Find sentence that minimises Bayes Risk under 1- BLEU loss */
-  return nBestList.at(minMBRLossIdx);
-  //return translations[minMBRLossIdx];
+  return nBestList.at(minMBRLossIdx[best]);
 }
 
 void
@@ -30,10 +30,14 @@ void
 GetOutputFactors(const Moses::TrellisPath &path, Moses::FactorType const f,
                  std::vector <const Moses::Factor*> &translation);
 
+//! n-gram counts of a translation as (n-gram id, count), sorted by id
+typedef std::vector<std::pair<size_t, int> > NgramCounts;
+
+//! ngram_order[id] is the length of the n-gram numbered id
 float
 calculate_score(const std::vector< std::vector<const Moses::Factor*> > & sents,
                 int ref, int hyp,
-                std::vector<std::map<std::vector<const Moses::Factor*>,int> > &
-                ngram_stats );
+                const std::vector<NgramCounts> & ngram_stats,
+                const std::vector<size_t> & ngram_order);
 
 #endif
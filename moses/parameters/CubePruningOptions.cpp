@@ -1,5 +1,6 @@
 // -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
 #include "CubePruningOptions.h"
+#include <algorithm>
 
 namespace Moses 
 {
@@ -8,6 +9,7 @@ namespace Moses
   CubePruningOptions() 
     : pop_limit(DEFAULT_CUBE_PRUNING_POP_LIMIT)
     , diversity(DEFAULT_CUBE_PRUNING_DIVERSITY)
+    , lookahead(DEFAULT_CUBE_PRUNING_LOOKAHEAD)
     , lazy_scoring(false)
     , deterministic_search(false)
   {}
@@ -20,6 +22,9 @@ namespace Moses
 		       DEFAULT_CUBE_PRUNING_POP_LIMIT);
     param.SetParameter(diversity, "cube-pruning-diversity",
 		       DEFAULT_CUBE_PRUNING_DIVERSITY);
+    param.SetParameter(lookahead, "cube-pruning-lookahead",
+		       DEFAULT_CUBE_PRUNING_LOOKAHEAD);
+    if (lookahead == 0) lookahead = 1;
     param.SetParameter(lazy_scoring, "cube-pruning-lazy-scoring", false);
     param.SetParameter(deterministic_search, "cube-pruning-deterministic-search", false);
     return true;
@@ -38,6 +43,10 @@ namespace Moses
       si = params.find("cube-pruning-diversity");
       if (si != params.end()) diversity = xmlrpc_c::value_int(si->second);
       
+      si = params.find("cube-pruning-lookahead");
+      if (si != params.end()) 
+        lookahead = std::max(1, int(xmlrpc_c::value_int(si->second)));
+
       si = params.find("cube-pruning-lazy-scoring");
       if (si != params.end())
 	    {
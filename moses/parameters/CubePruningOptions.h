@@ -11,6 +11,7 @@ namespace Moses
   {
     size_t  pop_limit;
     size_t  diversity;
+    size_t  lookahead;
     bool lazy_scoring;
     bool deterministic_search;
 
@@ -13,6 +13,7 @@ namespace Moses {
     , input_type(SentenceInput)
     , xml_policy(XmlPassThrough)
     , placeholder_factor(NOT_FOUND)
+    , document_input(false)
   { 
     xml_brackets.first  = "<";
     xml_brackets.second = ">";
@@ -79,6 +80,7 @@ namespace Moses {
 
     param.SetParameter<std::string>(factor_delimiter, "factor-delimiter", "|");
     param.SetParameter<std::string>(input_file_path,"input-file","");
+    param.SetParameter(document_input, "document-input", false);
 
     return true;
   }
@@ -17,6 +17,7 @@ namespace Moses
     std::string factor_delimiter; 
     FactorType placeholder_factor; // where to store original text for placeholders 
     std::string input_file_path;
+    bool document_input; // <doc> ... </doc> lines delimit documents
     std::pair<std::string,std::string> xml_brackets; 
     // strings to use as XML tags' opening and closing brackets. 
     // Default are "<" and ">"
@@ -8,6 +8,7 @@ namespace Moses {
     : enabled(false)
     , size(200)
     , scale(1.0f)
+    , threads(1)
   {}
 
 
@@ -18,6 +19,8 @@ namespace Moses {
     param.SetParameter(enabled, "minimum-bayes-risk", false);
     param.SetParameter<size_t>(size, "mbr-size", 200);
     param.SetParameter(scale, "mbr-scale", 1.0f);
+    param.SetParameter<size_t>(threads, "mbr-threads", 1);
+    if (threads == 0) threads = 1;
     return true;
   }
 
@@ -14,6 +14,7 @@ namespace Moses
     size_t size; //! number of translation candidates considered
     float scale; /*! scaling factor for computing marginal probability 
                   *  of candidate translation */
+    size_t threads; //! threads scoring the candidates of one sentence
     bool init(Parameter const& param);
     MBR_Options();
   };
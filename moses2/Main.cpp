@@ -82,7 +82,36 @@ void batch_run(Moses2::Parameter &params, Moses2::System &system, Moses2::Thread
 
   long translationId = 0;
   string line;
-  while (getline(inStream, line)) {
+
+  if (system.options.input.document_input) {
+    // lines outside <doc> ... </doc> are documents of one sentence
+    Moses2::DocumentTask::TaskList doc;
+    bool inDocument = false;
+    while (getline(inStream, line)) {
+      string trimmed = Moses2::Trim(line);
+      if (trimmed == "<doc>" || trimmed.find("<doc ") == 0) {
+        inDocument = true;
+      } else if (trimmed == "</doc>") {
+        inDocument = false;
+      } else {
+        doc.push_back(boost::shared_ptr<Moses2::TranslationTask>(
+                        new Moses2::TranslationTask(system, line, translationId)));
+        ++translationId;
+      }
+
+      if (!inDocument && doc.size()) {
+        boost::shared_ptr<Moses2::DocumentTask> task(new Moses2::DocumentTask(doc));
+        pool.Submit(task);
+        doc.clear();
+      }
+    }
+    if (doc.size()) {
+      boost::shared_ptr<Moses2::DocumentTask> task(new Moses2::DocumentTask(doc));
+      pool.Submit(task);
+    }
+  }
+
+  while (!system.options.input.document_input && getline(inStream, line)) {
     //cerr << "line=" << line << endl;
     boost::shared_ptr<Moses2::TranslationTask> task(new Moses2::TranslationTask(system, line, translationId));
 
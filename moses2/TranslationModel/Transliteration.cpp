@@ -29,18 +29,41 @@ namespace Moses2
 
 Transliteration::Transliteration(size_t startInd, const std::string &line) :
   PhraseTable(startInd, line)
+  ,m_mode("script")
+  ,m_nBestSize(50)
+  ,m_decoderThreads(1)
+  ,m_transliterationCacheSize(10000)
 {
   ReadParameters();
-  UTIL_THROW_IF2(m_mosesDir.empty() ||
-                 m_scriptDir.empty() ||
-                 m_externalDir.empty() ||
-                 m_inputLang.empty() ||
-                 m_outputLang.empty(), "Must specify all arguments");
+  if (m_mode == "decoder") {
+    UTIL_THROW_IF2(m_mosesDir.empty(), "Must specify moses-dir");
+    if (m_config.empty()) {
+      m_config = m_filePath + "/tuning/moses.tuned.ini";
+    }
+  } else {
+    UTIL_THROW_IF2(m_mode != "script", "Unknown transliteration mode " << m_mode);
+    UTIL_THROW_IF2(m_mosesDir.empty() ||
+                   m_scriptDir.empty() ||
+                   m_externalDir.empty() ||
+                   m_inputLang.empty() ||
+                   m_outputLang.empty(), "Must specify all arguments");
+  }
 }
 
 Transliteration::~Transliteration()
 {
-  // TODO Auto-generated destructor stub
+}
+
+void Transliteration::Load(System &system)
+{
+  if (m_mode != "decoder") {
+    return;
+  }
+
+  vector<string> argv = TransliterationDecoder::MosesArgs(m_mosesDir, m_config, m_nBestSize, m_decoderThreads);
+  UTIL_THROW_IF2(!FileExists(argv[0]), "Transliteration decoder " << argv[0] << " not found");
+  UTIL_THROW_IF2(!FileExists(m_config), "Transliteration model " << m_config << " not found");
+  m_decoder.reset(new TransliterationDecoder(argv, m_transliterationCacheSize));
 }
 
 void
@@ -57,6 +80,16 @@ SetParameter(const std::string& key, const std::string& value)
     m_inputLang = value;
   } else if (key == "output-lang") {
     m_outputLang = value;
+  } else if (key == "mode") {
+    m_mode = value;
+  } else if (key == "config") {
+    m_config = value;
+  } else if (key == "nbest") {
+    m_nBestSize = Scan<size_t>(value);
+  } else if (key == "decoder-threads") {
+    m_decoderThreads = Scan<size_t>(value);
+  } else if (key == "transliteration-cache-size") {
+    m_transliterationCacheSize = Scan<size_t>(value);
   } else {
     PhraseTable::SetParameter(key, value);
   }
@@ -65,17 +98,51 @@ SetParameter(const std::string& key, const std::string& value)
 void Transliteration::Lookup(const Manager &mgr,
                              InputPathsBase &inputPaths) const
 {
+  vector<InputPath*> decoderPaths;
   BOOST_FOREACH(InputPathBase *pathBase, inputPaths) {
     InputPath *path = static_cast<InputPath*>(pathBase);
 
     if (SatisfyBackoff(mgr, *path)) {
-      const SubPhrase<Moses2::Word> &phrase = path->subPhrase;
-
-      TargetPhrases *tps = Lookup(mgr, mgr.GetPool(), *path);
-      path->AddTargetPhrases(*this, tps);
+      if (m_decoder) {
+        // the model transliterates single words
+        if (path->subPhrase.GetSize() == 1) {
+          decoderPaths.push_back(path);
+        }
+      } else {
+        Lookup(mgr, mgr.GetPool(), *path);
+      }
     }
   }
 
+  if (!decoderPaths.empty()) {
+    LookupFromDecoder(mgr, decoderPaths);
+  }
+}
+
+void Transliteration::LookupFromDecoder(const Manager &mgr, const vector<InputPath*> &paths) const
+{
+  // all of the sentence's words in one go
+  vector<string> words(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    words[i] = paths[i]->subPhrase[0].GetString(m_input);
+  }
+  vector<Transliterations> transliterations;
+  m_decoder->Transliterate(words, transliterations);
+
+  MemPool &pool = mgr.GetPool();
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const SubPhrase<Moses2::Word> &sourcePhrase = paths[i]->subPhrase;
+    vector<TargetPhraseImpl*> targetPhrases
+    = CreateTargetPhrases(mgr, pool, sourcePhrase, transliterations[i]);
+
+    TargetPhrases *tps = new (pool.Allocate<TargetPhrases>()) TargetPhrases(pool, targetPhrases.size());
+    BOOST_FOREACH(TargetPhraseImpl *tp, targetPhrases) {
+      tps->AddTargetPhrase(*tp);
+    }
+    mgr.system.featureFunctions.EvaluateAfterTablePruning(pool, *tps, sourcePhrase);
+
+    paths[i]->AddTargetPhrases(*this, tps);
+  }
 }
 
 TargetPhrases *Transliteration::Lookup(const Manager &mgr, MemPool &pool,
@@ -118,6 +185,7 @@ TargetPhrases *Transliteration::Lookup(const Manager &mgr, MemPool &pool,
   mgr.system.featureFunctions.EvaluateAfterTablePruning(pool, *tps, sourcePhrase);
 
   inputPath.AddTargetPhrases(*this, tps);
+  return tps;
 }
 
 std::vector<TargetPhraseImpl*> Transliteration::CreateTargetPhrases(
@@ -156,6 +224,31 @@ std::vector<TargetPhraseImpl*> Transliteration::CreateTargetPhrases(
 
 }
 
+std::vector<TargetPhraseImpl*> Transliteration::CreateTargetPhrases(
+  const Manager &mgr,
+  MemPool &pool,
+  const SubPhrase<Moses2::Word> &sourcePhrase,
+  const Transliterations &transliterations) const
+{
+  std::vector<TargetPhraseImpl*> ret;
+
+  for (Transliterations::const_iterator iter = transliterations.begin(); iter != transliterations.end(); ++iter) {
+    TargetPhraseImpl *tp =
+      new (pool.Allocate<TargetPhraseImpl>()) TargetPhraseImpl(pool, *this, mgr.system, 1);
+    Moses2::Word &word = (*tp)[0];
+    word.CreateFromString(mgr.system.GetVocab(), mgr.system, iter->first);
+
+    tp->GetScores().PlusEquals(mgr.system, *this, iter->second);
+
+    // score of all other ff when this rule is being loaded
+    mgr.system.featureFunctions.EvaluateInIsolation(pool, mgr.system, sourcePhrase, *tp);
+
+    ret.push_back(tp);
+  }
+
+  return ret;
+}
+
 
 void Transliteration::EvaluateInIsolation(const System &system,
     const Phrase<Moses2::Word> &source, const TargetPhraseImpl &targetPhrase, Scores &scores,
@@ -7,7 +7,9 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
 #include "PhraseTable.h"
+#include "../legacy/TransliterationDecoder.h"
 
 namespace Moses2
 {
@@ -15,12 +17,21 @@ class Sentence;
 class InputPaths;
 class Range;
 
+/** mode=script (the default) runs prepare-transliteration-phrase-table.pl
+ * on every unknown word. mode=decoder keeps one decoder for the
+ * transliteration model running, sends it the unknown words of each
+ * sentence together and caches its n-best lists. Unlike the script, it does
+ * not filter and binarize the model's tables for the words but loads config
+ * (by default the unfiltered tuning/moses.tuned.ini of the model) as it is.
+ */
 class Transliteration: public PhraseTable
 {
 public:
   Transliteration(size_t startInd, const std::string &line);
   virtual ~Transliteration();
 
+  virtual void Load(System &system);
+
   void Lookup(const Manager &mgr, InputPathsBase &inputPaths) const;
   virtual TargetPhrases *Lookup(const Manager &mgr, MemPool &pool,
                                 InputPath &inputPath) const;
@@ -79,12 +90,27 @@ protected:
   std::string m_filePath;
   std::string m_mosesDir, m_scriptDir, m_externalDir, m_inputLang, m_outputLang;
 
+  typedef TransliterationDecoder::Transliterations Transliterations;
+
+  std::string m_mode, m_config;
+  size_t m_nBestSize, m_decoderThreads, m_transliterationCacheSize;
+
   std::vector<TargetPhraseImpl*> CreateTargetPhrases(
     const Manager &mgr,
     MemPool &pool,
     const SubPhrase<Moses2::Word> &sourcePhrase,
     const std::string &outDir) const;
 
+  std::vector<TargetPhraseImpl*> CreateTargetPhrases(
+    const Manager &mgr,
+    MemPool &pool,
+    const SubPhrase<Moses2::Word> &sourcePhrase,
+    const Transliterations &transliterations) const;
+
+  // decoder mode
+  void LookupFromDecoder(const Manager &mgr, const std::vector<InputPath*> &paths) const;
+
+  boost::scoped_ptr<TransliterationDecoder> m_decoder;
 };
 
 }
@@ -47,5 +47,17 @@ void TranslationTask::Run()
   delete m_mgr;
 }
 
+DocumentTask::DocumentTask(const TaskList &tasks)
+  :m_tasks(tasks)
+{
+}
+
+void DocumentTask::Run()
+{
+  for (size_t i = 0; i < m_tasks.size(); ++i) {
+    m_tasks[i]->Run();
+    m_tasks[i].reset();
+  }
 }
 
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
 #include "legacy/ThreadPool.h"
 
 namespace Moses2
@@ -21,5 +23,19 @@ protected:
   ManagerBase *m_mgr;
 };
 
+// Translates the sentences of one document in order on a single worker, so
+// they share that thread's manager pool and hypothesis recycler.
+class DocumentTask: public Task
+{
+public:
+  typedef std::vector<boost::shared_ptr<TranslationTask> > TaskList;
+
+  DocumentTask(const TaskList &tasks);
+  virtual void Run();
+
+protected:
+  TaskList m_tasks;
+};
+
 }
 
@@ -200,6 +200,8 @@ Parameter::Parameter()
            "text (0), confusion network (1), word lattice (2), tree (3) (default = 0)");
   AddParam(input_opts, "xml-input", "xi",
            "allows markup of input with desired translations and probabilities. values can be 'pass-through' (default), 'inclusive', 'exclusive', 'constraint', 'ignore'");
+  AddParam(input_opts, "document-input",
+           "lines between <doc ...> and </doc> form one document, decoded in order by a single thread (default false)");
   //AddParam(input_opts, "xml-brackets", "xb",
   //    "specify strings to be used as xml tags opening and closing, e.g. \"{{ }}\" (default \"< >\"). Avoid square brackets because of configuration file format. Valid only with text input mode");
   //AddParam(input_opts, "start-translation-id", "Id of 1st input. Default = 0");
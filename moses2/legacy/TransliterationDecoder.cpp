@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "TransliterationDecoder.h"
+#include "Util2.h"
+#include "util/exception.hh"
+#include "util/tokenize_piece.hh"
+
+using namespace std;
+
+namespace Moses2
+{
+
+namespace
+{
+// Words sent at a time, so that the decoder never waits for us to read its
+// n-best lists while we are still writing.
+const size_t kBatchSize = 200;
+}
+
+string SpaceCharacters(const string &word)
+{
+  string ret;
+  for (size_t i = 0; i < word.size(); ++i) {
+    // Every byte but a UTF-8 continuation byte starts a character.
+    if (i && (word[i] & 0xC0) != 0x80) ret += ' ';
+    ret += word[i];
+  }
+  return ret;
+}
+
+vector<string> TransliterationDecoder::MosesArgs(const string &mosesDir, const string &config, size_t nBestSize, size_t threads)
+{
+  vector<string> argv;
+  argv.push_back(mosesDir + "/bin/moses");
+  argv.push_back("-f");
+  argv.push_back(config);
+  argv.push_back("-search-algorithm");
+  argv.push_back("1");
+  argv.push_back("-cube-pruning-pop-limit");
+  argv.push_back("5000");
+  argv.push_back("-s");
+  argv.push_back("5000");
+  argv.push_back("-threads");
+  argv.push_back(SPrint(threads));
+  argv.push_back("-drop-unknown");
+  argv.push_back("-distortion-limit");
+  argv.push_back("0");
+  argv.push_back("-n-best-list");
+  argv.push_back("-");
+  argv.push_back(SPrint(nBestSize));
+  argv.push_back("-v");
+  argv.push_back("0");
+  return argv;
+}
+
+TransliterationDecoder::TransliterationDecoder(const vector<string> &argv, size_t cacheSize)
+  : m_decoder(argv)
+  , m_nextId(0)
+  , m_cacheSize(cacheSize)
+{
+}
+
+void TransliterationDecoder::Transliterate(const vector<string> &words, vector<Transliterations> &out)
+{
+  out.clear();
+  out.resize(words.size());
+  vector<bool> cached(words.size(), false);
+  vector<string> uncached;
+  {
+    boost::mutex::scoped_lock lock(m_cacheMutex);
+    for (size_t i = 0; i < words.size(); ++i) {
+      Cache::iterator found = m_cache.find(words[i]);
+      if (found == m_cache.end()) {
+        uncached.push_back(words[i]);
+        continue;
+      }
+      out[i] = found->second.first;
+      cached[i] = true;
+      m_cacheOrder.splice(m_cacheOrder.end(), m_cacheOrder, found->second.second);
+    }
+  }
+  if (uncached.empty()) return;
+
+  std::sort(uncached.begin(), uncached.end());
+  uncached.erase(std::unique(uncached.begin(), uncached.end()), uncached.end());
+  vector<Transliterations> decoded;
+  Decode(uncached, decoded);
+  for (size_t i = 0; i < words.size(); ++i) {
+    if (!cached[i]) out[i] = decoded[std::lower_bound(uncached.begin(), uncached.end(), words[i]) - uncached.begin()];
+  }
+
+  boost::mutex::scoped_lock lock(m_cacheMutex);
+  for (size_t i = 0; i < uncached.size(); ++i) {
+    if (m_cache.find(uncached[i]) != m_cache.end()) continue;
+    m_cacheOrder.push_back(uncached[i]);
+    m_cache[uncached[i]] = std::make_pair(decoded[i], --m_cacheOrder.end());
+  }
+  while (m_cache.size() > m_cacheSize) {
+    m_cache.erase(m_cacheOrder.front());
+    m_cacheOrder.pop_front();
+  }
+}
+
+void TransliterationDecoder::Decode(const vector<string> &words, vector<Transliterations> &out)
+{
+  out.clear();
+  out.resize(words.size());
+  boost::mutex::scoped_lock lock(m_decoderMutex);
+  for (size_t begin = 0; begin < words.size(); begin += kBatchSize) {
+    const size_t end = std::min(words.size(), begin + kBatchSize);
+    for (size_t i = begin; i < end; ++i) {
+      m_decoder.Write(SpaceCharacters(words[i]));
+      m_decoder.Write("\n");
+    }
+    // An n-best list ends where the next one starts; the one of this empty
+    // line ends the batch.
+    m_decoder.Write("\n");
+    m_decoder.Flush();
+
+    const size_t firstId = m_nextId, endId = firstId + (end - begin);
+    m_nextId = endId + 1;
+
+    string line;
+    while (true) {
+      UTIL_THROW_IF2(!m_decoder.ReadLine(line), "Transliteration decoder exited");
+      vector<StringPiece> fields;
+      for (util::TokenIter<util::MultiCharacter> it(line, util::MultiCharacter("|||")); it; ++it) {
+        fields.push_back(*it);
+      }
+      if (fields.size() < 4) continue;
+      const size_t id = std::strtoul(Trim(fields[0].as_string()).c_str(), NULL, 10);
+      // rest of the previous batch's empty line
+      if (id < firstId) continue;
+      if (id == endId) break;
+      UTIL_THROW_IF2(id > endId, "Transliteration decoder answered sentence " << id << " but was only sent up to " << endId);
+
+      // the characters of the transliteration, without the spaces
+      string word;
+      for (const char *c = fields[1].data(); c != fields[1].data() + fields[1].size(); ++c) {
+        if (*c != ' ') word += *c;
+      }
+      if (!word.empty()) {
+        out[begin + id - firstId].push_back(std::make_pair(word, std::strtof(Trim(fields[3].as_string()).c_str(), NULL)));
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "util/child_process.hh"
+
+namespace Moses2
+{
+
+//! "wörd" -> "w ö r d", as the transliteration model reads it.
+std::string SpaceCharacters(const std::string &word);
+
+/** Transliterates words with a character-based Moses model whose decoder
+ * keeps running in a child process, for the decoder mode of
+ * Transliteration. POSIX only.
+ *
+ * The decoder loads the whole model once; see
+ * Transliteration for how that differs from the script.
+ */
+class TransliterationDecoder
+{
+public:
+  //! Transliterations of a word with their scores, best first.
+  typedef std::vector<std::pair<std::string, float> > Transliterations;
+
+  //! The command line of mosesDir/bin/moses with the options that
+  //! prepare-transliteration-phrase-table.pl decodes with.
+  static std::vector<std::string> MosesArgs(const std::string &mosesDir, const std::string &config, size_t nBestSize, size_t threads);
+
+  /** argv is a decoder that reads a sentence per line and writes n-best
+   * lists ("id ||| words ||| features ||| score") to stdout, numbering the
+   * sentences from 0. The transliterations of at most cacheSize words are
+   * remembered.
+   */
+  TransliterationDecoder(const std::vector<std::string> &argv, size_t cacheSize);
+
+  //! Transliterate words, decoding those not cached together. Thread safe.
+  void Transliterate(const std::vector<std::string> &words, std::vector<Transliterations> &out);
+
+private:
+  //! Decode distinct words, in batches.
+  void Decode(const std::vector<std::string> &words, std::vector<Transliterations> &out);
+
+  util::ChildProcess m_decoder;
+  // sentence id the decoder gives to the next line
+  size_t m_nextId;
+  boost::mutex m_decoderMutex;
+
+  // least recently used first
+  typedef std::list<std::string> CacheOrder;
+  typedef boost::unordered_map<std::string, std::pair<Transliterations, CacheOrder::iterator> > Cache;
+  Cache m_cache;
+  CacheOrder m_cacheOrder;
+  size_t m_cacheSize;
+  boost::mutex m_cacheMutex;
+};
+
+}
@@ -13,6 +13,7 @@ InputOptions()
   , input_type(SentenceInput)
   , xml_policy(XmlPassThrough)
   , placeholder_factor(NOT_FOUND)
+  , document_input(false)
 {
   xml_brackets.first  = "<";
   xml_brackets.second = ">";
@@ -78,6 +79,7 @@ init(Parameter const& param)
 
   param.SetParameter<std::string>(factor_delimiter, "factor-delimiter", "|");
   param.SetParameter<std::string>(input_file_path,"input-file","");
+  param.SetParameter(document_input, "document-input", false);
 
   return true;
 }
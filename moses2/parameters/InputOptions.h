@@ -16,6 +16,7 @@ struct
   std::string factor_delimiter;
   FactorType placeholder_factor; // where to store original text for placeholders
   std::string input_file_path;
+  bool document_input; // <doc> ... </doc> lines delimit documents
   std::pair<std::string,std::string> xml_brackets;
   // strings to use as XML tags' opening and closing brackets.
   // Default are "<" and ">"
@@ -0,0 +1,121 @@
+/***********************************************************************
+  Moses - factored phrase-based language decoder
+  Copyright (C) 2015- University of Edinburgh
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***********************************************************************/
+
+#define  BOOST_TEST_MODULE MosesTrainingScoreThreads
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+
+// the score binary, given by the Jamfile
+string ScoreLocation()
+{
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "score";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+string ReadFile(const boost::filesystem::path &path)
+{
+  ifstream in(path.string().c_str());
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+class TempDir
+{
+public:
+  TempDir()
+    : m_path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("score-threads-%%%%-%%%%")) {
+    boost::filesystem::create_directories(m_path);
+  }
+
+  ~TempDir() {
+    boost::filesystem::remove_all(m_path);
+  }
+
+  boost::filesystem::path operator/(const char *name) const {
+    return m_path / name;
+  }
+
+private:
+  boost::filesystem::path m_path;
+};
+
+// A sorted extract file several chunks long, with a few translations of
+// every source phrase, and the lexical table that goes with it.
+void WriteTraining(const boost::filesystem::path &extract, const boost::filesystem::path &lex)
+{
+  ofstream extractOut(extract.string().c_str());
+  set<pair<string, string> > pairs;
+  char source[16], target[16];
+  for (int s = 0; s < 8000; ++s) {
+    sprintf(source, "s%05d", s);
+    for (int t = 0; t < 1 + s % 4; ++t) {
+      sprintf(target, "t%03d", (s + 7 * t) % 300);
+      // repeated pairs give counts other than one
+      for (int repeat = 0; repeat <= (s + t) % 3; ++repeat) {
+        extractOut << source << " of ||| " << target << " von ||| 0-0 1-1\n";
+      }
+      pairs.insert(make_pair(string(target), string(source)));
+    }
+  }
+  pairs.insert(make_pair(string("von"), string("of")));
+
+  ofstream lexOut(lex.string().c_str());
+  for (set<pair<string, string> >::const_iterator p = pairs.begin(); p != pairs.end(); ++p) {
+    lexOut << p->first << ' ' << p->second << ' ' << 1.0 / (1 + p->first.size() + p->second.size()) << '\n';
+  }
+}
+
+string Score(const TempDir &dir, const char *table, const string &options)
+{
+  ostringstream command;
+  command << ScoreLocation() << ' ' << dir / "extract" << ' ' << dir / "lex"
+          << ' ' << dir / table << options << " 2>/dev/null";
+  BOOST_REQUIRE_EQUAL(system(command.str().c_str()), 0);
+  return ReadFile(dir / table);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(threaded_output_equals_serial_output)
+{
+  TempDir dir;
+  WriteTraining(dir / "extract", dir / "lex");
+
+  const string serial = Score(dir, "serial", "");
+  BOOST_REQUIRE(!serial.empty());
+  BOOST_CHECK(serial == Score(dir, "threads", " --Threads 4"));
+
+  const string inverse = Score(dir, "inverse", " --Inverse");
+  BOOST_CHECK(inverse == Score(dir, "inverse-threads", " --Inverse --Threads 4"));
+}
@@ -21,14 +21,22 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <string>
 #include <sstream>
 #include <vector>
 
 #include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include "util/pcqueue.hh"
+#endif
 
 #include "syntax-common/exception.h"
 #include "syntax-common/xml_tree_parser.h"
@@ -60,6 +68,80 @@ namespace Syntax
 namespace GHKM
 {
 
+#ifdef WITH_THREADS
+// Writes the rules of each block to the extract files once those of all
+// earlier blocks are written, so the files come out in input order however
+// the threads finish.  Also holds the first error a thread ran into.
+class ExtractGHKM::BlockWriter
+{
+public:
+  // A thread waits before handing over a block more than window blocks
+  // ahead of the next one to write, which bounds the rules held in memory.
+  BlockWriter(std::ostream &fwd, std::ostream &inv, size_t window)
+    : m_fwd(fwd)
+    , m_inv(inv)
+    , m_window(window)
+    , m_next(0)
+    , m_failed(false)
+    , m_errorLineNum(0) {}
+
+  // Takes the rules of block index (leaving fwd and inv empty).  Once a
+  // thread has failed, blocks are still taken, so nobody waits for them,
+  // but no longer written.
+  void Write(size_t index, std::string &fwd, std::string &inv) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (index >= m_next + m_window) {
+      m_written.wait(lock);
+    }
+    std::pair<std::string, std::string> &rules = m_pending[index];
+    rules.first.swap(fwd);
+    rules.second.swap(inv);
+    std::map<size_t, std::pair<std::string, std::string> >::iterator p;
+    while ((p = m_pending.find(m_next)) != m_pending.end()) {
+      if (!m_failed) {
+        m_fwd << p->second.first;
+        m_inv << p->second.second;
+      }
+      m_pending.erase(p);
+      ++m_next;
+    }
+    m_written.notify_all();
+  }
+
+  // Records an error at lineNum, unless one at an earlier line is known.
+  void Fail(size_t lineNum, const std::string &msg) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (!m_failed || lineNum < m_errorLineNum) {
+      m_failed = true;
+      m_errorLineNum = lineNum;
+      m_error = msg;
+    }
+  }
+
+  bool Failed() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_failed;
+  }
+
+  // Only to be read once the threads are done.
+  const std::string &ErrorMessage() const {
+    return m_error;
+  }
+
+private:
+  std::ostream &m_fwd;
+  std::ostream &m_inv;
+  const size_t m_window;
+  boost::mutex m_mutex;
+  boost::condition_variable m_written;
+  std::map<size_t, std::pair<std::string, std::string> > m_pending;
+  size_t m_next;
+  bool m_failed;
+  size_t m_errorLineNum;
+  std::string m_error;
+};
+#endif
+
 int ExtractGHKM::Main(int argc, char *argv[])
 {
   using Moses::InputFileStream;
@@ -102,6 +184,18 @@ int ExtractGHKM::Main(int argc, char *argv[])
   OpenOutputFileOrDie(fwdFileName, fwdExtractStream);
   OpenOutputFileOrDie(invFileName, invExtractStream);
 
+  // One worker per thread.  A single worker writes its rules straight to the
+  // extract files; with more, the BlockWriter puts them there in input order.
+  std::vector<boost::shared_ptr<Worker> > workers;
+  if (options.threads == 1) {
+    workers.push_back(boost::shared_ptr<Worker>(
+                        new Worker(options, &fwdExtractStream, &invExtractStream)));
+  } else {
+    for (int i = 0; i < options.threads; ++i) {
+      workers.push_back(boost::shared_ptr<Worker>(new Worker(options)));
+    }
+  }
+
   if (!options.glueGrammarFile.empty()) {
     OpenOutputFileOrDie(options.glueGrammarFile, glueGrammarStream);
   }
@@ -121,23 +215,32 @@ int ExtractGHKM::Main(int argc, char *argv[])
     OpenOutputFileOrDie(options.unknownWordSoftMatchesFile, unknownWordSoftMatchesStream);
   }
 
-  // Word count statistics for producing unknown word labels.
-  std::map<std::string, int> targetWordCount;
-  std::map<std::string, std::string> targetWordLabel;
-
-  // Word count statistics for producing unknown word labels: source side.
-  std::map<std::string, int> sourceWordCount;
-  std::map<std::string, std::string> sourceWordLabel;
+#ifdef WITH_THREADS
+  // Blocks of sentences go to whichever thread is free.  The rules of a few
+  // deep trees can take longer than thousands of others.
+  const size_t blockSize = 100;
+  BlockQueue queue(options.threads * 4);
+  BlockWriter writer(fwdExtractStream, invExtractStream, options.threads * 4);
+  boost::thread_group threads;
+  if (options.threads > 1) {
+    for (int i = 0; i < options.threads; ++i) {
+      threads.create_thread(boost::bind(&ExtractGHKM::ExtractBlocks, this,
+                                        boost::cref(options),
+                                        boost::ref(queue),
+                                        boost::ref(writer),
+                                        boost::ref(*workers[i])));
+    }
+  }
+  SentenceBlock *block = 0;
+  size_t blockIndex = 0;
+#endif
 
   std::string targetLine;
   std::string sourceLine;
   std::string alignmentLine;
-  Alignment alignment;
-  XmlTreeParser targetXmlTreeParser;
-  XmlTreeParser sourceXmlTreeParser;
-  ScfgRuleWriter scfgWriter(fwdExtractStream, invExtractStream, options);
-  StsgRuleWriter stsgWriter(fwdExtractStream, invExtractStream, options);
   size_t lineNum = options.sentenceOffset;
+  // Reported once the threads are done with what was read before.
+  std::string inputError;
   while (true) {
     std::getline(targetStream, targetLine);
     std::getline(sourceStream, sourceLine);
@@ -148,155 +251,101 @@ int ExtractGHKM::Main(int argc, char *argv[])
     }
 
     if (targetStream.eof() || sourceStream.eof() || alignmentStream.eof()) {
-      Error("Files must contain same number of lines");
+      inputError = "Files must contain same number of lines";
+      break;
     }
 
     ++lineNum;
 
-    // Parse target tree.
-    if (targetLine.size() == 0) {
-      std::cerr << "skipping line " << lineNum << " with empty target tree\n";
-      continue;
-    }
-    std::auto_ptr<SyntaxTree> targetParseTree;
-    try {
-      targetParseTree = targetXmlTreeParser.Parse(targetLine);
-      assert(targetParseTree.get());
-    } catch (const Exception &e) {
-      std::ostringstream oss;
-      oss << "Failed to parse target XML tree at line " << lineNum;
-      if (!e.msg().empty()) {
-        oss << ": " << e.msg();
-      }
-      Error(oss.str());
-    }
-
-    // Read source tokens (and parse tree if using source labels).
-    std::vector<std::string> sourceTokens;
-    std::auto_ptr<SyntaxTree> sourceParseTree;
-    if (!options.sourceLabels) {
-      sourceTokens = ReadTokens(sourceLine);
-    } else {
+    if (options.threads == 1) {
       try {
-        sourceParseTree = sourceXmlTreeParser.Parse(sourceLine);
-        assert(sourceParseTree.get());
+        ExtractSentence(options, lineNum, targetLine, sourceLine, alignmentLine,
+                        *workers[0]);
       } catch (const Exception &e) {
-        std::ostringstream oss;
-        oss << "Failed to parse source XML tree at line " << lineNum;
-        if (!e.msg().empty()) {
-          oss << ": " << e.msg();
-        }
-        Error(oss.str());
+        Error(e.msg());
       }
-      sourceTokens = sourceXmlTreeParser.words();
+      continue;
     }
 
-    // Read word alignments.
-    try {
-      ReadAlignment(alignmentLine, alignment);
-    } catch (const Exception &e) {
-      std::ostringstream oss;
-      oss << "Failed to read alignment at line " << lineNum << ": ";
-      oss << e.msg();
-      Error(oss.str());
+#ifdef WITH_THREADS
+    if (writer.Failed()) {
+      break;
     }
-    if (alignment.size() == 0) {
-      std::cerr << "skipping line " << lineNum << " without alignment points\n";
-      continue;
+    if (!block) {
+      block = new SentenceBlock();
+      block->index = blockIndex++;
+      block->firstLineNum = lineNum;
     }
-    if (options.t2s) {
-      FlipAlignment(alignment);
+    block->targetLines.push_back(targetLine);
+    block->sourceLines.push_back(sourceLine);
+    block->alignmentLines.push_back(alignmentLine);
+    if (block->targetLines.size() == blockSize) {
+      queue.Produce(block);
+      block = 0;
     }
+#endif
+  }
 
-    // Record word counts.
-    if (!options.targetUnknownWordFile.empty()) {
-      CollectWordLabelCounts(*targetParseTree, options, targetWordCount,
-                             targetWordLabel);
+#ifdef WITH_THREADS
+  if (options.threads > 1) {
+    if (block) {
+      queue.Produce(block);
     }
-
-    // Record word counts: source side.
-    if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
-      CollectWordLabelCounts(*sourceParseTree, options, sourceWordCount,
-                             sourceWordLabel);
+    // One empty block per thread ends its loop.
+    for (int i = 0; i < options.threads; ++i) {
+      queue.Produce(0);
     }
-
-    // Form an alignment graph from the target tree, source words, and
-    // alignment.
-    AlignmentGraph graph(targetParseTree.get(), sourceTokens, alignment);
-
-    // Extract minimal rules, adding each rule to its root node's rule set.
-    graph.ExtractMinimalRules(options);
-
-    // Extract composed rules.
-    if (!options.minimal) {
-      graph.ExtractComposedRules(options);
+    threads.join_all();
+    if (writer.Failed()) {
+      Error(writer.ErrorMessage());
     }
+  }
+#endif
 
-    // Initialize phrase orientation scoring object
-    PhraseOrientation phraseOrientation(sourceTokens.size(),
-                                        targetXmlTreeParser.words().size(), alignment);
-
-    // Write the rules, subject to scope pruning.
-    const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
-    for (std::vector<Node *>::const_iterator p = targetNodes.begin();
-         p != targetNodes.end(); ++p) {
-
-      const std::vector<const Subgraph *> &rules = (*p)->GetRules();
-
-      PhraseOrientation::REO_CLASS l2rOrientation=PhraseOrientation::REO_CLASS_UNKNOWN, r2lOrientation=PhraseOrientation::REO_CLASS_UNKNOWN;
-      if (options.phraseOrientation && !rules.empty()) {
-        int sourceSpanBegin = *((*p)->GetSpan().begin());
-        int sourceSpanEnd   = *((*p)->GetSpan().rbegin());
-        l2rOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_L2R);
-        r2lOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_R2L);
-        // std::cerr << "span " << sourceSpanBegin << " " << sourceSpanEnd << std::endl;
-        // std::cerr << "phraseOrientation " << phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd) << std::endl;
-      }
+  if (!inputError.empty()) {
+    Error(inputError);
+  }
+  fwdExtractStream.Close();
+  invExtractStream.Close();
 
-      for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
-           q != rules.end(); ++q) {
-        // STSG output.
-        if (options.stsg) {
-          StsgRule rule(**q);
-          if (rule.Scope() <= options.maxScope) {
-            stsgWriter.Write(rule);
-          }
-          continue;
-        }
-        // SCFG output.
-        ScfgRule *r = 0;
-        if (options.sourceLabels) {
-          r = new ScfgRule(**q, &sourceXmlTreeParser.node_collection());
-        } else {
-          r = new ScfgRule(**q);
-        }
-        // TODO Can scope pruning be done earlier?
-        if (r->Scope() <= options.maxScope) {
-          scfgWriter.Write(*r,lineNum,false);
-          if (options.treeFragments) {
-            fwdExtractStream << " {{Tree ";
-            (*q)->PrintTree(fwdExtractStream);
-            fwdExtractStream << "}}";
-          }
-          if (options.partsOfSpeech) {
-            fwdExtractStream << " {{POS";
-            (*q)->PrintPartsOfSpeech(fwdExtractStream);
-            fwdExtractStream << "}}";
-          }
-          if (options.phraseOrientation) {
-            fwdExtractStream << " {{Orientation ";
-            phraseOrientation.WriteOrientation(fwdExtractStream,l2rOrientation);
-            fwdExtractStream << " ";
-            phraseOrientation.WriteOrientation(fwdExtractStream,r2lOrientation);
-            fwdExtractStream << "}}";
-            phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_L2R,l2rOrientation,1);
-            phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_R2L,r2lOrientation,1);
-          }
-          fwdExtractStream << std::endl;
-          invExtractStream << std::endl;
-        }
-        delete r;
-      }
+  // Merge the workers' label sets and counts.
+  std::set<std::string> targetLabelSet;
+  std::map<std::string, int> targetTopLabelSet;
+  std::set<std::string> sourceLabelSet;
+  std::map<std::string, int> targetWordCount;
+  std::map<std::string, std::string> targetWordLabel;
+  std::map<std::string, int> sourceWordCount;
+  std::map<std::string, std::string> sourceWordLabel;
+  PhraseOrientation phraseOrientationPriors;
+  for (std::vector<boost::shared_ptr<Worker> >::const_iterator p =
+         workers.begin(); p != workers.end(); ++p) {
+    const Worker &worker = **p;
+
+    const std::set<std::string> &labels = worker.targetXmlTreeParser.label_set();
+    targetLabelSet.insert(labels.begin(), labels.end());
+    const std::map<std::string, int> &topLabels =
+      worker.targetXmlTreeParser.top_label_set();
+    for (std::map<std::string, int>::const_iterator q = topLabels.begin();
+         q != topLabels.end(); ++q) {
+      targetTopLabelSet[q->first] += q->second;
+    }
+    const std::set<std::string> &workerSourceLabels =
+      worker.sourceXmlTreeParser.label_set();
+    sourceLabelSet.insert(workerSourceLabels.begin(), workerSourceLabels.end());
+
+    MergeWordLabelCounts(worker.targetWordCount, worker.targetWordLabel,
+                         targetWordCount, targetWordLabel);
+    MergeWordLabelCounts(worker.sourceWordCount, worker.sourceWordLabel,
+                         sourceWordCount, sourceWordLabel);
+
+    for (int orient = 0; orient <= PhraseOrientation::REO_CLASS_UNKNOWN;
+         ++orient) {
+      phraseOrientationPriors.IncrementPriorCount(
+        PhraseOrientation::REO_DIR_L2R, PhraseOrientation::REO_CLASS(orient),
+        worker.l2rOrientationPriorCounts[orient]);
+      phraseOrientationPriors.IncrementPriorCount(
+        PhraseOrientation::REO_DIR_R2L, PhraseOrientation::REO_CLASS(orient),
+        worker.r2lOrientationPriorCounts[orient]);
     }
   }
 
@@ -309,7 +358,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
 
   std::map<std::string,size_t> sourceLabels;
   if (options.sourceLabels && !options.sourceLabelSetFile.empty()) {
-    std::set<std::string> extendedLabelSet = sourceXmlTreeParser.label_set();
+    std::set<std::string> extendedLabelSet = sourceLabelSet;
     extendedLabelSet.insert("XLHS"); // non-matching label (left-hand side)
     extendedLabelSet.insert("XRHS"); // non-matching label (right-hand side)
     extendedLabelSet.insert("TOPLABEL");  // as used in the glue grammar
@@ -326,8 +375,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
   std::map<std::string, int> strippedTargetTopLabelSet;
   if (options.stripBitParLabels &&
       (!options.glueGrammarFile.empty() || !options.unknownWordSoftMatchesFile.empty())) {
-    StripBitParLabels(targetXmlTreeParser.label_set(),
-                      targetXmlTreeParser.top_label_set(),
+    StripBitParLabels(targetLabelSet, targetTopLabelSet,
                       strippedTargetLabelSet, strippedTargetTopLabelSet);
   }
 
@@ -335,8 +383,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
     if (options.stripBitParLabels) {
       WriteGlueGrammar(strippedTargetLabelSet, strippedTargetTopLabelSet, sourceLabels, options, glueGrammarStream);
     } else {
-      WriteGlueGrammar(targetXmlTreeParser.label_set(),
-                       targetXmlTreeParser.top_label_set(),
+      WriteGlueGrammar(targetLabelSet, targetTopLabelSet,
                        sourceLabels, options, glueGrammarStream);
     }
   }
@@ -353,14 +400,207 @@ int ExtractGHKM::Main(int argc, char *argv[])
     if (options.stripBitParLabels) {
       WriteUnknownWordSoftMatches(strippedTargetLabelSet, unknownWordSoftMatchesStream);
     } else {
-      WriteUnknownWordSoftMatches(targetXmlTreeParser.label_set(),
-                                  unknownWordSoftMatchesStream);
+      WriteUnknownWordSoftMatches(targetLabelSet, unknownWordSoftMatchesStream);
     }
   }
 
   return 0;
 }
 
+#ifdef WITH_THREADS
+void ExtractGHKM::ExtractBlocks(const Options &options, BlockQueue &queue,
+                                BlockWriter &writer, Worker &worker)
+{
+  SentenceBlock *block;
+  while (queue.Consume(block)) {
+    // After an error, in this thread or another, blocks are only passed on.
+    if (!writer.Failed()) {
+      size_t lineNum = block->firstLineNum;
+      try {
+        for (size_t i = 0; i < block->targetLines.size(); ++i, ++lineNum) {
+          ExtractSentence(options, lineNum, block->targetLines[i],
+                          block->sourceLines[i], block->alignmentLines[i],
+                          worker);
+        }
+      } catch (const Exception &e) {
+        writer.Fail(lineNum, e.msg());
+      } catch (const std::exception &e) {
+        std::ostringstream oss;
+        oss << "Failed to extract rules at line " << lineNum << ": "
+            << e.what();
+        writer.Fail(lineNum, oss.str());
+      }
+    }
+    std::string fwd = worker.fwdBuffer.str();
+    std::string inv = worker.invBuffer.str();
+    worker.fwdBuffer.str("");
+    worker.invBuffer.str("");
+    writer.Write(block->index, fwd, inv);
+    delete block;
+  }
+}
+#endif
+
+void ExtractGHKM::ExtractSentence(const Options &options, size_t lineNum,
+                                  const std::string &targetLine,
+                                  const std::string &sourceLine,
+                                  const std::string &alignmentLine,
+                                  Worker &worker)
+{
+  XmlTreeParser &targetXmlTreeParser = worker.targetXmlTreeParser;
+  XmlTreeParser &sourceXmlTreeParser = worker.sourceXmlTreeParser;
+  std::ostream &fwdExtractStream = worker.fwdExtractStream;
+  std::ostream &invExtractStream = worker.invExtractStream;
+
+  // Parse target tree.
+  if (targetLine.size() == 0) {
+    std::cerr << "skipping line " << lineNum << " with empty target tree\n";
+    return;
+  }
+  std::auto_ptr<SyntaxTree> targetParseTree;
+  try {
+    targetParseTree = targetXmlTreeParser.Parse(targetLine);
+    assert(targetParseTree.get());
+  } catch (const Exception &e) {
+    std::ostringstream oss;
+    oss << "Failed to parse target XML tree at line " << lineNum;
+    if (!e.msg().empty()) {
+      oss << ": " << e.msg();
+    }
+    throw Exception(oss.str());
+  }
+
+  // Read source tokens (and parse tree if using source labels).
+  std::vector<std::string> sourceTokens;
+  std::auto_ptr<SyntaxTree> sourceParseTree;
+  if (!options.sourceLabels) {
+    sourceTokens = ReadTokens(sourceLine);
+  } else {
+    try {
+      sourceParseTree = sourceXmlTreeParser.Parse(sourceLine);
+      assert(sourceParseTree.get());
+    } catch (const Exception &e) {
+      std::ostringstream oss;
+      oss << "Failed to parse source XML tree at line " << lineNum;
+      if (!e.msg().empty()) {
+        oss << ": " << e.msg();
+      }
+      throw Exception(oss.str());
+    }
+    sourceTokens = sourceXmlTreeParser.words();
+  }
+
+  // Read word alignments.
+  Alignment alignment;
+  try {
+    ReadAlignment(alignmentLine, alignment);
+  } catch (const Exception &e) {
+    std::ostringstream oss;
+    oss << "Failed to read alignment at line " << lineNum << ": ";
+    oss << e.msg();
+    throw Exception(oss.str());
+  }
+  if (alignment.size() == 0) {
+    std::cerr << "skipping line " << lineNum << " without alignment points\n";
+    return;
+  }
+  if (options.t2s) {
+    FlipAlignment(alignment);
+  }
+
+  // Record word counts.
+  if (!options.targetUnknownWordFile.empty()) {
+    CollectWordLabelCounts(*targetParseTree, options, worker.targetWordCount,
+                           worker.targetWordLabel);
+  }
+
+  // Record word counts: source side.
+  if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
+    CollectWordLabelCounts(*sourceParseTree, options, worker.sourceWordCount,
+                           worker.sourceWordLabel);
+  }
+
+  // Form an alignment graph from the target tree, source words, and
+  // alignment.
+  AlignmentGraph graph(targetParseTree.get(), sourceTokens, alignment);
+
+  // Extract minimal rules, adding each rule to its root node's rule set.
+  graph.ExtractMinimalRules(options);
+
+  // Extract composed rules.
+  if (!options.minimal) {
+    graph.ExtractComposedRules(options);
+  }
+
+  // Initialize phrase orientation scoring object
+  PhraseOrientation phraseOrientation(sourceTokens.size(),
+                                      targetXmlTreeParser.words().size(), alignment);
+
+  // Write the rules, subject to scope pruning.
+  const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
+  for (std::vector<Node *>::const_iterator p = targetNodes.begin();
+       p != targetNodes.end(); ++p) {
+
+    const std::vector<const Subgraph *> &rules = (*p)->GetRules();
+
+    PhraseOrientation::REO_CLASS l2rOrientation=PhraseOrientation::REO_CLASS_UNKNOWN, r2lOrientation=PhraseOrientation::REO_CLASS_UNKNOWN;
+    if (options.phraseOrientation && !rules.empty()) {
+      int sourceSpanBegin = *((*p)->GetSpan().begin());
+      int sourceSpanEnd   = *((*p)->GetSpan().rbegin());
+      l2rOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_L2R);
+      r2lOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_R2L);
+      // std::cerr << "span " << sourceSpanBegin << " " << sourceSpanEnd << std::endl;
+      // std::cerr << "phraseOrientation " << phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd) << std::endl;
+    }
+
+    for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
+         q != rules.end(); ++q) {
+      // STSG output.
+      if (options.stsg) {
+        StsgRule rule(**q);
+        if (rule.Scope() <= options.maxScope) {
+          worker.stsgWriter.Write(rule);
+        }
+        continue;
+      }
+      // SCFG output.
+      ScfgRule *r = 0;
+      if (options.sourceLabels) {
+        r = new ScfgRule(**q, &sourceXmlTreeParser.node_collection());
+      } else {
+        r = new ScfgRule(**q);
+      }
+      // TODO Can scope pruning be done earlier?
+      if (r->Scope() <= options.maxScope) {
+        worker.scfgWriter.Write(*r,lineNum,false);
+        if (options.treeFragments) {
+          fwdExtractStream << " {{Tree ";
+          (*q)->PrintTree(fwdExtractStream);
+          fwdExtractStream << "}}";
+        }
+        if (options.partsOfSpeech) {
+          fwdExtractStream << " {{POS";
+          (*q)->PrintPartsOfSpeech(fwdExtractStream);
+          fwdExtractStream << "}}";
+        }
+        if (options.phraseOrientation) {
+          fwdExtractStream << " {{Orientation ";
+          phraseOrientation.WriteOrientation(fwdExtractStream,l2rOrientation);
+          fwdExtractStream << " ";
+          phraseOrientation.WriteOrientation(fwdExtractStream,r2lOrientation);
+          fwdExtractStream << "}}";
+          // The prior counts are static; the main thread adds these up.
+          ++worker.l2rOrientationPriorCounts[l2rOrientation];
+          ++worker.r2lOrientationPriorCounts[r2lOrientation];
+        }
+        fwdExtractStream << std::endl;
+        invExtractStream << std::endl;
+      }
+      delete r;
+    }
+  }
+}
+
 void ExtractGHKM::ProcessOptions(int argc, char *argv[],
                                  Options &options) const
 {
@@ -456,6 +696,9 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
    "output STSG rules (default is SCFG)")
   ("T2S",
    "enable tree-to-string rule extraction (string-to-tree is assumed by default)")
+  ("Threads",
+   po::value(&options.threads)->default_value(options.threads),
+   "extract on this many threads")
   ("TreeFragments",
    "output parse tree information")
   ("SourceLabels",
@@ -591,6 +834,15 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
     options.unpairedExtractFormat = true;
   }
 
+  if (options.threads < 1) {
+    Error("Threads must be at least 1");
+  }
+#ifndef WITH_THREADS
+  if (options.threads > 1) {
+    Error("thread support not compiled in");
+  }
+#endif
+
   // Workaround for extract-parallel issue.
   if (options.sentenceOffset > 0) {
     options.targetUnknownWordFile.clear();
@@ -791,6 +1043,23 @@ void ExtractGHKM::CollectWordLabelCounts(
   }
 }
 
+void ExtractGHKM::MergeWordLabelCounts(
+  const std::map<std::string, int> &wordCount,
+  const std::map<std::string, std::string> &wordLabel,
+  std::map<std::string, int> &totalWordCount,
+  std::map<std::string, std::string> &totalWordLabel) const
+{
+  for (std::map<std::string, int>::const_iterator p = wordCount.begin();
+       p != wordCount.end(); ++p) {
+    totalWordCount[p->first] += p->second;
+  }
+  // Only the labels of singletons are used, and those have just the one.
+  for (std::map<std::string, std::string>::const_iterator p =
+         wordLabel.begin(); p != wordLabel.end(); ++p) {
+    totalWordLabel[p->first] = p->second;
+  }
+}
+
 std::vector<std::string> ExtractGHKM::ReadTokens(const SyntaxTree &root) const
 {
   std::vector<std::string> tokens;
@@ -22,6 +22,7 @@
 #include <map>
 #include <ostream>
 #include <set>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -29,6 +30,16 @@
 #include "SyntaxTree.h"
 
 #include "syntax-common/tool.h"
+#include "syntax-common/xml_tree_parser.h"
+
+#include "PhraseOrientation.h"
+#include "ScfgRuleWriter.h"
+#include "StsgRuleWriter.h"
+
+namespace util
+{
+template <class T> class PCQueue;
+}
 
 namespace MosesTraining
 {
@@ -47,11 +58,65 @@ public:
   virtual int Main(int argc, char *argv[]);
 
 private:
+  // What one extraction thread owns: its parsers (which also collect the
+  // label sets) and its share of the corpus-wide counts.  Rules go to the
+  // given extract streams or, if there are none, to the worker's buffers,
+  // from which ExtractBlocks() passes them on after each block.
+  struct Worker {
+    Worker(const Options &options, std::ostream *fwd = 0, std::ostream *inv = 0)
+      : fwdExtractStream(fwd ? *fwd : fwdBuffer)
+      , invExtractStream(inv ? *inv : invBuffer)
+      , scfgWriter(fwdExtractStream, invExtractStream, options)
+      , stsgWriter(fwdExtractStream, invExtractStream, options)
+      , l2rOrientationPriorCounts(PhraseOrientation::REO_CLASS_UNKNOWN+1, 0.0f)
+      , r2lOrientationPriorCounts(PhraseOrientation::REO_CLASS_UNKNOWN+1, 0.0f) {}
+
+    XmlTreeParser targetXmlTreeParser;
+    XmlTreeParser sourceXmlTreeParser;
+    std::ostringstream fwdBuffer;
+    std::ostringstream invBuffer;
+    std::ostream &fwdExtractStream;
+    std::ostream &invExtractStream;
+    ScfgRuleWriter scfgWriter;
+    StsgRuleWriter stsgWriter;
+    std::map<std::string, int> targetWordCount;
+    std::map<std::string, std::string> targetWordLabel;
+    std::map<std::string, int> sourceWordCount;
+    std::map<std::string, std::string> sourceWordLabel;
+    std::vector<float> l2rOrientationPriorCounts;
+    std::vector<float> r2lOrientationPriorCounts;
+  };
+
+  // Consecutive lines of the three input files, the index-th block of them.
+  struct SentenceBlock {
+    size_t index;
+    size_t firstLineNum;
+    std::vector<std::string> targetLines;
+    std::vector<std::string> sourceLines;
+    std::vector<std::string> alignmentLines;
+  };
+
+  typedef util::PCQueue<SentenceBlock*> BlockQueue;
+
+  class BlockWriter;
+
+  // Throws Exception if a line cannot be read.
+  void ExtractSentence(const Options &, size_t lineNum,
+                       const std::string &targetLine,
+                       const std::string &sourceLine,
+                       const std::string &alignmentLine,
+                       Worker &);
+  void ExtractBlocks(const Options &, BlockQueue &, BlockWriter &, Worker &);
+
   void RecordTreeLabels(const SyntaxTree &, std::set<std::string> &);
   void CollectWordLabelCounts(SyntaxTree &,
                               const Options &,
                               std::map<std::string, int> &,
                               std::map<std::string, std::string> &);
+  void MergeWordLabelCounts(const std::map<std::string, int> &,
+                            const std::map<std::string, std::string> &,
+                            std::map<std::string, int> &,
+                            std::map<std::string, std::string> &) const;
   void WriteUnknownWordLabel(const std::map<std::string, int> &,
                              const std::map<std::string, std::string> &,
                              const Options &,
@@ -28,6 +28,11 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/unordered_map.hpp>
 
+#ifdef WITH_THREADS
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#endif
+
 #include "ScoreFeature.h"
 #include "tables-core.h"
 #include "ExtractionPhrasePair.h"
@@ -35,6 +40,8 @@
 #include "InputFileStream.h"
 #include "OutputFileStream.h"
 
+#include "moses/OutputCollector.h"
+#include "moses/ThreadPool.h"
 #include "moses/Util.h"
 
 using namespace boost::algorithm;
@@ -70,23 +77,13 @@ bool nonTermContext = false;
 bool nonTermContextTarget = false;
 bool targetConstituentBoundariesFlag = false;
 
-int countOfCounts[COC_MAX+1];
-int totalDistinct = 0;
 float minCount = 0;
 float minCountHierarchical = 0;
 bool phraseOrientationPriorsFlag = false;
 
-boost::unordered_map<std::string,float> sourceLHSCounts;
-boost::unordered_map<std::string, boost::unordered_map<std::string,float>* > targetLHSAndSourceLHSJointCounts;
-std::set<std::string> sourceLabelSet;
 std::map<std::string,size_t> sourceLabels;
 std::vector<std::string> sourceLabelsByIndex;
 
-std::set<std::string> partsOfSpeechSet;
-
-boost::unordered_map<std::string,float> targetSyntacticPreferencesLHSCounts;
-boost::unordered_map<std::string, boost::unordered_map<std::string,float>* > ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts;
-std::set<std::string> targetSyntacticPreferencesLabelSet;
 std::map<std::string,size_t> targetSyntacticPreferencesLabels;
 std::vector<std::string> targetSyntacticPreferencesLabelsByIndex;
 
@@ -96,6 +93,87 @@ std::vector<float> orientationClassPriorsR2L(4,0); // mono swap dleft dright
 Vocabulary vcbT;
 Vocabulary vcbS;
 
+// Everything scoring counts up besides the phrase table itself.  With
+// several threads, each chunk of the extract file collects its own, to be
+// added to the overall statistics once the chunk is done.
+class ScoreStatistics
+{
+public:
+  typedef boost::unordered_map<std::string,float> LabelCounts;
+  typedef boost::unordered_map<std::string, LabelCounts* > JointLabelCounts;
+
+  int countOfCounts[COC_MAX+1];
+  int totalDistinct;
+
+  LabelCounts sourceLHSCounts;
+  JointLabelCounts targetLHSAndSourceLHSJointCounts;
+  std::set<std::string> sourceLabelSet;
+
+  std::set<std::string> partsOfSpeechSet;
+
+  LabelCounts targetSyntacticPreferencesLHSCounts;
+  JointLabelCounts ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts;
+  std::set<std::string> targetSyntacticPreferencesLabelSet;
+
+  ScoreStatistics() : totalDistinct(0) {
+    std::fill(countOfCounts, countOfCounts + COC_MAX + 1, 0);
+  }
+
+  ~ScoreStatistics() {
+    Clear(targetLHSAndSourceLHSJointCounts);
+    Clear(ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts);
+  }
+
+  void Add(const ScoreStatistics &other) {
+    for (int i=1; i<=COC_MAX; i++) {
+      countOfCounts[i] += other.countOfCounts[i];
+    }
+    totalDistinct += other.totalDistinct;
+    Add(sourceLHSCounts, other.sourceLHSCounts);
+    Add(targetLHSAndSourceLHSJointCounts, other.targetLHSAndSourceLHSJointCounts);
+    sourceLabelSet.insert(other.sourceLabelSet.begin(), other.sourceLabelSet.end());
+    partsOfSpeechSet.insert(other.partsOfSpeechSet.begin(), other.partsOfSpeechSet.end());
+    Add(targetSyntacticPreferencesLHSCounts, other.targetSyntacticPreferencesLHSCounts);
+    Add(ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts, other.ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts);
+    targetSyntacticPreferencesLabelSet.insert(other.targetSyntacticPreferencesLabelSet.begin(), other.targetSyntacticPreferencesLabelSet.end());
+  }
+
+private:
+  static void Add(LabelCounts &counts, const LabelCounts &other) {
+    for (LabelCounts::const_iterator iter=other.begin(); iter!=other.end(); ++iter) {
+      counts[iter->first] += iter->second;
+    }
+  }
+
+  static void Add(JointLabelCounts &counts, const JointLabelCounts &other) {
+    for (JointLabelCounts::const_iterator iter=other.begin(); iter!=other.end(); ++iter) {
+      LabelCounts *&jointCounts = counts[iter->first];
+      if (!jointCounts) {
+        jointCounts = new LabelCounts();
+      }
+      Add(*jointCounts, *iter->second);
+    }
+  }
+
+  static void Clear(JointLabelCounts &counts) {
+    for (JointLabelCounts::iterator iter=counts.begin(); iter!=counts.end(); ++iter) {
+      delete iter->second;
+    }
+    counts.clear();
+  }
+
+  ScoreStatistics(const ScoreStatistics &);
+  ScoreStatistics &operator=(const ScoreStatistics &);
+};
+
+ScoreStatistics scoreStatistics;
+#ifdef WITH_THREADS
+boost::mutex scoreStatisticsMutex;
+#endif
+
+// extract file lines handed to a thread at once, at least
+const size_t CHUNK_SIZE = 10000;
+
 } // namespace
 
 
@@ -104,15 +182,20 @@ void processLine( std::string line,
                   PHRASE *phraseSource, PHRASE *phraseTarget, ALIGNMENT *targetToSourceAlignment,
                   std::string &additionalPropertiesString,
                   float &count, float &pcfgSum );
+bool sameSource( const std::string &line, const std::string &otherLine );
+void scoreChunk( const std::vector<std::string> &lines, int firstLineID, std::ostream &phraseTableFile,
+                 const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb,
+                 ScoreStatistics &statistics );
 void writeCountOfCounts( const std::string &fileNameCountOfCounts );
-void writeLeftHandSideLabelCounts( const boost::unordered_map<std::string,float> &countsLabelLHS,
-                                   const boost::unordered_map<std::string, boost::unordered_map<std::string,float>* > &jointCountsLabelLHS,
+void writeLeftHandSideLabelCounts( const ScoreStatistics::LabelCounts &countsLabelLHS,
+                                   const ScoreStatistics::JointLabelCounts &jointCountsLabelLHS,
                                    const std::string &fileNameLeftHandSideSourceLabelCounts,
                                    const std::string &fileNameLeftHandSideTargetSourceLabelCounts );
 void writeLabelSet( const std::set<std::string> &labelSet, const std::string &fileName );
 void processPhrasePairs( std::vector< ExtractionPhrasePair* > &phrasePairsWithSameSource, std::ostream &phraseTableFile,
-                         const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb );
-void outputPhrasePair(const ExtractionPhrasePair &phrasePair, float, int, std::ostream &phraseTableFile, const ScoreFeatureManager &featureManager, const MaybeLog &maybeLog );
+                         const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb,
+                         ScoreStatistics &statistics );
+void outputPhrasePair(const ExtractionPhrasePair &phrasePair, float, int, std::ostream &phraseTableFile, const ScoreFeatureManager &featureManager, const MaybeLog &maybeLog, ScoreStatistics &statistics );
 double computeLexicalTranslation( const PHRASE *phraseSource, const PHRASE *phraseTarget, const ALIGNMENT *alignmentTargetToSource );
 double computeUnalignedPenalty( const ALIGNMENT *alignmentTargetToSource );
 std::set<std::string> functionWordList;
@@ -125,6 +208,47 @@ void printTargetPhrase( const PHRASE *phraseSource, const PHRASE *phraseTarget,
 void invertAlignment( const PHRASE *phraseSource, const PHRASE *phraseTarget, const ALIGNMENT *inTargetToSourceAlignment, ALIGNMENT *outSourceToTargetAlignment );
 size_t NumNonTerminal(const PHRASE *phraseSource);
 
+#ifdef WITH_THREADS
+// Scores one chunk of the extract file and passes on its part of the phrase
+// table in input order.
+class ScoreChunkTask : public Moses::Task
+{
+public:
+  ScoreChunkTask( int chunkId, int firstLineID, std::vector<std::string> *lines,
+                  Moses::OutputCollector &outputCollector,
+                  const ScoreFeatureManager &featureManager, const MaybeLog &maybeLogProb )
+    : m_chunkId(chunkId)
+    , m_firstLineID(firstLineID)
+    , m_lines(lines)
+    , m_outputCollector(outputCollector)
+    , m_featureManager(featureManager)
+    , m_maybeLogProb(maybeLogProb) {
+  }
+
+  ~ScoreChunkTask() {
+    delete m_lines;
+  }
+
+  void Run() {
+    std::ostringstream out;
+    ScoreStatistics statistics;
+    scoreChunk( *m_lines, m_firstLineID, out, m_featureManager, m_maybeLogProb, statistics );
+    m_outputCollector.Write( m_chunkId, out.str() );
+
+    boost::mutex::scoped_lock lock(scoreStatisticsMutex);
+    scoreStatistics.Add( statistics );
+  }
+
+private:
+  int m_chunkId;
+  int m_firstLineID;
+  std::vector<std::string> *m_lines;
+  Moses::OutputCollector &m_outputCollector;
+  const ScoreFeatureManager &m_featureManager;
+  const MaybeLog &m_maybeLogProb;
+};
+#endif
+
 
 int main(int argc, char* argv[])
 {
@@ -154,7 +278,8 @@ int main(int argc, char* argv[])
               "[--TargetSyntacticPreferences] "
               "[--UnpairedExtractFormat] "
               "[--ConditionOnTargetLHS] "
-              "[--CrossedNonTerm]"
+              "[--CrossedNonTerm] "
+              "[--Threads N]"
               << std::endl;
     std::cerr << featureManager.usage() << std::endl;
     exit(1);
@@ -172,6 +297,7 @@ int main(int argc, char* argv[])
   std::string fileNameLeftHandSideTargetSyntacticPreferencesLabelCounts;
   std::string fileNameLeftHandSideRuleTargetTargetSyntacticPreferencesLabelCounts;
   std::string fileNamePhraseOrientationPriors;
+  size_t threadCount = 1;
   // All unknown args are passed to feature manager.
   std::vector<std::string> featureArgs;
 
@@ -290,6 +416,19 @@ int main(int argc, char* argv[])
     } else if (strcmp(argv[i],"--TargetConstituentBoundaries") == 0) {
       targetConstituentBoundariesFlag = true;
       std::cerr << "including target constituent boundaries information" << std::endl;
+    } else if (strcmp(argv[i],"--Threads") == 0) {
+      if (i+1==argc || std::atoi(argv[i+1]) < 1) {
+        std::cerr << "ERROR: specify a positive number of threads!" << std::endl;
+        exit(1);
+      }
+      threadCount = std::atoi( argv[++i] );
+#ifndef WITH_THREADS
+      if (threadCount > 1) {
+        std::cerr << "ERROR: thread support not compiled in" << std::endl;
+        exit(1);
+      }
+#endif
+      std::cerr << "scoring on " << threadCount << " threads" << std::endl;
     } else {
       featureArgs.push_back(argv[i]);
       ++i;
@@ -317,11 +456,6 @@ int main(int argc, char* argv[])
     loadFunctionWords( fileNameFunctionWords );
   }
 
-  // compute count of counts for Good Turing discounting
-  if (goodTuringFlag || kneserNeyFlag) {
-    for(int i=1; i<=COC_MAX; i++) countOfCounts[i] = 0;
-  }
-
   if (phraseOrientationPriorsFlag) {
     loadOrientationPriors(fileNamePhraseOrientationPriors,orientationClassPriorsL2R,orientationClassPriorsR2L);
   }
@@ -350,8 +484,118 @@ int main(int argc, char* argv[])
     phraseTableFile = outputFile;
   }
 
+  // The extract file is sorted, so all translations of a source phrase
+  // come in one block.  Cut it into chunks at source phrase boundaries and
+  // score the chunks independently, on several threads if asked to.
+#ifdef WITH_THREADS
+  Moses::OutputCollector outputCollector(phraseTableFile, &std::cerr);
+  Moses::ThreadPool *pool = NULL;
+  if (threadCount > 1) {
+    pool = new Moses::ThreadPool(threadCount);
+    pool->SetQueueLimit(threadCount * 2);
+  }
+#endif
+
+  std::vector<std::string> *chunk = new std::vector<std::string>();
+  int chunkId = 0;
+  int firstLineID = 1;
+  std::string line;
+  int i=0;
+  while ( true ) {
+    bool endOfFile = !getline(extractFile, line);
+    if ( endOfFile ||
+         ( chunk->size() >= CHUNK_SIZE && !sameSource(line, chunk->back()) ) ) {
+#ifdef WITH_THREADS
+      if (pool) {
+        pool->Submit( boost::shared_ptr<Moses::Task>(
+                        new ScoreChunkTask( chunkId, firstLineID, chunk, outputCollector,
+                                            featureManager, maybeLogProb ) ) );
+        chunk = new std::vector<std::string>();
+      }
+#endif
+      if (!chunk->empty()) {
+        scoreChunk( *chunk, firstLineID, *phraseTableFile, featureManager, maybeLogProb, scoreStatistics );
+        chunk->clear();
+      }
+      ++chunkId;
+      firstLineID = i+1;
+    }
+    if (endOfFile) {
+      break;
+    }
+
+    // Print progress dots to stderr.
+    if ( ++i % 100000 == 0 ) {
+      std::cerr << "." << std::flush;
+    }
+    chunk->push_back(line);
+  }
+  delete chunk;
+
+#ifdef WITH_THREADS
+  if (pool) {
+    pool->Stop(true);
+    delete pool;
+  }
+#endif
+
+  // We've been printing progress dots to stderr.  End the line.
+  std::cerr << std::endl;
+
+  phraseTableFile->flush();
+  if (phraseTableFile != &std::cout) {
+    delete phraseTableFile;
+  }
+
+  // output count of count statistics
+  if (goodTuringFlag || kneserNeyFlag) {
+    writeCountOfCounts( fileNameCountOfCounts );
+  }
+
+  // source syntax labels
+  if (sourceSyntaxLabelsFlag && !inverseFlag) {
+    writeLabelSet( scoreStatistics.sourceLabelSet, fileNameSourceLabelSet );
+  }
+  if (sourceSyntaxLabelsFlag && sourceSyntaxLabelCountsLHSFlag && !inverseFlag) {
+    writeLeftHandSideLabelCounts( scoreStatistics.sourceLHSCounts,
+                                  scoreStatistics.targetLHSAndSourceLHSJointCounts,
+                                  fileNameLeftHandSideSourceLabelCounts,
+                                  fileNameLeftHandSideTargetSourceLabelCounts );
+  }
+
+  // parts-of-speech
+  if (partsOfSpeechFlag && !inverseFlag) {
+    writeLabelSet( scoreStatistics.partsOfSpeechSet, fileNamePartsOfSpeechSet );
+  }
+
+  // target syntactic preferences labels
+  if (targetSyntacticPreferencesFlag && !inverseFlag) {
+    writeLabelSet( scoreStatistics.targetSyntacticPreferencesLabelSet, fileNameTargetSyntacticPreferencesLabelSet );
+    writeLeftHandSideLabelCounts( scoreStatistics.targetSyntacticPreferencesLHSCounts,
+                                  scoreStatistics.ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts,
+                                  fileNameLeftHandSideTargetSyntacticPreferencesLabelCounts,
+                                  fileNameLeftHandSideRuleTargetTargetSyntacticPreferencesLabelCounts );
+  }
+}
+
+
+bool sameSource( const std::string &line, const std::string &otherLine )
+{
+  size_t sourceEnd = line.find("|||");
+  return sourceEnd != std::string::npos &&
+         otherLine.compare(0, sourceEnd+3, line, 0, sourceEnd+3) == 0;
+}
+
+
+void scoreChunk( const std::vector<std::string> &lines, int firstLineID, std::ostream &phraseTableFile,
+                 const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb,
+                 ScoreStatistics &statistics )
+{
+  if (lines.empty()) {
+    return;
+  }
+
   // loop through all extracted phrase translations
-  std::string line, lastLine;
   ExtractionPhrasePair *phrasePair = NULL;
   std::vector< ExtractionPhrasePair* > phrasePairsWithSameSource;
   std::vector< ExtractionPhrasePair* > phrasePairsWithSameSourceAndTarget; // required for hierarchical rules only, as non-terminal alignments might make the phrases incompatible
@@ -362,49 +606,40 @@ int main(int argc, char* argv[])
   std::string tmpAdditionalPropertiesString;
   float tmpCount=0.0f, tmpPcfgSum=0.0f;
 
-  int i=0;
-  if ( getline(extractFile, line) ) {
-    ++i;
-    tmpPhraseSource = new PHRASE();
-    tmpPhraseTarget = new PHRASE();
-    tmpTargetToSourceAlignment = new ALIGNMENT();
-    processLine( std::string(line),
-                 i, featureManager.includeSentenceId(), tmpSentenceId,
-                 tmpPhraseSource, tmpPhraseTarget, tmpTargetToSourceAlignment,
-                 tmpAdditionalPropertiesString,
-                 tmpCount, tmpPcfgSum);
-    phrasePair = new ExtractionPhrasePair( tmpPhraseSource, tmpPhraseTarget,
-                                           tmpTargetToSourceAlignment,
-                                           tmpCount, tmpPcfgSum );
-    phrasePair->AddProperties( tmpAdditionalPropertiesString, tmpCount );
-    featureManager.addPropertiesToPhrasePair( *phrasePair, tmpCount, tmpSentenceId );
-    phrasePairsWithSameSource.push_back( phrasePair );
-    if ( hierarchicalFlag ) {
-      phrasePairsWithSameSourceAndTarget.push_back( phrasePair );
-    }
-    lastLine = line;
+  int i=firstLineID;
+  tmpPhraseSource = new PHRASE();
+  tmpPhraseTarget = new PHRASE();
+  tmpTargetToSourceAlignment = new ALIGNMENT();
+  processLine( lines[0],
+               i, featureManager.includeSentenceId(), tmpSentenceId,
+               tmpPhraseSource, tmpPhraseTarget, tmpTargetToSourceAlignment,
+               tmpAdditionalPropertiesString,
+               tmpCount, tmpPcfgSum);
+  phrasePair = new ExtractionPhrasePair( tmpPhraseSource, tmpPhraseTarget,
+                                         tmpTargetToSourceAlignment,
+                                         tmpCount, tmpPcfgSum );
+  phrasePair->AddProperties( tmpAdditionalPropertiesString, tmpCount );
+  featureManager.addPropertiesToPhrasePair( *phrasePair, tmpCount, tmpSentenceId );
+  phrasePairsWithSameSource.push_back( phrasePair );
+  if ( hierarchicalFlag ) {
+    phrasePairsWithSameSourceAndTarget.push_back( phrasePair );
   }
 
-  while ( getline(extractFile, line) ) {
-
-    // Print progress dots to stderr.
-    if ( ++i % 100000 == 0 ) {
-      std::cerr << "." << std::flush;
-    }
+  for ( size_t l=1; l<lines.size(); ++l ) {
+    ++i;
+    const std::string &line = lines[l];
 
     // identical to last line? just add count
-    if (line == lastLine) {
+    if (line == lines[l-1]) {
       phrasePair->IncrementPrevious(tmpCount,tmpPcfgSum);
       continue;
-    } else {
-      lastLine = line;
     }
 
     tmpPhraseSource = new PHRASE();
     tmpPhraseTarget = new PHRASE();
     tmpTargetToSourceAlignment = new ALIGNMENT();
     tmpAdditionalPropertiesString.clear();
-    processLine( std::string(line),
+    processLine( line,
                  i, featureManager.includeSentenceId(), tmpSentenceId,
                  tmpPhraseSource, tmpPhraseTarget, tmpTargetToSourceAlignment,
                  tmpAdditionalPropertiesString,
@@ -447,7 +682,7 @@ int main(int argc, char* argv[])
 
       if ( !phrasePairsWithSameSource.empty() &&
            !sourceMatch ) {
-        processPhrasePairs( phrasePairsWithSameSource, *phraseTableFile, featureManager, maybeLogProb );
+        processPhrasePairs( phrasePairsWithSameSource, phraseTableFile, featureManager, maybeLogProb, statistics );
         for ( std::vector< ExtractionPhrasePair* >::const_iterator iter=phrasePairsWithSameSource.begin();
               iter!=phrasePairsWithSameSource.end(); ++iter) {
           delete *iter;
@@ -479,51 +714,12 @@ int main(int argc, char* argv[])
 
   }
 
-  // We've been printing progress dots to stderr.  End the line.
-  std::cerr << std::endl;
-
-  processPhrasePairs( phrasePairsWithSameSource, *phraseTableFile, featureManager, maybeLogProb );
+  processPhrasePairs( phrasePairsWithSameSource, phraseTableFile, featureManager, maybeLogProb, statistics );
   for ( std::vector< ExtractionPhrasePair* >::const_iterator iter=phrasePairsWithSameSource.begin();
         iter!=phrasePairsWithSameSource.end(); ++iter) {
     delete *iter;
   }
   phrasePairsWithSameSource.clear();
-
-
-  phraseTableFile->flush();
-  if (phraseTableFile != &std::cout) {
-    delete phraseTableFile;
-  }
-
-  // output count of count statistics
-  if (goodTuringFlag || kneserNeyFlag) {
-    writeCountOfCounts( fileNameCountOfCounts );
-  }
-
-  // source syntax labels
-  if (sourceSyntaxLabelsFlag && !inverseFlag) {
-    writeLabelSet( sourceLabelSet, fileNameSourceLabelSet );
-  }
-  if (sourceSyntaxLabelsFlag && sourceSyntaxLabelCountsLHSFlag && !inverseFlag) {
-    writeLeftHandSideLabelCounts( sourceLHSCounts,
-                                  targetLHSAndSourceLHSJointCounts,
-                                  fileNameLeftHandSideSourceLabelCounts,
-                                  fileNameLeftHandSideTargetSourceLabelCounts );
-  }
-
-  // parts-of-speech
-  if (partsOfSpeechFlag && !inverseFlag) {
-    writeLabelSet( partsOfSpeechSet, fileNamePartsOfSpeechSet );
-  }
-
-  // target syntactic preferences labels
-  if (targetSyntacticPreferencesFlag && !inverseFlag) {
-    writeLabelSet( targetSyntacticPreferencesLabelSet, fileNameTargetSyntacticPreferencesLabelSet );
-    writeLeftHandSideLabelCounts( targetSyntacticPreferencesLHSCounts,
-                                  ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts,
-                                  fileNameLeftHandSideTargetSyntacticPreferencesLabelCounts,
-                                  fileNameLeftHandSideRuleTargetTargetSyntacticPreferencesLabelCounts );
-  }
 }
 
 
@@ -610,18 +806,18 @@ void writeCountOfCounts( const std::string &fileNameCountOfCounts )
   }
 
   // Kneser-Ney needs the total number of phrase pairs
-  countOfCountsFile << totalDistinct << std::endl;
+  countOfCountsFile << scoreStatistics.totalDistinct << std::endl;
 
   // write out counts
   for(int i=1; i<=COC_MAX; i++) {
-    countOfCountsFile << countOfCounts[ i ] << std::endl;
+    countOfCountsFile << scoreStatistics.countOfCounts[ i ] << std::endl;
   }
   countOfCountsFile.Close();
 }
 
 
-void writeLeftHandSideLabelCounts( const boost::unordered_map<std::string,float> &countsLabelLHS,
-                                   const boost::unordered_map<std::string, boost::unordered_map<std::string,float>* > &jointCountsLabelLHS,
+void writeLeftHandSideLabelCounts( const ScoreStatistics::LabelCounts &countsLabelLHS,
+                                   const ScoreStatistics::JointLabelCounts &jointCountsLabelLHS,
                                    const std::string &fileNameLeftHandSideSourceLabelCounts,
                                    const std::string &fileNameLeftHandSideTargetSourceLabelCounts )
 {
@@ -635,8 +831,8 @@ void writeLeftHandSideLabelCounts( const boost::unordered_map<std::string,float>
   }
 
   // write source left-hand side counts
-  for (boost::unordered_map<std::string,float>::const_iterator iter=sourceLHSCounts.begin();
-       iter!=sourceLHSCounts.end(); ++iter) {
+  for (ScoreStatistics::LabelCounts::const_iterator iter=countsLabelLHS.begin();
+       iter!=countsLabelLHS.end(); ++iter) {
     leftHandSideSourceLabelCounts << iter->first << " " << iter->second << std::endl;
   }
 
@@ -652,9 +848,9 @@ void writeLeftHandSideLabelCounts( const boost::unordered_map<std::string,float>
   }
 
   // write source left-hand side / target left-hand side joint counts
-  for (boost::unordered_map<std::string, boost::unordered_map<std::string,float>* >::const_iterator iter=targetLHSAndSourceLHSJointCounts.begin();
-       iter!=targetLHSAndSourceLHSJointCounts.end(); ++iter) {
-    for (boost::unordered_map<std::string,float>::const_iterator iter2=(iter->second)->begin();
+  for (ScoreStatistics::JointLabelCounts::const_iterator iter=jointCountsLabelLHS.begin();
+       iter!=jointCountsLabelLHS.end(); ++iter) {
+    for (ScoreStatistics::LabelCounts::const_iterator iter2=(iter->second)->begin();
          iter2!=(iter->second)->end(); ++iter2) {
       leftHandSideTargetSourceLabelCounts << iter->first << " "<< iter2->first << " " << iter2->second << std::endl;
     }
@@ -685,7 +881,8 @@ void writeLabelSet( const std::set<std::string> &labelSet, const std::string &fi
 
 
 void processPhrasePairs( std::vector< ExtractionPhrasePair* > &phrasePairsWithSameSource, std::ostream &phraseTableFile,
-                         const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb )
+                         const ScoreFeatureManager& featureManager, const MaybeLog& maybeLogProb,
+                         ScoreStatistics &statistics )
 {
   if (phrasePairsWithSameSource.size() == 0) {
     return;
@@ -706,7 +903,7 @@ void processPhrasePairs( std::vector< ExtractionPhrasePair* > &phrasePairsWithSa
   for ( std::vector< ExtractionPhrasePair* >::const_iterator iter=phrasePairsWithSameSource.begin();
         iter!=phrasePairsWithSameSource.end(); ++iter) {
     // add to total count
-    outputPhrasePair( **iter, totalSource, phrasePairsWithSameSource.size(), phraseTableFile, featureManager, maybeLogProb );
+    outputPhrasePair( **iter, totalSource, phrasePairsWithSameSource.size(), phraseTableFile, featureManager, maybeLogProb, statistics );
   }
 }
 
@@ -714,7 +911,8 @@ void outputPhrasePair(const ExtractionPhrasePair &phrasePair,
                       float totalCount, int distinctCount,
                       std::ostream &phraseTableFile,
                       const ScoreFeatureManager& featureManager,
-                      const MaybeLog& maybeLogProb )
+                      const MaybeLog& maybeLogProb,
+                      ScoreStatistics &statistics )
 {
   assert(phrasePair.IsValid());
 
@@ -725,11 +923,11 @@ void outputPhrasePair(const ExtractionPhrasePair &phrasePair,
 
   // collect count of count statistics
   if (goodTuringFlag || kneserNeyFlag) {
-    totalDistinct++;
+    statistics.totalDistinct++;
     int countInt = count + 0.99999;
     if ((countInt <= COC_MAX) &&
         (countInt > 0))
-      countOfCounts[ countInt ]++;
+      statistics.countOfCounts[ countInt ]++;
   }
 
   // output phrases
@@ -874,7 +1072,7 @@ void outputPhrasePair(const ExtractionPhrasePair &phrasePair,
 
   // parts-of-speech
   if (partsOfSpeechFlag && !inverseFlag) {
-    phrasePair.UpdateVocabularyFromValueTokens("POS", partsOfSpeechSet);
+    phrasePair.UpdateVocabularyFromValueTokens("POS", statistics.partsOfSpeechSet);
     const std::string *bestPartOfSpeech = phrasePair.FindBestPropertyValue("POS");
     if (bestPartOfSpeech) {
       phraseTableFile << " {{POS " << *bestPartOfSpeech << "}}";
@@ -892,9 +1090,9 @@ void outputPhrasePair(const ExtractionPhrasePair &phrasePair,
     if (sourceSyntaxLabelsFlag) {
       std::string sourceLabelCounts;
       sourceLabelCounts = phrasePair.CollectAllLabelsSeparateLHSAndRHS("SourceLabels",
-                          sourceLabelSet,
-                          sourceLHSCounts,
-                          targetLHSAndSourceLHSJointCounts,
+                          statistics.sourceLabelSet,
+                          statistics.sourceLHSCounts,
+                          statistics.targetLHSAndSourceLHSJointCounts,
                           vcbT);
       if ( !sourceLabelCounts.empty() ) {
         phraseTableFile << " {{SourceLabels "
@@ -909,9 +1107,9 @@ void outputPhrasePair(const ExtractionPhrasePair &phrasePair,
     if (targetSyntacticPreferencesFlag) {
       std::string targetSyntacticPreferencesLabelCounts;
       targetSyntacticPreferencesLabelCounts = phrasePair.CollectAllLabelsSeparateLHSAndRHS("TargetPreferences",
-                                              targetSyntacticPreferencesLabelSet,
-                                              targetSyntacticPreferencesLHSCounts,
-                                              ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts,
+                                              statistics.targetSyntacticPreferencesLabelSet,
+                                              statistics.targetSyntacticPreferencesLHSCounts,
+                                              statistics.ruleTargetLHSAndTargetSyntacticPreferencesLHSJointCounts,
                                               vcbT);
       if (!targetSyntacticPreferencesLabelCounts.empty()) {
         phraseTableFile << " {{TargetPreferences "
@@ -1219,7 +1417,7 @@ void LexicalTable::load( const std::string &fileName )
     double prob = std::atof( token[2].c_str() );
     WORD_ID wordT = vcbT.storeIfNew( token[0] );
     WORD_ID wordS = vcbS.storeIfNew( token[1] );
-    ltable[ wordS ][ wordT ] = prob;
+    ltable[ key( wordS, wordT ) ] = prob;
   }
   std::cerr << std::endl;
 }
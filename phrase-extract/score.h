@@ -20,21 +20,30 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
 
 namespace MosesTraining
 {
 class LexicalTable
 {
 public:
-  std::map< WORD_ID, std::map< WORD_ID, double > > ltable;
   void load( const std::string &filePath );
-  double permissiveLookup( WORD_ID wordS, WORD_ID wordT ) {
-    // cout << endl << vcbS.getWord( wordS ) << "-" << vcbT.getWord( wordT ) << ":";
-    if (ltable.find( wordS ) == ltable.end()) return 1.0;
-    if (ltable[ wordS ].find( wordT ) == ltable[ wordS ].end()) return 1.0;
-    // cout << ltable[ wordS ][ wordT ];
-    return ltable[ wordS ][ wordT ];
+  // read-only once loaded, so scoring threads may share it
+  double permissiveLookup( WORD_ID wordS, WORD_ID wordT ) const {
+    Table::const_iterator i = ltable.find( key( wordS, wordT ) );
+    if (i == ltable.end()) return 1.0;
+    return i->second;
+  }
+
+private:
+  // one flat table keyed on the word pair instead of a map of maps
+  typedef boost::unordered_map< uint64_t, double > Table;
+  Table ltable;
+
+  static uint64_t key( WORD_ID wordS, WORD_ID wordT ) {
+    return (static_cast<uint64_t>(wordS) << 32) | wordT;
   }
 };
 
@@ -11,22 +11,55 @@ using namespace std;
 namespace MosesTraining
 {
 
+Vocabulary::Vocabulary()
+  : m_blocks( new WORD*[ ( (WORD_ID) -1 >> BLOCK_BITS ) + 1 ]() )
+  , m_size( 0 )
+{
+}
+
+Vocabulary::~Vocabulary()
+{
+  for( WORD_ID b = 0; b * BLOCK_SIZE < m_size; ++b ) {
+    delete[] m_blocks[ b ];
+  }
+}
+
 WORD_ID Vocabulary::storeIfNew( const WORD& word )
 {
-  map<WORD, WORD_ID>::iterator i = lookup.find( word );
+  {
+    // read-lock scope
+#ifdef WITH_THREADS
+    boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
+#endif
+    boost::unordered_map<WORD, WORD_ID>::const_iterator i = lookup.find( word );
+    if( i != lookup.end() )
+      return i->second;
+  }
 
+#ifdef WITH_THREADS
+  boost::unique_lock<boost::shared_mutex> lock(m_accessLock);
+#endif
+  // another thread may have added it in the meantime
+  boost::unordered_map<WORD, WORD_ID>::const_iterator i = lookup.find( word );
   if( i != lookup.end() )
     return i->second;
 
-  WORD_ID id = vocab.size();
-  vocab.push_back( word );
+  WORD_ID id = m_size;
+  if( ( id & ( BLOCK_SIZE - 1 ) ) == 0 ) {
+    m_blocks[ id >> BLOCK_BITS ] = new WORD[ BLOCK_SIZE ];
+  }
+  getWord( id ) = word;
+  ++m_size;
   lookup[ word ] = id;
   return id;
 }
 
 WORD_ID Vocabulary::getWordID( const WORD& word )
 {
-  map<WORD, WORD_ID>::iterator i = lookup.find( word );
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
+#endif
+  boost::unordered_map<WORD, WORD_ID>::const_iterator i = lookup.find( word );
   if( i == lookup.end() )
     return 0;
   return i->second;
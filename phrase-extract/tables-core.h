@@ -12,6 +12,14 @@
 #include <map>
 #include <cmath>
 
+#include <boost/scoped_array.hpp>
+#include <boost/unordered_map.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#endif
+
 namespace MosesTraining
 {
 
@@ -21,13 +29,35 @@ typedef unsigned int WORD_ID;
 class Vocabulary
 {
 public:
-  std::map<WORD, WORD_ID>  lookup;
-  std::vector< WORD > vocab;
+  Vocabulary();
+  ~Vocabulary();
+
+  boost::unordered_map<WORD, WORD_ID> lookup;
   WORD_ID storeIfNew( const WORD& );
   WORD_ID getWordID( const WORD& );
+  // Takes no lock: stored words never move, so an id can be looked up
+  // while other threads add words, once it has reached this thread through
+  // storeIfNew() or a task queue.
   inline WORD &getWord( const WORD_ID id ) {
-    return vocab[ id ];
+    return m_blocks[ id >> BLOCK_BITS ][ id & ( BLOCK_SIZE - 1 ) ];
   }
+
+protected:
+  // Words are kept in blocks of BLOCK_SIZE, allocated as needed. The table
+  // of blocks has room for every WORD_ID, so it never grows either.
+  static const unsigned int BLOCK_BITS = 16;
+  static const WORD_ID BLOCK_SIZE = 1u << BLOCK_BITS;
+  boost::scoped_array< WORD* > m_blocks;
+  WORD_ID m_size;
+
+#ifdef WITH_THREADS
+  //reader-writer lock for lookup and adding words
+  mutable boost::shared_mutex m_accessLock;
+#endif
+
+private:
+  Vocabulary( const Vocabulary& );
+  Vocabulary &operator=( const Vocabulary& );
 };
 
 typedef std::vector< WORD_ID > PHRASE;
@@ -14,11 +14,14 @@
 #include <cstring>
 #include "cmd.h"
 
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
 using namespace std;
 
-const int MAX_WORD = 10000;  // maximum lengthsource/target strings
-const int MAX_M = 400;       // maximum length of source strings
-const int MAX_N = 400;       // maximum length of target strings
+const size_t BLOCK_SIZE = 10000; // sentence pairs read and symmetrized at a time
 
 enum Alignment {
   UNION = 1,
@@ -56,63 +59,72 @@ Enum_T BoolEnum [] = {
   END_ENUM
 };
 
-// global variables and constants
+//one sentence pair: the direct alignment a[1..m] and the inverse
+//alignment b[1..n], 0 for unaligned words
+
+struct SentencePair {
+  int m, n;
+  vector<int> a, b;
+};
+
+//buffers of printgrow(), one set per thread
 
-int* fa; //counters of covered foreign positions
-int* ea; //counters of covered english positions
-int** A; //alignment matrix with information symmetric/direct/inverse alignments
+struct GrowBuffers {
+  vector<int> fa; //counters of covered foreign positions
+  vector<int> ea; //counters of covered english positions
+  vector<int> matrix;
+  vector<int*> A; //rows of the alignment matrix with information symmetric/direct/inverse alignments
+
+  void Reset(int m, int n) {
+    fa.assign(m+1,0);
+    ea.assign(n+1,0);
+    matrix.assign((n+1)*(m+1),0);
+    A.resize(n+1);
+    for (int i=0; i<=n; i++) A[i]=&matrix[i*(m+1)];
+  }
+};
+
+struct Heuristic {
+  int alignment;
+  bool diagonal;
+  bool isfinal;
+  bool bothuncovered;
+};
 
 int verbose=0;
 
 //read an alignment pair from the input stream.
 
-int lc = 0;
-
-int getals(istream& inp,int& m, int *a,int& n, int *b)
+int getals(istream& inp,SentencePair& p)
 {
-  char w[MAX_WORD], dummy[10];
+  string w;
   int i,j,freq;
   if (inp >> freq) {
-    ++lc;
     //target sentence
-    inp >> n;
-    assert(n<MAX_N);
-    for (i=1; i<=n; i++) {
-      inp >> setw(MAX_WORD) >> w;
-      if (strlen(w)>=MAX_WORD-1) {
-        cerr << lc << ": target len=" << strlen(w) << " is not less than MAX_WORD-1="
-             << MAX_WORD-1 << endl;
-        assert(strlen(w)<MAX_WORD-1);
-      }
-    }
+    inp >> p.n;
+    for (i=1; i<=p.n; i++) inp >> w;
 
-    inp >> dummy; //# separator
+    inp >> w; //# separator
     // inverse alignment
-    for (i=1; i<=n; i++) inp >> b[i];
+    p.b.resize(p.n+1);
+    for (i=1; i<=p.n; i++) inp >> p.b[i];
 
     //source sentence
-    inp >> m;
-    assert(m<MAX_M);
-    for (j=1; j<=m; j++) {
-      inp >> setw(MAX_WORD) >> w;
-      if (strlen(w)>=MAX_WORD-1) {
-        cerr << lc << ": source len=" << strlen(w) << " is not less than MAX_WORD-1="
-             << MAX_WORD-1 << endl;
-        assert(strlen(w)<MAX_WORD-1);
-      }
-    }
+    inp >> p.m;
+    for (j=1; j<=p.m; j++) inp >> w;
 
-    inp >> dummy; //# separator
+    inp >> w; //# separator
 
     // direct alignment
-    for (j=1; j<=m; j++) {
-      inp >> a[j];
-      assert(0<=a[j] && a[j]<=n);
+    p.a.resize(p.m+1);
+    for (j=1; j<=p.m; j++) {
+      inp >> p.a[j];
+      assert(0<=p.a[j] && p.a[j]<=p.n);
     }
 
     //check inverse alignemnt
-    for (i=1; i<=n; i++)
-      assert(0<=b[i] && b[i]<=m);
+    for (i=1; i<=p.n; i++)
+      assert(0<=p.b[i] && p.b[i]<=p.m);
 
     return 1;
 
@@ -143,7 +155,6 @@ int prunionalignment(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
@@ -168,7 +179,6 @@ int printersect(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
@@ -192,7 +202,6 @@ int printtgttosrc(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
@@ -216,7 +225,6 @@ int printsrctotgt(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
@@ -227,7 +235,7 @@ int printsrctotgt(ostream& out,int m,int *a,int n,int* b)
 //to represent the grow alignment as the unionalignment of a
 //directed and inverted alignment
 
-int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool isfinal=false,bool bothuncovered=false)
+int printgrow(ostream& out,int m,int *a,int n,int* b, GrowBuffers& buffers, bool diagonal=false,bool isfinal=false,bool bothuncovered=false)
 {
 
   ostringstream sout;
@@ -254,15 +262,14 @@ int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool i
   size_t o;
 
 
-  //covered foreign and english positions
-
-  memset(fa,0,(m+1)*sizeof(int));
-  memset(ea,0,(n+1)*sizeof(int));
-
+  //covered foreign and english positions, and
   //matrix to quickly check if one point is in the symmetric
   //alignment (value=2), direct alignment (=1) and inverse alignment
 
-  for (int i=1; i<=n; i++) memset(A[i],0,(m+1)*sizeof(int));
+  buffers.Reset(m,n);
+  int *fa=&buffers.fa[0];
+  int *ea=&buffers.ea[0];
+  int **A=&buffers.A[0];
 
   set <pair <int,int> > currentpoints; //symmetric alignment
   set <pair <int,int> > unionalignment; //union alignment
@@ -378,12 +385,73 @@ int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool i
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
   return 1;
 
   return 1;
 }
 
+//symmetrize the sentence pairs [start,end) of a block
+
+void symmetrize(vector<SentencePair>* block,size_t start,size_t end,const Heuristic* h,string* result)
+{
+  ostringstream out;
+  GrowBuffers buffers;
+  for (size_t s=start; s<end; s++) {
+    SentencePair& p=(*block)[s];
+    int *a=&p.a[0], *b=&p.b[0];
+    switch (h->alignment) {
+    case UNION:
+      prunionalignment(out,p.m,a,p.n,b);
+      break;
+    case INTERSECT:
+      printersect(out,p.m,a,p.n,b);
+      break;
+    case GROW:
+      printgrow(out,p.m,a,p.n,b,buffers,h->diagonal,h->isfinal,h->bothuncovered);
+      break;
+    case TGTTOSRC:
+      printtgttosrc(out,p.m,a,p.n,b);
+      break;
+    case SRCTOTGT:
+      printsrctotgt(out,p.m,a,p.n,b);
+      break;
+    }
+  }
+  *result=out.str();
+}
+
+//read blocks of sentence pairs, symmetrize each block on several threads,
+//and write the output in the order of the input
+
+int symmetrizeall(istream& inp,ostream& out,const Heuristic& h,int threads)
+{
+  vector<SentencePair> block(BLOCK_SIZE);
+  vector<string> results(threads);
+  int sents=0;
+  bool more=true;
+  while (more) {
+    size_t size=0;
+    while (size<BLOCK_SIZE && getals(inp,block[size])) size++;
+    more = size==BLOCK_SIZE;
+
+#ifdef WITH_THREADS
+    boost::thread_group workers;
+    for (int t=1; t<threads; t++)
+      workers.create_thread(boost::bind(&symmetrize,&block,size*t/threads,size*(t+1)/threads,&h,&results[t]));
+    symmetrize(&block,0,size/threads,&h,&results[0]);
+    workers.join_all();
+#else
+    for (int t=0; t<threads; t++)
+      symmetrize(&block,size*t/threads,size*(t+1)/threads,&h,&results[t]);
+#endif
+
+    for (int t=0; t<threads; t++) out << results[t];
+    sents+=size;
+  }
+  out.flush();
+  return sents;
+}
+
 } // namespace
 
 
@@ -399,6 +467,7 @@ int main(int argc, char** argv)
   int diagonal=false;
   int isfinal=false;
   int bothuncovered=false;
+  int threads=1;
 
 
   DeclareParams("a", CMDENUMTYPE,  &alignment, AlignEnum,
@@ -411,6 +480,8 @@ int main(int argc, char** argv)
                 "both", CMDENUMTYPE,  &bothuncovered, BoolEnum,
                 "i", CMDSTRINGTYPE, &input,
                 "o", CMDSTRINGTYPE, &output,
+                "t", CMDINTTYPE, &threads,
+                "threads", CMDINTTYPE, &threads,
                 "v", CMDENUMTYPE,  &verbose, BoolEnum,
                 "verbose", CMDENUMTYPE,  &verbose, BoolEnum,
 
@@ -419,7 +490,7 @@ int main(int argc, char** argv)
   GetParams(&argc, &argv, NULL);
 
   if (alignment==0) {
-    cerr << "usage: symal [-i=<inputfile>] [-o=<outputfile>] -a=[u|i|g] -d=[yes|no] -b=[yes|no] -f=[yes|no] \n"
+    cerr << "usage: symal [-i=<inputfile>] [-o=<outputfile>] -a=[u|i|g] -d=[yes|no] -b=[yes|no] -f=[yes|no] [-t=<threads>]\n"
          << "Input file or std must be in .bal format (see script giza2bal.pl).\n";
 
     exit(1);
@@ -441,73 +512,44 @@ int main(int argc, char** argv)
       out = fout;
     }
 
-    int a[MAX_M],b[MAX_N],m,n;
-    fa=new int[MAX_M+1];
-    ea=new int[MAX_N+1];
-
-
-    int sents = 0;
-    A=new int *[MAX_N+1];
-    for (int i=1; i<=MAX_N; i++) A[i]=new int[MAX_M+1];
+    if (threads<1) threads=1;
+    Heuristic h;
+    h.alignment=alignment;
+    h.diagonal=diagonal;
+    h.isfinal=isfinal;
+    h.bothuncovered=bothuncovered;
 
     switch (alignment) {
     case UNION:
       cerr << "symal: computing union alignment\n";
-      while(getals(*inp,m,a,n,b)) {
-        prunionalignment(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     case INTERSECT:
       cerr << "symal: computing intersect alignment\n";
-      while(getals(*inp,m,a,n,b)) {
-        printersect(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     case GROW:
       cerr << "symal: computing grow alignment: diagonal ("
            << diagonal << ") final ("<< isfinal << ")"
            <<  "both-uncovered (" << bothuncovered <<")\n";
-
-      while(getals(*inp,m,a,n,b))
-        printgrow(*out,m,a,n,b,diagonal,isfinal,bothuncovered);
-
       break;
     case TGTTOSRC:
       cerr << "symal: computing target-to-source alignment\n";
-
-      while(getals(*inp,m,a,n,b)) {
-        printtgttosrc(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     case SRCTOTGT:
       cerr << "symal: computing source-to-target alignment\n";
-
-      while(getals(*inp,m,a,n,b)) {
-        printsrctotgt(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     default:
       throw runtime_error("Unknown alignment");
     }
 
-    delete [] fa;
-    delete [] ea;
-    for (int i=1; i<=MAX_N; i++) delete [] A[i];
-    delete [] A;
+    int sents = symmetrizeall(*inp,*out,h,threads);
+    if (alignment != GROW)
+      cerr << "Sents: " << sents << endl;
 
     if (inp != &std::cin) {
       delete inp;
     }
     if (out != &std::cout) {
-      delete inp;
+      delete out;
     }
   } catch (const std::exception &e) {
     cerr << e.what() << std::endl;
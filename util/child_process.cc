@@ -0,0 +1,94 @@
+#include "util/child_process.hh"
+
+#include "util/exception.hh"
+
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+namespace {
+const std::size_t kReadSize = 65536;
+} // namespace
+
+ChildProcess::ChildProcess(const std::vector<std::string> &argv)
+  : pid_(-1), read_buffer_(kReadSize), read_begin_(0), read_end_(0) {
+#if defined(_WIN32) || defined(_WIN64)
+  UTIL_THROW(Exception, "Running " << argv[0] << " as a child process is not supported on Windows");
+#else
+  UTIL_THROW_IF(argv.empty(), Exception, "No program to run");
+  int to_child[2], from_child[2];
+  UTIL_THROW_IF(pipe(to_child), ErrnoException, "pipe failed");
+  scoped_fd child_in(to_child[0]), in(to_child[1]);
+  UTIL_THROW_IF(pipe(from_child), ErrnoException, "pipe failed");
+  scoped_fd out(from_child[0]), child_out(from_child[1]);
+  // Keep our ends out of this and any later children.
+  UTIL_THROW_IF(fcntl(in.get(), F_SETFD, FD_CLOEXEC) || fcntl(out.get(), F_SETFD, FD_CLOEXEC), ErrnoException, "fcntl failed");
+
+  std::vector<char*> args;
+  for (std::size_t i = 0; i < argv.size(); ++i) {
+    args.push_back(const_cast<char*>(argv[i].c_str()));
+  }
+  args.push_back(NULL);
+
+  pid_ = fork();
+  UTIL_THROW_IF(pid_ == -1, ErrnoException, "fork failed for " << argv[0]);
+  if (pid_ == 0) {
+    if (dup2(child_in.get(), 0) == -1 || dup2(child_out.get(), 1) == -1) _exit(127);
+    close(child_in.release());
+    close(child_out.release());
+    execvp(args[0], &args[0]);
+    _exit(127);
+  }
+  in_.reset(in.release());
+  out_.reset(out.release());
+#endif
+}
+
+ChildProcess::~ChildProcess() {
+#if !defined(_WIN32) && !defined(_WIN64)
+  try {
+    Flush();
+  } catch (const util::Exception &) {}
+  in_.reset();
+  out_.reset();
+  int status;
+  if (pid_ > 0) waitpid(pid_, &status, 0);
+#endif
+}
+
+void ChildProcess::Write(const StringPiece &data) {
+  write_buffer_.append(data.data(), data.size());
+}
+
+void ChildProcess::Flush() {
+  if (write_buffer_.empty()) return;
+  WriteOrThrow(in_.get(), write_buffer_.data(), write_buffer_.size());
+  write_buffer_.clear();
+}
+
+bool ChildProcess::ReadLine(std::string &line) {
+  line.clear();
+  while (true) {
+    const char *begin = &read_buffer_[0] + read_begin_;
+    const char *newline = static_cast<const char*>(std::memchr(begin, '\n', read_end_ - read_begin_));
+    if (newline) {
+      line.append(begin, newline);
+      read_begin_ += newline - begin + 1;
+      return true;
+    }
+    line.append(begin, read_end_ - read_begin_);
+    read_begin_ = read_end_ = 0;
+    // Blocks only until something arrives, unlike ReadOrEOF.
+    read_end_ = PartialRead(out_.get(), &read_buffer_[0], read_buffer_.size());
+    if (!read_end_) return !line.empty();
+  }
+}
+
+} // namespace util
@@ -0,0 +1,50 @@
+#ifndef UTIL_CHILD_PROCESS_H
+#define UTIL_CHILD_PROCESS_H
+
+/* Run a long-lived program and talk to it line by line over its stdin and
+ * stdout, e.g. a second decoder that is too expensive to start per request.
+ * POSIX only.
+ */
+
+#include "util/file.hh"
+#include "util/string_piece.hh"
+
+#include <string>
+#include <vector>
+
+namespace util {
+
+class ChildProcess {
+  public:
+    // argv[0] is looked up in PATH.  The child inherits stderr.
+    explicit ChildProcess(const std::vector<std::string> &argv);
+
+    // Closes the child's stdin and waits for it to exit.
+    ~ChildProcess();
+
+    // Write to the child's stdin.  Call Flush before waiting for an answer.
+    // The child's answers are not read meanwhile, so a child that answers
+    // as it reads must not be sent more than a pipe buffer at once.
+    void Write(const StringPiece &data);
+    void Flush();
+
+    // Read a line from the child's stdout, without the newline.  Returns
+    // false at end of file.
+    bool ReadLine(std::string &line);
+
+  private:
+    int pid_;
+    scoped_fd in_, out_;
+
+    std::string write_buffer_;
+
+    std::vector<char> read_buffer_;
+    std::size_t read_begin_, read_end_;
+
+    ChildProcess(const ChildProcess &);
+    ChildProcess &operator=(const ChildProcess &);
+};
+
+} // namespace util
+
+#endif // UTIL_CHILD_PROCESS_H
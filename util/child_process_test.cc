@@ -0,0 +1,41 @@
+#include "util/child_process.hh"
+
+#define BOOST_TEST_MODULE ChildProcessTest
+#include <boost/test/unit_test.hpp>
+
+namespace util {
+namespace {
+
+BOOST_AUTO_TEST_CASE(Conversation) {
+  std::vector<std::string> argv;
+  argv.push_back("cat");
+  ChildProcess cat(argv);
+  std::string line;
+  // Answers arrive before the child sees end of file.
+  for (int i = 0; i < 3; ++i) {
+    cat.Write("hello\nworld\n");
+    cat.Flush();
+    BOOST_REQUIRE(cat.ReadLine(line));
+    BOOST_CHECK_EQUAL("hello", line);
+    BOOST_REQUIRE(cat.ReadLine(line));
+    BOOST_CHECK_EQUAL("world", line);
+  }
+  // Less than a pipe buffer: cat answers while we are still writing.
+  std::string big(30000, 'x');
+  cat.Write(big);
+  cat.Write("\n");
+  cat.Flush();
+  BOOST_REQUIRE(cat.ReadLine(line));
+  BOOST_CHECK_EQUAL(big, line);
+}
+
+BOOST_AUTO_TEST_CASE(MissingProgram) {
+  std::vector<std::string> argv;
+  argv.push_back("/nonexistent/program");
+  ChildProcess missing(argv);
+  std::string line;
+  BOOST_CHECK(!missing.ReadLine(line));
+}
+
+}
+} // namespace util
@@ -208,6 +208,13 @@ template <class EntryT, class HashT, class EqualT = std::equal_to<typename Entry
       return FindFromIdeal(key, out);
     }
 
+    // Hint that key will be looked up soon: start loading its ideal bucket.
+    template <class Key> void Prefetch(const Key key) const {
+#if defined(__GNUC__)
+      __builtin_prefetch(Ideal(key));
+#endif
+    }
+
     // Like Find but we're sure it must be there.
     template <class Key> ConstIterator MustFind(const Key key) const {
       for (ConstIterator i(Ideal(key));; mod_.Next(begin_, end_, i)) {